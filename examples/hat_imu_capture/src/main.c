@@ -0,0 +1,329 @@
+#include <stdio.h>
+#include <string.h>
+#include <pico/stdlib.h>
+
+#include <FreeRTOS.h>
+#include <queue.h>
+#include <task.h>
+
+#include <tusb.h>
+#include "usbSerialDebug/helper.h"
+#include <tkjhat/sdk.h>
+#include <tkjhat/imu_timebase.h>
+
+#if CFG_TUSB_OS != OPT_OS_FREERTOS
+#error "This should be using FREERTOS but the CFG_TUSB_OS is not OPT_OS_FREERTOS"
+#endif
+
+// High-rate IMU capture.
+//
+// Samples are read from the IMU FIFO in batches into a ring in RAM, with no
+// formatting or printing while the capture runs. When the window is complete
+// the ring is sent over CDC1 as packed binary. Every sample is stamped from
+// the FIFO timestamps (tkjhat/imu_timebase.h), so the times do not depend on
+// when the FIFO was read. CDC0 is used for the log messages.
+// tools/imu_capture.py starts a capture and writes CSV / .npy.
+//
+// Commands on CDC1 (one per line):
+//   C [odr_hz] [ms] [accel_fsr_g] [gyro_fsr_dps]   capture, then dump
+//   D                                              dump the last capture again
+// Button 1 starts a capture with the default values.
+
+#define CDC_ITF_DATA            1
+
+#define CAPTURE_MAX_SAMPLES     4096    // 72 KB of RAM, 2.56 s at 1600 Hz
+#define CAPTURE_ODR_DEFAULT     1600
+#define CAPTURE_MS_DEFAULT      2000
+#define CAPTURE_AFSR_DEFAULT    16
+#define CAPTURE_GFSR_DEFAULT    2000
+#define FIFO_READ_PERIOD_MS     10      // 16 samples at 1600 Hz, the FIFO holds 128
+#define FIFO_CAPACITY           128
+
+// Dump format, little endian:
+//   capture_header_t, then sample_count * capture_sample_t
+//   (ax, ay, az, gx, gy, gz, temp as int16, raw sensor LSB, then the time of
+//   the sample in us since the first one as uint32).
+#define CAPTURE_MAGIC           "TKJC"
+#define CAPTURE_VERSION         2
+#define CAPTURE_FLAG_FIFO_FULL  0x01    // the FIFO overflowed: samples lost in the middle (see fifo_lost)
+#define CAPTURE_FLAG_WRAPPED    0x02    // window longer than the ring: only the last samples were kept
+
+typedef struct __attribute__((packed)) {
+    char magic[4];
+    uint8_t version;
+    uint8_t flags;
+    uint8_t sample_size;
+    uint8_t channels;
+    uint16_t odr_hz;
+    uint16_t accel_fsr_g;
+    uint16_t gyro_fsr_dps;
+    uint16_t fifo_lost;         // samples lost in FIFO overflows (saturates at 65535)
+    uint32_t sample_count;      // samples in the dump
+    uint32_t dropped;           // samples overwritten in the ring
+    uint32_t duration_us;       // time between the first and the last sample
+    uint32_t crc32;             // CRC-32 (zlib) of the samples
+} capture_header_t;
+
+_Static_assert(sizeof(capture_header_t) == 32, "capture header must be 32 bytes");
+
+typedef struct __attribute__((packed)) {
+    icm42670_raw_sample_t s;
+    uint32_t time_us;
+} capture_sample_t;
+
+_Static_assert(sizeof(capture_sample_t) == 18, "samples are sent as 7 x int16 + uint32");
+
+typedef struct {
+    char cmd;                   // 'C' or 'D'
+    uint16_t odr_hz;
+    uint16_t ms;
+    uint16_t accel_fsr_g;
+    uint16_t gyro_fsr_dps;
+} capture_cmd_t;
+
+static capture_sample_t ring[CAPTURE_MAX_SAMPLES];
+static uint32_t ring_written;   // total samples written (ring index = ring_written % size)
+static capture_header_t last_header;
+static bool have_capture = false;
+
+static QueueHandle_t cmd_queue;
+
+static uint32_t crc32_update(uint32_t crc, const uint8_t *p, size_t len) {
+    crc = ~crc;
+    while (len--) {
+        crc ^= *p++;
+        for (int k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+    }
+    return ~crc;
+}
+
+// Index in the ring of the i-th sample of the capture (oldest first)
+static uint32_t ring_index(uint32_t i) {
+    uint32_t first = ring_written > CAPTURE_MAX_SAMPLES ? ring_written - CAPTURE_MAX_SAMPLES : 0;
+    return (first + i) % CAPTURE_MAX_SAMPLES;
+}
+
+static bool imu_configure(const capture_cmd_t *c) {
+    if (ICM42670_enable_accel_gyro_ln_mode() != 0 ||
+        ICM42670_startAccel(c->odr_hz, c->accel_fsr_g) != 0 ||
+        ICM42670_startGyro(c->odr_hz, c->gyro_fsr_dps) != 0) {
+        return false;
+    }
+    // Gyro needs some time to give valid data after start-up
+    vTaskDelay(pdMS_TO_TICKS(100));
+    return ICM42670_fifo_start() == 0 && ICM42670_fifo_flush() == 0;
+}
+
+// Returns false if the capture failed. A failure while reading the FIFO also
+// drops the previous capture, as its samples in the ring are overwritten.
+static bool capture(const capture_cmd_t *c) {
+    char msg[128];
+    const uint32_t target = (uint32_t)c->odr_hz * c->ms / 1000u;
+
+    static imu_timebase_t tb;
+    if (imu_timebase_init(&tb, c->odr_hz) != 0) {
+        usb_serial_print("Capture: ODR below 16 Hz is not supported (timestamps wrap)\n");
+        return false;
+    }
+    if (!imu_configure(c)) {
+        usb_serial_print("Capture: invalid IMU settings\n");
+        return false;
+    }
+    snprintf(msg, sizeof(msg), "Capture: %u samples at %u Hz (+-%u g, +-%u dps)\n",
+             (unsigned)target, c->odr_hz, c->accel_fsr_g, c->gyro_fsr_dps);
+    usb_serial_print(msg);
+
+    static icm42670_raw_sample_t batch[FIFO_CAPACITY];
+    static uint16_t tmst[FIFO_CAPACITY];
+    static uint64_t t_us[FIFO_CAPACITY];
+
+    uint8_t flags = 0;
+    uint32_t fifo_lost = 0;
+    have_capture = false;       // the ring no longer matches last_header
+    ring_written = 0;
+    uint64_t first_us = 0;
+    TickType_t last_wake = xTaskGetTickCount();
+
+    while (ring_written < target) {
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(FIFO_READ_PERIOD_MS));
+        icm42670_fifo_batch_info_t info;
+        uint32_t want = target - ring_written;
+        int n = ICM42670_fifo_read_timed(batch, tmst, want < FIFO_CAPACITY ? want : FIFO_CAPACITY, &info);
+        if (n < 0) {
+            ICM42670_fifo_stop();
+            usb_serial_print("Capture: FIFO read failed\n");
+            return false;
+        }
+        int lost = imu_timebase_update(&tb, tmst, (size_t)n, &info, t_us);
+        if (lost > 0) {
+            flags |= CAPTURE_FLAG_FIFO_FULL;
+            fifo_lost += (uint32_t)lost;
+        }
+        if (n > 0 && ring_written == 0) first_us = t_us[0];
+        for (int i = 0; i < n; i++) {
+            capture_sample_t *r = &ring[ring_written % CAPTURE_MAX_SAMPLES];
+            r->s = batch[i];
+            r->time_us = (uint32_t)(t_us[i] - first_us);
+            ring_written++;
+        }
+    }
+    ICM42670_fifo_stop();
+
+    uint32_t count = ring_written > CAPTURE_MAX_SAMPLES ? CAPTURE_MAX_SAMPLES : ring_written;
+    if (ring_written > CAPTURE_MAX_SAMPLES) flags |= CAPTURE_FLAG_WRAPPED;
+
+    uint32_t crc = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        crc = crc32_update(crc, (const uint8_t *)&ring[ring_index(i)], sizeof(capture_sample_t));
+    }
+
+    memset(&last_header, 0, sizeof(last_header));
+    memcpy(last_header.magic, CAPTURE_MAGIC, 4);
+    last_header.version = CAPTURE_VERSION;
+    last_header.flags = flags;
+    last_header.sample_size = sizeof(capture_sample_t);
+    last_header.channels = 7;
+    last_header.odr_hz = c->odr_hz;
+    last_header.accel_fsr_g = c->accel_fsr_g;
+    last_header.gyro_fsr_dps = c->gyro_fsr_dps;
+    last_header.sample_count = count;
+    last_header.fifo_lost = fifo_lost > 0xFFFF ? 0xFFFF : (uint16_t)fifo_lost;
+    last_header.dropped = ring_written - count;
+    last_header.duration_us = count ? ring[ring_index(count - 1)].time_us - ring[ring_index(0)].time_us : 0;
+    last_header.crc32 = crc;
+    have_capture = true;
+
+    snprintf(msg, sizeof(msg), "Capture done: %u samples, %u dropped, %u lost, IMU clock %ld ppm\n",
+             (unsigned)count, (unsigned)last_header.dropped, (unsigned)fifo_lost,
+             (long)imu_timebase_drift_ppm(&tb));
+    usb_serial_print(msg);
+    return true;
+}
+
+// Write to CDC1 waiting for room in the TX buffer. Returns false if the host
+// closed the port.
+static bool cdc_write_all(const uint8_t *p, size_t len) {
+    while (len > 0) {
+        if (!tud_cdc_n_connected(CDC_ITF_DATA)) return false;
+        uint32_t avail = tud_cdc_n_write_available(CDC_ITF_DATA);
+        if (avail == 0) {
+            tud_cdc_n_write_flush(CDC_ITF_DATA);
+            vTaskDelay(1);
+            continue;
+        }
+        uint32_t w = tud_cdc_n_write(CDC_ITF_DATA, p, len < avail ? len : avail);
+        p += w;
+        len -= w;
+    }
+    return true;
+}
+
+static void dump(void) {
+    if (!have_capture) {
+        usb_serial_print("Dump: no capture yet\n");
+        return;
+    }
+    if (!tud_cdc_n_connected(CDC_ITF_DATA)) {
+        usb_serial_print("Dump: CDC1 not open\n");
+        return;
+    }
+    bool ok = cdc_write_all((const uint8_t *)&last_header, sizeof(last_header));
+    for (uint32_t i = 0; ok && i < last_header.sample_count; i++) {
+        ok = cdc_write_all((const uint8_t *)&ring[ring_index(i)], sizeof(capture_sample_t));
+    }
+    tud_cdc_n_write_flush(CDC_ITF_DATA);
+    usb_serial_print(ok ? "Dump done\n" : "Dump aborted: CDC1 closed\n");
+}
+
+static void capture_task(void *pvParameters) {
+    (void)pvParameters;
+
+    if (init_ICM42670() != 0) {
+        usb_serial_print("Failed to initialize ICM-42670P.\n");
+        vTaskDelete(NULL);
+    }
+    init_button1();
+
+    capture_cmd_t cmd;
+    bool button_was_down = false;
+    while (1) {
+        if (xQueueReceive(cmd_queue, &cmd, pdMS_TO_TICKS(20)) != pdTRUE) {
+            bool down = gpio_get(BUTTON1);
+            bool pressed = down && !button_was_down;
+            button_was_down = down;
+            if (!pressed) continue;
+            cmd = (capture_cmd_t){ 'C', CAPTURE_ODR_DEFAULT, CAPTURE_MS_DEFAULT,
+                                   CAPTURE_AFSR_DEFAULT, CAPTURE_GFSR_DEFAULT };
+        }
+        // 'C' dumps the capture only if it succeeded, 'D' dumps the last one
+        if (cmd.cmd == 'C' && !capture(&cmd)) continue;
+        dump();
+    }
+}
+
+// ---- Task running USB stack ----
+static void usbTask(void *arg) {
+    (void)arg;
+    while (1) {
+        tud_task();              // With FreeRTOS wait for events
+                                 // Do not add vTaskDelay.
+    }
+}
+
+int main() {
+
+    init_hat_sdk();
+    sleep_ms(300); //Wait some time so initialization of USB and hat is done.
+
+    cmd_queue = xQueueCreate(2, sizeof(capture_cmd_t));
+
+    TaskHandle_t hCapture, hUsb = NULL;
+    xTaskCreate(capture_task, "capture", 1024, NULL, 2, &hCapture);
+    xTaskCreate(usbTask, "usb", 1024, NULL, 3, &hUsb);
+    #if (configNUMBER_OF_CORES > 1)
+        vTaskCoreAffinitySet(hUsb, 1u << 0);
+    #endif
+
+    // VERY IMPORTANT, THIS SHOULD GO JUST BEFORE vTaskStartSheduler
+    // WITHOUT ANY DELAYS. OTHERWISE, THE TinyUSB stack wont recognize
+    // the device.
+    tusb_init();
+    usb_serial_init();
+    vTaskStartScheduler();
+
+    return 0;
+}
+
+// Commands arrive on CDC1. CDC0 must also be read, otherwise printing to it
+// stops working.
+void tud_cdc_rx_cb(uint8_t itf) {
+    static char line[48];
+    static size_t len = 0;
+    uint8_t buf[CFG_TUD_CDC_RX_BUFSIZE];
+    uint32_t count = tud_cdc_n_read(itf, buf, sizeof(buf));
+    if (itf != CDC_ITF_DATA) return;
+
+    for (uint32_t i = 0; i < count; i++) {
+        char ch = (char)buf[i];
+        if (ch != '\n' && ch != '\r') {
+            if (len < sizeof(line) - 1) line[len++] = ch;
+            continue;
+        }
+        line[len] = '\0';
+        len = 0;
+
+        unsigned odr = CAPTURE_ODR_DEFAULT, ms = CAPTURE_MS_DEFAULT;
+        unsigned afsr = CAPTURE_AFSR_DEFAULT, gfsr = CAPTURE_GFSR_DEFAULT;
+        capture_cmd_t cmd = { 0 };
+        if (line[0] == 'C' || line[0] == 'c') {
+            sscanf(line + 1, "%u %u %u %u", &odr, &ms, &afsr, &gfsr);
+            if (ms > 60000) ms = 60000;
+            cmd = (capture_cmd_t){ 'C', (uint16_t)odr, (uint16_t)ms, (uint16_t)afsr, (uint16_t)gfsr };
+        } else if (line[0] == 'D' || line[0] == 'd') {
+            cmd.cmd = 'D';
+        } else {
+            continue;
+        }
+        xQueueSend(cmd_queue, &cmd, 0);     // ignored while a capture is queued
+    }
+}
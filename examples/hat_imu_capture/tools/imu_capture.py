@@ -0,0 +1,150 @@
+#!/usr/bin/env python3
+"""Start a high-rate IMU capture on the hat_imu_capture example and save it.
+
+The board records the window in RAM and sends it over the second serial port
+(CDC1) as packed binary. This script sends the capture command, checks the
+dump and writes it as CSV and/or NumPy (.npy) files.
+
+Usage:
+    imu_capture.py /dev/ttyACM1 -o capture.csv
+    imu_capture.py /dev/ttyACM1 --odr 800 --ms 3000 -o capture.npy
+    imu_capture.py /dev/ttyACM1 --raw -o session.csv   # input for gesture_replay
+    imu_capture.py /dev/ttyACM1 --dump-only -o again.csv
+
+With --raw the CSV holds the raw sensor values (ax,ay,az,gx,gy,gz in LSB), the
+format read by fusion_replay and gesture_replay in libs/TKJHAT/tools. Otherwise
+the columns are t_s, ax_g, ay_g, az_g, gx_dps, gy_dps, gz_dps, temp_c, where
+t_s comes from the IMU FIFO timestamps (jitter free).
+A .npy file holds the raw int16 values, shape (N, 7); the times in us are
+written next to it as <name>_t.npy (uint32).
+
+Needs pyserial (pip install pyserial). NumPy is not needed.
+"""
+
+import argparse
+import struct
+import sys
+import time
+import zlib
+
+try:
+    import serial
+except ImportError:
+    sys.exit("pyserial is needed: pip install pyserial")
+
+HEADER = struct.Struct("<4sBBBBHHHHIIII")
+SAMPLE = struct.Struct("<7hI")      # raw sample + time in us since the first one
+MAGIC = b"TKJC"
+FLAG_FIFO_FULL = 0x01
+FLAG_WRAPPED = 0x02
+COLUMNS = ("ax", "ay", "az", "gx", "gy", "gz", "temp")
+
+
+def read_exact(port, n, timeout):
+    data = bytearray()
+    deadline = time.monotonic() + timeout
+    while len(data) < n:
+        chunk = port.read(n - len(data))
+        if chunk:
+            data += chunk
+            deadline = time.monotonic() + timeout
+        elif time.monotonic() > deadline:
+            raise TimeoutError("got %d of %d bytes" % (len(data), n))
+    return bytes(data)
+
+
+def receive(port, ms):
+    # The capture itself takes ms milliseconds before the header is sent
+    raw = read_exact(port, HEADER.size, timeout=ms / 1000.0 + 5.0)
+    (magic, version, flags, sample_size, channels, odr, afsr, gfsr, fifo_lost,
+     count, dropped, duration_us, crc) = HEADER.unpack(raw)
+    if magic != MAGIC or version != 2 or sample_size != SAMPLE.size or channels != 7:
+        raise ValueError("not a capture header (or another version): %r" % raw)
+    payload = read_exact(port, count * sample_size, timeout=2.0)
+    if zlib.crc32(payload) != crc:
+        raise ValueError("CRC mismatch, the dump is corrupted")
+    records = [SAMPLE.unpack_from(payload, i * sample_size) for i in range(count)]
+    return {
+        "odr": odr, "afsr": afsr, "gfsr": gfsr, "flags": flags, "fifo_lost": fifo_lost,
+        "dropped": dropped, "duration_us": duration_us,
+        "samples": [r[:7] for r in records], "times_us": [r[7] for r in records],
+    }
+
+
+def write_csv(path, cap, raw):
+    with open(path, "w") as f:
+        if raw:
+            f.write("ax,ay,az,gx,gy,gz\n")
+            for s in cap["samples"]:
+                f.write("%d,%d,%d,%d,%d,%d\n" % s[:6])
+            return
+        a = cap["afsr"] / 32768.0
+        g = cap["gfsr"] / 32768.0
+        f.write("t_s,ax_g,ay_g,az_g,gx_dps,gy_dps,gz_dps,temp_c\n")
+        for t, s in zip(cap["times_us"], cap["samples"]):
+            f.write("%.6f,%.5f,%.5f,%.5f,%.4f,%.4f,%.4f,%.2f\n" % (
+                t / 1e6, s[0] * a, s[1] * a, s[2] * a,
+                s[3] * g, s[4] * g, s[5] * g, s[6] / 128.0 + 25.0))
+
+
+def write_npy_array(path, descr, shape, data):
+    # NPY format version 1.0, little endian, C order
+    header = "{'descr': '%s', 'fortran_order': False, 'shape': %s, }" % (descr, shape)
+    pad = 64 - (10 + len(header) + 1) % 64
+    header = header + " " * pad + "\n"
+    with open(path, "wb") as f:
+        f.write(b"\x93NUMPY\x01\x00" + struct.pack("<H", len(header)) + header.encode("ascii"))
+        f.write(data)
+
+
+def write_npy(path, cap):
+    n = len(cap["samples"])
+    write_npy_array(path, "<i2", "(%d, 7)" % n,
+                    b"".join(struct.pack("<7h", *s) for s in cap["samples"]))
+    write_npy_array(path[:-4] + "_t.npy", "<u4", "(%d,)" % n,
+                    struct.pack("<%dI" % n, *cap["times_us"]))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("port", help="serial port of CDC1, e.g. /dev/ttyACM1 or COM5")
+    ap.add_argument("-o", "--out", action="append", required=True,
+                    help="output file, .csv or .npy (can be given several times)")
+    ap.add_argument("--odr", type=int, default=1600, help="sample rate in Hz (25..1600)")
+    ap.add_argument("--ms", type=int, default=2000, help="capture window in ms")
+    ap.add_argument("--afsr", type=int, default=16, help="accelerometer range in g")
+    ap.add_argument("--gfsr", type=int, default=2000, help="gyroscope range in dps")
+    ap.add_argument("--raw", action="store_true", help="CSV with raw LSB values")
+    ap.add_argument("--dump-only", action="store_true",
+                    help="do not capture, get the last capture again")
+    args = ap.parse_args()
+
+    with serial.Serial(args.port, timeout=0.2) as port:
+        port.reset_input_buffer()
+        if args.dump_only:
+            port.write(b"D\n")
+        else:
+            port.write(b"C %d %d %d %d\n" % (args.odr, args.ms, args.afsr, args.gfsr))
+        cap = receive(port, 0 if args.dump_only else args.ms)
+
+    n = len(cap["samples"])
+    rate = (n - 1 + cap["fifo_lost"]) * 1e6 / cap["duration_us"] if cap["duration_us"] else 0.0
+    print("%d samples at %d Hz (measured %.1f Hz), +-%d g, +-%d dps"
+          % (n, cap["odr"], rate, cap["afsr"], cap["gfsr"]))
+    if cap["flags"] & FLAG_FIFO_FULL:
+        print("warning: the IMU FIFO overflowed, %d samples are missing in the middle"
+              % cap["fifo_lost"])
+    if cap["flags"] & FLAG_WRAPPED:
+        print("warning: window longer than the ring, the first %d samples were dropped"
+              % cap["dropped"])
+
+    for path in args.out:
+        if path.endswith(".npy"):
+            write_npy(path, cap)
+        else:
+            write_csv(path, cap, args.raw)
+        print("written", path)
+
+
+if __name__ == "__main__":
+    main()
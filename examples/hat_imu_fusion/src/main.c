@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pico/stdlib.h>
+#include <hardware/clocks.h>
+
+#include <FreeRTOS.h>
+#include <queue.h>
+#include <task.h>
+
+#include <tkjhat/sdk.h>
+#include <tkjhat/imu_fusion.h>
+
+// Sensor settings. The fusion configuration must use the same values.
+#define IMU_ODR_HZ          400
+#define IMU_ACCEL_FSR_G     4
+#define IMU_GYRO_FSR_DPS    500
+
+#define FIFO_READ_PERIOD_MS 10      // 4 samples per read at 400 Hz
+#define BATCH_MAX           32
+#define PUBLISH_HZ          10
+
+// Benchmark: number of updates timed and cycle budget per update.
+// 400 Hz on a 125 MHz core gives 312500 cycles per sample; the fusion should
+// stay below 10 % of that so the rest of the application has room.
+#define BENCH_UPDATES       4000
+#define BENCH_BUDGET_CYCLES 31250
+
+static imu_fusion_t fusion;
+static QueueHandle_t orientation_queue;
+
+// Called from fusion_task every IMU_ODR_HZ / PUBLISH_HZ samples.
+static void on_orientation(const imu_orientation_t *o, void *ctx) {
+    (void)ctx;
+    xQueueOverwrite(orientation_queue, o);
+}
+
+// Time the fusion update with the scheduler stopped, so no other task runs
+// in the middle. Cycles are derived from the microsecond timer and clk_sys.
+static void fusion_benchmark(const struct imu_fusion_config *cfg) {
+    static imu_fusion_t bench;
+    static icm42670_raw_sample_t samples[64];
+    const int32_t one_g = 32768 / IMU_ACCEL_FSR_G;
+
+    // Board lying flat and slowly rotating, with some noise
+    for (int i = 0; i < 64; i++) {
+        samples[i].ax = (int16_t)((rand() % 200) - 100);
+        samples[i].ay = (int16_t)((rand() % 200) - 100);
+        samples[i].az = (int16_t)(one_g + (rand() % 200) - 100);
+        samples[i].gx = (int16_t)((rand() % 40) - 20);
+        samples[i].gy = (int16_t)((rand() % 40) - 20);
+        samples[i].gz = (int16_t)(650 + (rand() % 40) - 20);
+        samples[i].temp = 0;
+    }
+    imu_fusion_init(&bench, cfg);
+
+    vTaskSuspendAll();
+    uint64_t start = time_us_64();
+    for (int i = 0; i < BENCH_UPDATES; i++) {
+        imu_fusion_update(&bench, &samples[i & 63]);
+    }
+    uint64_t elapsed_us = time_us_64() - start;
+    xTaskResumeAll();
+
+    uint32_t mhz = clock_get_hz(clk_sys) / 1000000;
+    uint32_t cycles = (uint32_t)((elapsed_us * mhz) / BENCH_UPDATES);
+    uint32_t load_permille = (uint32_t)(((uint64_t)cycles * IMU_ODR_HZ) / (mhz * 1000));
+
+    imu_orientation_t o;
+    imu_fusion_get_orientation(&bench, &o);
+    printf("Fusion benchmark: %u updates in %u us\n", BENCH_UPDATES, (unsigned)elapsed_us);
+    printf("  %u cycles/update @ %u MHz (budget %u) -> %s\n",
+           (unsigned)cycles, (unsigned)mhz, BENCH_BUDGET_CYCLES,
+           cycles <= BENCH_BUDGET_CYCLES ? "OK" : "OVER BUDGET");
+    printf("  CPU load at %d Hz: %u.%u %%\n", IMU_ODR_HZ,
+           (unsigned)(load_permille / 10), (unsigned)(load_permille % 10));
+    printf("  final yaw %d.%02d deg\n", o.yaw_cdeg / 100, abs(o.yaw_cdeg % 100));
+}
+
+static void fusion_task(void *pvParameters) {
+    (void)pvParameters;
+
+    const struct imu_fusion_config cfg = {
+        .odr_hz = IMU_ODR_HZ,
+        .accel_fsr_g = IMU_ACCEL_FSR_G,
+        .gyro_fsr_dps = IMU_GYRO_FSR_DPS,
+        .kp = IMU_FUSION_KP_DEFAULT,
+        .ki = IMU_FUSION_KI_DEFAULT,
+        .publish_divider = IMU_ODR_HZ / PUBLISH_HZ,
+    };
+
+    fusion_benchmark(&cfg);
+
+    if (init_ICM42670() != 0) {
+        printf("Failed to initialize ICM-42670P.\n");
+        vTaskDelete(NULL);
+    }
+    if (ICM42670_enable_accel_gyro_ln_mode() != 0 ||
+        ICM42670_startAccel(IMU_ODR_HZ, IMU_ACCEL_FSR_G) != 0 ||
+        ICM42670_startGyro(IMU_ODR_HZ, IMU_GYRO_FSR_DPS) != 0) {
+        printf("ICM-42670P could not start accelerometer or gyroscope\n");
+        vTaskDelete(NULL);
+    }
+    // Gyro needs some time to give valid data after start-up
+    vTaskDelay(pdMS_TO_TICKS(100));
+    if (ICM42670_fifo_start() != 0) {
+        printf("ICM-42670P FIFO could not be started\n");
+        vTaskDelete(NULL);
+    }
+
+    imu_fusion_init(&fusion, &cfg);
+    imu_fusion_subscribe(&fusion, on_orientation, NULL);
+
+    icm42670_raw_sample_t batch[BATCH_MAX];
+    TickType_t last_wake = xTaskGetTickCount();
+    while (1) {
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(FIFO_READ_PERIOD_MS));
+        int n = ICM42670_fifo_read(batch, BATCH_MAX);
+        if (n > 0) {
+            imu_fusion_update_batch(&fusion, batch, (size_t)n);
+        } else if (n < 0) {
+            printf("Failed to read imu FIFO\n");
+        }
+    }
+}
+
+static void print_task(void *pvParameters) {
+    (void)pvParameters;
+    imu_orientation_t o;
+
+    while (1) {
+        if (xQueueReceive(orientation_queue, &o, portMAX_DELAY) == pdTRUE) {
+            printf("Roll %7.2f | Pitch %7.2f | Yaw %7.2f | samples %lu\n",
+                   o.roll_cdeg / 100.0f, o.pitch_cdeg / 100.0f, o.yaw_cdeg / 100.0f,
+                   (unsigned long)o.sample_count);
+        }
+    }
+}
+
+int main() {
+    stdio_init_all();
+    // Uncomment this lines if you want to wait till the serial monitor is connected
+    while (!stdio_usb_connected()){
+        sleep_ms(10);
+    }
+    init_hat_sdk();
+    sleep_ms(300); //Wait some time so initialization of USB and hat is done.
+    printf("Start orientation fusion test\n");
+
+    orientation_queue = xQueueCreate(1, sizeof(imu_orientation_t));
+
+    TaskHandle_t hFusionTask = NULL;
+    TaskHandle_t hPrintTask = NULL;
+
+    xTaskCreate(fusion_task, "FusionTask", 1024, NULL, 3, &hFusionTask);
+    xTaskCreate(print_task, "PrintTask", 1024, NULL, 2, &hPrintTask);
+
+    // Start the FreeRTOS scheduler
+    vTaskStartScheduler();
+
+    return 0;
+}
@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <math.h>
+#include <pico/stdlib.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include <tkjhat/sdk.h>
+
+// Noise floor of the IMU for every on-chip filter setting.
+//
+// Keep the board still on the table while the test runs. For every setting the
+// sensor is reconfigured, left to settle and then SAMPLES samples are
+// collected. The standard deviation per axis is the noise floor: it shows how
+// much of the low-pass filtering can be left to the sensor instead of the Pico.
+//
+// 1. LN mode, 400 Hz: accelerometer and gyroscope UI filter bandwidth (FIFO).
+// 2. LP mode (accelerometer only), 100 Hz: number of averaged samples (polled).
+
+#define LN_ODR_HZ           400
+#define LP_ODR_HZ           100
+#define ACCEL_FSR_G         2       // finest resolution
+#define GYRO_FSR_DPS        250
+#define SAMPLES             1024
+#define SETTLE_MS           200
+
+typedef struct {
+    int64_t sum[6];
+    int64_t sum2[6];
+    uint32_t n;
+} noise_acc_t;
+
+static void noise_add(noise_acc_t *acc, const icm42670_raw_sample_t *s) {
+    const int16_t v[6] = { s->ax, s->ay, s->az, s->gx, s->gy, s->gz };
+    for (int i = 0; i < 6; i++) {
+        acc->sum[i] += v[i];
+        acc->sum2[i] += (int32_t)v[i] * v[i];
+    }
+    acc->n++;
+}
+
+// Standard deviation of channel i in LSB
+static float noise_std(const noise_acc_t *acc, int i) {
+    double mean = (double)acc->sum[i] / acc->n;
+    double var = (double)acc->sum2[i] / acc->n - mean * mean;
+    return var > 0 ? (float)sqrt(var) : 0.0f;
+}
+
+static void print_row(const char *label, const noise_acc_t *acc, bool gyro) {
+    const float ug_per_lsb = ACCEL_FSR_G * 1e6f / 32768.0f;
+    const float mdps_per_lsb = GYRO_FSR_DPS * 1e3f / 32768.0f;
+    printf("%-14s", label);
+    for (int i = 0; i < 3; i++) printf(" %8.0f", noise_std(acc, i) * ug_per_lsb);
+    if (gyro) {
+        for (int i = 3; i < 6; i++) printf(" %8.1f", noise_std(acc, i) * mdps_per_lsb);
+    }
+    printf("   (%lu samples)\n", (unsigned long)acc->n);
+}
+
+// Collect SAMPLES samples from the FIFO
+static bool collect_fifo(noise_acc_t *acc) {
+    icm42670_raw_sample_t batch[32];
+    *acc = (noise_acc_t){ 0 };
+    vTaskDelay(pdMS_TO_TICKS(SETTLE_MS));
+    ICM42670_fifo_flush();
+    while (acc->n < SAMPLES) {
+        vTaskDelay(pdMS_TO_TICKS(20));
+        int n = ICM42670_fifo_read(batch, 32);
+        if (n < 0) return false;
+        for (int i = 0; i < n && acc->n < SAMPLES; i++) noise_add(acc, &batch[i]);
+    }
+    return true;
+}
+
+// Collect SAMPLES samples by polling the data registers at the ODR
+static bool collect_polled(noise_acc_t *acc, uint32_t odr_hz) {
+    icm42670_raw_sample_t s;
+    *acc = (noise_acc_t){ 0 };
+    vTaskDelay(pdMS_TO_TICKS(SETTLE_MS));
+    TickType_t last_wake = xTaskGetTickCount();
+    while (acc->n < SAMPLES) {
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(1000 / odr_hz));
+        if (ICM42670_read_sensor_data_raw(&s) != 0) return false;
+        noise_add(acc, &s);
+    }
+    return true;
+}
+
+static void noise_task(void *pvParameters) {
+    (void)pvParameters;
+    static const uint16_t bandwidths[] = { 0, 180, 121, 73, 53, 34, 25, 16 };
+    static const uint8_t averages[] = { 2, 4, 8, 16, 32, 64 };
+    noise_acc_t acc;
+    char label[16];
+
+    if (init_ICM42670() != 0) {
+        printf("Failed to initialize ICM-42670P.\n");
+        vTaskDelete(NULL);
+    }
+
+    printf("\nIMU noise floor (std dev), keep the board still\n");
+    printf("LN mode, %d Hz, +-%d g, +-%d dps\n", LN_ODR_HZ, ACCEL_FSR_G, GYRO_FSR_DPS);
+    printf("%-14s %8s %8s %8s %8s %8s %8s\n", "UI filter BW", "ax ug", "ay ug", "az ug",
+           "gx mdps", "gy mdps", "gz mdps");
+    if (ICM42670_enable_accel_gyro_ln_mode() != 0 ||
+        ICM42670_startAccel(LN_ODR_HZ, ACCEL_FSR_G) != 0 ||
+        ICM42670_startGyro(LN_ODR_HZ, GYRO_FSR_DPS) != 0) {
+        printf("ICM-42670P could not start accelerometer or gyroscope\n");
+        vTaskDelete(NULL);
+    }
+    vTaskDelay(pdMS_TO_TICKS(100));
+    ICM42670_fifo_start();
+    for (size_t i = 0; i < sizeof(bandwidths) / sizeof(bandwidths[0]); i++) {
+        if (ICM42670_set_accel_filter(bandwidths[i], 2) != 0 ||
+            ICM42670_set_gyro_filter(bandwidths[i]) != 0) {
+            printf("%u Hz: rejected for %d Hz ODR\n", bandwidths[i], LN_ODR_HZ);
+            continue;
+        }
+        if (bandwidths[i] == 0) snprintf(label, sizeof(label), "bypass");
+        else snprintf(label, sizeof(label), "%u Hz", bandwidths[i]);
+        if (!collect_fifo(&acc)) {
+            printf("Failed to read imu FIFO\n");
+            break;
+        }
+        print_row(label, &acc, true);
+    }
+    ICM42670_fifo_stop();
+
+    // The FIFO driver needs accel and gyro in every packet, so LP mode is polled
+    printf("\nLP mode (gyro off), %d Hz, +-%d g\n", LP_ODR_HZ, ACCEL_FSR_G);
+    printf("%-14s %8s %8s %8s\n", "LP averaging", "ax ug", "ay ug", "az ug");
+    ICM42670_startAccel(LP_ODR_HZ, ACCEL_FSR_G);
+    ICM42670_enable_ultra_low_power_mode();
+    for (size_t i = 0; i < sizeof(averages) / sizeof(averages[0]); i++) {
+        if (ICM42670_set_accel_filter(0, averages[i]) != 0) {
+            printf("%ux: rejected for %d Hz ODR\n", averages[i], LP_ODR_HZ);
+            continue;
+        }
+        snprintf(label, sizeof(label), "%ux", averages[i]);
+        if (!collect_polled(&acc, LP_ODR_HZ)) {
+            printf("Failed to read imu data\n");
+            break;
+        }
+        print_row(label, &acc, false);
+    }
+
+    printf("\nDone.\n");
+    vTaskDelete(NULL);
+}
+
+int main() {
+    stdio_init_all();
+    // Wait till the serial monitor is connected, the results are printed only once
+    while (!stdio_usb_connected()){
+        sleep_ms(10);
+    }
+    init_hat_sdk();
+    sleep_ms(300); //Wait some time so initialization of USB and hat is done.
+
+    TaskHandle_t hNoise = NULL;
+    xTaskCreate(noise_task, "noise", 2048, NULL, 2, &hNoise);
+
+    vTaskStartScheduler();
+    return 0;
+}
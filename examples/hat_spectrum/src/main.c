@@ -0,0 +1,266 @@
+#include <stdio.h>
+#include <string.h>
+#include <hardware/clocks.h>
+#include <pico/stdlib.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include <tusb.h>
+#include "usbSerialDebug/helper.h"
+#include <tkjhat/sdk.h>
+#include <tkjhat/fft.h>
+#include <tkjhat/vad.h>
+#include <tkjhat/pdm_microphone_task.h>
+
+#if CFG_TUSB_OS != OPT_OS_FREERTOS
+#error "This should be using FREERTOS but the CFG_TUSB_OS is not OPT_OS_FREERTOS"
+#endif
+
+// Live spectrum of the microphone on the OLED.
+//
+// The microphone task of the SDK (tkjhat/pdm_microphone_task.h, core 1)
+// filters the PDM buffers and hands each frame to on_frame(), which runs a
+// FFT_SIZE point fixed-point FFT (tkjhat/fft.h) on every block: at 8 kHz a 256-point
+// spectrum has 128 bins of 31.25 Hz, one column each on the display. The
+// bars hold their peak and fall DECAY_DB per block. The display task draws
+// them DISPLAY_MS apart with one update of the panel.
+//
+// BUTTON1 steps the filter volume (pdm_microphone_set_filter_volume) in 6 dB
+// steps, to see how the noise floor and loud sounds sit in the range. CDC0
+// shows the volume, the cost of one FFT in CPU cycles and the load of core 1
+// every REPORT_MS. With STREAM_BINS 1 every drawn spectrum also goes to CDC1
+// as a CSV line: time in ms, volume, then the level of each bar in dBFS.
+//
+// With SKIP_SILENCE 1 a voice/sound activity detector (tkjhat/vad.h) runs
+// on every frame first, and blocks with no sound skip the FFT: the bars just
+// fall. The report then shows how many blocks had sound.
+//
+// The USB task has the highest priority and core 0 to itself apart from the
+// display, so the FFT never holds up USB.
+
+#define FFT_SIZE        256         // 64..512 samples per transform
+#define PCM_FRAMES      8           // PCM queue: 8 x 32 ms
+#define BARS            (FFT_SIZE / 2 < 128 ? FFT_SIZE / 2 : 128)
+#define DISPLAY_MS      100
+#define REPORT_MS       2000
+#define DB_TOP          -20         // dBFS at the top of the display
+#define DB_RANGE        80          // dB from the bottom to the top
+#define DECAY_DB        3           // bars fall this much per block
+#define SKIP_SILENCE    1           // 1 = no FFT while the room is silent
+#define STREAM_BINS     0           // 1 = spectra as CSV lines on CDC1
+#define CDC_ITF_STREAM  1
+
+static const uint16_t volumes[] = { 16, 32, 64, 128, 256 };    // 64 = default of the SDK
+#define VOLUME_DEFAULT  2
+
+static volatile bool volume_step = false;
+
+// Written by the mic task, read by the display task (a torn frame is harmless)
+static int16_t hold_q8[BARS];               // bar levels in dBFS, Q8
+static volatile size_t volume_index = VOLUME_DEFAULT;
+static volatile uint32_t fft_count, fft_us_sum, fft_us_max, block_count;
+
+static fft_t fft;
+static vad_t vad;
+
+static void btn_fxn(uint gpio, uint32_t events) {
+    if (gpio == BUTTON1 && (events & GPIO_IRQ_EDGE_FALL))
+        volume_step = true;
+}
+
+// A silent block: the bars only fall
+static void silent_block(void) {
+    for (size_t b = 0; b < BARS; b++) {
+        int32_t fallen = hold_q8[b] - DECAY_DB * 256;
+        hold_q8[b] = fallen > FFT_DB_FLOOR_Q8 ? (int16_t)fallen : FFT_DB_FLOOR_Q8;
+    }
+}
+
+// One block: spectrum, then the bars (largest bin of each bar) with peak hold
+static void spectrum_block(fft_t *fft, const int16_t *block) {
+    static int16_t db_q8[FFT_SIZE / 2];
+
+    uint64_t start = time_us_64();
+    fft_spectrum_db(fft, block, db_q8);
+    uint32_t us = (uint32_t)(time_us_64() - start);
+    fft_us_sum += us;
+    if (us > fft_us_max) fft_us_max = us;
+    fft_count++;
+
+    const size_t per_bar = (FFT_SIZE / 2) / BARS;
+    for (size_t b = 0; b < BARS; b++) {
+        int16_t level = db_q8[b * per_bar];
+        for (size_t k = 1; k < per_bar; k++)
+            if (db_q8[b * per_bar + k] > level) level = db_q8[b * per_bar + k];
+        int32_t fallen = hold_q8[b] - DECAY_DB * 256;
+        hold_q8[b] = level > fallen ? level : (int16_t)fallen;
+    }
+}
+
+// Microphone task: every PCM frame, and with n = 0 every 100 ms without frames
+static void on_frame(const int16_t *frame, size_t n, void *arg) {
+    (void)arg;
+    static int16_t block[FFT_SIZE];
+    static size_t fill = 0;
+    static bool sampling = false, sound = !SKIP_SILENCE;
+
+    if (!sampling) {
+        sampling = init_microphone_sampling() == 0;
+        if (!sampling)
+            usb_serial_print("Cannot start sampling the microphone\n");
+        return;
+    }
+    if (volume_step) {
+        volume_step = false;
+        volume_index = (volume_index + 1) % (sizeof(volumes) / sizeof(volumes[0]));
+        pdm_microphone_set_filter_volume(volumes[volume_index]);
+    }
+
+    // A block has sound when any of its frames had
+    if (SKIP_SILENCE && n > 0 && vad_push(&vad, frame, n))
+        sound = true;
+    for (size_t i = 0; i < n; ) {
+        size_t take = FFT_SIZE - fill;
+        if (take > n - i) take = n - i;
+        memcpy(&block[fill], &frame[i], take * sizeof(block[0]));
+        fill += take;
+        i += take;
+        if (fill == FFT_SIZE) {
+            if (sound)
+                spectrum_block(&fft, block);
+            else
+                silent_block();
+            block_count++;
+            sound = !SKIP_SILENCE || vad_active(&vad);
+            fill = 0;
+        }
+    }
+}
+
+static void stream_bins(void) {
+    char line[16 + BARS * 5];
+    int len = snprintf(line, sizeof(line), "%lu,%u", (unsigned long)(time_us_64() / 1000),
+                       (unsigned)volumes[volume_index]);
+    for (size_t b = 0; b < BARS && len < (int)sizeof(line) - 6; b++)
+        len += snprintf(line + len, sizeof(line) - (size_t)len, ",%d", hold_q8[b] / 256);
+    line[len++] = '\n';
+    // Skip the line rather than wait when the host does not read CDC1
+    if (tud_cdc_n_connected(CDC_ITF_STREAM) && tud_cdc_n_write_available(CDC_ITF_STREAM) >= (uint32_t)len) {
+        tud_cdc_n_write(CDC_ITF_STREAM, line, (uint32_t)len);
+        tud_cdc_n_write_flush(CDC_ITF_STREAM);
+    }
+}
+
+static void report(uint32_t elapsed_ms) {
+    char buf[160];
+    uint32_t count = fft_count, us_sum = fft_us_sum, us_max = fft_us_max, blocks = block_count;
+    uint32_t busy;
+    fft_count = fft_us_sum = fft_us_max = block_count = 0;
+    pdm_microphone_task_stats(&busy, NULL);
+    if (blocks == 0)
+        return;
+    uint32_t fft_us = count ? us_sum / count : 0;     // 0 when all blocks were silent
+
+    // Cycles are derived from the microsecond timer and clk_sys
+    uint32_t mhz = clock_get_hz(clk_sys) / 1000000;
+    struct pdm_microphone_stats stats;
+    pdm_microphone_get_stats(&stats);
+    snprintf(buf, sizeof(buf),
+             "volume %u | sound %lu %% | FFT %d: %lu us = %lu cycles (max %lu us) | core 1 load %lu %% | lost since start %lu\n",
+             (unsigned)volumes[volume_index], (unsigned long)(count * 100 / blocks), FFT_SIZE,
+             (unsigned long)fft_us, (unsigned long)(fft_us * mhz), (unsigned long)us_max,
+             (unsigned long)(busy / 10 / elapsed_ms), (unsigned long)(stats.overruns + stats.pcm_dropped));
+    usb_serial_print(buf);
+}
+
+static void display_task(void *arg) {
+    (void)arg;
+    static uint8_t heights[BARS];
+    TickType_t last = xTaskGetTickCount();
+    uint32_t since_report = 0;
+
+    while (1) {
+        vTaskDelayUntil(&last, pdMS_TO_TICKS(DISPLAY_MS));
+
+        for (size_t b = 0; b < BARS; b++) {
+            int32_t h = (hold_q8[b] - DB_TOP * 256 + DB_RANGE * 256) * 64 / (DB_RANGE * 256);
+            heights[b] = (uint8_t)(h < 0 ? 0 : h > 64 ? 64 : h);
+        }
+        draw_bars(heights, BARS);
+        if (STREAM_BINS)
+            stream_bins();
+
+        since_report += DISPLAY_MS;
+        if (since_report >= REPORT_MS) {
+            report(since_report);
+            since_report = 0;
+        }
+    }
+}
+
+// ---- Task running USB stack ----
+static void usbTask(void *arg) {
+    (void)arg;
+    while (1) {
+        tud_task();              // With FreeRTOS wait for events
+                                 // Do not add vTaskDelay.
+    }
+}
+
+int main() {
+
+    init_hat_sdk();
+    sleep_ms(300); //Wait some time so initialization of USB and hat is done.
+    init_display();
+
+    gpio_init(BUTTON1);
+    gpio_set_dir(BUTTON1, GPIO_IN);
+    gpio_pull_up(BUTTON1);
+    gpio_set_irq_enabled_with_callback(BUTTON1, GPIO_IRQ_EDGE_FALL, true, btn_fxn);
+
+    // 8 kHz: 128 bins of 31.25 Hz up to 4 kHz with 256 points
+    if (init_pdm_microphone() < 0 || pdm_microphone_pcm_queue_init(PCM_FRAMES) < 0) {
+        init_red_led();
+        while (1) {
+            toggle_red_led();
+            sleep_ms(200);
+        }
+    }
+    pdm_microphone_set_filter_volume(volumes[VOLUME_DEFAULT]);
+
+    struct fft_config fft_cfg;
+    fft_default_config(&fft_cfg, FFT_SIZE);
+    struct vad_config vad_cfg;
+    vad_default_config(&vad_cfg, MEMS_SAMPLING_FREQUENCY);
+    for (size_t b = 0; b < BARS; b++)
+        hold_q8[b] = FFT_DB_FLOOR_Q8;
+    // Priority 2 on core 1; on_frame also runs every 100 ms to start the microphone
+    struct pdm_microphone_task_config mic_cfg = PDM_MICROPHONE_TASK_DEFAULT(on_frame, NULL);
+    mic_cfg.poll_ms = 100;
+    if (fft_init(&fft, &fft_cfg) != 0 || vad_init(&vad, &vad_cfg) != 0 ||
+        pdm_microphone_task_create(&mic_cfg) != 0) {
+        init_red_led();
+        while (1) {
+            toggle_red_led();
+            sleep_ms(500);
+        }
+    }
+
+    TaskHandle_t hUsb = NULL, hDisplay = NULL;
+    xTaskCreate(display_task, "display", 1024, NULL, 1, &hDisplay);
+    xTaskCreate(usbTask, "usb", 1024, NULL, 3, &hUsb);
+    #if (configNUMBER_OF_CORES > 1)
+        vTaskCoreAffinitySet(hUsb, 1u << 0);
+        vTaskCoreAffinitySet(hDisplay, 1u << 0);
+    #endif
+
+    // VERY IMPORTANT, THIS SHOULD GO JUST BEFORE vTaskStartSheduler
+    // WITHOUT ANY DELAYS. OTHERWISE, THE TinyUSB stack wont recognize
+    // the device.
+    tusb_init();
+    usb_serial_init();
+    vTaskStartScheduler();
+
+    return 0;
+}
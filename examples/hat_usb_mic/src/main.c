@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <pico/stdlib.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include <tusb.h>
+#include "usbSerialDebug/helper.h"
+#include "usbSerialDebug/usb_audio.h"
+#include <tkjhat/sdk.h>
+#include <tkjhat/pdm_microphone_task.h>
+
+#if CFG_TUSB_OS != OPT_OS_FREERTOS
+#error "This should be using FREERTOS but the CFG_TUSB_OS is not OPT_OS_FREERTOS"
+#endif
+
+#if !CFG_TUD_AUDIO
+#error "The USB microphone is not enabled: configure with -DUSB_SERIAL_DEBUG_AUDIO_MIC=ON"
+#endif
+
+// The board as a USB microphone.
+//
+// Next to the two serial ports the board shows up as "TKJHAT Microphone"
+// (USB Audio Class 2, mono, 16 bit, USB_SERIAL_DEBUG_AUDIO_RATE Hz). Select it
+// in any recording program (Audacity, arecord -D ..., the sound settings);
+// nothing has to be decoded on the host.
+//
+// The microphone only runs while the host records. The microphone task of the
+// SDK (tkjhat/pdm_microphone_task.h, pinned to core 1) filters the PDM
+// buffers into the PCM queue and on_frame() copies the PCM frames into the
+// FIFO of the isochronous endpoint.
+// TinyUSB sends one packet from it every millisecond. CDC0 shows a short
+// report when a recording ends. The red LED is on while recording.
+//
+// With MIC_AGC 1 the filter runs 12 dB under its default volume and the
+// automatic gain control of the driver (tkjhat/agc.h) keeps the level the
+// same for a quiet and a loud voice, without clipping.
+
+#define PCM_FRAMES 8
+#define MIC_AGC    1
+
+
+static void report(void) {
+    struct pdm_microphone_stats stats;
+    char buf[128];
+    pdm_microphone_get_stats(&stats);
+    snprintf(buf, sizeof(buf), "Recording ended: %lu buffers, %lu lost, %lu samples dropped by USB\n",
+             (unsigned long)stats.buffers, (unsigned long)(stats.overruns + stats.pcm_dropped),
+             (unsigned long)usb_audio_mic_dropped());
+    usb_serial_print(buf);
+    const agc_t *agc = pdm_microphone_get_agc();
+    if (agc) {
+        uint32_t limited, clipped;
+        agc_counters(agc, &limited, &clipped);
+        snprintf(buf, sizeof(buf), "AGC gain %lu/256, since start limited %lu ms, clipped in the filter %lu\n",
+                 (unsigned long)agc_gain_q8(agc), (unsigned long)limited, (unsigned long)clipped);
+        usb_serial_print(buf);
+    }
+    pdm_microphone_reset_stats();
+}
+
+// Microphone task: every frame while recording, otherwise every 50 ms with
+// count 0 to check the host
+static void on_frame(const int16_t *frame, size_t count, void *arg) {
+    (void)arg;
+    static bool recording = false;
+
+    bool streaming = usb_audio_mic_streaming();
+    if (streaming && !recording) {
+        if (init_microphone_sampling() < 0) {
+            usb_serial_print("Cannot start sampling the microphone\n");
+            vTaskDelay(pdMS_TO_TICKS(500));
+            return;
+        }
+        recording = true;
+        set_red_led_status(true);
+    }
+    else if (!streaming && recording) {
+        end_microphone_sampling();
+        recording = false;
+        set_red_led_status(false);
+        report();
+    }
+    if (recording && count > 0)
+        usb_audio_mic_write(frame, count);
+}
+
+// ---- Task running USB stack ----
+static void usbTask(void *arg) {
+    (void)arg;
+    while (1) {
+        tud_task();              // With FreeRTOS wait for events
+                                 // Do not add vTaskDelay.
+    }
+}
+
+int main() {
+
+    init_hat_sdk();
+    sleep_ms(300); //Wait some time so initialization of USB and hat is done.
+    init_red_led();
+    set_red_led_status(false);
+
+    // The microphone runs at the rate of the USB microphone. Its task has
+    // priority 2 on core 1.
+    struct pdm_microphone_task_config mic_cfg = PDM_MICROPHONE_TASK_DEFAULT(on_frame, NULL);
+    mic_cfg.poll_ms = 50;
+    if (init_pdm_microphone_rate(usb_audio_mic_sample_rate(), MEMS_DECIMATION) < 0 ||
+        pdm_microphone_pcm_queue_init(PCM_FRAMES) < 0 || pdm_microphone_task_create(&mic_cfg) < 0) {
+        while (1) {
+            toggle_red_led();
+            sleep_ms(200);
+        }
+    }
+    if (MIC_AGC) {
+        struct agc_config agc_cfg;
+        agc_default_config(&agc_cfg, usb_audio_mic_sample_rate());
+        pdm_microphone_set_filter_volume(16);
+        pdm_microphone_set_agc(&agc_cfg);
+    }
+
+    TaskHandle_t hUsb = NULL;
+    xTaskCreate(usbTask, "usb", 1024, NULL, 3, &hUsb);
+    #if (configNUMBER_OF_CORES > 1)
+        vTaskCoreAffinitySet(hUsb, 1u << 0);
+    #endif
+
+    // VERY IMPORTANT, THIS SHOULD GO JUST BEFORE vTaskStartSheduler
+    // WITHOUT ANY DELAYS. OTHERWISE, THE TinyUSB stack wont recognize
+    // the device.
+    tusb_init();
+    usb_serial_init();
+    vTaskStartScheduler();
+
+    return 0;
+}
@@ -3,6 +3,8 @@
 #include <hardware/gpio.h>
 #include <pico/stdlib.h>
 #include <tkjhat/sdk.h>
+#include <tkjhat/audio_codec.h>
+#include <tkjhat/vad.h>
 #include <pico/binary_info.h>
 #include <hardware/sync.h>
 
@@ -20,14 +22,44 @@ static inline void _blink(int n){
     /   MICROPHONE CONFIGURATION
     /=============================*/
     //Internal sample buffer for sound samples
-    int16_t sample_buffer[MEMS_BUFFER_SIZE];
-    int16_t temp_sample_buffer[MEMS_BUFFER_SIZE];//use to have two different buffers.
-    volatile int samples_read = 0;    
+    int16_t temp_sample_buffer[MEMS_BUFFER_SIZE];
+    // The library keeps MEMS_RAW_BUFFER_COUNT buffers in a DMA ring. Core 1
+    // converts them to PCM (PDM filter) into a queue of PCM_FRAMES frames, so
+    // this loop only copies the frames out and a slow USB write only fills the
+    // queue instead of losing samples.
+    #define PCM_FRAMES 8
 
-    void on_sound_buffer_ready(){
-        // callback from library when all the samples in the library
-        // internal sample buffer are ready for reading 
-        samples_read = get_microphone_samples(sample_buffer, MEMS_BUFFER_SIZE);
+    // Each PCM frame is sent as a compressed frame (tkjhat/audio_codec.h):
+    // IMA-ADPCM is 4:1 (4.4 KB/s at 8 kHz), AUDIO_CODEC_MULAW 2:1 and
+    // AUDIO_CODEC_PCM16 uncompressed. tools/record_audio.py decodes any of them
+    // and shows the printf output in between.
+    #define STREAM_CODEC AUDIO_CODEC_IMA_ADPCM
+    #define STREAM_SECONDS 5
+    static audio_encoder_t encoder;
+    static uint8_t frame_buffer[AUDIO_FRAME_MAX_SIZE(MEMS_BUFFER_SIZE)];
+
+    // With STREAM_AGC 1 the filter runs at a low volume, 12 dB under the
+    // default, so loud sounds do not clip in it, and the automatic gain
+    // control of the driver (tkjhat/agc.h) brings the level up: no volume
+    // and gain to find by trial and error for each room.
+    #define STREAM_AGC 1
+
+    // With STREAM_VAD 1 only the frames with sound are sent (tkjhat/vad.h):
+    // silent frames are not encoded nor written to USB. The last
+    // PREROLL_FRAMES silent frames go out first when a sound starts, so its
+    // beginning is not lost. The recording then holds the sounds back to back,
+    // and the stream still lasts STREAM_SECONDS.
+    #define STREAM_VAD 0
+    #define PREROLL_FRAMES 5
+    #if STREAM_VAD
+    static vad_t vad;
+    static vad_preroll_t preroll;
+    static int16_t preroll_storage[PREROLL_FRAMES * MEMS_BUFFER_SIZE];
+    #endif
+
+    static void send_frame(const int16_t *pcm, size_t n) {
+        size_t frame_len = audio_encode_frame(&encoder, pcm, n, frame_buffer, sizeof(frame_buffer));
+        fwrite(frame_buffer, 1, frame_len, stdout);
     }
 
     int main() {
@@ -46,17 +78,33 @@ static inline void _blink(int n){
             printf("PDM microphone initialization failed!\n");
             sleep_ms(1000);
         }
-        else 
+        else {
             printf("Initializing the microphone");
-        pdm_microphone_set_callback(on_sound_buffer_ready);
+            if (pdm_microphone_pcm_queue_init(PCM_FRAMES) == 0)
+                pdm_microphone_launch_core1_worker();
+        }
+        #if STREAM_AGC
+        pdm_microphone_set_filter_volume(16);     // 12 dB of headroom in the filter
+        struct agc_config agc_cfg;
+        agc_default_config(&agc_cfg, MEMS_SAMPLING_FREQUENCY);
+        pdm_microphone_set_agc(&agc_cfg);
+        #else
         pdm_microphone_set_filter_max_volume(64); // keep default
         pdm_microphone_set_filter_gain(8);        // safer base gain than 16
         pdm_microphone_set_filter_volume(56);     // was 64 ⇒ lower hiss; raise if still too quiet
+        #endif
+        audio_encoder_init(&encoder, STREAM_CODEC, MEMS_SAMPLING_FREQUENCY);
+        #if STREAM_VAD
+        struct vad_config vad_cfg;
+        vad_default_config(&vad_cfg, MEMS_SAMPLING_FREQUENCY);
+        vad_init(&vad, &vad_cfg);
+        vad_preroll_init(&preroll, preroll_storage, PREROLL_FRAMES, MEMS_BUFFER_SIZE);
+        #endif
         //Each iteration are 5 seconds. 
         while(true){
-            //We are going to send 5 seconds. Each sample is two bytes and sampling rate 8Khz. 
-            uint32_t target_bytes = MEMS_SAMPLING_FREQUENCY * 2u * 5u;
-            uint32_t sent_bytes = 0;
+            //We are going to send 5 seconds of samples at 8Khz.
+            uint32_t target_samples = MEMS_SAMPLING_FREQUENCY * STREAM_SECONDS;
+            uint32_t sent_samples = 0;
             _blink (5);
             if (is_mic_init >=0) {
                 // Wait till usb is ready and after that, turn the mike and inform other end with READY.
@@ -68,51 +116,71 @@ static inline void _blink(int n){
                     continue;
                 }
                 set_red_led_status(true);
-                while (sent_bytes < target_bytes){
+                #if STREAM_VAD
+                vad_reset(&vad);
+                vad_preroll_clear(&preroll);
+                #endif
+                while (sent_samples < target_samples){
                     if (!stdio_usb_connected()) {
                         _blink(1);
                         set_red_led_status(false);
                         break;
                     }
-                    if (samples_read == 0){
+                    if (pdm_microphone_available() == 0){
                         tight_loop_contents(); // yields without sleeping long
                         continue;
                     } 
-                    //Collect samples in a temporary buffer.          
-                    uint32_t irq = save_and_disable_interrupts();
-                    // store and clear the samples read from the callback
-                    int sample_count = samples_read;  
-                    memcpy(temp_sample_buffer, sample_buffer, (size_t)sample_count * sizeof(sample_buffer[0]));
-                    samples_read = 0;// restart the samples read
-                    restore_interrupts(irq);
+                    //Oldest PCM frame from the queue
+                    int sample_count = get_microphone_samples(temp_sample_buffer, MEMS_BUFFER_SIZE);
 
-                    // loop through any new collected samples
-                    // OPTION 1 using fwrite
-                    // First we create a temporary buffer, so i can send data even if I receive another irq. 
-                    int sample_sent = fwrite(temp_sample_buffer,sizeof(temp_sample_buffer[0]),sample_count,stdout);
-                    sent_bytes += sizeof(temp_sample_buffer[0]) * sample_sent;
-                    
-                    //stdio_flush();
+                    if (sample_count <= 0)
+                        continue;
 
-                    //OPTION 2 using putchar
-                    /*for (int i = 0; i < sample_count; i++) {
-                        int16_t s = temp_sample_buffer[i];
-                        putchar_raw((int8_t)(s & 0xFF));       // LSB
-                        ++sent_bytes;
-                        putchar_raw((int8_t)(s >> 8));         // MSB
-                        ++sent_bytes;
-                    }*/
-                    //stdio_flush();    
+                    // OPTION 1: compressed frames with fwrite
+                    #if STREAM_VAD
+                    // Silent frames count in the time too
+                    sent_samples += sample_count;
+                    if (!vad_push(&vad, temp_sample_buffer, sample_count)) {
+                        vad_preroll_push(&preroll, temp_sample_buffer, sample_count);
+                        continue;
+                    }
+                    size_t held;
+                    const int16_t *old;
+                    while ((old = vad_preroll_pop(&preroll, &held)) != NULL)
+                        send_frame(old, held);
+                    #else
+                    sent_samples += sample_count;
+                    #endif
+                    send_frame(temp_sample_buffer, sample_count);
 
-                    //OPTION 3: using printf. Only for showing in graph (e.g. in Arduino Uno plotter)
+                    //OPTION 2: using printf. Only for showing in graph (e.g. in Arduino Uno plotter)
                     /*for (int i = 0; i < sample_count; i++) {
                         printf("%d\n", temp_sample_buffer[i]);
-                        sent_bytes += sizeof(temp_sample_buffer[0]);
                     }
+                    sent_samples += sample_count;
                     stdio_flush();*/
                 }
                 set_red_led_status(false);
                 end_microphone_sampling();
+                #if STREAM_AGC
+                const agc_t *agc = pdm_microphone_get_agc();
+                if (agc) {
+                    uint32_t limited, clipped;
+                    agc_counters(agc, &limited, &clipped);
+                    printf("AGC gain %lu/256, since start limited %lu ms, clipped in the filter %lu\n",
+                           (unsigned long)agc_gain_q8(agc), (unsigned long)limited, (unsigned long)clipped);
+                }
+                #endif
+                #if STREAM_VAD
+                printf("Sound in %lu per mille of the stream\n", (unsigned long)vad_duty_permille(&vad));
+                #endif
+                // Lost buffers or frames during the stream: blink once per loss (max 5)
+                struct pdm_microphone_stats stats;
+                pdm_microphone_get_stats(&stats);
+                uint32_t lost = stats.overruns + stats.pcm_dropped;
+                if (lost > 0)
+                    _blink(lost > 5 ? 5 : (int)lost);
+                pdm_microphone_reset_stats();
                 _blink(3);   
             }
             //Debugging blink.
@@ -0,0 +1,249 @@
+#!/usr/bin/env python3
+"""Receive the compressed audio frames of hello_microphone and save or play them.
+
+The board sends every microphone buffer as a frame (tkjhat/audio_codec.h):
+IMA-ADPCM, mu-law or raw PCM16 with a small header and a CRC. This script finds
+the frames in the serial stream, decodes them and writes a .wav file, or plays
+them with aplay. Text printed by the board between the frames is shown on
+stderr, and lost or corrupted frames are reported.
+
+Usage:
+    record_audio.py /dev/ttyACM0                     # 5 s to mic_<date>.wav
+    record_audio.py /dev/ttyACM0 --secs 10 -o speech.wav
+    record_audio.py /dev/ttyACM0 --play              # until Ctrl-C
+    record_audio.py --input stream.bin -o out.wav    # decode a saved stream
+
+Needs pyserial (pip install pyserial) for a serial port. --play needs aplay
+(alsa-utils); nothing else is needed, the .wav is written directly.
+"""
+
+import argparse
+import struct
+import subprocess
+import sys
+import time
+import wave
+
+MAGIC = b"TA"
+HEADER = struct.Struct("<2sBBHHH")   # magic, codec, seq, rate, samples, CRC
+CODEC_PCM16, CODEC_MULAW, CODEC_IMA_ADPCM = 0, 1, 2
+CODEC_NAMES = {CODEC_PCM16: "PCM16", CODEC_MULAW: "mu-law", CODEC_IMA_ADPCM: "IMA-ADPCM"}
+MAX_SAMPLES = 4096
+ADPCM_PREAMBLE = 4
+
+ADPCM_STEPS = [
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+    11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+    32767,
+]
+ADPCM_INDEX_STEP = [-1, -1, -1, -1, 2, 4, 6, 8]
+
+
+def crc16(data, crc=0xFFFF):
+    # CRC-16/CCITT-FALSE, as in audio_codec.c
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) & 0xFFFF if crc & 0x8000 else (crc << 1) & 0xFFFF
+    return crc
+
+
+def payload_size(codec, samples):
+    if codec == CODEC_PCM16:
+        return 2 * samples
+    if codec == CODEC_MULAW:
+        return samples
+    if codec == CODEC_IMA_ADPCM:
+        return ADPCM_PREAMBLE + (samples + 1) // 2
+    return None
+
+
+def mulaw_table():
+    table = []
+    for code in range(256):
+        c = ~code & 0xFF
+        exponent = (c >> 4) & 0x07
+        s = ((((c & 0x0F) << 3) + 0x84) << exponent) - 0x84
+        table.append(-s if c & 0x80 else s)
+    return table
+
+
+MULAW = mulaw_table()
+
+
+def adpcm_decode(payload, samples):
+    pred, index = struct.unpack_from("<hB", payload)
+    out = []
+    for i in range(samples):
+        b = payload[ADPCM_PREAMBLE + i // 2]
+        code = b >> 4 if i & 1 else b & 0x0F
+        step = ADPCM_STEPS[index]
+        diff = step >> 3
+        if code & 4:
+            diff += step
+        if code & 2:
+            diff += step >> 1
+        if code & 1:
+            diff += step >> 2
+        pred = max(-32768, min(32767, pred - diff if code & 8 else pred + diff))
+        index = max(0, min(88, index + ADPCM_INDEX_STEP[code & 7]))
+        out.append(pred)
+    return out
+
+
+class Decoder:
+    """Splits a byte stream into frames and text, like audio_decode_frame()."""
+
+    def __init__(self):
+        self.buf = bytearray()
+        self.text = bytearray()
+        self.last_seq = None
+        self.frames = self.lost = self.skipped = 0
+        self.rate = self.codec = None
+
+    def feed(self, data):
+        """Add received bytes, return the decoded samples."""
+        self.buf += data
+        pcm = []
+        while True:
+            r = self._frame()
+            if r is None:
+                break
+            if r is False:
+                self.text.append(self.buf[0])
+                del self.buf[0]
+                self.skipped += 1
+                continue
+            pcm += r
+        self._flush_text()
+        return pcm
+
+    def _frame(self):
+        # None: wait for more bytes, False: no frame at buf[0], else the samples
+        buf = self.buf
+        if len(buf) < 1:
+            return None
+        if buf[0] != MAGIC[0]:
+            return False
+        if len(buf) < 2:
+            return None
+        if buf[1] != MAGIC[1]:
+            return False
+        if len(buf) < HEADER.size:
+            return None
+        _, codec, seq, rate, samples, crc = HEADER.unpack_from(buf)
+        size = payload_size(codec, samples)
+        if size is None or samples == 0 or samples > MAX_SAMPLES or rate == 0:
+            return False
+        end = HEADER.size + size
+        if len(buf) < end:
+            return None
+        payload = bytes(buf[HEADER.size:end])
+        if crc16(payload, crc16(buf[:HEADER.size - 2])) != crc:
+            return False
+        if codec == CODEC_IMA_ADPCM and payload[2] > 88:
+            return False
+
+        if codec == CODEC_PCM16:
+            pcm = list(struct.unpack("<%dh" % samples, payload))
+        elif codec == CODEC_MULAW:
+            pcm = [MULAW[b] for b in payload]
+        else:
+            pcm = adpcm_decode(payload, samples)
+        if self.last_seq is not None and seq != (self.last_seq + 1) & 0xFF:
+            self.lost += (seq - self.last_seq - 1) & 0xFF
+        self.last_seq = seq
+        if self.rate is None:
+            self.rate, self.codec = rate, codec
+            sys.stderr.write("stream: %s, %d Hz, %d samples per frame\n"
+                             % (CODEC_NAMES[codec], rate, samples))
+        self.frames += 1
+        del buf[:end]
+        return pcm
+
+    def _flush_text(self):
+        # Board output between frames: show complete lines
+        while b"\n" in self.text:
+            line, _, rest = self.text.partition(b"\n")
+            self.text = bytearray(rest)
+            line = line.decode("utf-8", "replace").strip()
+            if line:
+                sys.stderr.write("board: %s\n" % line)
+
+
+def chunks_from_port(path):
+    try:
+        import serial
+    except ImportError:
+        sys.exit("pyserial is needed: pip install pyserial")
+    with serial.Serial(path, timeout=0.2) as port:
+        port.reset_input_buffer()
+        while True:
+            yield port.read(4096)
+
+
+def chunks_from_file(path):
+    with open(path, "rb") as f:
+        while True:
+            data = f.read(4096)
+            if not data:
+                return
+            yield data
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("port", nargs="?", default="/dev/ttyACM0",
+                    help="serial port of the board, e.g. /dev/ttyACM0 or COM5")
+    ap.add_argument("--input", help="decode a saved stream instead of a serial port")
+    ap.add_argument("-o", "--out", help="output .wav file (default mic_<date>.wav)")
+    ap.add_argument("--secs", type=float, default=5.0, help="seconds of audio to record")
+    ap.add_argument("--play", action="store_true", help="play with aplay instead of saving")
+    args = ap.parse_args()
+
+    dec = Decoder()
+    source = chunks_from_file(args.input) if args.input else chunks_from_port(args.port)
+    player = None
+    pcm = []
+    try:
+        for data in source:
+            samples = dec.feed(data)
+            if not samples:
+                continue
+            if args.play:
+                if player is None:
+                    player = subprocess.Popen(["aplay", "-q", "-f", "S16_LE", "-r", str(dec.rate),
+                                               "-c", "1"], stdin=subprocess.PIPE)
+                player.stdin.write(struct.pack("<%dh" % len(samples), *samples))
+                player.stdin.flush()
+                continue
+            pcm += samples
+            if len(pcm) >= args.secs * dec.rate:
+                del pcm[int(args.secs * dec.rate):]
+                break
+    except KeyboardInterrupt:
+        pass
+    finally:
+        if player is not None:
+            player.stdin.close()
+            player.wait()
+
+    if dec.lost or dec.frames == 0:
+        sys.stderr.write("%d frames decoded, %d lost or corrupted\n" % (dec.frames, dec.lost))
+    if args.play or not pcm:
+        return
+    out = args.out or time.strftime("mic_%Y%m%d_%H%M%S.wav")
+    with wave.open(out, "wb") as w:
+        w.setnchannels(1)
+        w.setsampwidth(2)
+        w.setframerate(dec.rate)
+        w.writeframes(struct.pack("<%dh" % len(pcm), *pcm))
+    print("written %s: %.2f s at %d Hz" % (out, len(pcm) / dec.rate, dec.rate))
+
+
+if __name__ == "__main__":
+    main()
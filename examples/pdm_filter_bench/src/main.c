@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <hardware/clocks.h>
+#include <hardware/sync.h>
+#include <pico/stdlib.h>
+
+#include "OpenPDMFilter.h"
+
+// Cost of the PDM to PCM filter of the SDK on the RP2040.
+//
+// The filter decodes BENCH_MS milliseconds of random PDM data for every
+// sample rate and decimation the microphone supports. Printed: CPU cycles per
+// millisecond of audio and the load on one core. The microphone is not used.
+//
+// Build the SDK with -DTKJHAT_PDM_INT64=ON to measure the original 64-bit
+// stages, and with -DTKJHAT_PDM_BYTE_LUT=ON for the 48 KB table.
+
+#define BENCH_MS        1000
+#define MAX_BYTES_PER_MS (48 * 128 / 8)     // 48 kHz, decimation 128
+
+static uint8_t pdm[MAX_BYTES_PER_MS * 4];
+static int16_t pcm[48];
+
+// Cycles per millisecond of audio. Cycles are derived from the microsecond
+// timer and clk_sys, like in the hat_imu_fusion benchmark.
+static uint32_t filter_benchmark(uint16_t fs, uint8_t decimation) {
+    static TPDMFilter_InitStruct filter;
+    filter.Fs = fs;
+    filter.LP_HZ = fs / 2;
+    filter.HP_HZ = 10;
+    filter.In_MicChannels = 1;
+    filter.Out_MicChannels = 1;
+    filter.Decimation = decimation;
+    filter.MaxVolume = 64;
+    filter.Gain = 16;
+    Open_PDM_Filter_Init(&filter);
+
+    const uint32_t bytes_per_ms = fs / 1000 * decimation / 8;
+    uint32_t irq = save_and_disable_interrupts();
+    uint64_t start = time_us_64();
+    for (int ms = 0; ms < BENCH_MS; ms++) {
+        uint8_t *in = &pdm[(ms & 3) * bytes_per_ms];
+        if (decimation == 64) Open_PDM_Filter_64(in, (uint16_t *)pcm, filter.MaxVolume, &filter);
+        else Open_PDM_Filter_128(in, (uint16_t *)pcm, filter.MaxVolume, &filter);
+    }
+    uint64_t elapsed_us = time_us_64() - start;
+    restore_interrupts(irq);
+
+    uint32_t mhz = clock_get_hz(clk_sys) / 1000000;
+    return (uint32_t)((elapsed_us * mhz) / BENCH_MS);
+}
+
+int main() {
+    stdio_init_all();
+    sleep_ms(2000); // Wait to see the output.
+
+    srand(1);
+    for (size_t i = 0; i < sizeof(pdm); i++) pdm[i] = (uint8_t)rand();
+
+    static const struct { uint16_t fs; uint8_t decimation; } cfgs[] = {
+        { 8000, 64 }, { 16000, 64 }, { 8000, 128 }, { 16000, 128 }, { 48000, 64 },
+    };
+
+    while (true) {
+        uint32_t mhz = clock_get_hz(clk_sys) / 1000000;
+#ifdef OPENPDM_INT64
+        const char *stages = "64-bit";
+#else
+        const char *stages = "32-bit";
+#endif
+#ifdef OPENPDM_BYTE_LUT
+        const char *table = "byte (48 KB)";
+#else
+        const char *table = "nibble (flash)";
+#endif
+        printf("PDM filter benchmark: %s stages, %s table, %u MHz\n", stages, table, (unsigned)mhz);
+        printf("    Fs  dec  cycles/ms  core load\n");
+        for (size_t i = 0; i < sizeof(cfgs) / sizeof(cfgs[0]); i++) {
+            uint32_t cycles = filter_benchmark(cfgs[i].fs, cfgs[i].decimation);
+            uint32_t load_permille = cycles / mhz;  // cycles per ms / cycles per us
+            printf("%6u %4u %10u  %3u.%u %%\n", cfgs[i].fs, cfgs[i].decimation, (unsigned)cycles,
+                   (unsigned)(load_permille / 10), (unsigned)(load_permille % 10));
+        }
+        printf("\n");
+        sleep_ms(5000);
+    }
+    return 0;
+}
@@ -0,0 +1,155 @@
+/*
+Version 0.83
+
+MIT License
+
+Copyright (c) 2025 , Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file tkjhat/agc.h
+ * @brief Automatic gain control with a look-ahead limiter for microphone PCM.
+ *
+ * @details
+ * The fixed filter volume (pdm_microphone_set_filter_volume()) is either too
+ * low for a quiet room or clips at +-32700 on a loud voice. The AGC runs on
+ * the PCM samples after the filter: set the filter volume low (16 leaves
+ * 12 dB over the default volume before the filter clips) and let the AGC
+ * bring the level up to @c target.
+ *
+ * The samples are processed in 1 ms steps (sample_rate / 1000 samples):
+ *
+ * 1. **Envelope**: peak |x| of the step, followed with the @c attack_ms time
+ *    constant when it rises and @c release_ms when it falls.
+ * 2. **Gain**: @c target / envelope, between @c min_gain_q8 and
+ *    @c max_gain_q8. While the envelope is under @c gate the gain is held,
+ *    so the room noise between words is not pumped up.
+ * 3. **Limiter**: the peak of the step is known before the step is
+ *    written, so the gain is cut at once when peak * gain would go over
+ *    @c ceiling. The output never clips, without a flat top.
+ * 4. The gain moves linearly over the step: no clicks at the 1 ms steps.
+ *
+ * One multiply per sample plus one division per step: about 20 cycles per
+ * sample on the RP2040, under 0.2 % of a core at 8 kHz. The module is
+ * hardware independent (libs/TKJHAT/tools/agc_sim measures it with speech at
+ * different levels).
+ * pdm_microphone_set_agc() runs it inside the microphone driver.
+ *
+ * @code{.c}
+ * static agc_t agc;
+ * struct agc_config cfg;
+ * agc_default_config(&cfg, 8000);
+ * agc_init(&agc, &cfg);
+ * pdm_microphone_set_filter_volume(16);
+ *
+ * int n = get_microphone_samples(pcm, MEMS_BUFFER_SIZE);
+ * agc_process(&agc, pcm, n);          // in place
+ * @endcode
+ */
+
+#ifndef AGC_H
+#define AGC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define AGC_GAIN_ONE_Q8     256     /**< Gain 1 (0 dB) in Q8. */
+#define AGC_INPUT_CLIP      32700   /**< Input samples this large were clipped by the PDM filter. */
+
+/**
+ * @brief AGC configuration. Fill with ::agc_default_config() and adjust.
+ */
+struct agc_config {
+    uint32_t sample_rate;           /**< PCM sample rate in Hz (a multiple of 1000). */
+    uint16_t target;                /**< Envelope (peak) level to reach, LSB. */
+    uint16_t ceiling;               /**< Limiter: output peak never above this, LSB. */
+    uint16_t max_gain_q8;           /**< Most gain (Q8, 8192 = 32x = 30 dB). */
+    uint16_t min_gain_q8;           /**< Least gain (Q8, 64 = 0.25x = -12 dB). */
+    uint16_t attack_ms;             /**< Time constant of a rising envelope. */
+    uint16_t release_ms;            /**< Time constant of a falling envelope (the gain rises). */
+    uint16_t gate;                  /**< Gain is held while the input envelope is under this, LSB (0 = off). */
+};
+
+/**
+ * @brief AGC state. Treat fields as private.
+ */
+typedef struct {
+    struct agc_config cfg;
+    uint16_t step;                  /**< Samples per step (1 ms). */
+    uint32_t attack_q16;            /**< Envelope coefficients per step (Q16). */
+    uint32_t release_q16;
+    uint32_t env_q8;                /**< Input envelope (Q8). */
+    uint32_t gain_q16;              /**< Gain at the end of the last step (Q16). */
+    uint32_t limited;               /**< Steps cut by the limiter. */
+    uint32_t clipped;               /**< Input samples at the filter clip level. */
+} agc_t;
+
+/**
+ * @brief Default configuration: target 10000 (-10 dBFS), ceiling 30000,
+ *        gain -12..+30 dB, 5 ms attack, 500 ms release, gate 50.
+ *
+ * @param cfg         Configuration to fill.
+ * @param sample_rate PCM sample rate in Hz.
+ */
+void agc_default_config(struct agc_config *cfg, uint32_t sample_rate);
+
+/**
+ * @brief Initialize the AGC. The gain starts at 1.
+ *
+ * @param agc AGC state.
+ * @param cfg Configuration (copied).
+ * @return 0 on success, -1 on an invalid configuration.
+ */
+int agc_init(agc_t *agc, const struct agc_config *cfg);
+
+/**
+ * @brief Gain back to 1, envelope and counters cleared.
+ */
+void agc_reset(agc_t *agc);
+
+/**
+ * @brief Apply the gain to PCM samples, in place.
+ *
+ * @p n should be a multiple of sample_rate / 1000 (microphone frames are);
+ * a shorter last step is processed as it is.
+ *
+ * @param agc AGC state.
+ * @param pcm Samples, replaced by the output.
+ * @param n   Number of samples.
+ */
+void agc_process(agc_t *agc, int16_t *pcm, size_t n);
+
+/**
+ * @brief Current gain in Q8 (256 = 1).
+ */
+uint32_t agc_gain_q8(const agc_t *agc);
+
+/**
+ * @brief Counters since init or reset.
+ *
+ * @param agc     AGC state.
+ * @param limited Output: 1 ms steps where the limiter cut the gain (can be NULL).
+ * @param clipped Output: input samples at ::AGC_INPUT_CLIP, i.e. already
+ *                clipped by the PDM filter: lower the filter volume (can be NULL).
+ */
+void agc_counters(const agc_t *agc, uint32_t *limited, uint32_t *clipped);
+
+#endif /* AGC_H */
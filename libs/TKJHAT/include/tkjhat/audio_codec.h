@@ -0,0 +1,213 @@
+/*
+Version 0.83
+
+MIT License
+
+Copyright (c) 2025 , Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file tkjhat/audio_codec.h
+ * @brief Compress microphone PCM into framed IMA-ADPCM or µ-law blocks for a serial link.
+ *
+ * @details
+ * Raw 16-bit PCM takes 16 KB/s at 8 kHz and 64 KB/s at 32 kHz, most of a
+ * full-speed USB CDC link that also carries the debug output. The encoder packs
+ * one microphone buffer at a time into a frame:
+ *
+ * | Codec                       | Bytes per sample | 256 samples at 8 kHz |
+ * |-----------------------------|------------------|----------------------|
+ * | ::AUDIO_CODEC_PCM16         | 2                | 522 B, 16.3 KB/s     |
+ * | ::AUDIO_CODEC_MULAW (G.711) | 1                | 266 B, 8.3 KB/s      |
+ * | ::AUDIO_CODEC_IMA_ADPCM     | 0.5              | 142 B, 4.4 KB/s      |
+ *
+ * Frame layout (little endian):
+ *
+ * | Offset | Size | Field                                             |
+ * |--------|------|---------------------------------------------------|
+ * | 0      | 2    | Magic "TA"                                        |
+ * | 2      | 1    | Codec (::audio_codec_t)                           |
+ * | 3      | 1    | Sequence number (wraps at 256)                    |
+ * | 4      | 2    | Sample rate in Hz                                 |
+ * | 6      | 2    | Number of samples                                 |
+ * | 8      | 2    | CRC-16/CCITT-FALSE of bytes 0..7 and the payload  |
+ * | 10     | n    | Payload                                           |
+ *
+ * The IMA-ADPCM payload starts with the predictor (int16) and the step index
+ * (uint8, then one pad byte) before the first sample, followed by one nibble
+ * per sample (first sample in the low nibble). The encoder carries its state
+ * from frame to frame, but every frame can be decoded on its own, so a lost
+ * frame only leaves a gap.
+ *
+ * Text printed between frames (printf on the same port) does not break the
+ * stream: the decoder skips bytes until the magic, a known codec and the CRC
+ * match. The sequence number shows lost frames.
+ *
+ * The module is hardware independent, so the same code decodes on the host
+ * (libs/TKJHAT/tools/audio_codec_check). The Python decoder of the
+ * hello_microphone example (tools/record_audio.py) reads the same format.
+ *
+ * @code{.c}
+ * static audio_encoder_t enc;
+ * static uint8_t frame[AUDIO_FRAME_MAX_SIZE(MEMS_BUFFER_SIZE)];
+ * audio_encoder_init(&enc, AUDIO_CODEC_IMA_ADPCM, MEMS_SAMPLING_FREQUENCY);
+ *
+ * int n = get_microphone_samples(pcm, MEMS_BUFFER_SIZE);
+ * size_t len = audio_encode_frame(&enc, pcm, n, frame, sizeof(frame));
+ * fwrite(frame, 1, len, stdout);
+ * @endcode
+ */
+
+#ifndef AUDIO_CODEC_H
+#define AUDIO_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define AUDIO_FRAME_MAGIC0          'T'     /**< First byte of every frame. */
+#define AUDIO_FRAME_MAGIC1          'A'     /**< Second byte of every frame. */
+#define AUDIO_FRAME_HEADER_SIZE     10      /**< Bytes before the payload. */
+#define AUDIO_ADPCM_PREAMBLE_SIZE   4       /**< Predictor and step index at the start of an ADPCM payload. */
+#define AUDIO_FRAME_MAX_SAMPLES     4096    /**< Largest number of samples in one frame. */
+
+/**
+ * @brief Largest frame of any codec for @p samples samples, to size the output buffer.
+ *
+ * PCM16 needs 2 bytes a sample. An ADPCM frame of 1 or 2 samples is larger
+ * than that (preamble + 1 byte), so the preamble is counted as well.
+ */
+#define AUDIO_FRAME_MAX_SIZE(samples)   (AUDIO_FRAME_HEADER_SIZE + AUDIO_ADPCM_PREAMBLE_SIZE + 2 * (samples))
+
+/**
+ * @brief Payload coding of a frame.
+ */
+typedef enum {
+    AUDIO_CODEC_PCM16 = 0,          /**< Uncompressed int16, little endian. */
+    AUDIO_CODEC_MULAW = 1,          /**< G.711 µ-law, 8 bits per sample (2:1). */
+    AUDIO_CODEC_IMA_ADPCM = 2,      /**< IMA-ADPCM, 4 bits per sample (4:1). */
+} audio_codec_t;
+
+/**
+ * @brief IMA-ADPCM predictor state.
+ */
+typedef struct {
+    int16_t predictor;              /**< Last reconstructed sample. */
+    uint8_t index;                  /**< Step size index (0..88). */
+} audio_adpcm_state_t;
+
+/**
+ * @brief Encoder state. Treat fields as private.
+ */
+typedef struct {
+    audio_codec_t codec;
+    uint16_t sample_rate;
+    uint8_t seq;                    /**< Sequence number of the next frame. */
+    audio_adpcm_state_t adpcm;
+} audio_encoder_t;
+
+/**
+ * @brief Header of a decoded frame.
+ */
+typedef struct {
+    audio_codec_t codec;
+    uint8_t seq;
+    uint16_t sample_rate;           /**< Hz. */
+    uint16_t samples;
+} audio_frame_info_t;
+
+/**
+ * @brief Initialize an encoder.
+ *
+ * @param enc         Encoder state.
+ * @param codec       Payload coding.
+ * @param sample_rate Sample rate written to the frames (1..65535 Hz).
+ * @return 0 on success, -1 on an unknown codec or invalid sample rate.
+ */
+int audio_encoder_init(audio_encoder_t *enc, audio_codec_t codec, uint32_t sample_rate);
+
+/**
+ * @brief Encode one block of PCM into a frame.
+ *
+ * @param enc      Encoder state.
+ * @param pcm      Samples.
+ * @param samples  Number of samples (1..::AUDIO_FRAME_MAX_SAMPLES).
+ * @param out      Output buffer.
+ * @param out_size Size of @p out; ::AUDIO_FRAME_MAX_SIZE(samples) is always enough.
+ * @return Frame length in bytes, or 0 if the arguments are invalid or @p out is too small.
+ */
+size_t audio_encode_frame(audio_encoder_t *enc, const int16_t *pcm, size_t samples,
+                          uint8_t *out, size_t out_size);
+
+/**
+ * @brief Payload size in bytes of @p samples samples with @p codec (0 on an unknown codec).
+ */
+size_t audio_payload_size(audio_codec_t codec, size_t samples);
+
+/**
+ * @brief Decode the frame at the start of a byte stream.
+ *
+ * On -1 the caller drops the first byte and tries again (resynchronization).
+ *
+ * @param buf         Received bytes, starting where a frame is expected.
+ * @param len         Number of bytes in @p buf.
+ * @param pcm         Output samples (can be NULL to only check the frame).
+ * @param max_samples Size of @p pcm.
+ * @param info        Output: frame header (can be NULL).
+ * @return Length of the frame in bytes, 0 if @p buf holds only the start of a
+ *         frame (wait for more bytes), -1 if there is no valid frame at @p buf
+ *         or it has more than @p max_samples samples.
+ */
+int audio_decode_frame(const uint8_t *buf, size_t len, int16_t *pcm, size_t max_samples,
+                       audio_frame_info_t *info);
+
+/**
+ * @brief Encode one sample to G.711 µ-law.
+ */
+uint8_t audio_mulaw_encode(int16_t sample);
+
+/**
+ * @brief Decode one G.711 µ-law byte.
+ */
+int16_t audio_mulaw_decode(uint8_t code);
+
+/**
+ * @brief Encode samples to IMA-ADPCM nibbles (first sample in the low nibble).
+ *
+ * @param state   Predictor state, updated.
+ * @param pcm     Samples.
+ * @param samples Number of samples.
+ * @param out     Output, (samples + 1) / 2 bytes.
+ */
+void audio_adpcm_encode(audio_adpcm_state_t *state, const int16_t *pcm, size_t samples,
+                        uint8_t *out);
+
+/**
+ * @brief Decode IMA-ADPCM nibbles.
+ *
+ * @param state   Predictor state, updated.
+ * @param in      Nibbles, (samples + 1) / 2 bytes.
+ * @param samples Number of samples.
+ * @param pcm     Output samples.
+ */
+void audio_adpcm_decode(audio_adpcm_state_t *state, const uint8_t *in, size_t samples,
+                        int16_t *pcm);
+
+#endif /* AUDIO_CODEC_H */
@@ -0,0 +1,179 @@
+/*
+Version 0.83
+
+MIT License
+
+Copyright (c) 2025 , Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file tkjhat/clap.h
+ * @brief Clap and knock detector: short sharp sounds of the microphone as input events.
+ *
+ * @details
+ * PCM samples are pushed frame by frame as they come from the microphone.
+ * The level of each short block (4 ms by default) is the mean
+ * |x[n] - x[n-1]| (no multiplies, a high-pass like in tkjhat/vad.h), and a
+ * clap is recognised from how the level changes:
+ *
+ * 1. **Onset**: the level jumps @c on_ratio times over the background (the
+ *    slow mean of the level before, 15.6 dB by default) and over
+ *    @c min_level.
+ * 2. **Sharp**: the loudest block comes within @c rise_ms of the onset. A
+ *    word that keeps getting louder is not a clap.
+ * 3. **Short**: from @c decay_ms after the onset, the mean level of the
+ *    next @c quiet_ms is @c decay_ratio_q4 (Q4) times under the peak. Vowels,
+ *    whistles and music go on and are rejected, also a plosive ("t", "k")
+ *    followed by its vowel; the echo of a room is much quieter than the
+ *    clap itself near the microphone.
+ * 4. **Refractory**: nothing new is started for @c refractory_ms after a
+ *    clap, so its echo or a rattle is not a second clap.
+ *
+ * Claps less than @c group_ms apart form a group: ::clap_push() returns the
+ * number of claps once the group is over (1 for a single clap, 2 for a
+ * double clap...), so different counts can be different commands. The
+ * background is not updated during an onset and the refractory time.
+ *
+ * The cost is a subtraction and an addition per sample, negligible at 8 kHz.
+ * The module is hardware independent: libs/TKJHAT/tools/clap_sim measures it
+ * with synthetic claps, speech and typing, or with recorded .wav files.
+ *
+ * @code{.c}
+ * static clap_t clap;
+ * struct clap_config cfg;
+ * clap_default_config(&cfg, 8000);
+ * clap_init(&clap, &cfg);
+ *
+ * int n = get_microphone_samples(pcm, MEMS_BUFFER_SIZE);
+ * switch (clap_push(&clap, pcm, n)) {
+ * case 1: space(); break;                   // single clap
+ * case 2: send();  break;                   // double clap
+ * default: break;
+ * }
+ * @endcode
+ */
+
+#ifndef CLAP_H
+#define CLAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define CLAP_BLOCK_MS           4       /**< Default block length. */
+#define CLAP_MAX_GROUP          9       /**< Claps counted in one group at most. */
+
+/**
+ * @brief Detector configuration. Fill with ::clap_default_config() and adjust.
+ */
+struct clap_config {
+    uint32_t sample_rate;           /**< PCM sample rate in Hz. */
+    uint16_t block;                 /**< Samples per level, at least 4. */
+    uint16_t on_ratio_q4;           /**< Onset at this level over the background (Q4, 96 = 6x = 15.6 dB). */
+    uint16_t min_level;             /**< No onset below this level (LSB), whatever the background. */
+    uint8_t decay_ratio_q4;         /**< Peak / level after a clap (Q4, 56 = 3.5x = 11 dB), at least 2x. */
+    uint16_t rise_ms;               /**< The peak must come this soon after the onset. */
+    uint16_t decay_ms;              /**< The level must have fallen this soon after the onset... */
+    uint16_t quiet_ms;              /**< ...and stay down this long after that. */
+    uint16_t refractory_ms;         /**< No new onset this long after a clap (counted from the onset). */
+    uint16_t group_ms;              /**< Claps closer than this form one group. */
+};
+
+/**
+ * @brief Detector state. Treat fields as private.
+ */
+typedef struct {
+    struct clap_config cfg;
+    uint32_t sum;                   /**< Sum of the level in the current block. */
+    uint16_t count;                 /**< Samples of the current block. */
+    int16_t prev;                   /**< Previous sample. */
+    uint32_t level_q8;              /**< Level of the last block (Q8). */
+    uint32_t background_q8;         /**< Slow mean of the level outside claps (Q8). */
+    uint32_t peak_q8;               /**< Loudest block since the onset (Q8). */
+    uint32_t tail_q8;               /**< Sum of the levels in the quiet time (Q8). */
+    uint8_t state;                  /**< Waiting, onset, refractory. */
+    bool rejected;                  /**< The onset is not a clap (the quiet time is waited anyway). */
+    uint16_t since_onset;           /**< Blocks since the onset. */
+    uint16_t rise_blocks, decay_blocks, quiet_blocks, refractory_blocks, group_blocks;
+    uint16_t group_left;            /**< Blocks until the group is over (0 = no group). */
+    uint8_t group;                  /**< Claps in the group so far. */
+    uint32_t claps, rejects;        /**< Claps heard and onsets rejected since init or reset. */
+} clap_t;
+
+/**
+ * @brief Default configuration: 4 ms blocks, onset at 6x (15.6 dB) over the
+ *        background and a level of 600, peak within 10 ms, 3.5x (11 dB)
+ *        under the peak from 30 to 100 ms, 120 ms refractory time, 500 ms groups.
+ *
+ * The minimum level suits the microphone at volume 64 or behind the AGC of
+ * the driver (tkjhat/agc.h); lower it for a lower volume.
+ *
+ * @param cfg         Configuration to fill.
+ * @param sample_rate PCM sample rate in Hz.
+ */
+void clap_default_config(struct clap_config *cfg, uint32_t sample_rate);
+
+/**
+ * @brief Initialize the detector.
+ *
+ * @param clap Detector state.
+ * @param cfg  Configuration (copied).
+ * @return 0 on success, -1 on an invalid configuration.
+ */
+int clap_init(clap_t *clap, const struct clap_config *cfg);
+
+/**
+ * @brief Forget the background, a clap in progress and the group (e.g. after a pause in sampling).
+ *
+ * @param clap Detector state.
+ */
+void clap_reset(clap_t *clap);
+
+/**
+ * @brief Push one frame of PCM samples.
+ *
+ * @param clap Detector state.
+ * @param pcm  Samples.
+ * @param n    Number of samples.
+ * @return Number of claps in a group that ended in this frame (1 = single,
+ *         2 = double clap, at most ::CLAP_MAX_GROUP), 0 if no group ended.
+ */
+uint8_t clap_push(clap_t *clap, const int16_t *pcm, size_t n);
+
+/**
+ * @brief Levels for tuning: level of the last block and the background (LSB).
+ *
+ * @param clap       Detector state.
+ * @param level      Output (can be NULL).
+ * @param background Output (can be NULL).
+ */
+void clap_levels(const clap_t *clap, uint32_t *level, uint32_t *background);
+
+/**
+ * @brief Claps heard and onsets rejected (too slow or too long) since init or reset.
+ *
+ * @param clap    Detector state.
+ * @param claps   Output (can be NULL).
+ * @param rejects Output (can be NULL).
+ */
+void clap_counters(const clap_t *clap, uint32_t *claps, uint32_t *rejects);
+
+#endif /* CLAP_H */
@@ -0,0 +1,144 @@
+/*
+Version 0.83
+
+MIT License
+
+Copyright (c) 2025 , Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file tkjhat/fft.h
+ * @brief Fixed-point real FFT and dB spectrum for microphone blocks.
+ *
+ * @details
+ * One call turns @c size PCM samples (64..512, a power of two) into
+ * @c size / 2 bins of level in dB relative to a full-scale sine. Bin @c k is
+ * at k * sample_rate / size Hz, so at 8 kHz a 256-point spectrum has 128
+ * bins of 31.25 Hz: one column each on the 128 pixel wide OLED.
+ *
+ * 1. **Window**: Hann (or none), applied in Q15 from a table in flash.
+ * 2. **Packing**: the real block is transformed as a complex block of half
+ *    the length (even samples real, odd imaginary) and split afterwards, so
+ *    a 256-point spectrum costs a 128-point complex FFT.
+ * 3. **FFT**: radix-2 decimation in time on int16 values with Q15 twiddles
+ *    from a quarter-wave sine table in flash. The first two stages need no
+ *    multiplies (twiddles 1 and -j). Block floating point: the input is
+ *    normalized to use the full int16 range, and a stage halves its outputs
+ *    only when they could overflow, so quiet signals keep their resolution.
+ * 4. **dB**: power of every bin to dB in Q8 with an integer log2 (a 33 entry
+ *    table), no floating point per call.
+ *
+ * Only 32-bit multiplies, no division and no floating point in
+ * ::fft_spectrum_db() (the RP2040 has no FPU and no 64-bit multiplier). The
+ * state holds the work buffer (size * 2 bytes); the tables are shared and
+ * const. The module is hardware independent
+ * (libs/TKJHAT/tools/fft_check compares it with a double precision DFT).
+ *
+ * @code{.c}
+ * static fft_t fft;
+ * static int16_t db[128];
+ * struct fft_config cfg;
+ * fft_default_config(&cfg, 256);
+ * fft_init(&fft, &cfg);
+ *
+ * int n = get_microphone_samples(pcm, 256);
+ * if (n == 256) {
+ *     fft_spectrum_db(&fft, pcm, db);    // db[k] / 256 = dBFS of bin k
+ * }
+ * @endcode
+ */
+
+#ifndef FFT_H
+#define FFT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FFT_MIN_SIZE        64              /**< Smallest transform (samples). */
+#define FFT_MAX_SIZE        512             /**< Largest transform (samples). */
+#define FFT_DB_FLOOR_Q8     (-120 * 256)    /**< Level of an empty bin (dB, Q8). */
+
+/**
+ * @brief Window applied before the transform.
+ */
+typedef enum {
+    FFT_WINDOW_RECT = 0,            /**< No window: exact for bin-centred tones, strong leakage otherwise. */
+    FFT_WINDOW_HANN,                /**< Hann: sidelobes -31 dB falling fast, main lobe 4 bins wide. */
+} fft_window_t;
+
+/**
+ * @brief Transform configuration. Fill with ::fft_default_config() and adjust.
+ */
+struct fft_config {
+    uint16_t size;                  /**< Samples per transform, power of two ::FFT_MIN_SIZE..::FFT_MAX_SIZE. */
+    fft_window_t window;            /**< Window. */
+};
+
+/**
+ * @brief Complex value of the work buffer.
+ */
+typedef struct {
+    int16_t re, im;
+} fft_complex_t;
+
+/**
+ * @brief Transform state. Treat fields as private.
+ */
+typedef struct {
+    struct fft_config cfg;
+    uint8_t log2_half;              /**< log2(size / 2): stages of the complex FFT. */
+    uint16_t stride;                /**< Step in the tables (made for ::FFT_MAX_SIZE). */
+    int32_t ref_q8;                 /**< Level of a full-scale sine in the raw dB scale (Q8). */
+    int8_t exponent;                /**< Block exponent of the last transform. */
+    fft_complex_t buf[FFT_MAX_SIZE / 2];
+} fft_t;
+
+/**
+ * @brief Default configuration: Hann window.
+ *
+ * @param cfg  Configuration to fill.
+ * @param size Samples per transform.
+ */
+void fft_default_config(struct fft_config *cfg, uint16_t size);
+
+/**
+ * @brief Initialize the transform.
+ *
+ * @param f   Transform state.
+ * @param cfg Configuration (copied).
+ * @return 0 on success, -1 on an invalid configuration.
+ */
+int fft_init(fft_t *f, const struct fft_config *cfg);
+
+/**
+ * @brief Spectrum of one block in dB.
+ *
+ * A full-scale sine (amplitude 32767) on a bin gives about 0 dB in that bin,
+ * whatever the size and window. Empty bins read ::FFT_DB_FLOOR_Q8.
+ *
+ * @param f     Transform state.
+ * @param pcm   @c size samples.
+ * @param db_q8 Output: @c size / 2 bins (DC up to just below sample_rate / 2),
+ *              level in dBFS in Q8 (1/256 dB).
+ */
+void fft_spectrum_db(fft_t *f, const int16_t *pcm, int16_t *db_q8);
+
+#endif /* FFT_H */
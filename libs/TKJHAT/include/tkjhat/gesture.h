@@ -0,0 +1,223 @@
+/*
+Version 0.83
+
+MIT License
+
+Copyright (c) 2025 , Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file tkjhat/gesture.h
+ * @brief Streaming gesture recognizer (morse dot / dash) for the ICM-42670.
+ *
+ * @details
+ * Samples are pushed one by one. The recognizer keeps a slow estimate of
+ * gravity and a short sliding window of the movement around it:
+ *
+ * 1. **Segmentation**: a gesture starts when the mean movement in the window
+ *    goes above @c start_mg and ends when it stays below @c stop_mg for
+ *    @c stop_ms. The samples already in the window when the gesture starts are
+ *    included, so the beginning of a fast movement is not lost.
+ * 2. **Features**: duration, peak and energy of the movement per axis, share of
+ *    the energy per axis and gyroscope peaks (::gesture_features_t).
+ * 3. **Classification**: a small decision tree over the features. The default
+ *    tree maps movement mostly along Z to a dot and mostly along X to a dash,
+ *    like the original threshold code. A different tree can be given in the
+ *    configuration (e.g. one trained offline with the replay tool in
+ *    libs/TKJHAT/tools).
+ *
+ * Only integer arithmetic is used per sample.
+ *
+ * @code{.c}
+ * static gesture_t g;
+ * struct gesture_config cfg;
+ * gesture_default_config(&cfg, 100, 4);   // 100 Hz, ±4 g
+ * gesture_init(&g, &cfg);
+ *
+ * int n = ICM42670_fifo_read(batch, 32);
+ * for (int i = 0; i < n; i++) {
+ *     gesture_class_t c = gesture_push(&g, &batch[i]);
+ *     if (c == GESTURE_DOT) { ... }
+ * }
+ * @endcode
+ */
+
+#ifndef GESTURE_H
+#define GESTURE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "imu_sample.h"
+
+#define GESTURE_WINDOW            8     /**< Sliding window length in samples (power of two). */
+#define GESTURE_TREE_MAX_NODES    16    /**< Maximum number of decision tree nodes. */
+
+/**
+ * @brief Recognized gesture.
+ */
+typedef enum {
+    GESTURE_NONE = 0,   /**< Nothing recognized (or gesture rejected). */
+    GESTURE_DOT,        /**< Morse dot. */
+    GESTURE_DASH,       /**< Morse dash. */
+    GESTURE_CLASS_COUNT
+} gesture_class_t;
+
+/**
+ * @brief Feature indexes used by the decision tree.
+ */
+typedef enum {
+    GESTURE_F_DURATION = 0,         /**< Gesture length in samples. */
+    GESTURE_F_PEAK_X,               /**< Peak |a - gravity| along X (LSB). */
+    GESTURE_F_PEAK_Y,               /**< Peak |a - gravity| along Y (LSB). */
+    GESTURE_F_PEAK_Z,               /**< Peak |a - gravity| along Z (LSB). */
+    GESTURE_F_SHARE_X,              /**< Share of the movement energy along X, 0..256. */
+    GESTURE_F_SHARE_Y,              /**< Share of the movement energy along Y, 0..256. */
+    GESTURE_F_SHARE_Z,              /**< Share of the movement energy along Z, 0..256. */
+    GESTURE_F_GYRO_PEAK_X,          /**< Peak |gyro| around X (LSB). */
+    GESTURE_F_GYRO_PEAK_Y,          /**< Peak |gyro| around Y (LSB). */
+    GESTURE_F_GYRO_PEAK_Z,          /**< Peak |gyro| around Z (LSB). */
+    GESTURE_F_COUNT
+} gesture_feature_t;
+
+/**
+ * @brief Features of the last segmented gesture, indexed by ::gesture_feature_t.
+ */
+typedef struct {
+    int32_t f[GESTURE_F_COUNT];     /**< Feature values. */
+    uint32_t energy[3];             /**< Movement energy per axis (sum of dev^2 >> 12). */
+    uint32_t end_sample;            /**< Sample index (since init) at which the gesture ended. */
+} gesture_features_t;
+
+/** @brief Leaf value for a decision tree child: returns class @p c. */
+#define GESTURE_LEAF(c)           (-1 - (int8_t)(c))
+
+/**
+ * @brief Decision tree node: go to @c left if f[feature] <= threshold, else to @c right.
+ *
+ * Children are node indexes (>= 0) or leaves built with @ref GESTURE_LEAF.
+ */
+typedef struct {
+    uint8_t feature;                /**< ::gesture_feature_t. */
+    int32_t threshold;              /**< Threshold. */
+    int8_t left;                    /**< Child if the feature is <= threshold. */
+    int8_t right;                   /**< Child if the feature is > threshold. */
+} gesture_tree_node_t;
+
+/**
+ * @brief Recognizer configuration. Fill with ::gesture_default_config() and adjust.
+ */
+struct gesture_config {
+    uint16_t odr_hz;                /**< Sample rate of the pushed data. */
+    uint16_t accel_fsr_g;           /**< Accelerometer full-scale range in g. */
+    uint16_t start_mg;              /**< Mean movement in the window that starts a gesture (mg). */
+    uint16_t stop_mg;               /**< Mean movement below which the gesture is ending (mg). */
+    uint16_t stop_ms;               /**< Quiet time that ends a gesture. */
+    uint16_t min_ms;                /**< Shorter gestures are rejected (bumps). */
+    uint16_t max_ms;                /**< Longer gestures are classified and the recognizer waits for stillness. */
+    uint16_t refractory_ms;         /**< No new gesture starts during this time after the previous one. */
+    const gesture_tree_node_t *tree;/**< Decision tree, NULL for the built-in one. */
+    uint8_t tree_len;               /**< Number of nodes in @c tree. */
+};
+
+/**
+ * @brief Recognizer state. Treat fields as private.
+ */
+typedef struct {
+    int32_t grav[3];                /**< Gravity estimate (LSB << 8). */
+    int16_t win_dev[GESTURE_WINDOW][3];  /**< Movement of the last samples. */
+    int16_t win_gyro[GESTURE_WINDOW][3]; /**< Gyro of the last samples. */
+    uint32_t win_sum;               /**< Sum of L1 movement in the window. */
+    uint16_t win_l1[GESTURE_WINDOW];/**< L1 movement of each window sample. */
+    uint8_t win_pos;
+    uint8_t win_fill;
+    enum { GESTURE_IDLE, GESTURE_ACTIVE, GESTURE_SETTLE } state;
+    uint32_t start_thr, stop_thr;   /**< Window sums (LSB * GESTURE_WINDOW). */
+    uint16_t stop_samples, min_samples, max_samples, refractory_samples;
+    uint16_t quiet, refractory;
+    uint32_t sample_count;
+    gesture_features_t cur;         /**< Features being accumulated. */
+    gesture_features_t last;        /**< Features of the last finished gesture. */
+    gesture_tree_node_t tree[GESTURE_TREE_MAX_NODES];
+    uint8_t tree_len;
+} gesture_t;
+
+/**
+ * @brief Fill @p cfg with default values for the given sensor settings.
+ *
+ * @param cfg         Configuration to fill.
+ * @param odr_hz      Sample rate.
+ * @param accel_fsr_g Accelerometer full-scale range in g.
+ */
+void gesture_default_config(struct gesture_config *cfg, uint16_t odr_hz, uint16_t accel_fsr_g);
+
+/**
+ * @brief Initialize the recognizer.
+ *
+ * @param g   Recognizer state.
+ * @param cfg Configuration.
+ * @return 0 on success, -1 on invalid sensor settings, -2 on invalid thresholds or tree.
+ */
+int gesture_init(gesture_t *g, const struct gesture_config *cfg);
+
+/**
+ * @brief Forget the current gesture and the gravity estimate.
+ *
+ * Use after a gap in the data (e.g. FIFO overflow).
+ *
+ * @param g Recognizer state.
+ */
+void gesture_reset(gesture_t *g);
+
+/**
+ * @brief Push one sample.
+ *
+ * @param g Recognizer state.
+ * @param s Raw sample.
+ * @return The class of the gesture that ended with this sample, or ::GESTURE_NONE.
+ */
+gesture_class_t gesture_push(gesture_t *g, const icm42670_raw_sample_t *s);
+
+/**
+ * @brief true while a gesture is in progress (or the recognizer waits for stillness).
+ *
+ * @param g Recognizer state.
+ */
+bool gesture_busy(const gesture_t *g);
+
+/**
+ * @brief Features of the last finished gesture (also the rejected ones).
+ *
+ * @param g Recognizer state.
+ */
+const gesture_features_t *gesture_last_features(const gesture_t *g);
+
+/**
+ * @brief Run the decision tree of @p g on a feature vector.
+ *
+ * @param g Recognizer state.
+ * @param f Features.
+ * @return Class.
+ */
+gesture_class_t gesture_classify(const gesture_t *g, const gesture_features_t *f);
+
+#endif /* GESTURE_H */
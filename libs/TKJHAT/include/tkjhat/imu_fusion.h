@@ -0,0 +1,206 @@
+/*
+Version 0.83
+
+MIT License
+
+Copyright (c) 2025 , Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file tkjhat/imu_fusion.h
+ * @brief Fixed-point orientation fusion (Mahony filter) for the ICM-42670.
+ *
+ * @details
+ * Combines accelerometer and gyroscope samples into an orientation quaternion
+ * and publishes roll / pitch / yaw to registered subscribers.
+ *
+ * The update step only uses integer arithmetic (quaternion in Q30), so it does
+ * not depend on the software floating point library of the Cortex-M0+. Floats
+ * are only used once in ::imu_fusion_init() to precompute the gains.
+ *
+ * Typical usage, with the ICM-42670 FIFO running at 400 Hz:
+ * @code{.c}
+ * static imu_fusion_t fusion;
+ *
+ * static void on_orientation(const imu_orientation_t *o, void *ctx) {
+ *     // o->roll_cdeg, o->pitch_cdeg, o->yaw_cdeg are in 1/100 degrees
+ * }
+ *
+ * const struct imu_fusion_config cfg = {
+ *     .odr_hz = 400, .accel_fsr_g = 4, .gyro_fsr_dps = 500,
+ *     .kp = IMU_FUSION_KP_DEFAULT, .ki = IMU_FUSION_KI_DEFAULT,
+ *     .publish_divider = 8,  // 50 Hz to subscribers
+ * };
+ * imu_fusion_init(&fusion, &cfg);
+ * imu_fusion_subscribe(&fusion, on_orientation, NULL);
+ *
+ * icm42670_raw_sample_t batch[16];
+ * int n = ICM42670_fifo_read(batch, 16);
+ * if (n > 0) imu_fusion_update_batch(&fusion, batch, n);
+ * @endcode
+ *
+ * Axes follow the ICM-42670 body frame: roll rotates around X, pitch around Y
+ * and yaw around Z. Yaw is not referenced to north (there is no magnetometer),
+ * so it slowly drifts with the gyroscope bias.
+ */
+
+#ifndef IMU_FUSION_H
+#define IMU_FUSION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "imu_sample.h"
+
+#define IMU_FUSION_MAX_SUBSCRIBERS   4       /**< Maximum number of orientation subscribers. */
+#define IMU_FUSION_KP_DEFAULT        0.5f    /**< Default proportional gain (accelerometer trust). */
+#define IMU_FUSION_KI_DEFAULT        0.0f    /**< Default integral gain (gyro bias learning disabled). */
+
+/**
+ * @brief Orientation published by the fusion filter.
+ */
+typedef struct {
+    int32_t q[4];           /**< Orientation quaternion w, x, y, z in Q30 (1.0 = 1 << 30). */
+    int16_t roll_cdeg;      /**< Roll (rotation around X) in 1/100 degrees, -18000..18000. */
+    int16_t pitch_cdeg;     /**< Pitch (rotation around Y) in 1/100 degrees, -9000..9000. */
+    int16_t yaw_cdeg;       /**< Yaw (rotation around Z) in 1/100 degrees, -18000..18000. */
+    uint32_t sample_count;  /**< Number of samples processed since the last reset. */
+} imu_orientation_t;
+
+/**
+ * @brief Subscriber callback. Called from the context that runs ::imu_fusion_update().
+ *
+ * @param o   Latest orientation. Only valid during the call.
+ * @param ctx User pointer given to ::imu_fusion_subscribe().
+ */
+typedef void (*imu_fusion_subscriber_t)(const imu_orientation_t *o, void *ctx);
+
+/**
+ * @brief Fusion configuration. Must match the settings used to start the IMU.
+ */
+struct imu_fusion_config {
+    uint16_t odr_hz;           /**< Sample rate of the incoming data (ICM42670_startAccel / startGyro ODR). */
+    uint16_t accel_fsr_g;      /**< Accelerometer full-scale range in g (2, 4, 8, 16). */
+    uint16_t gyro_fsr_dps;     /**< Gyroscope full-scale range in dps (250, 500, 1000, 2000). */
+    float kp;                  /**< Proportional gain, e.g. @ref IMU_FUSION_KP_DEFAULT. */
+    float ki;                  /**< Integral gain, e.g. @ref IMU_FUSION_KI_DEFAULT. */
+    uint16_t publish_divider;  /**< Subscribers are notified every N samples (0 or 1 = every sample). */
+};
+
+/**
+ * @brief Fusion state. Treat fields as private.
+ */
+typedef struct {
+    int32_t q[4];                 /**< Quaternion w, x, y, z (Q30). */
+    int64_t ix, iy, iz;           /**< Integral feedback in half-angle units (Q60). */
+    int32_t gyro_h;               /**< Gyro LSB to half-angle per sample (Q46). */
+    int32_t kp_h;                 /**< Proportional gain in half-angle per sample (Q30). */
+    int32_t ki_h;                 /**< Integral gain in half-angle per sample (Q30). */
+    int32_t accel_min, accel_max; /**< Accepted accelerometer norm (LSB) for gravity correction. */
+    uint32_t sample_count;
+    uint16_t publish_divider;
+    uint16_t publish_countdown;
+    imu_fusion_subscriber_t subscribers[IMU_FUSION_MAX_SUBSCRIBERS];
+    void *subscriber_ctx[IMU_FUSION_MAX_SUBSCRIBERS];
+} imu_fusion_t;
+
+/**
+ * @brief Initialize the fusion state.
+ *
+ * Precomputes the fixed-point gains and resets the orientation to identity.
+ * Subscribers are cleared.
+ *
+ * @param f   Fusion state.
+ * @param cfg Configuration.
+ * @return 0 on success, -1 on invalid ODR / FSR, -2 on invalid gains.
+ */
+int imu_fusion_init(imu_fusion_t *f, const struct imu_fusion_config *cfg);
+
+/**
+ * @brief Reset the orientation to identity and clear the integral feedback.
+ *
+ * Gains and subscribers are kept.
+ *
+ * @param f Fusion state.
+ */
+void imu_fusion_reset(imu_fusion_t *f);
+
+/**
+ * @brief Process one sample.
+ *
+ * Integrates the gyroscope and corrects roll / pitch with the accelerometer
+ * when the measured acceleration is close to 1 g. Subscribers are notified
+ * every @c publish_divider samples.
+ *
+ * @param f Fusion state.
+ * @param s Raw sample.
+ */
+void imu_fusion_update(imu_fusion_t *f, const icm42670_raw_sample_t *s);
+
+/**
+ * @brief Process a batch of samples (e.g. the output of ICM42670_fifo_read()).
+ *
+ * @param f Fusion state.
+ * @param s Samples, oldest first.
+ * @param n Number of samples.
+ */
+void imu_fusion_update_batch(imu_fusion_t *f, const icm42670_raw_sample_t *s, size_t n);
+
+/**
+ * @brief Get the current orientation, including Euler angles.
+ *
+ * @param f   Fusion state.
+ * @param out Destination.
+ */
+void imu_fusion_get_orientation(const imu_fusion_t *f, imu_orientation_t *out);
+
+/**
+ * @brief Register a subscriber.
+ *
+ * @param f   Fusion state.
+ * @param cb  Callback.
+ * @param ctx User pointer passed back to @p cb.
+ * @return 0 on success, -1 if all @ref IMU_FUSION_MAX_SUBSCRIBERS slots are in use.
+ */
+int imu_fusion_subscribe(imu_fusion_t *f, imu_fusion_subscriber_t cb, void *ctx);
+
+/**
+ * @brief Remove a subscriber previously registered with ::imu_fusion_subscribe().
+ *
+ * @param f  Fusion state.
+ * @param cb Callback to remove.
+ */
+void imu_fusion_unsubscribe(imu_fusion_t *f, imu_fusion_subscriber_t cb);
+
+/**
+ * @brief Fixed-point atan2.
+ *
+ * Approximation with a maximum error of about 0.1 degrees. Inputs may use any
+ * common scale.
+ *
+ * @param y Y component.
+ * @param x X component.
+ * @return Angle in 1/100 degrees, -18000..18000.
+ */
+int32_t imu_fusion_atan2_cdeg(int32_t y, int32_t x);
+
+#endif /* IMU_FUSION_H */
@@ -0,0 +1,65 @@
+/*
+Version 0.83
+
+MIT License
+
+Copyright (c) 2025 , Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file tkjhat/imu_sample.h
+ * @brief Raw ICM-42670 sample type shared by the driver and the IMU processing modules.
+ *
+ * @details
+ * This header only depends on the C standard library, so the IMU processing
+ * modules (fusion, gesture detection...) can also be compiled on a desktop
+ * computer to replay recorded data.
+ */
+
+#ifndef IMU_SAMPLE_H
+#define IMU_SAMPLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief One accelerometer + gyroscope sample in raw sensor units (LSB).
+ *
+ * Conversion to physical units depends on the configured full-scale range:
+ * - Acceleration: 32768 LSB = FSR in g (e.g. 8192 LSB/g at ±4 g).
+ * - Angular rate: 32768 LSB = FSR in dps (e.g. 131 LSB/dps at ±250 dps).
+ * - Temperature: °C = temp / 128 + 25 (same scale as the TEMP_DATA registers).
+ */
+typedef struct {
+    int16_t ax, ay, az;   /**< Acceleration X/Y/Z (raw LSB). */
+    int16_t gx, gy, gz;   /**< Angular rate X/Y/Z (raw LSB). */
+    int16_t temp;         /**< Die temperature (raw LSB, register scale). */
+} icm42670_raw_sample_t;
+
+/**
+ * @brief Information about one FIFO read (see ::ICM42670_fifo_read_timed()).
+ */
+typedef struct {
+    uint64_t read_time_us;  /**< time_us_64() right after the FIFO count was read. */
+    bool overflow;          /**< The FIFO was full: older samples may have been lost. */
+} icm42670_fifo_batch_info_t;
+
+#endif /* IMU_SAMPLE_H */
@@ -0,0 +1,256 @@
+/*
+Version 0.83
+
+MIT License
+
+Copyright (c) 2025 , Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file tkjhat/imu_tempcomp.h
+ * @brief Temperature compensation of the ICM-42670 accelerometer and gyroscope bias.
+ *
+ * @details
+ * The zero level of a MEMS gyroscope moves with the die temperature, so the
+ * small rates measured by the gesture and fusion code change while the board
+ * warms up. Every sample already carries the die temperature, so the bias can
+ * be modelled against it and removed:
+ *
+ * 1. **Learning**: samples are collected in short windows. A window in which
+ *    the board did not move (small spread on every axis) is an observation of
+ *    the bias at that temperature. Observations are averaged in temperature
+ *    bins of @ref IMU_TEMPCOMP_BIN_C degrees.
+ * 2. **Gyroscope model**: a line (offset + slope) fitted through the bins.
+ *    A still gyroscope reads zero, so the whole bias is learned.
+ * 3. **Accelerometer model**: a still accelerometer reads gravity in an unknown
+ *    orientation, so only the change with temperature can be learned: the slope
+ *    is measured between still windows in the same orientation and the
+ *    correction is zero at 25 °C.
+ * 4. **Apply**: the correction for the temperature of the batch is computed
+ *    once (integers only) and subtracted from every sample in place.
+ *
+ * The model is kept per board: ::imu_tempcomp_save_flash() stores it in the
+ * last sector of the flash and ::imu_tempcomp_load_flash() restores it at
+ * start-up, so it keeps improving across power cycles without a calibration
+ * step. Biases are stored in the units of the finest range (±2 g, ±250 dps) and
+ * work with any full-scale setting.
+ *
+ * Apart from the flash functions the module is hardware independent, so it
+ * can be checked on a desktop computer (libs/TKJHAT/tools/tempcomp_sim).
+ *
+ * @code{.c}
+ * static imu_tempcomp_t tc;
+ * struct imu_tempcomp_config cfg;
+ * imu_tempcomp_default_config(&cfg, 100, 4, 250);
+ * imu_tempcomp_init(&tc, &cfg);
+ * imu_tempcomp_load_flash(&tc);           // no model saved yet: starts empty
+ *
+ * int n = ICM42670_fifo_read(batch, 32);
+ * if (n > 0) {
+ *     imu_tempcomp_learn(&tc, batch, n);  // raw samples
+ *     imu_tempcomp_apply(&tc, batch, n);  // bias removed in place
+ * }
+ * ...
+ * if (imu_tempcomp_dirty(&tc)) imu_tempcomp_save_flash(&tc);  // now and then, not per batch
+ * @endcode
+ */
+
+#ifndef IMU_TEMPCOMP_H
+#define IMU_TEMPCOMP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "imu_sample.h"
+
+#define IMU_TEMPCOMP_BINS           16      /**< Number of temperature bins. */
+#define IMU_TEMPCOMP_BIN_C          4       /**< Width of a bin in °C. */
+#define IMU_TEMPCOMP_MIN_C          5       /**< Lower edge of the first bin in °C (bins cover 5..69 °C). */
+#define IMU_TEMPCOMP_BIN_MAX_WEIGHT 64      /**< Observations averaged per bin; later ones are an EMA. */
+#define IMU_TEMPCOMP_MAX_WINDOW     128     /**< Longest learning window in samples: one full FIFO. */
+#define IMU_TEMPCOMP_ACCEL_FSR_G    2       /**< Range of the stored accelerometer values. */
+#define IMU_TEMPCOMP_GYRO_FSR_DPS   250     /**< Range of the stored gyroscope values. */
+#define IMU_TEMPCOMP_RECORD_VERSION 1       /**< Version of ::imu_tempcomp_record_t. */
+
+/**
+ * @brief Learning configuration. Fill with ::imu_tempcomp_default_config() and adjust.
+ */
+struct imu_tempcomp_config {
+    uint16_t odr_hz;            /**< Sample rate of the data. */
+    uint16_t accel_fsr_g;       /**< Accelerometer full-scale range in g (2, 4, 8, 16). */
+    uint16_t gyro_fsr_dps;      /**< Gyroscope full-scale range in dps (250, 500, 1000, 2000). */
+    uint16_t window_ms;         /**< Length of a learning window (at most @ref IMU_TEMPCOMP_MAX_WINDOW samples). */
+    uint16_t still_mg;          /**< Maximum peak-to-peak acceleration in a still window. */
+    uint16_t still_mdps;        /**< Maximum peak-to-peak rate in a still window (mdps). */
+    uint16_t orientation_mg;    /**< Larger changes between still windows are a new orientation. */
+};
+
+/**
+ * @brief Bias observations of one temperature bin (finest range, LSB in Q8).
+ */
+typedef struct {
+    int32_t gyro_q8[3];         /**< Mean gyroscope bias. */
+    int16_t temp;               /**< Mean temperature (register scale: °C = temp / 128 + 25). */
+    uint16_t weight;            /**< Number of observations, up to @ref IMU_TEMPCOMP_BIN_MAX_WEIGHT. */
+} imu_tempcomp_bin_t;
+
+/**
+ * @brief Learned model as stored in flash (see ::imu_tempcomp_export()).
+ */
+typedef struct {
+    uint32_t magic;             /**< "TKTC". */
+    uint16_t version;           /**< @ref IMU_TEMPCOMP_RECORD_VERSION. */
+    uint16_t size;              /**< sizeof(imu_tempcomp_record_t). */
+    imu_tempcomp_bin_t bins[IMU_TEMPCOMP_BINS];
+    int64_t accel_sxy[3];       /**< Sum of dT * da over same-orientation pairs. */
+    int64_t accel_sxx;          /**< Sum of dT * dT over the same pairs. */
+    uint32_t crc;               /**< CRC-32 of all the fields above. */
+} imu_tempcomp_record_t;
+
+/**
+ * @brief Compensation state. Treat fields as private.
+ */
+typedef struct {
+    imu_tempcomp_bin_t bins[IMU_TEMPCOMP_BINS];
+    int64_t accel_sxy[3], accel_sxx;
+    // Model (finest range, Q8 LSB; slopes per °C)
+    int32_t gyro_off_q8[3], gyro_slope_q8[3], accel_slope_q8[3];
+    int16_t temp_lo, temp_hi;   /**< Temperature range of the data; the model is not extrapolated further. */
+    uint8_t accel_shift, gyro_shift;    /**< log2(FSR / finest FSR). */
+    // Correction cache
+    int16_t corr[6];            /**< Correction in LSB of the configured range. */
+    int16_t corr_temp;          /**< Temperature (1/8 °C) of the cached correction. */
+    bool corr_valid;
+    // Learning window
+    uint16_t win_samples;
+    uint16_t win_n;
+    int32_t win_sum[7];
+    int16_t win_min[6], win_max[6];
+    int16_t win_temp_min, win_temp_max;
+    uint16_t still_accel, still_gyro, orientation;  /**< Thresholds in LSB of the configured range. */
+    int32_t ref_accel_q8[3];    /**< Last still accelerometer mean (finest range). */
+    int16_t ref_temp;
+    bool ref_valid;
+    bool dirty;
+    uint32_t observations;      /**< Still windows seen since init. */
+} imu_tempcomp_t;
+
+/**
+ * @brief Fill @p cfg with default values for the given sensor settings.
+ *
+ * @param cfg          Configuration to fill.
+ * @param odr_hz       Sample rate.
+ * @param accel_fsr_g  Accelerometer full-scale range in g.
+ * @param gyro_fsr_dps Gyroscope full-scale range in dps.
+ */
+void imu_tempcomp_default_config(struct imu_tempcomp_config *cfg, uint16_t odr_hz,
+                                 uint16_t accel_fsr_g, uint16_t gyro_fsr_dps);
+
+/**
+ * @brief Initialize with an empty model (no correction).
+ *
+ * @param tc  Compensation state.
+ * @param cfg Configuration.
+ * @return 0 on success, -1 on invalid sensor settings, -2 on invalid thresholds.
+ */
+int imu_tempcomp_init(imu_tempcomp_t *tc, const struct imu_tempcomp_config *cfg);
+
+/**
+ * @brief Drop the current learning window (use after a gap in the data).
+ *
+ * @param tc Compensation state.
+ */
+void imu_tempcomp_reset_window(imu_tempcomp_t *tc);
+
+/**
+ * @brief Learn from raw samples. Call before ::imu_tempcomp_apply() on the same batch.
+ *
+ * @param tc      Compensation state.
+ * @param samples Raw samples, oldest first.
+ * @param n       Number of samples.
+ * @return Number of still windows completed in this batch.
+ */
+int imu_tempcomp_learn(imu_tempcomp_t *tc, const icm42670_raw_sample_t *samples, size_t n);
+
+/**
+ * @brief Remove the modelled bias from samples, in place.
+ *
+ * @param tc      Compensation state.
+ * @param samples Samples to correct.
+ * @param n       Number of samples.
+ */
+void imu_tempcomp_apply(imu_tempcomp_t *tc, icm42670_raw_sample_t *samples, size_t n);
+
+/**
+ * @brief Modelled bias at a temperature, in LSB of the configured ranges.
+ *
+ * @param tc   Compensation state.
+ * @param temp Temperature (register scale).
+ * @param bias Output: ax, ay, az, gx, gy, gz.
+ */
+void imu_tempcomp_bias(const imu_tempcomp_t *tc, int16_t temp, int16_t bias[6]);
+
+/**
+ * @brief True if the model changed since it was last exported (or loaded).
+ *
+ * @param tc Compensation state.
+ */
+bool imu_tempcomp_dirty(const imu_tempcomp_t *tc);
+
+/**
+ * @brief Copy the model to a record (with CRC) and clear the dirty flag.
+ *
+ * @param tc  Compensation state.
+ * @param rec Output record.
+ */
+void imu_tempcomp_export(imu_tempcomp_t *tc, imu_tempcomp_record_t *rec);
+
+/**
+ * @brief Restore the model from a record.
+ *
+ * @param tc  Compensation state (initialized).
+ * @param rec Record from ::imu_tempcomp_export().
+ * @return 0 on success, -1 if the record is not valid (the model is not changed).
+ */
+int imu_tempcomp_import(imu_tempcomp_t *tc, const imu_tempcomp_record_t *rec);
+
+/**
+ * @brief Restore the model from the last flash sector (Pico only).
+ *
+ * @param tc Compensation state (initialized).
+ * @return 0 on success, -1 if no valid model is stored.
+ */
+int imu_tempcomp_load_flash(imu_tempcomp_t *tc);
+
+/**
+ * @brief Store the model in the last flash sector (Pico only).
+ *
+ * Erasing and programming takes tens of milliseconds, during which code can
+ * not run from flash on either core. Call it rarely (e.g. every few minutes
+ * when ::imu_tempcomp_dirty()) and not from time critical code.
+ *
+ * @param tc Compensation state.
+ * @return 0 on success, -1 if the flash could not be written.
+ */
+int imu_tempcomp_save_flash(imu_tempcomp_t *tc);
+
+#endif /* IMU_TEMPCOMP_H */
@@ -0,0 +1,165 @@
+/*
+Version 0.83
+
+MIT License
+
+Copyright (c) 2025 , Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file tkjhat/imu_timebase.h
+ * @brief Map ICM-42670 FIFO timestamps to the RP2040 time base (time_us_64()).
+ *
+ * @details
+ * Every FIFO packet carries the 16-bit timestamp (1 us, sensor clock) of the
+ * moment it was sampled. The time between samples is therefore exact, however
+ * late or irregularly the FIFO is read. This module turns the timestamps into
+ * absolute times in microseconds of time_us_64():
+ *
+ * 1. **Unwrap**: the timestamps wrap every 65.5 ms, so consecutive samples must
+ *    be closer than that: the ODR must be at least ::IMU_TIMEBASE_ODR_MIN Hz
+ *    (the 12.5 Hz and slower low power rates of the sensor are not
+ *    supported). After a FIFO overflow the last sample of the batch is placed
+ *    using the time the FIFO was read instead, and the samples lost in
+ *    between are counted.
+ * 2. **Offset**: a sample can not be later than the moment the FIFO was read,
+ *    so (read time - sensor time) is an upper bound of the clock offset. The
+ *    estimate follows the lowest of these bounds: it drops at once to a lower
+ *    one and only creeps up slowly otherwise.
+ * 3. **Drift**: the sensor runs on its own oscillator (up to a few % away from
+ *    the RP2040 crystal). The minimum bound of every window of about one
+ *    second is kept, and the drift is the slope across the last windows.
+ *
+ * Intervals between samples are exact up to the drift estimate. The absolute
+ * time is usually a fraction of a sample period off (the samples can only be
+ * placed as precisely as the FIFO read times bound them).
+ *
+ * The module is hardware independent (integer arithmetic only), so it can be
+ * checked on a desktop computer (libs/TKJHAT/tools/timebase_sim).
+ *
+ * @code{.c}
+ * static imu_timebase_t tb;
+ * imu_timebase_init(&tb, 400);
+ *
+ * icm42670_raw_sample_t batch[32];
+ * uint16_t tmst[32];
+ * uint64_t t_us[32];
+ * icm42670_fifo_batch_info_t info;
+ * int n = ICM42670_fifo_read_timed(batch, tmst, 32, &info);
+ * if (n > 0) {
+ *     int lost = imu_timebase_update(&tb, tmst, n, &info, t_us);
+ *     // t_us[i] is the time_us_64() at which batch[i] was sampled
+ * }
+ * @endcode
+ */
+
+#ifndef IMU_TIMEBASE_H
+#define IMU_TIMEBASE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "imu_sample.h"
+
+#define IMU_TIMEBASE_ODR_MIN        16      /**< Lowest ODR: samples less than 65.5 ms apart. */
+#define IMU_TIMEBASE_ODR_MAX        10000   /**< Highest ODR. */
+#define IMU_TIMEBASE_WINDOW_US      1000000 /**< Minimum length of a drift window (sensor us). */
+#define IMU_TIMEBASE_WINDOW_BATCHES 16      /**< Minimum number of FIFO reads in a drift window. */
+#define IMU_TIMEBASE_HISTORY        8       /**< Windows kept: the drift is measured across all of them. */
+#define IMU_TIMEBASE_CREEP_PPM      50      /**< Upward creep of the offset between low readings. */
+#define IMU_TIMEBASE_MAX_DRIFT_PPM  50000   /**< Larger drift measurements are ignored. */
+
+/**
+ * @brief Time base state. Treat fields as private.
+ */
+typedef struct {
+    uint32_t period_us;             /**< Nominal sample period (sensor clock). */
+    bool valid;                     /**< A batch has been seen. */
+    int64_t last_s;                 /**< Unwrapped sensor time of the last sample (us). */
+    uint16_t last_tmst;             /**< FIFO timestamp of the last sample. */
+    int64_t anchor_s;               /**< Sensor time where the offset was last set. */
+    int64_t anchor_offset;          /**< Host time - sensor time at anchor_s. */
+    int64_t drift_q32;              /**< (host rate / sensor rate - 1) * 2^32. */
+    int64_t win_start_s;            /**< Start of the current window. */
+    int64_t win_min_offset;         /**< Minimum (read time - sensor time) in the window. */
+    int64_t win_min_s;
+    uint16_t win_batches;           /**< Batches in the current window. */
+    int64_t hist_offset[IMU_TIMEBASE_HISTORY];  /**< Minima of the last windows. */
+    int64_t hist_s[IMU_TIMEBASE_HISTORY];
+    uint8_t hist_len, hist_pos;
+    uint32_t lost;                  /**< Samples lost since init. */
+} imu_timebase_t;
+
+/**
+ * @brief Initialize the time base.
+ *
+ * @param tb     Time base state.
+ * @param odr_hz Sample rate of the FIFO data, ::IMU_TIMEBASE_ODR_MIN to ::IMU_TIMEBASE_ODR_MAX Hz.
+ * @return 0 on success, -1 on an ODR outside that range.
+ */
+int imu_timebase_init(imu_timebase_t *tb, uint16_t odr_hz);
+
+/**
+ * @brief Forget the offset and drift (e.g. after the sensor was reconfigured).
+ *
+ * @param tb Time base state.
+ */
+void imu_timebase_reset(imu_timebase_t *tb);
+
+/**
+ * @brief Stamp one FIFO batch.
+ *
+ * @param tb      Time base state.
+ * @param tmst    FIFO timestamps of the batch, oldest first.
+ * @param n       Number of samples.
+ * @param info    Read information from ::ICM42670_fifo_read_timed().
+ * @param time_us Output: time_us_64() time of every sample (can be NULL).
+ * @return Number of samples lost between the previous batch and this one.
+ */
+int imu_timebase_update(imu_timebase_t *tb, const uint16_t *tmst, size_t n,
+                        const icm42670_fifo_batch_info_t *info, uint64_t *time_us);
+
+/**
+ * @brief time_us_64() time of a sensor time (unwrapped sensor microseconds).
+ *
+ * @param tb       Time base state.
+ * @param sensor_us Sensor time.
+ */
+uint64_t imu_timebase_to_host(const imu_timebase_t *tb, int64_t sensor_us);
+
+/**
+ * @brief Current drift estimate in parts per million (sensor clock vs RP2040).
+ *
+ * Positive when the sensor clock is slow (its microsecond is longer).
+ *
+ * @param tb Time base state.
+ */
+int32_t imu_timebase_drift_ppm(const imu_timebase_t *tb);
+
+/**
+ * @brief Real sample period in nanoseconds of the RP2040 clock.
+ *
+ * @param tb Time base state.
+ */
+uint32_t imu_timebase_period_ns(const imu_timebase_t *tb);
+
+#endif /* IMU_TIMEBASE_H */
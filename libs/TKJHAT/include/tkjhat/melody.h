@@ -0,0 +1,157 @@
+/*
+Version 0.83
+
+MIT License
+
+Copyright (c) 2025 , Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file tkjhat/melody.h
+ * @brief Melodies on the buzzer without blocking: a note queue played by an alarm, and an RTTTL parser.
+ *
+ * @details
+ * A melody is a table of ::melody_note (frequency and length, 4 bytes a
+ * note), usually @c const in flash. ::melody_play() starts it and returns at
+ * once; an alarm of the default alarm pool retunes the buzzer PWM
+ * (::buzzer_set_frequency()) at each note boundary. Each alarm is scheduled
+ * from the time the previous one was due, so the notes do not drift with
+ * interrupt latency or task load. The task that started the melody is free:
+ * it can sleep, update the display or wait for the end.
+ *
+ * Up to ::MELODY_QUEUE_LEN tables can be queued with ::melody_queue() to play
+ * one after the other (e.g. a melody twice, or an intro and a theme). When the
+ * queue has played out, the callback of ::melody_set_done_callback() is
+ * called in the alarm interrupt, e.g. to notify a FreeRTOS task.
+ *
+ * Notes are separated by a short silence (::MELODY_GAP_MS, taken from the end
+ * of the note) so that repeated notes are heard as separate notes.
+ *
+ * Tables can be written by hand or parsed from RTTTL (ring tone text, e.g.
+ * "name:d=4,o=5,b=100:8e6,8d#6,p,2a"), at run time with
+ * ::melody_parse_rtttl() or on the computer with libs/TKJHAT/tools/rtttl2c,
+ * which prints the @c const table to paste into the program.
+ *
+ * The buzzer must be initialized with init_buzzer(). A melody and
+ * buzzer_play_tone() share the buzzer: a tone played during a melody is
+ * retuned at the next note. A melody stops the morse output of
+ * tkjhat/morse_player.h, and the other way round.
+ *
+ * @code{.c}
+ * // rtttl2c "Intro:d=16,o=4,b=100:a,d5,a,d5,2a,4f,4g,2d."
+ * static const struct melody_note intro[] = {
+ *     {440, 150}, {587, 150}, {440, 150}, {587, 150},
+ *     {440, 1200}, {349, 600}, {392, 600}, {294, 1800},
+ * };
+ *
+ * static void done(void *arg) {
+ *     BaseType_t woken = pdFALSE;
+ *     vTaskNotifyGiveFromISR((TaskHandle_t)arg, &woken);
+ *     portYIELD_FROM_ISR(woken);
+ * }
+ *
+ * melody_set_done_callback(done, xTaskGetCurrentTaskHandle());
+ * melody_play(intro, sizeof(intro) / sizeof(intro[0]));
+ * ulTaskNotifyTake(pdTRUE, portMAX_DELAY);        // blocked, no CPU used
+ * @endcode
+ */
+
+#ifndef MELODY_H
+#define MELODY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MELODY_QUEUE_LEN        4       /**< Tables that can be queued. */
+#define MELODY_GAP_MS           10      /**< Silence at the end of each note (notes over 2x this long). */
+
+/**
+ * @brief One note: frequency (0 = rest) and length.
+ */
+struct melody_note {
+    uint16_t freq;                  /**< Frequency in Hz, 0 for a rest. */
+    uint16_t ms;                    /**< Length in milliseconds, gap included. */
+};
+
+/**
+ * @brief Called in the alarm interrupt when the queue has played out.
+ */
+typedef void (*melody_done_t)(void *arg);
+
+/**
+ * @brief Parse an RTTTL string into notes.
+ *
+ * Format: @c name:d=<duration>,o=<octave>,b=<bpm>:<notes>, where each note is
+ * [duration]<a-g|p>[#][.][octave][.], separated by commas. The defaults are
+ * d=4, o=6, b=63 when the section leaves them out. A whole note lasts 4
+ * beats; a dot makes a note 1.5 times longer. Octaves 3 to 8 (A4 = 440 Hz,
+ * equal temperament, rounded to 1 Hz).
+ *
+ * The function uses no hardware and can run on the computer.
+ *
+ * @param text       RTTTL text (spaces are ignored).
+ * @param notes      Output notes.
+ * @param max_notes  Room in @p notes.
+ * @param name       Output: the name (can be NULL).
+ * @param name_size  Size of @p name, including the terminating 0.
+ * @return Number of notes, or -1 on a syntax error or when the notes do not fit.
+ */
+int melody_parse_rtttl(const char *text, struct melody_note *notes, size_t max_notes, char *name,
+                       size_t name_size);
+
+/**
+ * @brief Stop what is playing and play a melody.
+ *
+ * @param notes Notes; must stay valid until the melody has played (a @c const table).
+ * @param count Number of notes.
+ * @return 0 on success, -1 on invalid arguments (also notes of 0 ms only) or when no alarm is free.
+ */
+int melody_play(const struct melody_note *notes, size_t count);
+
+/**
+ * @brief Play a melody after the ones queued (at once if nothing plays).
+ *
+ * @param notes Notes; must stay valid until the melody has played.
+ * @param count Number of notes.
+ * @return 0 on success, -1 on invalid arguments, a full queue or no free alarm.
+ */
+int melody_queue(const struct melody_note *notes, size_t count);
+
+/**
+ * @brief Stop at once and empty the queue. The done callback is not called.
+ */
+void melody_stop(void);
+
+/**
+ * @brief A melody is playing (true) or the queue is empty.
+ */
+bool melody_is_playing(void);
+
+/**
+ * @brief Set the function called when the queue has played out (NULL = none).
+ *
+ * @param cb  Callback, runs in the alarm interrupt: keep it short.
+ * @param arg Passed to the callback.
+ */
+void melody_set_done_callback(melody_done_t cb, void *arg);
+
+#endif /* MELODY_H */
@@ -0,0 +1,152 @@
+/*
+Version 0.83
+
+MIT License
+
+Copyright (c) 2025 , Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file tkjhat/morse_decode.h
+ * @brief Turn key-down / key-up times into morse symbols (dots, dashes and gaps).
+ *
+ * @details
+ * The key state is stepped at a steady rate, e.g. once per block of
+ * ::tone_detect_push(). The output uses the symbols of the morse application:
+ * '.' and '-' for the marks, ' ' after a letter and a second ' ' after a word.
+ *
+ * | Element       | Standard length | Decision            |
+ * |---------------|-----------------|---------------------|
+ * | dot           | 1 unit          | mark < 1.7 units    |
+ * | dash          | 3 units         | mark >= 1.7 units   |
+ * | letter gap    | 3 units         | silence >= 2 units  |
+ * | word gap      | 7 units         | silence >= 5 units  |
+ *
+ * Key-up or key-down glitches shorter than a quarter unit are ignored (a
+ * flicker of the tone detector or a click). The unit follows the sender: every
+ * dot or dash moves the dot or dash length a quarter of the way to its own
+ * length, so the exact speed does not have to be known in advance.
+ *
+ * A dot or dash is given as soon as the silence after it is longer than a
+ * glitch, the gaps as soon as the silence reaches their length.
+ *
+ * A mark is a dash when it is nearer (by ratio) to the dash length than to the
+ * dot length, i.e. longer than sqrt(dot * dash) (1.7 units at the standard
+ * 1:3). Both lengths follow the marks, so a sender up to about 1.7 times
+ * faster or slower than @c unit_ms is decoded from the first letter.
+ *
+ * @code{.c}
+ * static morse_decode_t md;
+ * struct morse_decode_config cfg;
+ * morse_decode_default_config(&cfg, 100);     // unit 100 ms to start with
+ * morse_decode_init(&md, &cfg);
+ *
+ * char sym[MORSE_DECODE_MAX_OUT];
+ * size_t n = morse_decode_step(&md, key, 10, sym);   // 10 ms blocks
+ * for (size_t i = 0; i < n; i++) send_symbol(sym[i]);
+ * @endcode
+ */
+
+#ifndef MORSE_DECODE_H
+#define MORSE_DECODE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MORSE_DECODE_MAX_OUT    3       /**< Most symbols given by one step. */
+
+/**
+ * @brief Decoder configuration. Fill with ::morse_decode_default_config() and adjust.
+ */
+struct morse_decode_config {
+    uint16_t unit_ms;               /**< Dot length to start with. */
+    uint16_t min_unit_ms;           /**< The unit is kept within min_unit_ms..max_unit_ms. */
+    uint16_t max_unit_ms;
+    bool adaptive;                  /**< Follow the speed of the sender. */
+};
+
+/**
+ * @brief Decoder state. Treat fields as private.
+ */
+typedef struct {
+    struct morse_decode_config cfg;
+    uint32_t unit_ms;               /**< Current unit. */
+    uint32_t dot_ms;                /**< Typical dot length of the sender. */
+    uint32_t dash_ms;               /**< Typical dash length of the sender. */
+    uint32_t mark_ms;               /**< Length of the current (or last) mark. */
+    uint32_t gap_ms;                /**< Length of the current silence. */
+    uint32_t prev_gap_ms;           /**< Silence before the current mark (restored if it is a glitch). */
+    bool in_mark;                   /**< Key is down. */
+    bool pending;                   /**< The last mark has not been given yet. */
+    bool after_symbol;              /**< A dot or dash was given and its gaps are not complete. */
+    uint8_t gaps;                   /**< Gaps given after the last symbol (0, 1 or 2). */
+} morse_decode_t;
+
+/**
+ * @brief Default configuration: adaptive, unit kept within 20..400 ms.
+ *
+ * @param cfg     Configuration to fill.
+ * @param unit_ms Dot length to start with (100 ms in the morse application).
+ */
+void morse_decode_default_config(struct morse_decode_config *cfg, uint16_t unit_ms);
+
+/**
+ * @brief Initialize the decoder.
+ *
+ * @param md  Decoder state.
+ * @param cfg Configuration (copied).
+ * @return 0 on success, -1 on an invalid configuration.
+ */
+int morse_decode_init(morse_decode_t *md, const struct morse_decode_config *cfg);
+
+/**
+ * @brief Forget the current mark and gap; the unit is kept.
+ *
+ * @param md Decoder state.
+ */
+void morse_decode_reset(morse_decode_t *md);
+
+/**
+ * @brief Advance the decoder by @p dt_ms with the key in state @p key.
+ *
+ * @param md    Decoder state.
+ * @param key   true while the tone is on.
+ * @param dt_ms Time since the previous step.
+ * @param out   Output: up to ::MORSE_DECODE_MAX_OUT symbols ('.', '-', ' ').
+ * @return Number of symbols written to @p out.
+ */
+size_t morse_decode_step(morse_decode_t *md, bool key, uint32_t dt_ms, char *out);
+
+/**
+ * @brief Current unit (dot length) in ms.
+ */
+uint32_t morse_decode_unit_ms(const morse_decode_t *md);
+
+/**
+ * @brief Letter of a dot/dash code.
+ *
+ * @param code Dots and dashes of one letter, e.g. ".-" (ends at '\0' or ' ').
+ * @return 'A'..'Z' or '0'..'9', 0 if the code is not known.
+ */
+char morse_decode_letter(const char *code);
+
+#endif /* MORSE_DECODE_H */
@@ -0,0 +1,184 @@
+/*
+Version 0.83
+
+MIT License
+
+Copyright (c) 2025 , Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file tkjhat/morse_player.h
+ * @brief Morse output on the buzzer and the LED, timed by an alarm with microsecond steps.
+ *
+ * @details
+ * A message in the symbols of the morse application ('.' and '-' for the
+ * marks, ' ' after a letter and a second ' ' after a word, as given by
+ * tkjhat/morse_decode.h) is played in two steps:
+ *
+ * 1. ::morse_compile() turns it into a timeline of on and off steps, each
+ *    with its length in microseconds. The lengths come from a
+ *    ::morse_timing, set from the speed with ::morse_timing_wpm().
+ * 2. ::morse_player_start() plays the timeline from an alarm of the default
+ *    alarm pool. At each step the alarm switches the buzzer PWM
+ *    (::buzzer_set_frequency()) and the red LED together and schedules the
+ *    next step from the time this one was due, so the timing does not drift
+ *    with interrupt latency, task load or display writes.
+ *
+ * Speed follows the PARIS standard: a unit (dot) lasts 1200 / WPM ms, a
+ * dash 3 units, the gap inside a letter 1 unit, between letters 3 and
+ * between words 7 units, so "PARIS " is 50 units long.
+ *
+ * | Element       | Length                   |
+ * |---------------|--------------------------|
+ * | dot           | 1 unit                   |
+ * | dash          | 3 units                  |
+ * | mark gap      | 1 unit                   |
+ * | letter gap    | 3 Farnsworth units       |
+ * | word gap      | 7 Farnsworth units       |
+ *
+ * With Farnsworth timing the letters are sent at the character speed and the
+ * gaps between letters and words are stretched so that the text comes at the
+ * lower overall speed (ARRL: of the 50 units of "PARIS ", the 19 of the
+ * letter and word gaps take 60 / overall - 31 * 1.2 / character seconds).
+ * Learners hear each letter at full speed but have time between them.
+ *
+ * Other characters in the message (e.g. letters) are skipped; a newline ends
+ * the message. The player can call a function in the alarm interrupt when
+ * the symbol played changes and at the end, e.g. to wake a task that shows
+ * the symbol on the display. The compilation uses no hardware and can run
+ * on the computer (libs/TKJHAT/tools/morse_timing_check).
+ *
+ * The buzzer must be initialized with init_buzzer() and the LED with
+ * init_led(). The player and tkjhat/melody.h share the buzzer: starting one
+ * stops the other.
+ *
+ * @code{.c}
+ * static struct morse_step steps[2 * 64];
+ *
+ * struct morse_timing timing;
+ * morse_timing_wpm(&timing, 18, 10);              // letters at 18 WPM, text at 10 WPM
+ * int n = morse_compile(".-- . .-.. .-.. -.. --- -. .  ", &timing, steps, 128);
+ * if (n > 0)
+ *     morse_player_start(steps, n, 600, NULL, NULL);
+ * while (morse_player_is_playing())
+ *     vTaskDelay(pdMS_TO_TICKS(100));         // or other work
+ * @endcode
+ */
+
+#ifndef MORSE_PLAYER_H
+#define MORSE_PLAYER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MORSE_WPM_MIN           1       /**< Slowest speed. */
+#define MORSE_WPM_MAX           100     /**< Fastest speed (12 ms units). */
+
+/**
+ * @brief Lengths of the morse elements in microseconds.
+ */
+struct morse_timing {
+    uint32_t dot_us;                /**< Dot and the gap between the marks of a letter. */
+    uint32_t dash_us;               /**< Dash. */
+    uint32_t letter_gap_us;         /**< Gap between letters. */
+    uint32_t word_gap_us;           /**< Gap between words. */
+};
+
+/**
+ * @brief One step of the timeline: buzzer and LED on or off for a time.
+ */
+struct morse_step {
+    uint32_t us;                    /**< Length in microseconds. */
+    uint16_t symbol;                /**< Index of the message symbol this step plays. */
+    bool on;                        /**< Tone and LED on. */
+};
+
+/**
+ * @brief Called in the alarm interrupt when the symbol played changes.
+ *
+ * @param symbol Index of the symbol in the message, -1 when the timeline has played out.
+ * @param arg    As given to ::morse_player_start().
+ */
+typedef void (*morse_player_cb_t)(int symbol, void *arg);
+
+/**
+ * @brief Set the timing from the speed.
+ *
+ * @param timing      Output timing.
+ * @param char_wpm    Character speed in words per minute (PARIS).
+ * @param overall_wpm Farnsworth overall speed, 0 or @p char_wpm for standard timing.
+ * @return 0 on success, -1 if a speed is outside ::MORSE_WPM_MIN to ::MORSE_WPM_MAX or
+ *         @p overall_wpm is faster than @p char_wpm.
+ */
+int morse_timing_wpm(struct morse_timing *timing, uint32_t char_wpm, uint32_t overall_wpm);
+
+/**
+ * @brief Compile a message into a timeline of on and off steps.
+ *
+ * A step per mark and per gap; consecutive gaps are merged into the longest
+ * of them. Spaces before the first mark or after the last one give a gap at
+ * the start or the end of the timeline.
+ *
+ * The function uses no hardware and can run on the computer.
+ *
+ * @param symbols   Message: '.', '-' and ' ' (a second ' ' for a word gap), ends at 0 or a newline.
+ * @param timing    Element lengths.
+ * @param steps     Output steps (at most two per symbol).
+ * @param max_steps Room in @p steps.
+ * @return Number of steps, or -1 on invalid arguments or when the steps do not fit.
+ */
+int morse_compile(const char *symbols, const struct morse_timing *timing, struct morse_step *steps,
+                  size_t max_steps);
+
+/**
+ * @brief Stop what is playing and play a timeline.
+ *
+ * The first step starts at once, the rest from the alarm. A melody that is
+ * playing is stopped. The callback is not called for the first symbol (it is
+ * ::morse_player_symbol() when this returns), only from the alarm.
+ *
+ * @param steps     Timeline; must stay valid until it has played.
+ * @param count     Number of steps.
+ * @param freq_hz   Tone frequency in Hz.
+ * @param cb        Called in the alarm interrupt when the symbol changes and at the end (can be NULL).
+ * @param arg       Passed to @p cb.
+ * @return 0 on success, -1 on invalid arguments (also steps of 0 us only) or when no alarm is free.
+ */
+int morse_player_start(const struct morse_step *steps, size_t count, uint32_t freq_hz, morse_player_cb_t cb,
+                       void *arg);
+
+/**
+ * @brief Stop at once; buzzer and LED off. The callback is not called.
+ */
+void morse_player_stop(void);
+
+/**
+ * @brief A timeline is playing (true) or the player is idle.
+ */
+bool morse_player_is_playing(void);
+
+/**
+ * @brief Index of the message symbol playing, -1 when idle.
+ */
+int morse_player_symbol(void);
+
+#endif /* MORSE_PLAYER_H */
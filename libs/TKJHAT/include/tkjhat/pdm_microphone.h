@@ -13,6 +13,14 @@
 
 #include "hardware/pio.h"
 
+#include <tkjhat/agc.h>
+
+#define PDM_RAW_BUFFER_COUNT_DEFAULT 4   // raw buffers in the DMA ring when the config leaves it 0
+#define PDM_RAW_BUFFER_COUNT_MAX     16
+#define PDM_DECIMATION_DEFAULT       64  // when the config leaves decimation 0
+#define PDM_CLOCK_MAX_HZ        3250000  // highest PDM clock (sample_rate * decimation)
+
+// Called from the DMA interrupt once for every finished buffer
 typedef void (*pdm_samples_ready_handler_t)(void);
 
 struct pdm_microphone_config {
@@ -20,11 +28,30 @@ struct pdm_microphone_config {
     uint gpio_clk;
     PIO pio;
     uint pio_sm;
-    uint sample_rate;
-    uint sample_buffer_size;
+    uint sample_rate;           // PCM rate in Hz, a multiple of 1000 (8000, 16000, 32000...)
+    uint sample_buffer_size;    // a multiple of sample_rate / 1000
+    uint raw_buffer_count;      // power of two, 2..PDM_RAW_BUFFER_COUNT_MAX (0 = default)
+    uint decimation;            // PDM bits per PCM sample: 64 or 128 (0 = default)
+};
+
+// Ring statistics since start (or the last pdm_microphone_reset_stats()).
+// Buffers hold sample_buffer_size samples each.
+struct pdm_microphone_stats {
+    uint32_t buffers;           // buffers written by the DMA
+    uint32_t overruns;          // buffers lost: overwritten before they were read
+    uint32_t underruns;         // pdm_microphone_read() calls that found no buffer
+    uint16_t fill;              // buffers waiting to be read now
+    uint16_t max_fill;          // highest fill seen by the interrupt
+    uint16_t capacity;          // most buffers that can wait (raw_buffer_count - 1)
+    uint32_t pcm_dropped;       // PCM frames dropped because the PCM queue was full
 };
 
+// The PIO clock, the raw buffers and the filter follow the config. Calling it
+// again changes the format: the microphone is stopped and deinitialized first
+// (the samples ready handler is kept). Fails if sample_rate * decimation is
+// above PDM_CLOCK_MAX_HZ, e.g. 32 kHz works only with decimation 64.
 int pdm_microphone_init(const struct pdm_microphone_config* config);
+// Stops the microphone and frees the buffers, DMA channels and PIO program
 void pdm_microphone_deinit();
 
 int pdm_microphone_start();
@@ -35,6 +62,59 @@ void pdm_microphone_set_filter_max_volume(uint8_t max_volume);
 void pdm_microphone_set_filter_gain(uint8_t gain);
 void pdm_microphone_set_filter_volume(uint16_t volume);
 
+// Automatic gain control (tkjhat/agc.h) on the PCM samples after the filter,
+// in the same context as the filter. NULL turns it off. Only while stopped:
+// after init (which turns it off) and before start; the gain is kept over a
+// stop and start. Set the filter volume low (e.g. 16) so that the filter
+// does not clip before the AGC. Returns -1 if running or the config is invalid.
+int pdm_microphone_set_agc(const struct agc_config* config);
+// AGC state for agc_gain_q8() and agc_counters(), NULL when off
+const agc_t* pdm_microphone_get_agc();
+
+// Converts the oldest waiting buffer (up to sample_buffer_size samples), or
+// with a PCM queue copies the oldest PCM frame. Returns the number of samples,
+// 0 if nothing is waiting.
 int pdm_microphone_read(int16_t* buffer, size_t samples);
 
+// Raw buffers (or with a PCM queue, PCM frames) waiting to be read
+uint pdm_microphone_available();
+void pdm_microphone_get_stats(struct pdm_microphone_stats* stats);
+void pdm_microphone_reset_stats();
+
+// PDM filter worker. The PDM to PCM filter is the costly part of the
+// microphone; with a PCM queue it runs in a worker instead of the reader:
+//
+//   pdm_microphone_init(&config);
+//   pdm_microphone_pcm_queue_init(8);        // 8 frames of sample_buffer_size
+//   pdm_microphone_start();
+//   pdm_microphone_launch_core1_worker();    // bare metal: core 1 does the filtering
+//   ...
+//   if (pdm_microphone_available()) pdm_microphone_read(frame, sample_buffer_size);
+//
+// With FreeRTOS SMP both cores belong to the scheduler: instead of
+// pdm_microphone_launch_core1_worker(), run pdm_microphone_worker_process() in
+// a task pinned to core 1 (vTaskCoreAffinitySet(task, 1 << 1)), woken from the
+// samples ready handler. The worker is the only reader of the raw buffers.
+//
+// pdm_microphone_stop() and pdm_microphone_deinit() wait (sleep_ms(1), which
+// blocks the calling task under FreeRTOS) until a conversion in progress has
+// finished; call them from a task or from bare metal code, not from an
+// interrupt.
+// pdm_microphone_task_create() (tkjhat/pdm_microphone_task.h) makes that task
+// and hands the frames to a function.
+
+// Allocates the PCM queue (frame_count is a power of two). After init, before start.
+int pdm_microphone_pcm_queue_init(uint frame_count);
+// Filters every waiting raw buffer into the PCM queue. Returns the frames added.
+uint pdm_microphone_worker_process();
+// Runs pdm_microphone_worker_process() on core 1, sleeping between buffers.
+// Returns -1 if another worker (e.g. the task of pdm_microphone_task_create())
+// has been claimed.
+int pdm_microphone_launch_core1_worker();
+// Only one context may run pdm_microphone_worker_process(). The worker claims
+// it first: returns -1 if another one has. pdm_microphone_launch_core1_worker()
+// and pdm_microphone_task_create() do it; a worker of the application must too.
+int pdm_microphone_claim_worker();
+void pdm_microphone_release_worker();
+
 #endif
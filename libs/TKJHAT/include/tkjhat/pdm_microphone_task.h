@@ -0,0 +1,87 @@
+/*
+Version 0.83
+
+MIT License
+
+Copyright (c) 2025 , Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef _PICO_PDM_MICROPHONE_TASK_H_
+#define _PICO_PDM_MICROPHONE_TASK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <tkjhat/pdm_microphone.h>
+
+// FreeRTOS delivery of the microphone frames.
+//
+// By default the samples ready handler runs in the DMA interrupt, and each
+// FreeRTOS application wrote the same code: the handler gives a task
+// notification, and a task pinned to core 1 runs the filter and reads the
+// frames. pdm_microphone_task_create() does it once: the interrupt only
+// counts the buffer and calls vTaskNotifyGiveFromISR(), and a task of the
+// given priority and core runs the PDM filter (into the PCM queue, when
+// there is one) and calls the frame handler for every PCM frame. Interrupts
+// stay a few microseconds long whatever the handler does, so USB and GPIO
+// are not delayed while audio runs.
+//
+//   init_pdm_microphone();
+//   pdm_microphone_pcm_queue_init(8);
+//   struct pdm_microphone_task_config cfg = PDM_MICROPHONE_TASK_DEFAULT(on_frame, NULL);
+//   pdm_microphone_task_create(&cfg);     // before or after vTaskStartScheduler()
+//   ...
+//   init_microphone_sampling();           // from a task: frames come while it runs
+//
+// The handler runs in the task: it may block and use any FreeRTOS call, but
+// while it runs the next buffers wait (in the PCM queue, or in the DMA ring
+// without one). The task replaces the samples ready handler
+// (pdm_microphone_set_samples_ready_handler()); only one task per microphone.
+// Needs FreeRTOS; the source is only linked into programs that call it.
+
+// Called in the task for every PCM frame of the microphone
+typedef void (*pdm_frame_handler_t)(const int16_t* samples, size_t count, void* arg);
+
+struct pdm_microphone_task_config {
+    pdm_frame_handler_t handler;
+    void* arg;                  // passed to the handler
+    uint priority;              // FreeRTOS priority of the task
+    uint core_mask;             // cores the task may run on (1 << 1 = core 1, 0 = any)
+    uint stack_words;           // task stack, handler included
+    uint frame_samples;         // largest frame, MEMS_BUFFER_SIZE with the SDK
+    uint poll_ms;               // handler also called with count 0 this often (0 = never)
+};
+
+// Priority 2 on core 1, 1024 words of stack, MEMS_BUFFER_SIZE frames
+#define PDM_MICROPHONE_TASK_DEFAULT(fn, user_arg) \
+    { .handler = (fn), .arg = (user_arg), .priority = 2, .core_mask = 1u << 1, \
+      .stack_words = 1024, .frame_samples = 256, .poll_ms = 0 }
+
+// Creates the task and routes the microphone interrupt to it. Returns -1 if
+// it already exists, another worker runs (pdm_microphone_launch_core1_worker())
+// or the task or its frame buffer can not be allocated.
+int pdm_microphone_task_create(const struct pdm_microphone_task_config* config);
+
+// Time the handler and the filter took in the task since the last call, in
+// microseconds (for load reports), and the frames handled. Either can be NULL.
+void pdm_microphone_task_stats(uint32_t* busy_us, uint32_t* frames);
+
+#endif
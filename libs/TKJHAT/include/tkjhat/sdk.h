@@ -111,6 +111,7 @@ SOFTWARE.
 #include <hardware/i2c.h>
 
 #include "pdm_microphone.h"   // pdm_samples_ready_handler_t
+#include "imu_sample.h"       // icm42670_raw_sample_t
 #include "pins.h"
 
 /* =========================
@@ -172,8 +173,10 @@ SOFTWARE.
 /** @name Microphone
  *  Microphone's sampling rate and buffer size. 
  *  @{ */
-#define MEMS_SAMPLING_FREQUENCY                 8000   /**< Sampling frequency in Hz for PDM microphone. */
+#define MEMS_SAMPLING_FREQUENCY                 8000   /**< Default sampling frequency in Hz for PDM microphone. */
+#define MEMS_DECIMATION                         64     /**< Default PDM bits per PCM sample (64 or 128). */
 #define MEMS_BUFFER_SIZE                        256    /**< Number of samples in each microphone buffer. */
+#define MEMS_RAW_BUFFER_COUNT                   4      /**< Buffers in the microphone DMA ring (power of two). */
 /** @} */
 
 /* =========================
@@ -266,12 +269,98 @@ SOFTWARE.
 #define ICM42670_GYRO_MODE_LN                   0x0C   /**< Gyro Low-Noise mode code for PWR_MGMT0 gyro field. */
 /** @} */
 
+/** @name UI filter
+ *  GYRO_CONFIG1[2:0] / ACCEL_CONFIG1[2:0]: low-pass bandwidth of the UI path (LN mode).
+ *  ACCEL_CONFIG1[6:4]: number of samples averaged per output in accel LP mode.
+ *  @{ */
+#define ICM42670_GYRO_CONFIG1_REG               0x23   /**< GYRO_CONFIG1: [2:0] GYRO_UI_FILT_BW. */
+#define ICM42670_ACCEL_CONFIG1_REG              0x24   /**< ACCEL_CONFIG1: [6:4] ACCEL_UI_AVG, [2:0] ACCEL_UI_FILT_BW. */
+#define ICM42670_UI_FILT_BW_MASK                0x07   /**< GYRO_CONFIG1 / ACCEL_CONFIG1: UI_FILT_BW field. */
+#define ICM42670_ACCEL_UI_AVG_MASK              0x70   /**< ACCEL_CONFIG1: ACCEL_UI_AVG field. */
+#define ICM42670_UI_FILT_BW_BYPASS              0x00   /**< Low-pass filter bypassed. */
+#define ICM42670_UI_FILT_BW_180HZ               0x01   /**< 180 Hz (reset value). */
+#define ICM42670_UI_FILT_BW_121HZ               0x02   /**< 121 Hz. */
+#define ICM42670_UI_FILT_BW_73HZ                0x03   /**< 73 Hz. */
+#define ICM42670_UI_FILT_BW_53HZ                0x04   /**< 53 Hz. */
+#define ICM42670_UI_FILT_BW_34HZ                0x05   /**< 34 Hz. */
+#define ICM42670_UI_FILT_BW_25HZ                0x06   /**< 25 Hz. */
+#define ICM42670_UI_FILT_BW_16HZ                0x07   /**< 16 Hz. */
+#define ICM42670_ACCEL_UI_AVG_MAX_RATE          3200   /**< SDK limit: averaged samples x ODR (Hz) in LP mode. */
+/** @} */
+
 /** @name Sensor data window
  *  Starting register for burst reads of temp/accel/gyro data.
  *  @{ */
 #define ICM42670_SENSOR_DATA_START_REG          0x09   /**< First data register for TEMP/ACCEL/GYRO burst read. */
 /** @} */
 
+/** @name FIFO
+ *  FIFO registers, bits and packet format (FIFO packet 3: accel + gyro + temp + timestamp).
+ *  @{ */
+#define ICM42670_FIFO_CONFIG1_REG               0x28   /**< FIFO_CONFIG1: [1] FIFO_MODE (0 stream, 1 stop-on-full), [0] FIFO_BYPASS. */
+#define ICM42670_FIFO_BYPASS_BIT                0x01   /**< FIFO_CONFIG1: FIFO disabled (bypass). */
+#define ICM42670_INTF_CONFIG0_REG               0x35   /**< INTF_CONFIG0: FIFO count format and data endianness. */
+#define ICM42670_FIFO_COUNT_FORMAT_BIT          0x40   /**< INTF_CONFIG0: FIFO count in records (0 = in bytes). */
+#define ICM42670_FIFO_COUNT_ENDIAN_BIT          0x20   /**< INTF_CONFIG0: FIFO count big endian (0 = little). */
+#define ICM42670_SENSOR_DATA_ENDIAN_BIT         0x10   /**< INTF_CONFIG0: sensor and FIFO data big endian (0 = little). */
+#define ICM42670_FIFO_COUNTH_REG                0x3D   /**< FIFO byte count, high byte (reading it latches the low byte). */
+#define ICM42670_FIFO_COUNTL_REG                0x3E   /**< FIFO byte count, low byte. */
+#define ICM42670_FIFO_DATA_REG                  0x3F   /**< FIFO read port. */
+#define ICM42670_FIFO_FLUSH_BIT                 0x04   /**< SIGNAL_PATH_RESET: flush the FIFO. */
+#define ICM42670_FIFO_PACKET_SIZE               16     /**< Bytes per FIFO packet 3. */
+#define ICM42670_FIFO_SIZE                      2048   /**< FIFO size in bytes (128 packets). */
+#define ICM42670_FIFO_HEADER_EMPTY              0x80   /**< Packet header: FIFO empty / invalid packet. */
+#define ICM42670_FIFO_HEADER_ACCEL              0x40   /**< Packet header: packet contains accelerometer data. */
+#define ICM42670_FIFO_HEADER_GYRO               0x20   /**< Packet header: packet contains gyroscope data. */
+#define ICM42670_FIFO_INVALID_SAMPLE            (-32768) /**< Value of a sensor sample that is not valid yet. */
+/** @} */
+
+/** @name MREG1 access
+ *  Indirect access to the MREG1 register bank (used by FIFO and APEX configuration).
+ *  @{ */
+#define ICM42670_BLK_SEL_W_REG                  0x79   /**< Bank select for MREG writes. */
+#define ICM42670_MADDR_W_REG                    0x7A   /**< MREG address to write. */
+#define ICM42670_M_W_REG                        0x7B   /**< MREG write data. */
+#define ICM42670_BLK_SEL_R_REG                  0x7C   /**< Bank select for MREG reads. */
+#define ICM42670_MADDR_R_REG                    0x7D   /**< MREG address to read. */
+#define ICM42670_M_R_REG                        0x7E   /**< MREG read data. */
+#define ICM42670_MREG1_TMST_CONFIG1             0x00   /**< MREG1: [3] TMST_RES, [2] TMST_DELTA_EN, [0] TMST_EN. */
+#define ICM42670_TMST_CONFIG1_TMST_EN           0x01   /**< TMST_CONFIG1: timestamp enabled (1 us, absolute). */
+#define ICM42670_MREG1_FIFO_CONFIG5             0x01   /**< MREG1: [3] HIRES, [2] TMST_FSYNC, [1] GYRO, [0] ACCEL FIFO enables. */
+#define ICM42670_FIFO_CONFIG5_ACCEL_EN          0x01   /**< FIFO_CONFIG5: accelerometer data to FIFO. */
+#define ICM42670_FIFO_CONFIG5_GYRO_EN           0x02   /**< FIFO_CONFIG5: gyroscope data to FIFO. */
+#define ICM42670_FIFO_CONFIG5_TMST_FSYNC_EN     0x04   /**< FIFO_CONFIG5: timestamp in FIFO packets. */
+/** @} */
+
+/** @name APEX (motion engine)
+ *  Wake-on-motion, significant motion and tilt detection registers.
+ *  @{ */
+#define ICM42670_APEX_CONFIG0_REG               0x25   /**< APEX_CONFIG0: [3] DMP_POWER_SAVE, [2] DMP_INIT_EN, [0] DMP_MEM_RESET_EN. */
+#define ICM42670_APEX_CONFIG1_REG               0x26   /**< APEX_CONFIG1: [6] SMD, [5] FF, [4] TILT, [3] PED enables, [1:0] DMP_ODR. */
+#define ICM42670_WOM_CONFIG_REG                 0x27   /**< WOM_CONFIG: [4:3] INT_DUR, [2] INT_MODE, [1] WOM_MODE, [0] WOM_EN. */
+#define ICM42670_INT_SOURCE0_REG                0x2B   /**< INT_SOURCE0: INT1 routing of data ready / FIFO interrupts. */
+#define ICM42670_INT_SOURCE1_REG                0x2C   /**< INT_SOURCE1: INT1 routing of SMD [3] and WOM Z/Y/X [2:0]. */
+#define ICM42670_INT_STATUS2_REG                0x3B   /**< INT_STATUS2: SMD [3], WOM Z/Y/X [2:0]. Cleared on read. */
+#define ICM42670_INT_STATUS3_REG                0x3C   /**< INT_STATUS3: step [5], tilt [3], free fall [2], low-g [1]. Cleared on read. */
+#define ICM42670_MREG1_INT_SOURCE6              0x2F   /**< MREG1: INT1 routing of free fall [7], low-g [6], step [5], tilt [3]. */
+#define ICM42670_MREG1_ACCEL_WOM_X_THR          0x4B   /**< MREG1: WOM threshold X (1 LSB = 1/256 g). */
+#define ICM42670_MREG1_ACCEL_WOM_Y_THR          0x4C   /**< MREG1: WOM threshold Y (1 LSB = 1/256 g). */
+#define ICM42670_MREG1_ACCEL_WOM_Z_THR          0x4D   /**< MREG1: WOM threshold Z (1 LSB = 1/256 g). */
+#define ICM42670_INT1_APEX_CONFIG_VALUE         0x03   /**< INT_CONFIG for APEX: INT1 pulsed, push-pull, active high. */
+#define ICM42670_APEX_EVENT_QUEUE_LENGTH        16     /**< Interrupts buffered between the ISR and ::ICM42670_apex_read_event(). */
+/** @} */
+
+/** @name APEX events
+ *  Bit flags used in icm42670_apex_config::events and icm42670_apex_event_t::events.
+ *  @{ */
+#define ICM42670_APEX_WOM_X                     0x01   /**< Wake on motion, X axis. */
+#define ICM42670_APEX_WOM_Y                     0x02   /**< Wake on motion, Y axis. */
+#define ICM42670_APEX_WOM_Z                     0x04   /**< Wake on motion, Z axis. */
+#define ICM42670_APEX_WOM_ANY                   0x07   /**< Wake on motion, any axis. */
+#define ICM42670_APEX_SMD                       0x08   /**< Significant motion detected. */
+#define ICM42670_APEX_TILT                      0x10   /**< Tilt (orientation change held for a while). */
+/** @} */
+
 /** @} */ /* end of group  of registers*/
 
 
@@ -616,7 +705,8 @@ void stop_rgb_led(void);
  * and for the PDM MEMS microphone connected via PIO.
  *
  * **Buzzer (@ref BUZZER_PIN — GPIO 17)**
- * - Output-only pin for tone generation using PWM or software toggling.
+ * - Output-only pin driven by a PWM slice: the tone plays in hardware and
+ *   the CPU is free meanwhile.
  * - Useful for short alerts, melodies, or feedback tones.
  *
  * **Microphone (@ref PDM_CLK — GPIO 15, @ref PDM_DATA — GPIO 16)**
@@ -632,7 +722,8 @@ void stop_rgb_led(void);
  * | Sample rate | 16 kHz |
  * | Buffer size | 256 samples |
  *
- * @note Buzzer functions are blocking (CPU toggles pin for duration).
+ * @note ::buzzer_play_tone() blocks the calling task (it sleeps, it does not
+ * spin); ::buzzer_play_tone_async() returns at once and an alarm stops the tone.
  * Microphone functions use interrupts and DMA to collect samples asynchronously.
  * @{
  */
@@ -645,30 +736,68 @@ void stop_rgb_led(void);
 /**
  * @brief Initialize the buzzer (GPIO 17).
  *
- * Configures the buzzer pin as a digital output.  
+ * Configures the buzzer pin as a PWM output (slice 0, channel B), silent.
  * After this call, the buzzer can be controlled with
- * ::buzzer_play_tone() or ::buzzer_turn_off().
+ * ::buzzer_play_tone(), ::buzzer_play_tone_async() or ::buzzer_turn_off().
  */
 void init_buzzer(void);
 
 /**
- * @brief Play a tone on the buzzer.
+ * @brief Play a tone on the buzzer and wait until it ends.
  *
- * Generates a square wave at the requested frequency for the
- * specified duration by toggling the buzzer pin.
+ * Starts the tone with ::buzzer_play_tone_async() and sleeps for the
+ * duration with sleep_ms(). In a FreeRTOS task the task is blocked, so other
+ * tasks (and lower priority ones) run while the tone plays.
  *
- * @param frequency     Tone frequency in Hz.
+ * @param frequency     Tone frequency in Hz (0 = silence for the duration).
  * @param duration_ms   Duration of the tone in milliseconds.
- *
- * @note This implementation is blocking: the CPU is kept busy
- *       toggling the pin for the entire duration.
  */
 void buzzer_play_tone(uint32_t frequency, uint32_t duration_ms);
 
+/**
+ * @brief Start a tone on the buzzer and return at once.
+ *
+ * The PWM slice of the buzzer pin makes a square wave (50 % duty) at the
+ * frequency: the clock divider and the wrap are chosen so that the wrap fits
+ * in 16 bits with the smallest divider, which gives the closest frequency
+ * (7.5 Hz .. clk_sys / 2). An alarm of the default alarm pool silences the
+ * buzzer after @p duration_ms.
+ *
+ * A new tone replaces the one playing, so a melody can be played from a task
+ * by starting each note and sleeping or doing other work until the next.
+ *
+ * @param frequency     Tone frequency in Hz (0 = silence).
+ * @param duration_ms   Duration of the tone in milliseconds.
+ * @return 0 on success, -1 if no alarm was free (the buzzer is left silent).
+ *
+ * @code{.c}
+ * buzzer_play_tone_async(600, 100);   // dot
+ * update_display();                   // runs while the tone plays
+ * @endcode
+ */
+int buzzer_play_tone_async(uint32_t frequency, uint32_t duration_ms);
+
+/**
+ * @brief Tone playing now (true) or silent.
+ */
+bool buzzer_is_playing(void);
+
+/**
+ * @brief Retune the buzzer PWM to a frequency (0 = silent), with no timing.
+ *
+ * For sequencers that time the notes themselves (tkjhat/melody.h); safe to
+ * call from an alarm or another interrupt, on either core. It replaces a tone
+ * of ::buzzer_play_tone_async(): the alarm of that tone no longer stops the
+ * buzzer.
+ *
+ * @param frequency Tone frequency in Hz, 0 to silence.
+ */
+void buzzer_set_frequency(uint32_t frequency);
+
 /**
  * @brief Turn the buzzer off.
  *
- * Drives the buzzer pin low, silencing any ongoing tone.
+ * Silences any ongoing tone and cancels its alarm.
  */
 void buzzer_turn_off(void);
 
@@ -701,18 +830,49 @@ void deinit_buzzer(void);
  * Default parameters:
  * - Data pin: GPIO 16
  * - Clock pin: GPIO 15
- * - Sample rate: 16 kHz
+ * - Sample rate: @ref MEMS_SAMPLING_FREQUENCY (8 kHz), decimation @ref MEMS_DECIMATION
  * - Buffer size: 256 samples
  *
  * @return 0 on success, negative value on error.
  */
 int init_pdm_microphone(void);
 
+/**
+ * @brief Initialize the PDM MEMS microphone with another sample rate.
+ *
+ * Same as ::init_pdm_microphone(), but the PCM sample rate and the decimation
+ * (PDM bits per sample) are chosen at run time, so one firmware can use 8 kHz
+ * for tone or keyword detection (least CPU) and 16 or 32 kHz for recording.
+ * The PDM clock is @p sample_rate * @p decimation and must stay at or below
+ * 3.25 MHz:
+ *
+ * | Sample rate | Decimation 64 | Decimation 128 |
+ * |-------------|---------------|----------------|
+ * | 8 kHz       | 512 kHz       | 1.024 MHz      |
+ * | 16 kHz      | 1.024 MHz     | 2.048 MHz      |
+ * | 32 kHz      | 2.048 MHz     | not supported  |
+ *
+ * Decimation 128 gives less noise, but the filter reads twice the PDM data
+ * per sample. If the microphone is already initialized it is stopped and
+ * reinitialized; start it again with ::init_microphone_sampling(). The
+ * callback stays registered, but the filter volume and gain are reset, the
+ * AGC (pdm_microphone_set_agc()) is off and a PCM queue must be created
+ * again. Each buffer still holds
+ * @ref MEMS_BUFFER_SIZE samples, so at 32 kHz it lasts 8 ms instead of 32 ms.
+ *
+ * @param sample_rate PCM sample rate in Hz, a multiple of 1000 that divides
+ *                    into @ref MEMS_BUFFER_SIZE samples per ms (8000, 16000, 32000).
+ * @param decimation  64 or 128.
+ * @return 0 on success, negative value on error (the microphone is then not
+ *         initialized).
+ */
+int init_pdm_microphone_rate(uint32_t sample_rate, uint8_t decimation);
+
 /**
  * @brief Start microphone sampling.
  *
  * Begins continuous capture of PCM samples from the microphone
- * at 16 kHz with a buffer size of 256 samples.
+ * at the rate given at init, with a buffer size of 256 samples.
  *
  * @return 0 on success, negative value on error.
  */
@@ -730,7 +890,9 @@ void end_microphone_sampling(void);
  * @brief Register a callback for new microphone samples.
  *
  * Sets the function that will be invoked when new samples are
- * available in the buffer.
+ * available in the buffer. It runs in the DMA interrupt: keep it short.
+ * With FreeRTOS, pdm_microphone_task_create() (tkjhat/pdm_microphone_task.h)
+ * moves the filtering and the frame handling into a task instead.
  *
  * @param handler Callback of type ::pdm_samples_ready_handler_t.
  */
@@ -743,9 +905,14 @@ void pdm_microphone_set_callback(pdm_samples_ready_handler_t handler);
  *
  * @param buffer  Destination buffer for PCM samples.
  * @param samples Number of samples to read.
- * @return The number of samples actually read, or negative on error.
+ * The microphone DMA writes into a ring of @ref MEMS_RAW_BUFFER_COUNT buffers
+ * without CPU help. Every call converts the oldest waiting buffer, so it can be
+ * called from the sample-ready callback or later from a task (check
+ * ::pdm_microphone_available() first). If the reader falls behind by more than
+ * @ref MEMS_RAW_BUFFER_COUNT - 1 buffers, the oldest ones are lost and counted
+ * in the overruns of ::pdm_microphone_get_stats().
  *
- * @note This function is called inside the sample-ready callback. Otherwise, might not work. 
+ * @return The number of samples actually read, 0 if no buffer was waiting.
  */
 int get_microphone_samples(int16_t *buffer, size_t samples);
 
@@ -796,6 +963,43 @@ int get_microphone_samples(int16_t *buffer, size_t samples);
  * }
  * @endcode
  */
+
+/**
+ * @example mic_task.c
+ * @brief Microphone with FreeRTOS: the frames are handled in a task, not in the interrupt.
+ *
+ * @code
+ * #include <FreeRTOS.h>
+ * #include <task.h>
+ * #include <tkjhat/sdk.h>
+ * #include <tkjhat/pdm_microphone_task.h>
+ *
+ * // Runs in the microphone task (core 1), once per MEMS_BUFFER_SIZE samples,
+ * // and with count 0 every poll_ms while no samples come
+ * static void on_frame(const int16_t *samples, size_t count, void *arg) {
+ *     static bool started = false;
+ *     (void)arg;
+ *     if (!started) {
+ *         started = init_microphone_sampling() == 0;   // from a task: the scheduler runs
+ *         return;
+ *     }
+ *     // TODO: process samples[0 .. count-1]; blocking calls are allowed
+ * }
+ *
+ * int main(void) {
+ *     init_hat_sdk();
+ *     if (init_pdm_microphone() < 0 || pdm_microphone_pcm_queue_init(8) < 0)
+ *         while (1) { tight_loop_contents(); }
+ *
+ *     struct pdm_microphone_task_config cfg = PDM_MICROPHONE_TASK_DEFAULT(on_frame, NULL);
+ *     cfg.poll_ms = 100;
+ *     pdm_microphone_task_create(&cfg);
+ *
+ *     vTaskStartScheduler();
+ *     return 0;
+ * }
+ * @endcode
+ */
 /** @} */ // end of group Audio
 
 /* =========================
@@ -925,6 +1129,22 @@ void draw_line(int16_t x0, int16_t y0, int16_t x1, int16_t y1);
  */
 void draw_square(uint32_t x, uint32_t y, uint32_t w, uint32_t h, bool fill);
 
+/**
+ * @brief Draw a bar graph over the whole display in one update.
+ *
+ * Clears the off-screen buffer and draws @p n vertical bars from the bottom
+ * edge, side by side across the 128 pixel width (128 / @p n pixels each,
+ * one pixel gap when they are at least 3 pixels wide). Then the panel is
+ * updated once, so a spectrum or level meter can be refreshed many times a
+ * second.
+ *
+ * @param heights Bar heights in pixels, 0..64 (larger values are clipped).
+ * @param n       Number of bars, 1..128.
+ *
+ * @note Calls @c ssd1306_show() internally (once).
+ */
+void draw_bars(const uint8_t *heights, size_t n);
+
 /**
  * @brief Clear the display.
  *
@@ -1277,6 +1497,16 @@ int ICM42670_startGyro(uint16_t odr_hz, uint16_t fsr_dps);
  */
 int ICM42670_enable_accel_gyro_ln_mode(void);
 
+/**
+ * @brief Accelerometer in low-power (LP) mode and gyroscope off.
+ *
+ * In LP mode the accelerometer averages samples instead of using the UI
+ * low-pass filter (see ::ICM42670_set_accel_filter()).
+ *
+ * @return 0 on success, negative value on error.
+ */
+int ICM42670_enable_ultra_low_power_mode(void);
+
 /**
  * @brief Start IMU with SDK default settings and enable LN mode.
  *
@@ -1293,6 +1523,40 @@ int ICM42670_enable_accel_gyro_ln_mode(void);
  */
 int ICM42670_start_with_default_values(void);
 
+/**
+ * @brief Set the accelerometer low-pass filter and LP-mode averaging.
+ *
+ * The filter runs inside the sensor, so the samples do not need to be
+ * low-passed again on the Pico. @p bw_hz is used in LN mode, @p lp_avg in LP
+ * mode (::ICM42670_enable_ultra_low_power_mode()).
+ *
+ * The values are checked against the ODR given to ::ICM42670_startAccel():
+ * - @p bw_hz must be below ODR / 2, otherwise the filter does not remove aliasing.
+ * - @p lp_avg x ODR must not exceed @ref ICM42670_ACCEL_UI_AVG_MAX_RATE.
+ *
+ * @param bw_hz  0 (bypass), 16, 25, 34, 53, 73, 121 or 180 Hz.
+ * @param lp_avg Samples averaged in LP mode: 2, 4, 8, 16, 32 or 64.
+ *
+ * @pre ::ICM42670_startAccel() called.
+ *
+ * @return 0 on success, -1 on invalid value, -2 if not valid for the ODR
+ *         (or the accelerometer is not started), -3 on I2C error.
+ */
+int ICM42670_set_accel_filter(uint16_t bw_hz, uint8_t lp_avg);
+
+/**
+ * @brief Set the gyroscope low-pass filter.
+ *
+ * @param bw_hz 0 (bypass), 16, 25, 34, 53, 73, 121 or 180 Hz. Must be below
+ *              ODR / 2 of ::ICM42670_startGyro().
+ *
+ * @pre ::ICM42670_startGyro() called.
+ *
+ * @return 0 on success, -1 on invalid value, -2 if not valid for the ODR
+ *         (or the gyroscope is not started), -3 on I2C error.
+ */
+int ICM42670_set_gyro_filter(uint16_t bw_hz);
+
 /**
  * @brief Read accelerometer, gyroscope, and temperature data.
  *
@@ -1316,6 +1580,162 @@ int ICM42670_read_sensor_data(float *ax, float *ay, float *az,
                               float *gx, float *gy, float *gz,
                               float *t);
 
+/**
+ * @brief Read one accelerometer, gyroscope and temperature sample in raw units.
+ *
+ * Same registers as ::ICM42670_read_sensor_data(), without the float
+ * conversion. See ::icm42670_raw_sample_t for the scale of each field.
+ *
+ * @param s Destination sample.
+ *
+ * @return 0 on success, negative value on error.
+ */
+int ICM42670_read_sensor_data_raw(icm42670_raw_sample_t *s);
+
+/**
+ * @brief Enable the FIFO in stream mode with accelerometer, gyroscope and timestamp.
+ *
+ * The sensor stores every sample (at the ODR given to ::ICM42670_startAccel()
+ * and ::ICM42670_startGyro()) in its 2 KB FIFO, so the application can read
+ * them in batches with ::ICM42670_fifo_read() instead of polling every sample.
+ * The FIFO holds 128 samples: at 400 Hz it must be read at least every 300 ms.
+ * When the FIFO is full the oldest samples are lost.
+ *
+ * INTF_CONFIG0 is set to what the readers expect (also the reset value): the
+ * FIFO count in bytes and big endian, the sample data big endian.
+ *
+ * @pre Accelerometer and gyroscope started and in LN mode (the MREG1 bank is
+ *      only accessible while the sensor clock is running).
+ *
+ * @return 0 on success, negative value on error.
+ */
+int ICM42670_fifo_start(void);
+
+/**
+ * @brief Disable the FIFO (bypass mode).
+ *
+ * @return 0 on success, negative value on error.
+ */
+int ICM42670_fifo_stop(void);
+
+/**
+ * @brief Discard all samples stored in the FIFO.
+ *
+ * @return 0 on success, negative value on error.
+ */
+int ICM42670_fifo_flush(void);
+
+/**
+ * @brief Read up to @p max samples from the FIFO, oldest first.
+ *
+ * Packets are transferred in bursts of up to 8 packets per I2C transaction.
+ * Packets that do not contain both accelerometer and gyroscope data, or that
+ * contain samples flagged as invalid (e.g. during gyro start-up), are dropped.
+ *
+ * @param samples Destination array.
+ * @param max     Capacity of @p samples.
+ *
+ * @return Number of samples written (0 if the FIFO is empty), negative value on error.
+ */
+int ICM42670_fifo_read(icm42670_raw_sample_t *samples, size_t max);
+
+/**
+ * @brief Same as ::ICM42670_fifo_read(), also returning the FIFO timestamps.
+ *
+ * Each packet carries the 16-bit timestamp (1 us of the sensor clock, wraps
+ * every 65.5 ms) of the moment it was sampled. Together with @p info they can
+ * be turned into time_us_64() times with tkjhat/imu_timebase.h, without extra
+ * bus transfers.
+ *
+ * @param samples Destination array.
+ * @param tmst    Timestamp of each sample (can be NULL).
+ * @param max     Capacity of @p samples and @p tmst.
+ * @param info    Read time and overflow flag (can be NULL).
+ *
+ * @return Number of samples written (0 if the FIFO is empty), negative value on error.
+ */
+int ICM42670_fifo_read_timed(icm42670_raw_sample_t *samples, uint16_t *tmst, size_t max,
+                             icm42670_fifo_batch_info_t *info);
+
+/**
+ * @brief APEX configuration used by ::ICM42670_apex_start().
+ */
+struct icm42670_apex_config {
+    uint8_t events;             /**< Events to enable, OR of ICM42670_APEX_* flags (e.g. @ref ICM42670_APEX_WOM_ANY). */
+    uint16_t wom_threshold_mg;  /**< Wake-on-motion threshold in mg, same for all axes (4..996). */
+    bool wom_compare_previous;  /**< true: compare with the previous sample (detects movement).
+                                     false: compare with the sample taken when WOM was enabled (detects a change of position). */
+};
+
+/**
+ * @brief One APEX interrupt and the events it reported.
+ */
+typedef struct {
+    uint8_t events;             /**< OR of ICM42670_APEX_* flags. 0 if the interrupt had no enabled event. */
+    uint64_t time_us;           /**< time_us_64() when the interrupt was received. */
+} icm42670_apex_event_t;
+
+/**
+ * @brief Callback run in interrupt context when the IMU raises INT1.
+ *
+ * Must be short and must not use I2C. Typically used to wake up the task that
+ * calls ::ICM42670_apex_read_event() (e.g. with vTaskNotifyGiveFromISR()).
+ */
+typedef void (*icm42670_apex_irq_callback_t)(void);
+
+/**
+ * @brief Enable the APEX motion engine and the IMU interrupt (@ref ICM42670_INT).
+ *
+ * The detection runs inside the sensor. The RP2040 only gets an interrupt when
+ * one of the enabled events happens, so the application does not need to poll
+ * the IMU to notice movement. Each interrupt is timestamped and queued; the
+ * event flags are read later from a task with ::ICM42670_apex_read_event().
+ *
+ * The GPIO interrupt is installed with gpio_add_raw_irq_handler(), so it can be
+ * used together with a callback registered with gpio_set_irq_enabled_with_callback().
+ *
+ * @note The ICM-42670-P has no tap detection. A short knock on the board is seen
+ *       as wake-on-motion on the axis of the knock.
+ *
+ * @param cfg      Events to enable and WOM parameters.
+ * @param callback Optional callback run from the interrupt (NULL if not needed).
+ *
+ * @pre Accelerometer started (::ICM42670_startAccel() and LN mode). Tilt and
+ *      significant motion need an accelerometer ODR of at least 50 Hz.
+ *
+ * @return 0 on success, -1 on invalid configuration, other negative values on I2C error.
+ */
+int ICM42670_apex_start(const struct icm42670_apex_config *cfg, icm42670_apex_irq_callback_t callback);
+
+/**
+ * @brief Disable all APEX events and the IMU interrupt.
+ *
+ * @return 0 on success, negative value on error.
+ */
+int ICM42670_apex_stop(void);
+
+/**
+ * @brief Get the oldest pending APEX interrupt and read which events caused it.
+ *
+ * Reads INT_STATUS2 / INT_STATUS3 over I2C, so it must be called from a task,
+ * not from an interrupt.
+ *
+ * @param ev Destination.
+ *
+ * @return 1 if an event was read, 0 if there is no pending interrupt, negative value on I2C error.
+ */
+int ICM42670_apex_read_event(icm42670_apex_event_t *ev);
+
+/**
+ * @brief Drop all pending APEX interrupts and clear the sensor status registers.
+ *
+ * Useful after a period in which the events are not relevant (e.g. while the
+ * buzzer is giving feedback of the previous event).
+ *
+ * @return 0 on success, negative value on error.
+ */
+int ICM42670_apex_flush_events(void);
+
 /** @} */ // end of group ICM42670
 
 
@@ -0,0 +1,164 @@
+/*
+Version 0.83
+
+MIT License
+
+Copyright (c) 2025 , Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file tkjhat/tone_detect.h
+ * @brief Streaming single tone detector (fixed-point Goertzel) for the microphone.
+ *
+ * @details
+ * PCM samples are pushed as they come from the microphone. For every block of
+ * @c block samples (10 ms by default) the detector decides whether the tone is
+ * on (key down) or off:
+ *
+ * 1. **Goertzel**: one DFT bin at @c freq_hz, computed with a second order
+ *    resonator in Q14 (one multiply per sample). The bin is about
+ *    sample_rate / block wide (100 Hz with 10 ms blocks), so a buzzer a few
+ *    tens of Hz off still counts. The tone amplitude in LSB comes from the bin
+ *    power.
+ * 2. **Purity**: share of the block energy that is in the bin. Speech, claps
+ *    and hiss spread their energy and are not taken for the tone.
+ * 3. **Adaptive threshold**: a noise floor follows the amplitude while the
+ *    key is up (falls at once, rises slowly). The key goes down when the
+ *    amplitude is @c on_ratio times above the floor (and above
+ *    @c min_amplitude). It goes up again when the amplitude falls below half
+ *    of that threshold or 12 dB under the level of the tone, so the
+ *    decision does not chatter on a fading tone, or when the purity drops to
+ *    half of @c min_purity (a voice covers the tone).
+ *
+ * About 10 cycles per sample plus a square root per block: a tiny part of
+ * what an FFT would need for the same job. The module is hardware
+ * independent (libs/TKJHAT/tools/morse_audio_sim decodes synthetic audio).
+ *
+ * @code{.c}
+ * static tone_detect_t td;
+ * struct tone_detect_config cfg;
+ * tone_detect_default_config(&cfg, 8000, 600);
+ * tone_detect_init(&td, &cfg);
+ *
+ * bool key[MEMS_BUFFER_SIZE / 80 + 1];
+ * int n = get_microphone_samples(pcm, MEMS_BUFFER_SIZE);
+ * size_t blocks = tone_detect_push(&td, pcm, n, key, sizeof(key) / sizeof(key[0]));
+ * // key[i]: tone present in block i, each block lasts tone_detect_block_us(&td)
+ * @endcode
+ */
+
+#ifndef TONE_DETECT_H
+#define TONE_DETECT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define TONE_DETECT_BLOCK_MS        10      /**< Default block length. */
+#define TONE_DETECT_MAX_BLOCK       512     /**< Longest block in samples. */
+
+/**
+ * @brief Detector configuration. Fill with ::tone_detect_default_config() and adjust.
+ */
+struct tone_detect_config {
+    uint32_t sample_rate;           /**< PCM sample rate in Hz. */
+    uint16_t freq_hz;               /**< Tone frequency (below sample_rate / 2). */
+    uint16_t block;                 /**< Samples per decision (8..::TONE_DETECT_MAX_BLOCK). */
+    uint8_t on_ratio;               /**< Key down when the amplitude is this many times the noise floor. */
+    uint8_t min_purity;             /**< Least share of the block energy in the bin, 0..255 (255 = all). */
+    uint16_t min_amplitude;         /**< Key down only above this tone amplitude (LSB). */
+};
+
+/**
+ * @brief Detector state. Treat fields as private.
+ */
+typedef struct {
+    struct tone_detect_config cfg;
+    int32_t coef_q14;               /**< 2 cos(2 pi f / fs) in Q14. */
+    int32_t s1, s2;                 /**< Goertzel resonator. */
+    uint64_t energy;                /**< Sum of x^2 in the block. */
+    uint16_t count;                 /**< Samples in the current block. */
+    bool key;                       /**< Current decision. */
+    uint32_t amplitude;             /**< Tone amplitude of the last block (LSB). */
+    uint32_t noise_q4;              /**< Noise floor (LSB, Q4). */
+    uint32_t level_q4;              /**< Tone level while the key is down (LSB, Q4). */
+    uint8_t purity;                 /**< Purity of the last block, 0..255. */
+} tone_detect_t;
+
+/**
+ * @brief Default configuration: 10 ms blocks, 4x (12 dB) above the noise, 50 % purity.
+ *
+ * @param cfg         Configuration to fill.
+ * @param sample_rate PCM sample rate in Hz.
+ * @param freq_hz     Tone frequency in Hz.
+ */
+void tone_detect_default_config(struct tone_detect_config *cfg, uint32_t sample_rate, uint16_t freq_hz);
+
+/**
+ * @brief Initialize the detector.
+ *
+ * @param td  Detector state.
+ * @param cfg Configuration (copied).
+ * @return 0 on success, -1 on an invalid configuration.
+ */
+int tone_detect_init(tone_detect_t *td, const struct tone_detect_config *cfg);
+
+/**
+ * @brief Forget the levels and the block in progress (e.g. after a pause in sampling).
+ *
+ * @param td Detector state.
+ */
+void tone_detect_reset(tone_detect_t *td);
+
+/**
+ * @brief Push PCM samples.
+ *
+ * @param td         Detector state.
+ * @param pcm        Samples.
+ * @param n          Number of samples.
+ * @param key        Output: decision of every block finished in this call
+ *                   (true = tone on). Can be NULL.
+ * @param max_blocks Size of @p key; decisions beyond it are not stored.
+ * @return Number of blocks finished in this call.
+ */
+size_t tone_detect_push(tone_detect_t *td, const int16_t *pcm, size_t n, bool *key, size_t max_blocks);
+
+/**
+ * @brief Current decision (true = tone on).
+ */
+bool tone_detect_key(const tone_detect_t *td);
+
+/**
+ * @brief Length of one block in microseconds.
+ */
+uint32_t tone_detect_block_us(const tone_detect_t *td);
+
+/**
+ * @brief Levels for tuning: tone amplitude of the last block, noise floor and tone level (LSB).
+ *
+ * @param td        Detector state.
+ * @param amplitude Output (can be NULL).
+ * @param noise     Output (can be NULL).
+ * @param level     Output (can be NULL).
+ */
+void tone_detect_levels(const tone_detect_t *td, uint32_t *amplitude, uint32_t *noise, uint32_t *level);
+
+#endif /* TONE_DETECT_H */
@@ -0,0 +1,229 @@
+/*
+Version 0.83
+
+MIT License
+
+Copyright (c) 2025 , Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file tkjhat/vad.h
+ * @brief Sound activity detector to skip the processing of silent microphone blocks.
+ *
+ * @details
+ * PCM samples are pushed frame by frame as they come from the microphone.
+ * ::vad_push() tells whether the frame has sound worth processing; silent
+ * frames can skip the codec, the USB stream, the FFT or the tone detector.
+ *
+ * The frame is looked at in blocks of @c block samples (10 ms by default),
+ * using only every @c decimation th sample (2 by default, half the cost):
+ *
+ * 1. **Level**: mean |x[n] - x[n-1]| of the used samples (no multiplies).
+ *    The difference is a high-pass: mains hum and the rumble of a fan do
+ *    not hide speech, whose energy is mostly above 300 Hz.
+ * 2. **Zero crossing rate**: share of sign changes between the samples
+ *    (0..255). Voiced sounds are low, hiss and fricatives (s, f) high.
+ * 3. **Noise floor**: follows the level while the room is silent (falls at
+ *    once, rises slowly), and much more slowly while there is sound, so a
+ *    new steady noise is learnt within seconds.
+ * 4. **Decision**: a block starts sound when its level is @c on_ratio
+ *    times above the floor (and above @c min_level). A block with a
+ *    smaller level (@c keep_ratio) keeps the sound going when its zero
+ *    crossing rate is high: quiet word endings like "s" are not cut. After
+ *    the last such block the sound lasts @c hangover_ms more.
+ *
+ * A ::vad_preroll_t keeps the last silent frames. When sound starts they are
+ * sent first, so the beginning of a word that was still below the threshold
+ * is not clipped.
+ *
+ * The module is hardware independent (libs/TKJHAT/tools/vad_sim measures it
+ * with synthetic speech and noise).
+ *
+ * @code{.c}
+ * static vad_t vad;
+ * static vad_preroll_t preroll;
+ * static int16_t preroll_storage[5 * MEMS_BUFFER_SIZE];   // 5 frames, 160 ms at 8 kHz
+ * struct vad_config cfg;
+ * vad_default_config(&cfg, 8000);
+ * vad_init(&vad, &cfg);
+ * vad_preroll_init(&preroll, preroll_storage, 5, MEMS_BUFFER_SIZE);
+ *
+ * int n = get_microphone_samples(pcm, MEMS_BUFFER_SIZE);
+ * if (!vad_push(&vad, pcm, n)) {
+ *     vad_preroll_push(&preroll, pcm, n);       // silent: keep, do not send
+ * } else {
+ *     size_t m;
+ *     const int16_t *old;
+ *     while ((old = vad_preroll_pop(&preroll, &m)) != NULL)
+ *         send(old, m);
+ *     send(pcm, n);
+ * }
+ * @endcode
+ */
+
+#ifndef VAD_H
+#define VAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define VAD_BLOCK_MS                10      /**< Default block length. */
+#define VAD_PREROLL_MAX_FRAMES      16      /**< Most frames a pre-roll buffer can hold. */
+
+/**
+ * @brief Detector configuration. Fill with ::vad_default_config() and adjust.
+ */
+struct vad_config {
+    uint32_t sample_rate;           /**< PCM sample rate in Hz. */
+    uint16_t block;                 /**< Samples per decision (before decimation). */
+    uint8_t decimation;             /**< Use every n th sample, 1..8. */
+    uint8_t on_ratio_q4;            /**< Sound starts at this level over the floor (Q4, 36 = 2.25x = 7 dB). */
+    uint8_t keep_ratio_q4;          /**< With a high zero crossing rate sound goes on at this ratio (Q4). */
+    uint8_t zcr_min;                /**< Zero crossing rate counted as high, 0..255. */
+    uint16_t min_level;             /**< No sound below this level (LSB), whatever the floor. */
+    uint16_t hangover_ms;           /**< Sound lasts this long after the last loud block. */
+};
+
+/**
+ * @brief Detector state. Treat fields as private.
+ */
+typedef struct {
+    struct vad_config cfg;
+    uint32_t sum;                   /**< Sum of the level in the current block. */
+    uint16_t count;                 /**< Samples of the current block (decimated). */
+    uint16_t crossings;             /**< Sign changes in the current block. */
+    uint8_t phase;                  /**< Position within the decimation. */
+    bool negative;                  /**< Sign of the previous sample used. */
+    int16_t prev;                   /**< Previous sample used. */
+    uint32_t level_q8;              /**< Level of the last block (Q8). */
+    uint32_t noise_q8;              /**< Noise floor (Q8). */
+    uint8_t zcr;                    /**< Zero crossing rate of the last block. */
+    bool active;                    /**< Sound now (including the hangover). */
+    uint32_t hangover_blocks;       /**< Hangover in blocks. */
+    uint32_t hangover_left;         /**< Blocks of hangover left. */
+    uint32_t blocks, active_blocks; /**< Blocks seen and blocks with sound. */
+} vad_t;
+
+/**
+ * @brief Frames kept while silent, sent when sound starts. Treat fields as private.
+ */
+typedef struct {
+    int16_t *storage;               /**< frames * frame_samples samples, given by the caller. */
+    uint16_t frame_samples;
+    uint16_t frames;
+    uint16_t head;                  /**< Oldest frame. */
+    uint16_t count;                 /**< Frames stored. */
+    uint16_t length[VAD_PREROLL_MAX_FRAMES];
+} vad_preroll_t;
+
+/**
+ * @brief Default configuration: 10 ms blocks, every 2nd sample, start at 2.25x
+ *        (7 dB) over the floor, keep at 2x, 300 ms hangover.
+ *
+ * @param cfg         Configuration to fill.
+ * @param sample_rate PCM sample rate in Hz.
+ */
+void vad_default_config(struct vad_config *cfg, uint32_t sample_rate);
+
+/**
+ * @brief Initialize the detector.
+ *
+ * @param vad Detector state.
+ * @param cfg Configuration (copied).
+ * @return 0 on success, -1 on an invalid configuration.
+ */
+int vad_init(vad_t *vad, const struct vad_config *cfg);
+
+/**
+ * @brief Forget the noise floor and the block in progress (e.g. after a pause in sampling).
+ *
+ * The floor is learnt again from the next blocks; until then loud blocks
+ * count as sound.
+ *
+ * @param vad Detector state.
+ */
+void vad_reset(vad_t *vad);
+
+/**
+ * @brief Push one frame of PCM samples.
+ *
+ * @param vad Detector state.
+ * @param pcm Samples.
+ * @param n   Number of samples.
+ * @return true if the frame should be processed: there was sound (or
+ *         hangover) in any block of it, or the frame ended during sound.
+ */
+bool vad_push(vad_t *vad, const int16_t *pcm, size_t n);
+
+/**
+ * @brief Sound now (true), including the hangover.
+ */
+bool vad_active(const vad_t *vad);
+
+/**
+ * @brief Levels for tuning: level of the last block, noise floor (LSB) and zero crossing rate (0..255).
+ *
+ * @param vad   Detector state.
+ * @param level Output (can be NULL).
+ * @param noise Output (can be NULL).
+ * @param zcr   Output (can be NULL).
+ */
+void vad_levels(const vad_t *vad, uint32_t *level, uint32_t *noise, uint8_t *zcr);
+
+/**
+ * @brief Share of the blocks with sound since init or reset, 0..1000 (per mille).
+ */
+uint32_t vad_duty_permille(const vad_t *vad);
+
+/**
+ * @brief Initialize a pre-roll buffer.
+ *
+ * @param p             Buffer state.
+ * @param storage       Room for @p frames * @p frame_samples samples.
+ * @param frames        Frames to keep, 1..::VAD_PREROLL_MAX_FRAMES.
+ * @param frame_samples Longest frame in samples.
+ * @return 0 on success, -1 on invalid arguments.
+ */
+int vad_preroll_init(vad_preroll_t *p, int16_t *storage, uint16_t frames, uint16_t frame_samples);
+
+/**
+ * @brief Keep a silent frame (the oldest one is dropped when full).
+ *
+ * Samples beyond @c frame_samples are not kept.
+ */
+void vad_preroll_push(vad_preroll_t *p, const int16_t *pcm, size_t n);
+
+/**
+ * @brief Take the oldest kept frame.
+ *
+ * @param p Buffer state.
+ * @param n Output: samples in the frame.
+ * @return The samples (valid until the next push), or NULL when empty.
+ */
+const int16_t *vad_preroll_pop(vad_preroll_t *p, size_t *n);
+
+/**
+ * @brief Drop all kept frames.
+ */
+void vad_preroll_clear(vad_preroll_t *p);
+
+#endif /* VAD_H */
@@ -0,0 +1,134 @@
+/*
+Version 0.83
+
+MIT License
+
+Copyright (c) 2025 Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <string.h>
+
+#include <tkjhat/agc.h>
+
+void agc_default_config(struct agc_config *cfg, uint32_t sample_rate) {
+    cfg->sample_rate = sample_rate;
+    cfg->target = 10000;            // -10 dBFS: room for the peaks the envelope is late for
+    cfg->ceiling = 30000;           // under the +-32700 clip of the filter
+    cfg->max_gain_q8 = 8192;        // 32x, 30 dB
+    cfg->min_gain_q8 = 64;          // 0.25x, -12 dB
+    cfg->attack_ms = 5;
+    cfg->release_ms = 500;
+    cfg->gate = 50;                 // -56 dBFS: the gain is not raised on room noise
+}
+
+// 1 - exp(-1 / t) for a time constant of t steps, as 1 / (t + 0.5) (Q16)
+static uint32_t coef_q16(uint16_t t) {
+    return (uint32_t)(2u * 65536u / (2u * t + 1u));
+}
+
+int agc_init(agc_t *agc, const struct agc_config *cfg) {
+    if (!agc || !cfg || cfg->sample_rate < 1000 || cfg->sample_rate > 64000 ||
+        cfg->target == 0 || cfg->ceiling < cfg->target || cfg->ceiling > 32767 ||
+        cfg->min_gain_q8 == 0 || cfg->min_gain_q8 > cfg->max_gain_q8 || cfg->max_gain_q8 > 8192)
+        return -1;
+    memset(agc, 0, sizeof(*agc));
+    agc->cfg = *cfg;
+    agc->step = (uint16_t)(cfg->sample_rate / 1000);
+    agc->attack_q16 = coef_q16(cfg->attack_ms);
+    agc->release_q16 = coef_q16(cfg->release_ms);
+    agc_reset(agc);
+    return 0;
+}
+
+void agc_reset(agc_t *agc) {
+    agc->env_q8 = 0;
+    agc->gain_q16 = (uint32_t)AGC_GAIN_ONE_Q8 << 8;
+    agc->limited = 0;
+    agc->clipped = 0;
+}
+
+static void agc_step(agc_t *agc, int16_t *pcm, size_t n) {
+    const struct agc_config *cfg = &agc->cfg;
+
+    uint32_t peak = 0;
+    for (size_t i = 0; i < n; i++) {
+        const uint32_t a = (uint32_t)(pcm[i] < 0 ? -pcm[i] : pcm[i]);
+        if (a > peak) peak = a;
+        agc->clipped += a >= AGC_INPUT_CLIP;
+    }
+
+    // Envelope (Q8, at most 2^23: the products fit in 64 bits)
+    const uint32_t p_q8 = peak << 8;
+    if (p_q8 > agc->env_q8)
+        agc->env_q8 += (uint32_t)(((uint64_t)(p_q8 - agc->env_q8) * agc->attack_q16) >> 16);
+    else
+        agc->env_q8 -= (uint32_t)(((uint64_t)(agc->env_q8 - p_q8) * agc->release_q16) >> 16);
+
+    // Wanted gain, held under the gate
+    uint32_t want = agc->gain_q16;
+    if (agc->env_q8 > 0 && agc->env_q8 >= (uint32_t)cfg->gate << 8) {
+        const uint64_t g = ((uint64_t)cfg->target << 24) / agc->env_q8;
+        const uint32_t lo = (uint32_t)cfg->min_gain_q8 << 8, hi = (uint32_t)cfg->max_gain_q8 << 8;
+        want = g < lo ? lo : g > hi ? hi : (uint32_t)g;
+    }
+
+    // Limiter: no sample of this step may go over the ceiling
+    uint32_t start = agc->gain_q16;
+    if (peak > 0) {
+        const uint32_t lim = ((uint32_t)cfg->ceiling << 16) / peak;
+        if (want > lim || start > lim) {
+            agc->limited++;
+            if (want > lim) want = lim;
+            if (start > lim) start = lim;
+        }
+    }
+
+    // Linear ramp from start to want; Q10 gain (<= 2^15) times a sample fits in 32 bits
+    const int32_t delta = (int32_t)(want - start) / (int32_t)n;
+    int32_t g = (int32_t)start;
+    for (size_t i = 0; i < n; i++) {
+        g += delta;
+        int32_t y = pcm[i] * (g >> 6);
+        y = (y + (1 << 9)) >> 10;
+        if (y > cfg->ceiling) y = cfg->ceiling;
+        else if (y < -(int32_t)cfg->ceiling) y = -(int32_t)cfg->ceiling;
+        pcm[i] = (int16_t)y;
+    }
+    agc->gain_q16 = want;
+}
+
+void agc_process(agc_t *agc, int16_t *pcm, size_t n) {
+    while (n > 0) {
+        const size_t m = n < agc->step ? n : agc->step;
+        agc_step(agc, pcm, m);
+        pcm += m;
+        n -= m;
+    }
+}
+
+uint32_t agc_gain_q8(const agc_t *agc) {
+    return agc->gain_q16 >> 8;
+}
+
+void agc_counters(const agc_t *agc, uint32_t *limited, uint32_t *clipped) {
+    if (limited) *limited = agc->limited;
+    if (clipped) *clipped = agc->clipped;
+}
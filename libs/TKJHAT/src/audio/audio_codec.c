@@ -0,0 +1,249 @@
+/*
+Version 0.83
+
+MIT License
+
+Copyright (c) 2025 Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <stdint.h>
+#include <string.h>
+
+#include <tkjhat/audio_codec.h>
+
+#define MULAW_BIAS      0x84
+#define MULAW_CLIP      32635
+
+static const int16_t adpcm_steps[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+    11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+    32767
+};
+
+static const int8_t adpcm_index_step[8] = { -1, -1, -1, -1, 2, 4, 6, 8 };
+
+static void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+// CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF), bitwise: no table in flash
+static uint16_t crc16(uint16_t crc, const uint8_t *p, size_t n) {
+    while (n--) {
+        crc ^= (uint16_t)(*p++ << 8);
+        for (int b = 0; b < 8; b++)
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+    return crc;
+}
+
+uint8_t audio_mulaw_encode(int16_t sample) {
+    int s = sample;
+    uint8_t sign = 0;
+    if (s < 0) {
+        s = -s;
+        sign = 0x80;
+    }
+    if (s > MULAW_CLIP) s = MULAW_CLIP;
+    s += MULAW_BIAS;
+    int exponent = 7;
+    for (int mask = 0x4000; exponent > 0 && !(s & mask); mask >>= 1)
+        exponent--;
+    uint8_t mantissa = (uint8_t)((s >> (exponent + 3)) & 0x0F);
+    return (uint8_t)~(sign | (exponent << 4) | mantissa);
+}
+
+int16_t audio_mulaw_decode(uint8_t code) {
+    code = (uint8_t)~code;
+    int exponent = (code >> 4) & 0x07;
+    int s = (((code & 0x0F) << 3) + MULAW_BIAS) << exponent;
+    s -= MULAW_BIAS;
+    return (int16_t)((code & 0x80) ? -s : s);
+}
+
+// One IMA-ADPCM step: the encoder and the decoder update the state the same way
+static inline void adpcm_update(audio_adpcm_state_t *st, uint8_t code) {
+    int step = adpcm_steps[st->index];
+    int diff = step >> 3;
+    if (code & 4) diff += step;
+    if (code & 2) diff += step >> 1;
+    if (code & 1) diff += step >> 2;
+    int pred = st->predictor + ((code & 8) ? -diff : diff);
+    if (pred > 32767) pred = 32767;
+    else if (pred < -32768) pred = -32768;
+    st->predictor = (int16_t)pred;
+    int index = st->index + adpcm_index_step[code & 7];
+    if (index < 0) index = 0;
+    else if (index > 88) index = 88;
+    st->index = (uint8_t)index;
+}
+
+static inline uint8_t adpcm_encode_sample(audio_adpcm_state_t *st, int16_t sample) {
+    int step = adpcm_steps[st->index];
+    int diff = sample - st->predictor;
+    uint8_t code = 0;
+    if (diff < 0) {
+        code = 8;
+        diff = -diff;
+    }
+    if (diff >= step) { code |= 4; diff -= step; }
+    step >>= 1;
+    if (diff >= step) { code |= 2; diff -= step; }
+    step >>= 1;
+    if (diff >= step) code |= 1;
+    adpcm_update(st, code);
+    return code;
+}
+
+void audio_adpcm_encode(audio_adpcm_state_t *state, const int16_t *pcm, size_t samples,
+                        uint8_t *out) {
+    for (size_t i = 0; i + 1 < samples; i += 2) {
+        uint8_t lo = adpcm_encode_sample(state, pcm[i]);
+        uint8_t hi = adpcm_encode_sample(state, pcm[i + 1]);
+        *out++ = (uint8_t)(lo | (hi << 4));
+    }
+    if (samples & 1)
+        *out = adpcm_encode_sample(state, pcm[samples - 1]);
+}
+
+void audio_adpcm_decode(audio_adpcm_state_t *state, const uint8_t *in, size_t samples,
+                        int16_t *pcm) {
+    for (size_t i = 0; i < samples; i++) {
+        uint8_t code = (i & 1) ? (uint8_t)(in[i >> 1] >> 4) : (uint8_t)(in[i >> 1] & 0x0F);
+        adpcm_update(state, code);
+        pcm[i] = state->predictor;
+    }
+}
+
+size_t audio_payload_size(audio_codec_t codec, size_t samples) {
+    switch (codec) {
+    case AUDIO_CODEC_PCM16:     return 2 * samples;
+    case AUDIO_CODEC_MULAW:     return samples;
+    case AUDIO_CODEC_IMA_ADPCM: return AUDIO_ADPCM_PREAMBLE_SIZE + (samples + 1) / 2;
+    default:                    return 0;
+    }
+}
+
+int audio_encoder_init(audio_encoder_t *enc, audio_codec_t codec, uint32_t sample_rate) {
+    if (!enc || audio_payload_size(codec, 1) == 0 || sample_rate == 0 || sample_rate > 65535)
+        return -1;
+    memset(enc, 0, sizeof(*enc));
+    enc->codec = codec;
+    enc->sample_rate = (uint16_t)sample_rate;
+    return 0;
+}
+
+size_t audio_encode_frame(audio_encoder_t *enc, const int16_t *pcm, size_t samples,
+                          uint8_t *out, size_t out_size) {
+    if (!enc || !pcm || !out || samples == 0 || samples > AUDIO_FRAME_MAX_SAMPLES)
+        return 0;
+    const size_t len = AUDIO_FRAME_HEADER_SIZE + audio_payload_size(enc->codec, samples);
+    if (out_size < len)
+        return 0;
+
+    uint8_t *payload = out + AUDIO_FRAME_HEADER_SIZE;
+    switch (enc->codec) {
+    case AUDIO_CODEC_PCM16:
+        for (size_t i = 0; i < samples; i++)
+            put_u16(payload + 2 * i, (uint16_t)pcm[i]);
+        break;
+    case AUDIO_CODEC_MULAW:
+        for (size_t i = 0; i < samples; i++)
+            payload[i] = audio_mulaw_encode(pcm[i]);
+        break;
+    case AUDIO_CODEC_IMA_ADPCM:
+        put_u16(payload, (uint16_t)enc->adpcm.predictor);
+        payload[2] = enc->adpcm.index;
+        payload[3] = 0;
+        audio_adpcm_encode(&enc->adpcm, pcm, samples, payload + AUDIO_ADPCM_PREAMBLE_SIZE);
+        break;
+    }
+
+    out[0] = AUDIO_FRAME_MAGIC0;
+    out[1] = AUDIO_FRAME_MAGIC1;
+    out[2] = (uint8_t)enc->codec;
+    out[3] = enc->seq++;
+    put_u16(out + 4, enc->sample_rate);
+    put_u16(out + 6, (uint16_t)samples);
+    uint16_t crc = crc16(0xFFFF, out, 8);
+    put_u16(out + 8, crc16(crc, payload, len - AUDIO_FRAME_HEADER_SIZE));
+    return len;
+}
+
+int audio_decode_frame(const uint8_t *buf, size_t len, int16_t *pcm, size_t max_samples,
+                       audio_frame_info_t *info) {
+    if (len < 1) return 0;
+    if (buf[0] != AUDIO_FRAME_MAGIC0) return -1;
+    if (len < 2) return 0;
+    if (buf[1] != AUDIO_FRAME_MAGIC1) return -1;
+    if (len < AUDIO_FRAME_HEADER_SIZE) return 0;
+
+    const audio_codec_t codec = (audio_codec_t)buf[2];
+    const uint16_t samples = get_u16(buf + 6);
+    const size_t payload_len = audio_payload_size(codec, samples);
+    if (payload_len == 0 || samples == 0 || samples > AUDIO_FRAME_MAX_SAMPLES ||
+        get_u16(buf + 4) == 0)
+        return -1;
+    const size_t frame_len = AUDIO_FRAME_HEADER_SIZE + payload_len;
+    if (len < frame_len) return 0;
+
+    const uint8_t *payload = buf + AUDIO_FRAME_HEADER_SIZE;
+    if (crc16(crc16(0xFFFF, buf, 8), payload, payload_len) != get_u16(buf + 8))
+        return -1;
+    if (codec == AUDIO_CODEC_IMA_ADPCM && payload[2] > 88)
+        return -1;
+    if (pcm && samples > max_samples)
+        return -1;
+
+    if (info) {
+        info->codec = codec;
+        info->seq = buf[3];
+        info->sample_rate = get_u16(buf + 4);
+        info->samples = samples;
+    }
+    if (!pcm)
+        return (int)frame_len;
+
+    switch (codec) {
+    case AUDIO_CODEC_PCM16:
+        for (size_t i = 0; i < samples; i++)
+            pcm[i] = (int16_t)get_u16(payload + 2 * i);
+        break;
+    case AUDIO_CODEC_MULAW:
+        for (size_t i = 0; i < samples; i++)
+            pcm[i] = audio_mulaw_decode(payload[i]);
+        break;
+    case AUDIO_CODEC_IMA_ADPCM: {
+        audio_adpcm_state_t st = { .predictor = (int16_t)get_u16(payload), .index = payload[2] };
+        audio_adpcm_decode(&st, payload + AUDIO_ADPCM_PREAMBLE_SIZE, samples, pcm);
+        break;
+    }
+    }
+    return (int)frame_len;
+}
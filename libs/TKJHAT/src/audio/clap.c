@@ -0,0 +1,211 @@
+/*
+Version 0.83
+
+MIT License
+
+Copyright (c) 2025 Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <string.h>
+
+#include <tkjhat/clap.h>
+
+#define BACKGROUND_DOWN_SHIFT   3   // background falls by 1/8 of the difference per block
+#define BACKGROUND_UP_SHIFT     4   // and rises by 1/16 (64 ms with 4 ms blocks)
+#define RESTART_SHIFT           1   // a block 2x over the peak starts the onset again
+
+enum {
+    STATE_WAIT,
+    STATE_ONSET,
+    STATE_REFRACTORY,
+};
+
+void clap_default_config(struct clap_config *cfg, uint32_t sample_rate) {
+    cfg->sample_rate = sample_rate;
+    cfg->block = (uint16_t)(sample_rate * CLAP_BLOCK_MS / 1000);
+    cfg->on_ratio_q4 = 96;          // 6x, 15.6 dB
+    cfg->min_level = 600;
+    cfg->decay_ratio_q4 = 56;       // 3.5x, 11 dB
+    cfg->rise_ms = 10;
+    cfg->decay_ms = 30;
+    cfg->quiet_ms = 70;
+    cfg->refractory_ms = 120;
+    cfg->group_ms = 500;
+}
+
+// Milliseconds to whole blocks, rounded up
+static uint16_t ms_to_blocks(const struct clap_config *cfg, uint32_t ms) {
+    const uint32_t per_block = (uint32_t)cfg->block * 1000;
+    const uint32_t blocks = (uint32_t)(((uint64_t)ms * cfg->sample_rate + per_block - 1) / per_block);
+    return (uint16_t)(blocks > UINT16_MAX ? UINT16_MAX : blocks);
+}
+
+int clap_init(clap_t *clap, const struct clap_config *cfg) {
+    if (!clap || !cfg || cfg->sample_rate == 0 || cfg->block < 4 || cfg->on_ratio_q4 < 16 ||
+        cfg->decay_ratio_q4 < 32)
+        return -1;
+    memset(clap, 0, sizeof(*clap));
+    clap->cfg = *cfg;
+    clap->rise_blocks = ms_to_blocks(cfg, cfg->rise_ms);
+    clap->decay_blocks = ms_to_blocks(cfg, cfg->decay_ms);
+    clap->quiet_blocks = ms_to_blocks(cfg, cfg->quiet_ms);
+    clap->refractory_blocks = ms_to_blocks(cfg, cfg->refractory_ms);
+    clap->group_blocks = ms_to_blocks(cfg, cfg->group_ms);
+    if (clap->decay_blocks <= clap->rise_blocks || clap->quiet_blocks == 0 || clap->quiet_blocks > 255 ||
+        clap->group_blocks == 0)
+        return -1;
+    clap_reset(clap);
+    return 0;
+}
+
+void clap_reset(clap_t *clap) {
+    clap->sum = 0;
+    clap->count = 0;
+    clap->prev = 0;
+    clap->level_q8 = 0;
+    clap->background_q8 = (uint32_t)clap->cfg.min_level << 8;  // no onset from the first sound
+    clap->peak_q8 = 0;
+    clap->tail_q8 = 0;
+    clap->state = STATE_WAIT;
+    clap->rejected = false;
+    clap->since_onset = 0;
+    clap->group_left = 0;
+    clap->group = 0;
+    clap->claps = 0;
+    clap->rejects = 0;
+}
+
+static void start_onset(clap_t *clap, uint32_t level_q8) {
+    clap->state = STATE_ONSET;
+    clap->peak_q8 = level_q8;
+    clap->tail_q8 = 0;
+    clap->rejected = false;
+    clap->since_onset = 0;
+}
+
+static void follow_background(clap_t *clap, uint32_t level_q8) {
+    if (level_q8 < clap->background_q8)
+        clap->background_q8 -= (clap->background_q8 - level_q8) >> BACKGROUND_DOWN_SHIFT;
+    else
+        clap->background_q8 += (level_q8 - clap->background_q8) >> BACKGROUND_UP_SHIFT;
+}
+
+// The quiet time after the decay is over: clap or not
+static void decide(clap_t *clap) {
+    const uint32_t tail_q8 = clap->tail_q8 / clap->quiet_blocks;
+    if (!clap->rejected && (uint64_t)tail_q8 * clap->cfg.decay_ratio_q4 <= (uint64_t)clap->peak_q8 << 4) {
+        clap->claps++;
+        if (clap->group < CLAP_MAX_GROUP)
+            clap->group++;
+        clap->group_left = clap->group_blocks;
+        clap->state = clap->since_onset < clap->refractory_blocks ? STATE_REFRACTORY : STATE_WAIT;
+    } else {
+        // A sound that goes on: it is the background now, so that it does
+        // not start a new onset in the next block
+        clap->rejects++;
+        clap->background_q8 = tail_q8;
+        clap->state = STATE_WAIT;
+    }
+}
+
+// One block is complete: returns the claps of a group that ended, or 0
+static uint8_t end_block(clap_t *clap) {
+    const uint32_t level_q8 = (uint32_t)(((uint64_t)clap->sum << 8) / clap->count);
+    clap->level_q8 = level_q8;
+    clap->sum = 0;
+    clap->count = 0;
+
+    switch (clap->state) {
+    case STATE_WAIT:
+        if (level_q8 >= (uint32_t)clap->cfg.min_level << 8 &&
+            ((uint64_t)level_q8 << 4) > (uint64_t)clap->background_q8 * clap->cfg.on_ratio_q4) {
+            start_onset(clap, level_q8);
+            return 0;               // the group waits for the decision
+        }
+        follow_background(clap, level_q8);
+        break;
+    case STATE_ONSET:
+        clap->since_onset++;
+        if (clap->since_onset > clap->rise_blocks && (level_q8 >> RESTART_SHIFT) > clap->peak_q8) {
+            // Much louder than the onset so far: a clap over a word starts
+            // again from here (the word itself is not a clap)
+            clap->rejects++;
+            start_onset(clap, level_q8);
+            return 0;
+        }
+        if (level_q8 > clap->peak_q8) {
+            if (clap->since_onset > clap->rise_blocks)
+                clap->rejected = true;  // still getting louder: not sharp
+            clap->peak_q8 = level_q8;
+        }
+        if (clap->since_onset > clap->decay_blocks)
+            clap->tail_q8 += level_q8;
+        if (clap->since_onset == clap->decay_blocks + clap->quiet_blocks)
+            decide(clap);
+        return 0;
+    case STATE_REFRACTORY:
+        if (++clap->since_onset >= clap->refractory_blocks)
+            clap->state = STATE_WAIT;
+        break;
+    }
+
+    if (clap->group_left > 0 && --clap->group_left == 0) {
+        const uint8_t group = clap->group;
+        clap->group = 0;
+        return group;
+    }
+    return 0;
+}
+
+uint8_t clap_push(clap_t *clap, const int16_t *pcm, size_t n) {
+    const uint32_t per_block = clap->cfg.block;
+    uint32_t sum = clap->sum, count = clap->count;
+    int32_t prev = clap->prev;
+    uint8_t result = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        const int32_t x = pcm[i], d = x - prev;
+        prev = x;
+        sum += (uint32_t)(d < 0 ? -d : d);
+        if (++count == per_block) {
+            clap->sum = sum;
+            clap->count = (uint16_t)count;
+            const uint8_t group = end_block(clap);
+            if (group)
+                result = group;
+            sum = count = 0;
+        }
+    }
+    clap->sum = sum;
+    clap->count = (uint16_t)count;
+    clap->prev = (int16_t)prev;
+    return result;
+}
+
+void clap_levels(const clap_t *clap, uint32_t *level, uint32_t *background) {
+    if (level) *level = clap->level_q8 >> 8;
+    if (background) *background = clap->background_q8 >> 8;
+}
+
+void clap_counters(const clap_t *clap, uint32_t *claps, uint32_t *rejects) {
+    if (claps) *claps = clap->claps;
+    if (rejects) *rejects = clap->rejects;
+}
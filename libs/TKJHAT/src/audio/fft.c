@@ -0,0 +1,303 @@
+/*
+Version 0.83
+
+MIT License
+
+Copyright (c) 2025 Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <tkjhat/fft.h>
+
+#define TABLE_SIZE      FFT_MAX_SIZE
+#define SAFE_MAX        13572       // |value| up to this: a butterfly output fits in int16 (1 + sqrt(2))
+                                    // without halving, up to 2 * SAFE_MAX with halving
+#define ROUND_Q15       (1 << 14)
+#define DB_PER_LOG2_Q12 12330       // 10 log10(2) in Q12
+#define DB_PER_EXP_Q8   1541        // 20 log10(2) in Q8
+
+// sin(2 pi k / 512), k = 0..128, Q15 (quarter wave)
+static const int16_t sin_table[TABLE_SIZE / 4 + 1] = {
+    0, 402, 804, 1206, 1608, 2009, 2411, 2811, 3212, 3612, 4011, 4410,
+    4808, 5205, 5602, 5998, 6393, 6787, 7180, 7571, 7962, 8351, 8740, 9127,
+    9512, 9896, 10279, 10660, 11039, 11417, 11793, 12167, 12540, 12910, 13279, 13646,
+    14010, 14373, 14733, 15091, 15447, 15800, 16151, 16500, 16846, 17190, 17531, 17869,
+    18205, 18538, 18868, 19195, 19520, 19841, 20160, 20475, 20788, 21097, 21403, 21706,
+    22006, 22302, 22595, 22884, 23170, 23453, 23732, 24008, 24279, 24548, 24812, 25073,
+    25330, 25583, 25833, 26078, 26320, 26557, 26791, 27020, 27246, 27467, 27684, 27897,
+    28106, 28311, 28511, 28707, 28899, 29086, 29269, 29448, 29622, 29792, 29957, 30118,
+    30274, 30425, 30572, 30715, 30853, 30986, 31114, 31238, 31357, 31471, 31581, 31686,
+    31786, 31881, 31972, 32058, 32138, 32214, 32286, 32352, 32413, 32470, 32522, 32568,
+    32610, 32647, 32679, 32706, 32729, 32746, 32758, 32766, 32767
+};
+
+// Periodic Hann window 0.5 - 0.5 cos(2 pi k / 512), k = 0..256, Q15 (half, symmetric)
+static const int16_t hann_table[TABLE_SIZE / 2 + 1] = {
+    0, 1, 5, 11, 20, 31, 44, 60, 79, 100, 123, 149,
+    177, 208, 241, 277, 315, 355, 398, 443, 491, 541, 593, 648,
+    705, 765, 827, 891, 958, 1027, 1098, 1171, 1247, 1325, 1406, 1488,
+    1573, 1660, 1749, 1841, 1935, 2030, 2128, 2229, 2331, 2435, 2542, 2651,
+    2761, 2874, 2989, 3105, 3224, 3345, 3468, 3592, 3719, 3847, 3978, 4110,
+    4244, 4380, 4518, 4657, 4799, 4942, 5087, 5233, 5381, 5531, 5682, 5835,
+    5990, 6146, 6304, 6463, 6624, 6786, 6950, 7115, 7282, 7449, 7619, 7789,
+    7961, 8134, 8308, 8484, 8661, 8839, 9018, 9198, 9379, 9561, 9745, 9929,
+    10114, 10300, 10487, 10676, 10864, 11054, 11245, 11436, 11628, 11821, 12014, 12208,
+    12403, 12598, 12794, 12991, 13188, 13385, 13583, 13781, 13980, 14179, 14378, 14578,
+    14778, 14978, 15179, 15379, 15580, 15781, 15982, 16183, 16384, 16585, 16786, 16987,
+    17188, 17389, 17589, 17790, 17990, 18190, 18390, 18589, 18788, 18987, 19185, 19383,
+    19580, 19777, 19974, 20170, 20365, 20560, 20754, 20947, 21140, 21332, 21523, 21714,
+    21904, 22092, 22281, 22468, 22654, 22839, 23023, 23207, 23389, 23570, 23750, 23929,
+    24107, 24284, 24460, 24634, 24807, 24979, 25149, 25319, 25486, 25653, 25818, 25982,
+    26144, 26305, 26464, 26622, 26778, 26933, 27086, 27237, 27387, 27535, 27681, 27826,
+    27969, 28111, 28250, 28388, 28524, 28658, 28790, 28921, 29049, 29176, 29300, 29423,
+    29544, 29663, 29779, 29894, 30007, 30117, 30226, 30333, 30437, 30539, 30640, 30738,
+    30833, 30927, 31019, 31108, 31195, 31280, 31362, 31443, 31521, 31597, 31670, 31741,
+    31810, 31877, 31941, 32003, 32063, 32120, 32175, 32227, 32277, 32325, 32370, 32413,
+    32453, 32491, 32527, 32560, 32591, 32619, 32645, 32668, 32689, 32708, 32724, 32737,
+    32748, 32757, 32763, 32767, 32767
+};
+
+// log2(1 + i / 32), i = 0..32, Q16
+static const uint32_t log2_table[33] = {
+    0, 2909, 5732, 8473, 11136, 13727, 16248, 18704,
+    21098, 23433, 25711, 27936, 30109, 32234, 34312, 36346,
+    38336, 40286, 42196, 44068, 45904, 47705, 49472, 51207,
+    52911, 54584, 56229, 57845, 59434, 60997, 62534, 64047,
+    65536
+};
+
+// sin and cos of a * 2 pi / 512 for a = 0..256
+static inline int32_t table_sin(uint32_t a) {
+    return a <= TABLE_SIZE / 4 ? sin_table[a] : sin_table[TABLE_SIZE / 2 - a];
+}
+
+static inline int32_t table_cos(uint32_t a) {
+    return a <= TABLE_SIZE / 4 ? sin_table[TABLE_SIZE / 4 - a] : -sin_table[a - TABLE_SIZE / 4];
+}
+
+static inline int32_t window_at(fft_window_t window, uint32_t a) {
+    if (window == FFT_WINDOW_RECT)
+        return 32767;
+    return a <= TABLE_SIZE / 2 ? hann_table[a] : hann_table[TABLE_SIZE - a];
+}
+
+static inline uint32_t bit_reverse(uint32_t v, uint32_t bits) {
+    v = ((v >> 1) & 0x55) | ((v & 0x55) << 1);
+    v = ((v >> 2) & 0x33) | ((v & 0x33) << 2);
+    v = ((v >> 4) & 0x0F) | ((v & 0x0F) << 4);
+    return v >> (8 - bits);
+}
+
+static inline int32_t abs32(int32_t v) {
+    return v < 0 ? -v : v;
+}
+
+// log2(x) in Q16 for x > 0
+static int32_t log2_q16(uint32_t x) {
+    int32_t msb = 31 - __builtin_clz(x);
+    uint32_t m = x << (31 - msb);               // 1.31, top bit set
+    uint32_t i = (m >> 26) & 31;
+    uint32_t frac = (m >> 10) & 0xFFFF;
+    return (msb << 16) + (int32_t)(log2_table[i] + (((log2_table[i + 1] - log2_table[i]) * frac) >> 16));
+}
+
+void fft_default_config(struct fft_config *cfg, uint16_t size) {
+    cfg->size = size;
+    cfg->window = FFT_WINDOW_HANN;
+}
+
+int fft_init(fft_t *f, const struct fft_config *cfg) {
+    if (!f || !cfg || cfg->size < FFT_MIN_SIZE || cfg->size > FFT_MAX_SIZE || (cfg->size & (cfg->size - 1)) ||
+        (cfg->window != FFT_WINDOW_RECT && cfg->window != FFT_WINDOW_HANN))
+        return -1;
+    memset(f, 0, sizeof(*f));
+    f->cfg = *cfg;
+    f->stride = (uint16_t)(TABLE_SIZE / cfg->size);
+    uint8_t log2_half = 0;
+    while ((1u << log2_half) < cfg->size / 2u) log2_half++;
+    f->log2_half = log2_half;
+
+    // A sine of amplitude A on a bin: |X| = A * (sum of the window) / 2
+    double sum = 0.0;
+    for (uint32_t i = 0; i < cfg->size; i++)
+        sum += window_at(cfg->window, i * f->stride) / 32768.0;
+    f->ref_q8 = (int32_t)lround(20.0 * log10(32767.0 * sum / 2.0) * 256.0);
+    return 0;
+}
+
+// Largest of acc and the magnitudes
+static inline uint32_t max4(uint32_t acc, int32_t a, int32_t b, int32_t c, int32_t d) {
+    uint32_t m = (uint32_t)abs32(a);
+    if ((uint32_t)abs32(b) > m) m = (uint32_t)abs32(b);
+    if ((uint32_t)abs32(c) > m) m = (uint32_t)abs32(c);
+    if ((uint32_t)abs32(d) > m) m = (uint32_t)abs32(d);
+    return m > acc ? m : acc;
+}
+
+// Halving needed by a stage whose inputs are at most bound
+static inline int stage_shift(uint32_t bound) {
+    return bound > 2 * SAFE_MAX ? 2 : bound > SAFE_MAX ? 1 : 0;
+}
+
+// Complex radix-2 FFT of m = 2^stages values in bit reversed order, in place.
+// bound: largest |re| or |im| of the input (or more). Returns the block
+// exponent added by the stages.
+static int fft_complex(fft_complex_t *buf, uint32_t stages, uint32_t bound) {
+    const uint32_t m = 1u << stages;
+    int scaled = 0;
+
+    // Stage 1: twiddle 1
+    {
+        const int shift = stage_shift(bound);
+        const int32_t rnd = (1 << shift) >> 1;
+        scaled += shift;
+        uint32_t acc = 0;
+        for (uint32_t i = 0; i < m; i += 2) {
+            const int32_t ar = buf[i].re, ai = buf[i].im, br = buf[i + 1].re, bi = buf[i + 1].im;
+            const int32_t r0 = (ar + br + rnd) >> shift, i0 = (ai + bi + rnd) >> shift;
+            const int32_t r1 = (ar - br + rnd) >> shift, i1 = (ai - bi + rnd) >> shift;
+            buf[i].re = (int16_t)r0; buf[i].im = (int16_t)i0;
+            buf[i + 1].re = (int16_t)r1; buf[i + 1].im = (int16_t)i1;
+            acc = max4(acc, r0, i0, r1, i1);
+        }
+        bound = acc;
+    }
+
+    // Stage 2: twiddles 1 and -j
+    if (stages >= 2) {
+        const int shift = stage_shift(bound);
+        const int32_t rnd = (1 << shift) >> 1;
+        scaled += shift;
+        uint32_t acc = 0;
+        for (uint32_t i = 0; i < m; i += 4) {
+            int32_t ar = buf[i].re, ai = buf[i].im, br = buf[i + 2].re, bi = buf[i + 2].im;
+            int32_t r0 = (ar + br + rnd) >> shift, i0 = (ai + bi + rnd) >> shift;
+            int32_t r1 = (ar - br + rnd) >> shift, i1 = (ai - bi + rnd) >> shift;
+            buf[i].re = (int16_t)r0; buf[i].im = (int16_t)i0;
+            buf[i + 2].re = (int16_t)r1; buf[i + 2].im = (int16_t)i1;
+            acc = max4(acc, r0, i0, r1, i1);
+
+            // b * -j = (b.im, -b.re)
+            ar = buf[i + 1].re; ai = buf[i + 1].im; br = buf[i + 3].im; bi = -buf[i + 3].re;
+            r0 = (ar + br + rnd) >> shift; i0 = (ai + bi + rnd) >> shift;
+            r1 = (ar - br + rnd) >> shift; i1 = (ai - bi + rnd) >> shift;
+            buf[i + 1].re = (int16_t)r0; buf[i + 1].im = (int16_t)i0;
+            buf[i + 3].re = (int16_t)r1; buf[i + 3].im = (int16_t)i1;
+            acc = max4(acc, r0, i0, r1, i1);
+        }
+        bound = acc;
+    }
+
+    // Other stages: twiddle W = cos - j sin from the table, t = b * W
+    for (uint32_t s = 3; s <= stages; s++) {
+        const uint32_t half = 1u << (s - 1), step = TABLE_SIZE >> s;
+        const int shift = stage_shift(bound);
+        const int32_t rnd = (1 << shift) >> 1;
+        scaled += shift;
+        uint32_t acc = 0;
+        for (uint32_t j = 0; j < half; j++) {
+            const int32_t c = table_cos(j * step), sn = table_sin(j * step);
+            for (uint32_t i = j; i < m; i += 2 * half) {
+                fft_complex_t *a = &buf[i], *b = &buf[i + half];
+                const int32_t tr = (b->re * c + b->im * sn + ROUND_Q15) >> 15;
+                const int32_t ti = (b->im * c - b->re * sn + ROUND_Q15) >> 15;
+                const int32_t r0 = (a->re + tr + rnd) >> shift, i0 = (a->im + ti + rnd) >> shift;
+                const int32_t r1 = (a->re - tr + rnd) >> shift, i1 = (a->im - ti + rnd) >> shift;
+                a->re = (int16_t)r0; a->im = (int16_t)i0;
+                b->re = (int16_t)r1; b->im = (int16_t)i1;
+                acc = max4(acc, r0, i0, r1, i1);
+            }
+        }
+        bound = acc;
+    }
+    return scaled;
+}
+
+void fft_spectrum_db(fft_t *f, const int16_t *pcm, int16_t *db_q8) {
+    const uint32_t n = f->cfg.size, m = n / 2, stride = f->stride;
+
+    // Normalize: the largest sample is shifted up to just below SAFE_MAX
+    // (quiet blocks keep their resolution, the exponent remembers the shift)
+    uint32_t peak = 0;
+    for (uint32_t i = 0; i < n; i++)
+        if ((uint32_t)abs32(pcm[i]) > peak) peak = (uint32_t)abs32(pcm[i]);
+    if (peak == 0) {
+        for (uint32_t k = 0; k < m; k++)
+            db_q8[k] = FFT_DB_FLOOR_Q8;
+        f->exponent = 0;
+        return;
+    }
+    int shift = 0;
+    while ((peak << (shift + 1)) <= SAFE_MAX)
+        shift++;
+    if (peak > SAFE_MAX)
+        shift = -1;
+    int exponent = -shift;
+
+    // Window and pack: even samples real, odd imaginary, bit reversed order
+    uint32_t bound = 0;
+    for (uint32_t i = 0; i < m; i++) {
+        int32_t x0 = pcm[2 * i], x1 = pcm[2 * i + 1];
+        x0 = shift >= 0 ? x0 << shift : x0 >> 1;
+        x1 = shift >= 0 ? x1 << shift : x1 >> 1;
+        if (f->cfg.window != FFT_WINDOW_RECT) {
+            x0 = (x0 * window_at(f->cfg.window, 2 * i * stride) + ROUND_Q15) >> 15;
+            x1 = (x1 * window_at(f->cfg.window, (2 * i + 1) * stride) + ROUND_Q15) >> 15;
+        }
+        fft_complex_t *z = &f->buf[bit_reverse(i, f->log2_half)];
+        z->re = (int16_t)x0;
+        z->im = (int16_t)x1;
+        bound = max4(bound, x0, x1, 0, 0);
+    }
+    exponent += fft_complex(f->buf, f->log2_half, bound);
+    f->exponent = (int8_t)exponent;
+
+    // Split: X[k] = E[k] + W^k O[k] with E = (Z[k] + Z*[m-k]) / 2, O = -j (Z[k] - Z*[m-k]) / 2
+    const int32_t offset_q8 = exponent * DB_PER_EXP_Q8 - f->ref_q8;
+    for (uint32_t k = 0; k < m; k++) {
+        const fft_complex_t a = f->buf[k], b = f->buf[(m - k) & (m - 1)];
+        const int32_t er = (a.re + b.re) >> 1, ei = (a.im - b.im) >> 1;
+        const int32_t or_ = (a.im + b.im) >> 1, oi = (b.re - a.re) >> 1;
+        const uint32_t angle = k * stride;
+        const int32_t c = table_cos(angle), sn = table_sin(angle);
+        int32_t xr = er + ((or_ * c + oi * sn + ROUND_Q15) >> 15);
+        int32_t xi = ei + ((oi * c - or_ * sn + ROUND_Q15) >> 15);
+        int32_t db_exp = 0;
+        if ((abs32(xr) | abs32(xi)) > INT16_MAX) {
+            // Rare near full scale: keep the squares within 32 bits
+            xr >>= 1;
+            xi >>= 1;
+            db_exp = DB_PER_EXP_Q8;
+        }
+        const uint32_t power = (uint32_t)(xr * xr) + (uint32_t)(xi * xi);
+        if (power == 0) {
+            db_q8[k] = FFT_DB_FLOOR_Q8;
+            continue;
+        }
+        int32_t db = (((log2_q16(power) >> 4) * DB_PER_LOG2_Q12) >> 16) + offset_q8 + db_exp;
+        if (db < FFT_DB_FLOOR_Q8) db = FFT_DB_FLOOR_Q8;
+        if (db > INT16_MAX) db = INT16_MAX;
+        db_q8[k] = (int16_t)db;
+    }
+}
@@ -0,0 +1,234 @@
+/*
+Version 0.83
+
+MIT License
+
+Copyright (c) 2025 Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "pico/sync.h"
+#include "pico/time.h"
+
+#include <tkjhat/melody.h>
+#include <tkjhat/morse_player.h>
+#include <tkjhat/sdk.h>
+
+// The alarm callback and the calling tasks (on either core) share the state
+// below under a critical section. Each start gets a new generation, passed to
+// the alarm: a callback of a stopped melody that is already running when the
+// melody is stopped sees an old generation and does nothing. The buzzer
+// takes a lock of its own, so it is retuned after melody_lock is released.
+
+struct melody_entry {
+    const struct melody_note *notes;
+    size_t count;
+};
+
+static critical_section_t melody_lock;
+static struct melody_entry queue[MELODY_QUEUE_LEN];
+static uint8_t q_head = 0;
+static uint8_t q_count = 0;
+static size_t note_index = 0;
+static bool in_gap = false;                     // the sound of the note is over, the gap plays
+static volatile bool playing = false;
+static uint32_t generation = 0;
+static alarm_id_t melody_alarm = 0;
+static melody_done_t done_cb = NULL;
+static void *done_arg = NULL;
+
+static void melody_lock_init(void) {
+    if (!critical_section_is_initialized(&melody_lock))
+        critical_section_init_with_lock_num(&melody_lock, (uint)spin_lock_claim_unused(true));
+}
+
+// Advance to the next note or gap: store its frequency (0 = silence) in
+// *freq and return the microseconds until the step after it, 0 when the
+// queue has played out
+static uint32_t step_locked(uint32_t *freq) {
+    *freq = 0;
+    while (q_count > 0) {
+        const struct melody_entry *m = &queue[q_head];
+        if (note_index == m->count) {
+            q_head = (uint8_t)((q_head + 1) % MELODY_QUEUE_LEN);
+            q_count--;
+            note_index = 0;
+            continue;
+        }
+        const struct melody_note *n = &m->notes[note_index];
+        if (in_gap) {
+            in_gap = false;
+            note_index++;
+            return MELODY_GAP_MS * 1000u;
+        }
+        if (n->ms == 0) {
+            note_index++;
+            continue;
+        }
+        *freq = n->freq;
+        if (n->freq != 0 && n->ms > 2 * MELODY_GAP_MS) {
+            in_gap = true;
+            return (uint32_t)(n->ms - MELODY_GAP_MS) * 1000u;
+        }
+        note_index++;
+        return (uint32_t)n->ms * 1000u;
+    }
+    return 0;
+}
+
+// Retune the buzzer for a step of generation gen, outside melody_lock. A stop
+// on the other core can silence the buzzer before this retunes it: then the
+// note is silenced again.
+static void retune(uint32_t freq, uint32_t gen) {
+    buzzer_set_frequency(freq);
+    if (freq == 0)
+        return;
+    critical_section_enter_blocking(&melody_lock);
+    const bool stale = gen != generation && !playing;
+    critical_section_exit(&melody_lock);
+    if (stale)
+        buzzer_set_frequency(0);
+}
+
+static void clear_locked(void) {
+    q_head = 0;
+    q_count = 0;
+    note_index = 0;
+    in_gap = false;
+    playing = false;
+    generation++;
+    melody_alarm = 0;
+}
+
+static int64_t melody_alarm_cb(alarm_id_t id, void *user_data) {
+    (void)id;
+    critical_section_enter_blocking(&melody_lock);
+    if (!playing || (uint32_t)(uintptr_t)user_data != generation) {
+        critical_section_exit(&melody_lock);
+        return 0;
+    }
+    const uint32_t gen = generation;
+    uint32_t freq;
+    const uint32_t us = step_locked(&freq);
+    if (us == 0)
+        clear_locked();
+    melody_done_t cb = done_cb;
+    void *arg = done_arg;
+    critical_section_exit(&melody_lock);
+
+    retune(freq, gen);
+    if (us != 0)
+        return -(int64_t)us;                    // negative: from the time this alarm was due
+    if (cb)
+        cb(arg);
+    return 0;
+}
+
+int melody_queue(const struct melody_note *notes, size_t count) {
+    if (!notes || count == 0)
+        return -1;
+    melody_lock_init();
+
+    critical_section_enter_blocking(&melody_lock);
+    if (q_count == MELODY_QUEUE_LEN) {
+        critical_section_exit(&melody_lock);
+        return -1;
+    }
+    queue[(q_head + q_count) % MELODY_QUEUE_LEN] = (struct melody_entry){notes, count};
+    q_count++;
+    if (playing) {
+        // The alarm running takes it from the queue
+        critical_section_exit(&melody_lock);
+        return 0;
+    }
+    critical_section_exit(&melody_lock);
+
+    // Nothing plays: a timed tone or morse would cut the first note
+    morse_player_stop();
+    buzzer_turn_off();
+
+    critical_section_enter_blocking(&melody_lock);
+    if (playing || q_count == 0) {
+        // Started by another task meanwhile, or stopped
+        critical_section_exit(&melody_lock);
+        return 0;
+    }
+    uint32_t freq;
+    const uint32_t us = step_locked(&freq);
+    if (us == 0) {
+        // Only empty notes: nothing to play, and the done callback runs
+        // in the alarm interrupt only
+        clear_locked();
+        critical_section_exit(&melody_lock);
+        return -1;
+    }
+    playing = true;
+    const uint32_t gen = generation;
+    critical_section_exit(&melody_lock);
+
+    retune(freq, gen);
+    alarm_id_t id = add_alarm_in_us(us, melody_alarm_cb, (void *)(uintptr_t)gen, true);
+
+    critical_section_enter_blocking(&melody_lock);
+    if (gen == generation) {
+        if (id < 0) {
+            // No free alarm: no note that never ends
+            clear_locked();
+            critical_section_exit(&melody_lock);
+            buzzer_set_frequency(0);
+            return -1;
+        }
+        melody_alarm = id;
+    }
+    critical_section_exit(&melody_lock);
+    return 0;
+}
+
+int melody_play(const struct melody_note *notes, size_t count) {
+    if (!notes || count == 0)
+        return -1;
+    melody_stop();
+    return melody_queue(notes, count);
+}
+
+void melody_stop(void) {
+    melody_lock_init();
+    critical_section_enter_blocking(&melody_lock);
+    const bool was_playing = playing;
+    const alarm_id_t id = melody_alarm;
+    clear_locked();
+    critical_section_exit(&melody_lock);
+    if (id > 0)
+        cancel_alarm(id);
+    if (was_playing)
+        buzzer_set_frequency(0);
+}
+
+bool melody_is_playing(void) {
+    return playing;
+}
+
+void melody_set_done_callback(melody_done_t cb, void *arg) {
+    melody_lock_init();
+    critical_section_enter_blocking(&melody_lock);
+    done_cb = cb;
+    done_arg = arg;
+    critical_section_exit(&melody_lock);
+}
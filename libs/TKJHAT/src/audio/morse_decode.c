@@ -0,0 +1,178 @@
+/*
+Version 0.83
+
+MIT License
+
+Copyright (c) 2025 Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <stdint.h>
+#include <string.h>
+
+#include <tkjhat/morse_decode.h>
+
+#define LETTER_GAP_UNITS2   4       // silence >= 2 units (in half units) ends a letter
+#define WORD_GAP_UNITS2     10      // silence >= 5 units ends a word
+#define ADAPT_SHIFT         2       // dot / dash length move 1/4 of the way per symbol
+
+// International morse code: letters and digits
+static const struct {
+    char letter;
+    const char *code;
+} morse_table[] = {
+    {'A', ".-"},    {'B', "-..."},  {'C', "-.-."},  {'D', "-.."},   {'E', "."},
+    {'F', "..-."},  {'G', "--."},   {'H', "...."},  {'I', ".."},    {'J', ".---"},
+    {'K', "-.-"},   {'L', ".-.."},  {'M', "--"},    {'N', "-."},    {'O', "---"},
+    {'P', ".--."},  {'Q', "--.-"},  {'R', ".-."},   {'S', "..."},   {'T', "-"},
+    {'U', "..-"},   {'V', "...-"},  {'W', ".--"},   {'X', "-..-"},  {'Y', "-.--"},
+    {'Z', "--.."},
+    {'0', "-----"}, {'1', ".----"}, {'2', "..---"}, {'3', "...--"}, {'4', "....-"},
+    {'5', "....."}, {'6', "-...."}, {'7', "--..."}, {'8', "---.."}, {'9', "----."},
+};
+
+void morse_decode_default_config(struct morse_decode_config *cfg, uint16_t unit_ms) {
+    cfg->unit_ms = unit_ms;
+    cfg->min_unit_ms = 20;
+    cfg->max_unit_ms = 400;
+    cfg->adaptive = true;
+}
+
+int morse_decode_init(morse_decode_t *md, const struct morse_decode_config *cfg) {
+    if (!md || !cfg || cfg->min_unit_ms == 0 || cfg->min_unit_ms > cfg->max_unit_ms ||
+        cfg->unit_ms < cfg->min_unit_ms || cfg->unit_ms > cfg->max_unit_ms)
+        return -1;
+    memset(md, 0, sizeof(*md));
+    md->cfg = *cfg;
+    md->dot_ms = cfg->unit_ms;
+    md->dash_ms = 3u * cfg->unit_ms;
+    md->unit_ms = cfg->unit_ms;
+    return 0;
+}
+
+void morse_decode_reset(morse_decode_t *md) {
+    md->mark_ms = 0;
+    md->gap_ms = 0;
+    md->prev_gap_ms = 0;
+    md->in_mark = false;
+    md->pending = false;
+    md->after_symbol = false;
+    md->gaps = 0;
+}
+
+static uint32_t glitch_ms(const morse_decode_t *md) {
+    uint32_t g = md->unit_ms / 4;
+    return g ? g : 1;
+}
+
+static uint32_t approach(uint32_t from, uint32_t to) {
+    return (uint32_t)((int32_t)from + ((int32_t)to - (int32_t)from) / (1 << ADAPT_SHIFT));
+}
+
+// Move the dot or the dash length towards the new mark. The other one keeps
+// the 1:3 ratio if they come closer than 1:2, and the unit is their mean.
+static void adapt(morse_decode_t *md, bool dash, uint32_t mark_ms) {
+    if (!md->cfg.adaptive)
+        return;
+    if (dash) {
+        md->dash_ms = approach(md->dash_ms, mark_ms);
+        if (md->dash_ms < 2 * md->dot_ms) md->dot_ms = md->dash_ms / 3;
+    } else {
+        md->dot_ms = approach(md->dot_ms, mark_ms);
+        if (md->dash_ms < 2 * md->dot_ms) md->dash_ms = 3 * md->dot_ms;
+    }
+    const uint32_t lo = md->cfg.min_unit_ms, hi = md->cfg.max_unit_ms;
+    if (md->dot_ms < lo) md->dot_ms = lo;
+    if (md->dot_ms > hi) md->dot_ms = hi;
+    if (md->dash_ms < 3 * lo) md->dash_ms = 3 * lo;
+    if (md->dash_ms > 3 * hi) md->dash_ms = 3 * hi;
+    md->unit_ms = (md->dot_ms + md->dash_ms / 3) / 2;
+}
+
+size_t morse_decode_step(morse_decode_t *md, bool key, uint32_t dt_ms, char *out) {
+    size_t n = 0;
+    if (key) {
+        if (!md->in_mark) {
+            // A silence shorter than a glitch (the last mark is still pending)
+            // is part of the mark
+            if (md->pending) {
+                md->mark_ms += md->gap_ms;
+            } else {
+                md->mark_ms = 0;
+                md->prev_gap_ms = md->gap_ms;
+            }
+            md->in_mark = true;
+            md->pending = true;
+            md->gap_ms = 0;
+        }
+        md->mark_ms += dt_ms;
+        return 0;
+    }
+
+    if (md->in_mark) {
+        md->in_mark = false;
+        md->gap_ms = 0;
+    }
+    md->gap_ms += dt_ms;
+
+    if (md->pending && md->gap_ms >= glitch_ms(md)) {
+        md->pending = false;
+        if (md->mark_ms >= glitch_ms(md)) {
+            // Nearer to the dot or the dash length by ratio: mark < sqrt(dot * dash)
+            const bool dash = (uint64_t)md->mark_ms * md->mark_ms >= (uint64_t)md->dot_ms * md->dash_ms;
+            out[n++] = dash ? '-' : '.';
+            adapt(md, dash, md->mark_ms);
+            md->after_symbol = true;
+            md->gaps = 0;
+        } else {
+            // A click in a gap: the silence goes on as if it was not there
+            md->gap_ms += md->prev_gap_ms + md->mark_ms;
+        }
+    }
+    if (md->after_symbol && !md->pending) {
+        if (md->gaps == 0 && md->gap_ms * 2 >= LETTER_GAP_UNITS2 * md->unit_ms) {
+            out[n++] = ' ';
+            md->gaps = 1;
+        }
+        if (md->gaps == 1 && md->gap_ms * 2 >= WORD_GAP_UNITS2 * md->unit_ms) {
+            out[n++] = ' ';
+            md->gaps = 2;
+            md->after_symbol = false;
+        }
+    }
+    return n;
+}
+
+uint32_t morse_decode_unit_ms(const morse_decode_t *md) {
+    return md->unit_ms;
+}
+
+char morse_decode_letter(const char *code) {
+    size_t len = 0;
+    while (code[len] == '.' || code[len] == '-')
+        len++;
+    if (len == 0 || (code[len] != '\0' && code[len] != ' '))
+        return 0;
+    for (size_t i = 0; i < sizeof(morse_table) / sizeof(morse_table[0]); i++) {
+        if (strlen(morse_table[i].code) == len && memcmp(morse_table[i].code, code, len) == 0)
+            return morse_table[i].letter;
+    }
+    return 0;
+}
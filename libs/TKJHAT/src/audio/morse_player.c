@@ -0,0 +1,194 @@
+/*
+Version 0.83
+
+MIT License
+
+Copyright (c) 2025 Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "pico/sync.h"
+#include "pico/time.h"
+
+#include <tkjhat/morse_player.h>
+#include <tkjhat/melody.h>
+#include <tkjhat/sdk.h>
+
+// Shared by the alarm callback and the calling tasks under a critical
+// section. As in melody.c, each start gets a new generation so that a
+// callback of a stopped timeline does nothing, and the buzzer and the LED
+// are switched after player_lock is released.
+
+static critical_section_t player_lock;
+static const struct morse_step *player_steps = NULL;
+static size_t player_count = 0;
+static size_t player_index = 0;
+static uint32_t player_freq = 0;
+static volatile bool playing = false;
+static volatile int current_symbol = -1;
+static uint32_t generation = 0;
+static alarm_id_t player_alarm = 0;
+static morse_player_cb_t player_cb = NULL;
+static void *player_arg = NULL;
+
+static void player_lock_init(void) {
+    if (!critical_section_is_initialized(&player_lock))
+        critical_section_init_with_lock_num(&player_lock, (uint)spin_lock_claim_unused(true));
+}
+
+static void output(bool on, uint32_t freq) {
+    buzzer_set_frequency(on ? freq : 0);
+    set_led_status(on);
+}
+
+// Switch the output for a step of generation gen, outside player_lock. A stop
+// on the other core can switch it off before this switches it on: then it is
+// switched off again.
+static void output_step(bool on, uint32_t freq, uint32_t gen) {
+    output(on, freq);
+    if (!on)
+        return;
+    critical_section_enter_blocking(&player_lock);
+    const bool stale = gen != generation && !playing;
+    critical_section_exit(&player_lock);
+    if (stale)
+        output(false, 0);
+}
+
+// Take the step at player_index: store whether it sounds in *on and return
+// its length, 0 at the end
+static uint32_t step_locked(bool *symbol_changed, bool *on) {
+    if (player_index == player_count) {
+        *on = false;
+        *symbol_changed = true;
+        return 0;
+    }
+    const struct morse_step *s = &player_steps[player_index++];
+    *on = s->on;
+    *symbol_changed = s->symbol != current_symbol;
+    current_symbol = s->symbol;
+    return s->us;
+}
+
+static void clear_locked(void) {
+    playing = false;
+    current_symbol = -1;
+    player_steps = NULL;
+    player_count = 0;
+    player_index = 0;
+    generation++;
+    player_alarm = 0;
+}
+
+static int64_t player_alarm_cb(alarm_id_t id, void *user_data) {
+    (void)id;
+    critical_section_enter_blocking(&player_lock);
+    if (!playing || (uint32_t)(uintptr_t)user_data != generation) {
+        critical_section_exit(&player_lock);
+        return 0;
+    }
+    const uint32_t gen = generation;
+    const uint32_t freq = player_freq;
+    bool changed, on;
+    uint32_t us = step_locked(&changed, &on);
+    // Empty steps take no time
+    while (us == 0 && player_index < player_count)
+        us = step_locked(&changed, &on);
+    if (us == 0)
+        clear_locked();
+    const int symbol = us ? current_symbol : -1;
+    morse_player_cb_t cb = player_cb;
+    void *arg = player_arg;
+    critical_section_exit(&player_lock);
+
+    output_step(on, freq, gen);
+
+    if (cb && changed)
+        cb(symbol, arg);
+    return us ? -(int64_t)us : 0;           // negative: from the time this alarm was due
+}
+
+int morse_player_start(const struct morse_step *steps, size_t count, uint32_t freq_hz, morse_player_cb_t cb,
+                       void *arg) {
+    if (!steps || count == 0 || freq_hz == 0)
+        return -1;
+    morse_player_stop();
+    melody_stop();
+    buzzer_turn_off();
+
+    critical_section_enter_blocking(&player_lock);
+    player_steps = steps;
+    player_count = count;
+    player_index = 0;
+    player_freq = freq_hz;
+    player_cb = cb;
+    player_arg = arg;
+    bool changed, on;
+    uint32_t us = step_locked(&changed, &on);
+    while (us == 0 && player_index < player_count)
+        us = step_locked(&changed, &on);
+    if (us == 0) {
+        // Only empty steps; the callback runs in the alarm interrupt only
+        clear_locked();
+        critical_section_exit(&player_lock);
+        return -1;
+    }
+    playing = true;
+    const uint32_t gen = generation;
+    critical_section_exit(&player_lock);
+
+    output_step(on, freq_hz, gen);
+    alarm_id_t id = add_alarm_in_us(us, player_alarm_cb, (void *)(uintptr_t)gen, true);
+
+    critical_section_enter_blocking(&player_lock);
+    if (gen == generation) {
+        if (id < 0) {
+            // No free alarm: no tone that never ends
+            clear_locked();
+            critical_section_exit(&player_lock);
+            output(false, 0);
+            return -1;
+        }
+        player_alarm = id;
+    }
+    critical_section_exit(&player_lock);
+    return 0;
+}
+
+void morse_player_stop(void) {
+    player_lock_init();
+    critical_section_enter_blocking(&player_lock);
+    const bool was_playing = playing;
+    const alarm_id_t id = player_alarm;
+    clear_locked();
+    critical_section_exit(&player_lock);
+    if (id > 0)
+        cancel_alarm(id);
+    if (was_playing)
+        output(false, 0);
+}
+
+bool morse_player_is_playing(void) {
+    return playing;
+}
+
+int morse_player_symbol(void) {
+    return current_symbol;
+}
@@ -0,0 +1,104 @@
+/*
+Version 0.83
+
+MIT License
+
+Copyright (c) 2025 Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <tkjhat/morse_player.h>
+
+int morse_timing_wpm(struct morse_timing *timing, uint32_t char_wpm, uint32_t overall_wpm) {
+    if (!timing || char_wpm < MORSE_WPM_MIN || char_wpm > MORSE_WPM_MAX)
+        return -1;
+    if (overall_wpm == 0)
+        overall_wpm = char_wpm;
+    if (overall_wpm < MORSE_WPM_MIN || overall_wpm > char_wpm)
+        return -1;
+
+    // PARIS: 50 units a word, a unit is 1.2 s / WPM
+    const uint32_t unit = (1200000u + char_wpm / 2) / char_wpm;
+
+    // Farnsworth: "PARIS " takes 60 / overall s, of which the 31 units of the
+    // marks and mark gaps are at the character speed and the rest is spread
+    // over the 19 units of the letter and word gaps
+    const uint64_t num = 60000000ull * char_wpm - 37200000ull * overall_wpm;
+    const uint64_t den = 19ull * overall_wpm * char_wpm;
+    const uint32_t gap_unit = (uint32_t)((num + den / 2) / den);
+
+    timing->dot_us = unit;
+    timing->dash_us = 3 * unit;
+    timing->letter_gap_us = 3 * gap_unit;
+    timing->word_gap_us = 7 * gap_unit;
+    return 0;
+}
+
+int morse_compile(const char *symbols, const struct morse_timing *timing, struct morse_step *steps,
+                  size_t max_steps) {
+    if (!symbols || !timing || (!steps && max_steps > 0) || timing->dot_us == 0)
+        return -1;
+
+    size_t count = 0;
+    uint32_t gap_us = 0;                        // gap waiting for the next mark
+    uint16_t gap_symbol = 0;
+    bool in_letter = false;                     // a mark of this letter has been played
+
+    for (size_t i = 0; symbols[i] != '\0' && symbols[i] != '\n' && symbols[i] != '\r'; i++) {
+        const char c = symbols[i];
+        if (i > UINT16_MAX)
+            return -1;
+        if (c == '.' || c == '-') {
+            if (in_letter && gap_us < timing->dot_us) {
+                gap_us = timing->dot_us;
+                gap_symbol = (uint16_t)(i - 1);
+            }
+            if (gap_us > 0) {
+                if (count == max_steps)
+                    return -1;
+                steps[count++] = (struct morse_step){gap_us, gap_symbol, false};
+            }
+            if (count == max_steps)
+                return -1;
+            steps[count++] = (struct morse_step){c == '.' ? timing->dot_us : timing->dash_us, (uint16_t)i, true};
+            gap_us = 0;
+            in_letter = true;
+        } else if (c == ' ') {
+            // A second space makes the letter gap a word gap
+            uint32_t us = timing->letter_gap_us;
+            if (i > 0 && symbols[i - 1] == ' ')
+                us = timing->word_gap_us;
+            if (us >= gap_us) {
+                gap_us = us;
+                gap_symbol = (uint16_t)i;
+            }
+            in_letter = false;
+        }
+        // Other characters are skipped
+    }
+
+    // Trailing spaces keep the gap before the next message
+    if (gap_us > 0) {
+        if (count == max_steps)
+            return -1;
+        steps[count++] = (struct morse_step){gap_us, gap_symbol, false};
+    }
+    return (int)count;
+}
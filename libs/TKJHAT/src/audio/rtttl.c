@@ -0,0 +1,173 @@
+/*
+Version 0.83
+
+MIT License
+
+Copyright (c) 2025 Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <ctype.h>
+#include <string.h>
+
+#include <tkjhat/melody.h>
+
+// Octave 8 in 1/100 Hz (C8 = 4186.01 Hz, A8 = 7040 Hz), the lower octaves
+// are halved from these
+static const uint32_t octave8_centihz[12] = {
+    418601, 443492, 469864, 497803, 527404, 558765,
+    591991, 627193, 664488, 704000, 745862, 790213,
+};
+
+// Semitone above c of the letters a-g
+static const uint8_t letter_semitone[7] = {9, 11, 0, 2, 4, 5, 7};
+
+static const char *skip_space(const char *p) {
+    while (*p && isspace((unsigned char)*p))
+        p++;
+    return p;
+}
+
+// Decimal number (0 if no digits)
+static const char *parse_number(const char *p, uint32_t *value) {
+    uint32_t v = 0;
+    p = skip_space(p);
+    while (isdigit((unsigned char)*p)) {
+        if (v < 100000)
+            v = v * 10 + (uint32_t)(*p - '0');
+        p++;
+    }
+    *value = v;
+    return skip_space(p);
+}
+
+static bool valid_duration(uint32_t d) {
+    return d == 1 || d == 2 || d == 4 || d == 8 || d == 16 || d == 32;
+}
+
+int melody_parse_rtttl(const char *text, struct melody_note *notes, size_t max_notes, char *name,
+                       size_t name_size) {
+    if (!text || (!notes && max_notes > 0))
+        return -1;
+
+    // Name
+    const char *colon = strchr(text, ':');
+    if (!colon)
+        return -1;
+    if (name && name_size > 0) {
+        const char *start = skip_space(text);
+        size_t len = start < colon ? (size_t)(colon - start) : 0;
+        while (len > 0 && isspace((unsigned char)start[len - 1]))
+            len--;
+        if (len >= name_size)
+            len = name_size - 1;
+        memcpy(name, start, len);
+        name[len] = '\0';
+    }
+
+    // Defaults: d=, o=, b= (others are ignored)
+    uint32_t def_duration = 4, def_octave = 6, bpm = 63;
+    const char *p = colon + 1;
+    while (*(p = skip_space(p)) && *p != ':') {
+        const char key = (char)tolower((unsigned char)*p);
+        p = skip_space(p + 1);
+        if (*p != '=')
+            return -1;
+        uint32_t value;
+        p = parse_number(p + 1, &value);
+        if (key == 'd')
+            def_duration = value;
+        else if (key == 'o')
+            def_octave = value;
+        else if (key == 'b')
+            bpm = value;
+        if (*p == ',')
+            p++;
+        else if (*p != ':')
+            return -1;
+    }
+    if (*p != ':' || !valid_duration(def_duration) || def_octave < 3 || def_octave > 8 || bpm == 0 ||
+        bpm > 900)
+        return -1;
+    p++;
+
+    // Notes
+    size_t count = 0;
+    while (*(p = skip_space(p))) {
+        uint32_t duration, octave;
+        p = parse_number(p, &duration);
+        if (duration == 0)
+            duration = def_duration;
+        if (!valid_duration(duration))
+            return -1;
+
+        const char letter = (char)tolower((unsigned char)*p);
+        int semitone = -1;                      // rest
+        if (letter >= 'a' && letter <= 'g')
+            semitone = letter_semitone[letter - 'a'];
+        else if (letter != 'p')
+            return -1;
+        p = skip_space(p + 1);
+        if (*p == '#') {
+            if (semitone < 0)
+                return -1;
+            semitone++;                         // b# is c of the same octave, as in most players
+            if (semitone == 12)
+                semitone = 0;
+            p = skip_space(p + 1);
+        }
+        bool dotted = false;
+        if (*p == '.') {
+            dotted = true;
+            p = skip_space(p + 1);
+        }
+        p = parse_number(p, &octave);
+        if (octave == 0)
+            octave = def_octave;
+        if (*p == '.') {
+            dotted = true;
+            p = skip_space(p + 1);
+        }
+        if (octave < 3 || octave > 8)
+            return -1;
+
+        // A whole note is 4 beats
+        uint32_t ms = (240000u * (dotted ? 3 : 2) / (bpm * duration) + 1) / 2;
+        if (ms > UINT16_MAX)
+            return -1;
+        uint32_t freq = 0;
+        if (semitone >= 0) {
+            const uint32_t div = 100u << (8 - octave);
+            freq = (octave8_centihz[semitone] + div / 2) / div;
+        }
+
+        if (count == max_notes)
+            return -1;
+        notes[count].freq = (uint16_t)freq;
+        notes[count].ms = (uint16_t)ms;
+        count++;
+
+        if (*p == ',')
+            p++;
+        else if (*p)
+            return -1;
+    }
+    return (int)count;
+}
@@ -0,0 +1,189 @@
+/*
+Version 0.83
+
+MIT License
+
+Copyright (c) 2025 Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <tkjhat/tone_detect.h>
+
+#define NOISE_UP_SHIFT      4       // noise floor rises by 1/16 of the difference per block
+#define NOISE_DOWN_SHIFT    1       // and falls by 1/2
+#define LEVEL_SHIFT         2       // tone level: 1/4 per block while the key is down
+#define TONE_PI             3.14159265358979
+
+// (coef * s) >> 14 with 32-bit multiplies only (no 64-bit multiply on the M0+):
+// s = hi * 2^14 + lo with 0 <= lo < 2^14, both products fit in 32 bits.
+static inline int32_t mul_q14(int32_t coef, int32_t s) {
+    return coef * (s >> 14) + ((coef * (s & 0x3FFF)) >> 14);
+}
+
+static uint32_t isqrt64(uint64_t x) {
+    uint64_t r = 0, bit = (uint64_t)1 << 62;
+    while (bit > x) bit >>= 2;
+    while (bit) {
+        if (x >= r + bit) {
+            x -= r + bit;
+            r = (r >> 1) + bit;
+        } else {
+            r >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)r;
+}
+
+void tone_detect_default_config(struct tone_detect_config *cfg, uint32_t sample_rate, uint16_t freq_hz) {
+    cfg->sample_rate = sample_rate;
+    cfg->freq_hz = freq_hz;
+    cfg->block = (uint16_t)(sample_rate * TONE_DETECT_BLOCK_MS / 1000);
+    cfg->on_ratio = 4;
+    cfg->min_purity = 64;
+    cfg->min_amplitude = 16;
+}
+
+int tone_detect_init(tone_detect_t *td, const struct tone_detect_config *cfg) {
+    if (!td || !cfg || cfg->sample_rate == 0 || cfg->block < 8 || cfg->block > TONE_DETECT_MAX_BLOCK ||
+        cfg->on_ratio < 2)
+        return -1;
+    // At least two bins away from DC and Nyquist: the resonator stays within 32 bits
+    const uint32_t bin2 = 2 * cfg->sample_rate / cfg->block;
+    if (cfg->freq_hz < bin2 || cfg->freq_hz > cfg->sample_rate / 2 - bin2)
+        return -1;
+    memset(td, 0, sizeof(*td));
+    td->cfg = *cfg;
+    td->coef_q14 = (int32_t)lround(2.0 * cos(2.0 * TONE_PI * cfg->freq_hz / cfg->sample_rate) * 16384.0);
+    tone_detect_reset(td);
+    return 0;
+}
+
+void tone_detect_reset(tone_detect_t *td) {
+    td->s1 = td->s2 = 0;
+    td->energy = 0;
+    td->count = 0;
+    td->key = false;
+    td->amplitude = 0;
+    td->purity = 0;
+    td->noise_q4 = (uint32_t)td->cfg.min_amplitude << 4;
+    td->level_q4 = 0;
+}
+
+// One block is complete: tone amplitude, purity and the decision
+static bool end_block(tone_detect_t *td) {
+    const int32_t s1 = td->s1, s2 = td->s2;
+    const uint32_t n = td->cfg.block;
+    int64_t power = (int64_t)s1 * s1 + (int64_t)s2 * s2 - (int64_t)mul_q14(td->coef_q14, s1) * s2;
+    if (power < 0) power = 0;
+
+    // A sine of amplitude A on the bin gives power (A n / 2)^2
+    const uint32_t amp = 2 * isqrt64((uint64_t)power) / n;
+    // Share of the block energy in the bin: (A^2 / 2) n / sum(x^2) = 2 power / (n energy)
+    uint32_t purity = 0;
+    if (td->energy > 0) {
+        uint64_t p = (uint64_t)power * 2 * 255 / n / td->energy;
+        purity = p > 255 ? 255 : (uint32_t)p;
+    }
+    td->amplitude = amp;
+    td->purity = (uint8_t)purity;
+    td->s1 = td->s2 = 0;
+    td->energy = 0;
+    td->count = 0;
+
+    const uint32_t amp_q4 = amp << 4;
+    uint32_t on_q4 = td->noise_q4 * td->cfg.on_ratio;
+    if (on_q4 < (uint32_t)td->cfg.min_amplitude << 4)
+        on_q4 = (uint32_t)td->cfg.min_amplitude << 4;
+
+    if (!td->key) {
+        if (amp_q4 > on_q4 && purity >= td->cfg.min_purity) {
+            td->key = true;
+            td->level_q4 = amp_q4;
+        } else if (amp_q4 > td->noise_q4) {
+            td->noise_q4 += (amp_q4 - td->noise_q4) >> NOISE_UP_SHIFT;
+        } else {
+            td->noise_q4 -= (td->noise_q4 - amp_q4) >> NOISE_DOWN_SHIFT;
+        }
+    } else {
+        uint32_t off_q4 = on_q4 / 2;
+        if (off_q4 < td->level_q4 / 4)
+            off_q4 = td->level_q4 / 4;
+        // Released when the tone fades or no longer dominates the block (a voice on the bin)
+        if (amp_q4 < off_q4 || purity < td->cfg.min_purity / 2) {
+            td->key = false;
+        } else if (amp_q4 > td->level_q4) {
+            td->level_q4 += (amp_q4 - td->level_q4) >> LEVEL_SHIFT;
+        } else {
+            td->level_q4 -= (td->level_q4 - amp_q4) >> LEVEL_SHIFT;
+        }
+    }
+    return td->key;
+}
+
+size_t tone_detect_push(tone_detect_t *td, const int16_t *pcm, size_t n, bool *key, size_t max_blocks) {
+    size_t blocks = 0;
+    const int32_t coef = td->coef_q14;
+    int32_t s1 = td->s1, s2 = td->s2;
+    uint64_t energy = td->energy;
+    uint32_t count = td->count;
+    for (size_t i = 0; i < n; i++) {
+        const int32_t x = pcm[i];
+        const int32_t s0 = x + mul_q14(coef, s1) - s2;
+        s2 = s1;
+        s1 = s0;
+        energy += (uint32_t)(x * x);
+        if (++count == td->cfg.block) {
+            td->s1 = s1;
+            td->s2 = s2;
+            td->energy = energy;
+            bool k = end_block(td);
+            if (key && blocks < max_blocks)
+                key[blocks] = k;
+            blocks++;
+            s1 = s2 = 0;
+            energy = 0;
+            count = 0;
+        }
+    }
+    td->s1 = s1;
+    td->s2 = s2;
+    td->energy = energy;
+    td->count = (uint16_t)count;
+    return blocks;
+}
+
+bool tone_detect_key(const tone_detect_t *td) {
+    return td->key;
+}
+
+uint32_t tone_detect_block_us(const tone_detect_t *td) {
+    return (uint32_t)((uint64_t)td->cfg.block * 1000000u / td->cfg.sample_rate);
+}
+
+void tone_detect_levels(const tone_detect_t *td, uint32_t *amplitude, uint32_t *noise, uint32_t *level) {
+    if (amplitude) *amplitude = td->amplitude;
+    if (noise) *noise = td->noise_q4 >> 4;
+    if (level) *level = td->level_q4 >> 4;
+}
@@ -0,0 +1,194 @@
+/*
+Version 0.83
+
+MIT License
+
+Copyright (c) 2025 Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <string.h>
+
+#include <tkjhat/vad.h>
+
+#define NOISE_DOWN_SHIFT    1       // floor falls by 1/2 of the difference per block
+#define NOISE_UP_SHIFT      7       // rises by 1/128 in silence (1.3 s with 10 ms blocks)
+#define NOISE_UP_SOUND_SHIFT 9      // and by 1/512 during sound (5 s): a steady new noise is learnt
+
+void vad_default_config(struct vad_config *cfg, uint32_t sample_rate) {
+    cfg->sample_rate = sample_rate;
+    cfg->block = (uint16_t)(sample_rate * VAD_BLOCK_MS / 1000);
+    cfg->decimation = 2;
+    cfg->on_ratio_q4 = 36;          // 2.25x, 7 dB
+    cfg->keep_ratio_q4 = 32;        // 2x, only with a high zero crossing rate
+    cfg->zcr_min = 80;              // 31 % sign changes: 1250 crossings/s at 8 kHz with decimation 2
+    cfg->min_level = 4;
+    cfg->hangover_ms = 300;
+}
+
+int vad_init(vad_t *vad, const struct vad_config *cfg) {
+    if (!vad || !cfg || cfg->sample_rate == 0 || cfg->decimation < 1 || cfg->decimation > 8 ||
+        cfg->block / cfg->decimation < 8 || cfg->on_ratio_q4 < 16 || cfg->keep_ratio_q4 < 16)
+        return -1;
+    memset(vad, 0, sizeof(*vad));
+    vad->cfg = *cfg;
+    const uint32_t block_ms = (uint32_t)cfg->block * 1000 / cfg->sample_rate;
+    vad->hangover_blocks = block_ms ? (cfg->hangover_ms + block_ms - 1) / block_ms : 0;
+    vad_reset(vad);
+    return 0;
+}
+
+void vad_reset(vad_t *vad) {
+    vad->sum = 0;
+    vad->count = 0;
+    vad->crossings = 0;
+    vad->phase = 0;
+    vad->negative = false;
+    vad->prev = 0;
+    vad->level_q8 = 0;
+    vad->zcr = 0;
+    vad->noise_q8 = (uint32_t)vad->cfg.min_level << 8;
+    vad->active = false;
+    vad->hangover_left = 0;
+    vad->blocks = 0;
+    vad->active_blocks = 0;
+}
+
+// One block is complete: level, zero crossing rate, floor and the decision
+static void end_block(vad_t *vad) {
+    const uint32_t level_q8 = (uint32_t)(((uint64_t)vad->sum << 8) / vad->count);
+    uint32_t zcr = (uint32_t)vad->crossings * 255 / vad->count;
+    vad->level_q8 = level_q8;
+    vad->zcr = (uint8_t)(zcr > 255 ? 255 : zcr);
+    vad->sum = 0;
+    vad->count = 0;
+    vad->crossings = 0;
+
+    // level / floor against the ratios (Q4), both sides in Q12. The level is
+    // at most 65535 (Q8: 2^24), so the products fit in 32 bits.
+    const bool above_min = level_q8 >= (uint32_t)vad->cfg.min_level << 8;
+    const bool loud = above_min && (level_q8 << 4) > vad->noise_q8 * vad->cfg.on_ratio_q4;
+    const bool keep = vad->active && above_min && vad->zcr >= vad->cfg.zcr_min &&
+                      (level_q8 << 4) > vad->noise_q8 * vad->cfg.keep_ratio_q4;
+
+    if (loud || keep) {
+        vad->active = true;
+        vad->hangover_left = vad->hangover_blocks;
+    } else if (vad->hangover_left > 0) {
+        vad->hangover_left--;
+    } else {
+        vad->active = false;
+    }
+
+    if (level_q8 < vad->noise_q8)
+        vad->noise_q8 -= (vad->noise_q8 - level_q8) >> NOISE_DOWN_SHIFT;
+    else
+        vad->noise_q8 += (level_q8 - vad->noise_q8) >> (loud || keep ? NOISE_UP_SOUND_SHIFT : NOISE_UP_SHIFT);
+
+    vad->blocks++;
+    if (vad->active)
+        vad->active_blocks++;
+}
+
+bool vad_push(vad_t *vad, const int16_t *pcm, size_t n) {
+    const uint32_t dec = vad->cfg.decimation, per_block = vad->cfg.block / dec;
+    bool any = vad->active;
+    uint32_t sum = vad->sum, count = vad->count, crossings = vad->crossings;
+    bool negative = vad->negative;
+    int32_t prev = vad->prev;
+
+    size_t i = vad->phase;
+    for (; i < n; i += dec) {
+        // Level of the difference: a high-pass that removes hum and fan rumble
+        const int32_t x = pcm[i], d = x - prev;
+        const bool neg = x < 0;
+        prev = x;
+        sum += (uint32_t)(d < 0 ? -d : d);
+        crossings += neg != negative;
+        negative = neg;
+        if (++count == per_block) {
+            vad->sum = sum;
+            vad->count = (uint16_t)count;
+            vad->crossings = (uint16_t)crossings;
+            end_block(vad);
+            any |= vad->active;
+            sum = count = crossings = 0;
+        }
+    }
+    vad->phase = (uint8_t)(i - n);
+    vad->sum = sum;
+    vad->count = (uint16_t)count;
+    vad->crossings = (uint16_t)crossings;
+    vad->negative = negative;
+    vad->prev = (int16_t)prev;
+    return any;
+}
+
+bool vad_active(const vad_t *vad) {
+    return vad->active;
+}
+
+void vad_levels(const vad_t *vad, uint32_t *level, uint32_t *noise, uint8_t *zcr) {
+    if (level) *level = vad->level_q8 >> 8;
+    if (noise) *noise = vad->noise_q8 >> 8;
+    if (zcr) *zcr = vad->zcr;
+}
+
+uint32_t vad_duty_permille(const vad_t *vad) {
+    return vad->blocks ? (uint32_t)((uint64_t)vad->active_blocks * 1000 / vad->blocks) : 0;
+}
+
+int vad_preroll_init(vad_preroll_t *p, int16_t *storage, uint16_t frames, uint16_t frame_samples) {
+    if (!p || !storage || frames < 1 || frames > VAD_PREROLL_MAX_FRAMES || frame_samples == 0)
+        return -1;
+    memset(p, 0, sizeof(*p));
+    p->storage = storage;
+    p->frames = frames;
+    p->frame_samples = frame_samples;
+    return 0;
+}
+
+void vad_preroll_push(vad_preroll_t *p, const int16_t *pcm, size_t n) {
+    if (p->count == p->frames) {
+        p->head = (uint16_t)((p->head + 1) % p->frames);
+        p->count--;
+    }
+    const uint16_t slot = (uint16_t)((p->head + p->count) % p->frames);
+    if (n > p->frame_samples)
+        n = p->frame_samples;
+    memcpy(p->storage + (size_t)slot * p->frame_samples, pcm, n * sizeof(*pcm));
+    p->length[slot] = (uint16_t)n;
+    p->count++;
+}
+
+const int16_t *vad_preroll_pop(vad_preroll_t *p, size_t *n) {
+    if (p->count == 0)
+        return NULL;
+    const uint16_t slot = p->head;
+    p->head = (uint16_t)((p->head + 1) % p->frames);
+    p->count--;
+    *n = p->length[slot];
+    return p->storage + (size_t)slot * p->frame_samples;
+}
+
+void vad_preroll_clear(vad_preroll_t *p) {
+    p->head = 0;
+    p->count = 0;
+}
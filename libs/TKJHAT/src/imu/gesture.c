@@ -0,0 +1,260 @@
+/*
+Version 0.83
+
+MIT License
+
+Copyright (c) 2025 Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <string.h>
+
+#include <tkjhat/gesture.h>
+
+#define GRAVITY_SHIFT   5       // gravity EMA: 1/32 per sample while idle
+
+// Built-in tree: the dominant axis of the movement decides.
+//   X share > 50 %          -> dash
+//   else Z share > 50 %     -> dot
+//   else                    -> none (Y or mixed movement)
+static const gesture_tree_node_t default_tree[] = {
+    { GESTURE_F_SHARE_X, 128, 1, GESTURE_LEAF(GESTURE_DASH) },
+    { GESTURE_F_SHARE_Z, 128, GESTURE_LEAF(GESTURE_NONE), GESTURE_LEAF(GESTURE_DOT) },
+};
+
+static inline int32_t iabs(int32_t x) { return x < 0 ? -x : x; }
+
+static inline int16_t clamp16(int32_t x) {
+    if (x > 32767) return 32767;
+    if (x < -32768) return -32768;
+    return (int16_t)x;
+}
+
+static uint16_t ms_to_samples(uint16_t ms, uint16_t odr_hz) {
+    uint32_t n = ((uint32_t)ms * odr_hz + 999u) / 1000u;
+    return (uint16_t)(n > 0xFFFF ? 0xFFFF : n);
+}
+
+void gesture_default_config(struct gesture_config *cfg, uint16_t odr_hz, uint16_t accel_fsr_g) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->odr_hz = odr_hz;
+    cfg->accel_fsr_g = accel_fsr_g;
+    cfg->start_mg = 120;
+    cfg->stop_mg = 50;
+    cfg->stop_ms = 80;
+    cfg->min_ms = 40;
+    cfg->max_ms = 1500;
+    cfg->refractory_ms = 100;
+    cfg->tree = NULL;
+    cfg->tree_len = 0;
+}
+
+static bool tree_valid(const gesture_tree_node_t *t, uint8_t len) {
+    if (len == 0 || len > GESTURE_TREE_MAX_NODES) return false;
+    for (uint8_t i = 0; i < len; i++) {
+        if (t[i].feature >= GESTURE_F_COUNT) return false;
+        int8_t ch[2] = { t[i].left, t[i].right };
+        for (int k = 0; k < 2; k++) {
+            if (ch[k] >= 0) {
+                // Children must come after the parent: no loops
+                if (ch[k] <= (int8_t)i || ch[k] >= (int8_t)len) return false;
+            } else if (-1 - ch[k] >= GESTURE_CLASS_COUNT) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int gesture_init(gesture_t *g, const struct gesture_config *cfg) {
+    if (!g || !cfg || cfg->odr_hz == 0) return -1;
+    switch (cfg->accel_fsr_g) {
+        case 2: case 4: case 8: case 16: break;
+        default: return -1;
+    }
+    if (cfg->stop_mg == 0 || cfg->stop_mg > cfg->start_mg || cfg->max_ms <= cfg->min_ms) return -2;
+
+    const gesture_tree_node_t *tree = cfg->tree ? cfg->tree : default_tree;
+    uint8_t tree_len = cfg->tree ? cfg->tree_len : (uint8_t)(sizeof(default_tree) / sizeof(default_tree[0]));
+    if (!tree_valid(tree, tree_len)) return -2;
+
+    memset(g, 0, sizeof(*g));
+    memcpy(g->tree, tree, tree_len * sizeof(*tree));
+    g->tree_len = tree_len;
+
+    // Thresholds are compared with the sum of the L1 movement in the window
+    const uint32_t lsb_per_g = 32768u / cfg->accel_fsr_g;
+    g->start_thr = (cfg->start_mg * lsb_per_g / 1000u) * GESTURE_WINDOW;
+    g->stop_thr = (cfg->stop_mg * lsb_per_g / 1000u) * GESTURE_WINDOW;
+    g->stop_samples = ms_to_samples(cfg->stop_ms, cfg->odr_hz);
+    g->min_samples = ms_to_samples(cfg->min_ms, cfg->odr_hz);
+    g->max_samples = ms_to_samples(cfg->max_ms, cfg->odr_hz);
+    g->refractory_samples = ms_to_samples(cfg->refractory_ms, cfg->odr_hz);
+    if (g->stop_samples == 0) g->stop_samples = 1;
+
+    gesture_reset(g);
+    return 0;
+}
+
+void gesture_reset(gesture_t *g) {
+    memset(g->grav, 0, sizeof(g->grav));
+    memset(g->win_dev, 0, sizeof(g->win_dev));
+    memset(g->win_gyro, 0, sizeof(g->win_gyro));
+    memset(g->win_l1, 0, sizeof(g->win_l1));
+    g->win_sum = 0;
+    g->win_pos = 0;
+    g->win_fill = 0;
+    g->state = GESTURE_IDLE;
+    g->quiet = 0;
+    g->refractory = 0;
+    memset(&g->cur, 0, sizeof(g->cur));
+}
+
+static void accumulate(gesture_features_t *c, const int16_t dev[3], const int16_t gyro[3]) {
+    c->f[GESTURE_F_DURATION]++;
+    for (int a = 0; a < 3; a++) {
+        int32_t d = iabs(dev[a]);
+        if (d > c->f[GESTURE_F_PEAK_X + a]) c->f[GESTURE_F_PEAK_X + a] = d;
+        c->energy[a] += ((uint32_t)(d * d)) >> 12;
+        int32_t w = iabs(gyro[a]);
+        if (w > c->f[GESTURE_F_GYRO_PEAK_X + a]) c->f[GESTURE_F_GYRO_PEAK_X + a] = w;
+    }
+}
+
+gesture_class_t gesture_classify(const gesture_t *g, const gesture_features_t *f) {
+    int8_t node = 0;
+    for (uint8_t steps = 0; steps < g->tree_len && node >= 0; steps++) {
+        const gesture_tree_node_t *n = &g->tree[node];
+        node = (f->f[n->feature] <= n->threshold) ? n->left : n->right;
+    }
+    return node < 0 ? (gesture_class_t)(-1 - node) : GESTURE_NONE;
+}
+
+static gesture_class_t finish(gesture_t *g) {
+    gesture_features_t *c = &g->cur;
+    uint32_t total = c->energy[0] + c->energy[1] + c->energy[2];
+    for (int a = 0; a < 3; a++) {
+        c->f[GESTURE_F_SHARE_X + a] = total ? (int32_t)(((uint64_t)c->energy[a] * 256u) / total) : 0;
+    }
+    c->end_sample = g->sample_count;
+    g->last = *c;
+    g->refractory = g->refractory_samples;
+
+    // The window is quiet now: take its mean as the new gravity, in case the
+    // gesture left the board in a different orientation.
+    int32_t mean[3] = {0, 0, 0};
+    for (int i = 0; i < GESTURE_WINDOW; i++) {
+        for (int a = 0; a < 3; a++) mean[a] += g->win_dev[i][a];
+    }
+    for (int a = 0; a < 3; a++) g->grav[a] += (mean[a] * 256) / GESTURE_WINDOW;
+
+    // Only the movement counts for the minimum length, not the quiet tail
+    int32_t active = c->f[GESTURE_F_DURATION] - g->quiet;
+    if (active < (int32_t)g->min_samples) return GESTURE_NONE;
+    return gesture_classify(g, c);
+}
+
+gesture_class_t gesture_push(gesture_t *g, const icm42670_raw_sample_t *s) {
+    const int16_t acc[3] = { s->ax, s->ay, s->az };
+    const int16_t gyro[3] = { s->gx, s->gy, s->gz };
+    gesture_class_t result = GESTURE_NONE;
+
+    g->sample_count++;
+    if (g->win_fill == 0) {
+        for (int a = 0; a < 3; a++) g->grav[a] = (int32_t)acc[a] << 8;
+    }
+
+    // Movement = distance to the gravity estimate
+    int16_t dev[3];
+    uint32_t l1 = 0;
+    for (int a = 0; a < 3; a++) {
+        dev[a] = clamp16(acc[a] - (g->grav[a] >> 8));
+        l1 += (uint32_t)iabs(dev[a]);
+    }
+    if (l1 > 0xFFFF) l1 = 0xFFFF;
+
+    // Sliding window
+    uint8_t p = g->win_pos;
+    g->win_sum += l1 - g->win_l1[p];
+    g->win_l1[p] = (uint16_t)l1;
+    memcpy(g->win_dev[p], dev, sizeof(dev));
+    memcpy(g->win_gyro[p], gyro, sizeof(gyro));
+    g->win_pos = (uint8_t)((p + 1) & (GESTURE_WINDOW - 1));
+
+    if (g->win_fill < GESTURE_WINDOW) {
+        g->win_fill++;
+        for (int a = 0; a < 3; a++) g->grav[a] += (((int32_t)acc[a] << 8) - g->grav[a]) >> GRAVITY_SHIFT;
+        return GESTURE_NONE;
+    }
+
+    switch (g->state) {
+        case GESTURE_IDLE:
+            if (g->refractory) g->refractory--;
+            if (g->refractory == 0 && g->win_sum > g->start_thr) {
+                // Start: include the samples already in the window (oldest first)
+                memset(&g->cur, 0, sizeof(g->cur));
+                for (int i = 0; i < GESTURE_WINDOW; i++) {
+                    int k = (g->win_pos + i) & (GESTURE_WINDOW - 1);
+                    accumulate(&g->cur, g->win_dev[k], g->win_gyro[k]);
+                }
+                g->quiet = 0;
+                g->state = GESTURE_ACTIVE;
+            } else {
+                for (int a = 0; a < 3; a++) g->grav[a] += (((int32_t)acc[a] << 8) - g->grav[a]) >> GRAVITY_SHIFT;
+            }
+            break;
+
+        case GESTURE_ACTIVE:
+            accumulate(&g->cur, dev, gyro);
+            // Gestures push and stop, so their mean is close to zero. A much
+            // slower gravity update lets a tilt (constant offset) end the gesture.
+            for (int a = 0; a < 3; a++) g->grav[a] += (((int32_t)acc[a] << 8) - g->grav[a]) >> (GRAVITY_SHIFT + 1);
+            g->quiet = (g->win_sum < g->stop_thr) ? (uint16_t)(g->quiet + 1) : 0;
+            if (g->quiet >= g->stop_samples) {
+                result = finish(g);
+                g->state = GESTURE_IDLE;
+            } else if (g->cur.f[GESTURE_F_DURATION] >= (int32_t)g->max_samples) {
+                result = finish(g);
+                g->quiet = 0;
+                g->state = GESTURE_SETTLE;
+            }
+            break;
+
+        case GESTURE_SETTLE:
+            // Too long movement: wait for the board to be still before the next
+            // gesture. Gravity follows faster here, the orientation may have changed.
+            for (int a = 0; a < 3; a++) g->grav[a] += (((int32_t)acc[a] << 8) - g->grav[a]) >> (GRAVITY_SHIFT - 2);
+            g->quiet = (g->win_sum < g->stop_thr) ? (uint16_t)(g->quiet + 1) : 0;
+            if (g->quiet >= g->stop_samples) {
+                g->refractory = g->refractory_samples;
+                g->state = GESTURE_IDLE;
+            }
+            break;
+    }
+    return result;
+}
+
+bool gesture_busy(const gesture_t *g) {
+    return g->state != GESTURE_IDLE;
+}
+
+const gesture_features_t *gesture_last_features(const gesture_t *g) {
+    return &g->last;
+}
@@ -0,0 +1,281 @@
+/*
+Version 0.83
+
+MIT License
+
+Copyright (c) 2025 Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Mahony complementary filter, IMU only (no magnetometer).
+// Reference: R. Mahony et al., "Nonlinear Complementary Filters on the Special
+// Orthogonal Group", IEEE TAC 2008, and S. Madgwick's open source implementation.
+//
+// Fixed-point layout:
+//  - Quaternion: Q30 (int32). A unit quaternion has components in [-1, 1].
+//  - The gyro rate is turned directly into a half-angle increment per sample
+//    (0.5 * w * dt), also in Q30. This folds dt and the LSB scale into one
+//    constant, so the update does not need any division.
+//  - Accelerometer direction: Q15 (int32 division, hardware divider on RP2040).
+
+#include <string.h>
+
+#include <tkjhat/imu_fusion.h>
+
+#define Q30_ONE         (1 << 30)
+#define Q15_ONE         (1 << 15)
+#define FUSION_PI       3.14159265358979f
+
+static inline int32_t qmul30(int32_t a, int32_t b) {
+    return (int32_t)(((int64_t)a * b) >> 30);
+}
+
+// floor(sqrt(x)), bit by bit. Only used on the accelerometer norm.
+static uint32_t isqrt32(uint32_t x) {
+    uint32_t res = 0;
+    uint32_t bit = 1u << 30;
+    while (bit > x) bit >>= 2;
+    while (bit) {
+        if (x >= res + bit) {
+            x -= res + bit;
+            res = (res >> 1) + bit;
+        } else {
+            res >>= 1;
+        }
+        bit >>= 2;
+    }
+    return res;
+}
+
+int imu_fusion_init(imu_fusion_t *f, const struct imu_fusion_config *cfg) {
+    if (!f || !cfg) return -1;
+
+    switch (cfg->accel_fsr_g) {
+        case 2: case 4: case 8: case 16: break;
+        default: return -1;
+    }
+    switch (cfg->gyro_fsr_dps) {
+        case 250: case 500: case 1000: case 2000: break;
+        default: return -1;
+    }
+    if (cfg->odr_hz == 0) return -1;
+    if (cfg->kp < 0.0f || cfg->ki < 0.0f) return -2;
+
+    memset(f, 0, sizeof(*f));
+
+    const float dt = 1.0f / (float)cfg->odr_hz;
+    const float rad_per_lsb = ((float)cfg->gyro_fsr_dps / 32768.0f) * (FUSION_PI / 180.0f);
+
+    // 0.5 * dt * rad/LSB in Q46 so that (raw * gyro_h) >> 16 is Q30.
+    const float gyro_h = 0.5f * dt * rad_per_lsb * 70368744177664.0f;   // 2^46
+    const float kp_h = 0.5f * dt * cfg->kp * (float)Q30_ONE;
+    const float ki_h = 0.5f * dt * dt * cfg->ki * (float)Q30_ONE;
+    if (gyro_h >= 2147483647.0f || kp_h >= 2147483647.0f || ki_h >= 2147483647.0f) {
+        return -2;
+    }
+    f->gyro_h = (int32_t)(gyro_h + 0.5f);
+    f->kp_h = (int32_t)(kp_h + 0.5f);
+    f->ki_h = (int32_t)(ki_h + 0.5f);
+
+    // Only trust the accelerometer as gravity reference between 0.5 g and 1.5 g.
+    const int32_t lsb_per_g = 32768 / cfg->accel_fsr_g;
+    f->accel_min = lsb_per_g / 2;
+    f->accel_max = lsb_per_g + lsb_per_g / 2;
+
+    f->publish_divider = cfg->publish_divider ? cfg->publish_divider : 1;
+    imu_fusion_reset(f);
+    return 0;
+}
+
+void imu_fusion_reset(imu_fusion_t *f) {
+    f->q[0] = Q30_ONE;
+    f->q[1] = f->q[2] = f->q[3] = 0;
+    f->ix = f->iy = f->iz = 0;
+    f->sample_count = 0;
+    f->publish_countdown = f->publish_divider;
+}
+
+static void publish(imu_fusion_t *f) {
+    imu_orientation_t o;
+    bool computed = false;
+    for (int i = 0; i < IMU_FUSION_MAX_SUBSCRIBERS; i++) {
+        if (!f->subscribers[i]) continue;
+        // Euler angles are only computed if somebody is listening.
+        if (!computed) {
+            imu_fusion_get_orientation(f, &o);
+            computed = true;
+        }
+        f->subscribers[i](&o, f->subscriber_ctx[i]);
+    }
+}
+
+void imu_fusion_update(imu_fusion_t *f, const icm42670_raw_sample_t *s) {
+    int32_t q0 = f->q[0], q1 = f->q[1], q2 = f->q[2], q3 = f->q[3];
+
+    // Gyro: half-angle increment for this sample (Q30)
+    int32_t hx = (int32_t)(((int64_t)s->gx * f->gyro_h) >> 16);
+    int32_t hy = (int32_t)(((int64_t)s->gy * f->gyro_h) >> 16);
+    int32_t hz = (int32_t)(((int64_t)s->gz * f->gyro_h) >> 16);
+
+    // Accelerometer correction, skipped while the board is being shaken.
+    int32_t ax = s->ax, ay = s->ay, az = s->az;
+    uint32_t norm = isqrt32((uint32_t)(ax * ax) + (uint32_t)(ay * ay) + (uint32_t)(az * az));
+    if ((int32_t)norm >= f->accel_min && (int32_t)norm <= f->accel_max) {
+        // Measured gravity direction (Q15)
+        ax = (ax * Q15_ONE) / (int32_t)norm;
+        ay = (ay * Q15_ONE) / (int32_t)norm;
+        az = (az * Q15_ONE) / (int32_t)norm;
+
+        // Estimated gravity direction from the quaternion (Q30 -> Q15)
+        int32_t vx = (2 * (qmul30(q1, q3) - qmul30(q0, q2))) >> 15;
+        int32_t vy = (2 * (qmul30(q0, q1) + qmul30(q2, q3))) >> 15;
+        int32_t vz = (qmul30(q0, q0) - qmul30(q1, q1) - qmul30(q2, q2) + qmul30(q3, q3)) >> 15;
+
+        // Error = measured x estimated (Q30). |e| <= 1 so it cannot overflow.
+        int32_t ex = ay * vz - az * vy;
+        int32_t ey = az * vx - ax * vz;
+        int32_t ez = ax * vy - ay * vx;
+
+        // The integral step is tiny (Ki * dt^2), keep it in Q60 to avoid a
+        // rounding bias that would show up as yaw drift.
+        if (f->ki_h) {
+            f->ix += (int64_t)ex * f->ki_h;
+            f->iy += (int64_t)ey * f->ki_h;
+            f->iz += (int64_t)ez * f->ki_h;
+        }
+        hx += qmul30(ex, f->kp_h);
+        hy += qmul30(ey, f->kp_h);
+        hz += qmul30(ez, f->kp_h);
+    }
+    hx += (int32_t)(f->ix >> 30);
+    hy += (int32_t)(f->iy >> 30);
+    hz += (int32_t)(f->iz >> 30);
+
+    // q += q (x) (0, h)
+    int32_t n0 = q0 - qmul30(q1, hx) - qmul30(q2, hy) - qmul30(q3, hz);
+    int32_t n1 = q1 + qmul30(q0, hx) + qmul30(q2, hz) - qmul30(q3, hy);
+    int32_t n2 = q2 + qmul30(q0, hy) - qmul30(q1, hz) + qmul30(q3, hx);
+    int32_t n3 = q3 + qmul30(q0, hz) + qmul30(q1, hy) - qmul30(q2, hx);
+
+    // Renormalize with Newton iterations on 1/sqrt(x), starting from 1.
+    // After a normal step |q|^2 is within 1e-4 of 1 and one iteration is enough.
+    int32_t sq = qmul30(n0, n0) + qmul30(n1, n1) + qmul30(n2, n2) + qmul30(n3, n3);
+    int32_t inv = Q30_ONE;
+    for (int it = 0; it < 4; it++) {
+        // inv = inv * (3 - sq * inv^2) / 2
+        int32_t t = qmul30(sq, qmul30(inv, inv));
+        inv = qmul30(inv, (3 * (Q30_ONE >> 1)) - (t >> 1));
+        int32_t d = t - Q30_ONE;
+        if (d < (1 << 12) && d > -(1 << 12)) break;
+    }
+    f->q[0] = qmul30(n0, inv);
+    f->q[1] = qmul30(n1, inv);
+    f->q[2] = qmul30(n2, inv);
+    f->q[3] = qmul30(n3, inv);
+
+    f->sample_count++;
+    if (--f->publish_countdown == 0) {
+        f->publish_countdown = f->publish_divider;
+        publish(f);
+    }
+}
+
+void imu_fusion_update_batch(imu_fusion_t *f, const icm42670_raw_sample_t *s, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        imu_fusion_update(f, &s[i]);
+    }
+}
+
+// atan(z) for z in [0, 1] (Q15), in 1/100 degrees.
+// atan(z) ~= pi/4 z + z (1 - z) (0.2447 + 0.0663 z), max error ~0.0015 rad.
+static int32_t atan_unit_cdeg(int32_t z) {
+    int32_t inner = 8018 + ((2173 * z) >> 15);
+    int32_t corr = (((z * (Q15_ONE - z)) >> 15) * inner) >> 15;
+    int32_t rad = ((z * 25736) >> 15) + corr;     // Q15 radians
+    return (rad * 5730 + (1 << 14)) >> 15;        // 180/pi * 100 = 5729.6
+}
+
+int32_t imu_fusion_atan2_cdeg(int32_t y, int32_t x) {
+    if (x == 0 && y == 0) return 0;
+
+    uint32_t ax = (x < 0) ? (uint32_t)(-(int64_t)x) : (uint32_t)x;
+    uint32_t ay = (y < 0) ? (uint32_t)(-(int64_t)y) : (uint32_t)y;
+
+    // Bring both to 16 bits so the ratio fits a 32-bit division.
+    while (ax > 0xFFFF || ay > 0xFFFF) {
+        ax >>= 1;
+        ay >>= 1;
+    }
+
+    int32_t angle;
+    if (ay <= ax) {
+        angle = atan_unit_cdeg((int32_t)((ay << 15) / ax));
+    } else {
+        angle = 9000 - atan_unit_cdeg((int32_t)((ax << 15) / ay));
+    }
+    if (x < 0) angle = 18000 - angle;
+    if (y < 0) angle = -angle;
+    return angle;
+}
+
+void imu_fusion_get_orientation(const imu_fusion_t *f, imu_orientation_t *out) {
+    const int32_t q0 = f->q[0], q1 = f->q[1], q2 = f->q[2], q3 = f->q[3];
+
+    memcpy(out->q, f->q, sizeof(out->q));
+    out->sample_count = f->sample_count;
+
+    // Roll
+    int32_t sinr = 2 * (qmul30(q0, q1) + qmul30(q2, q3));
+    int32_t cosr = Q30_ONE - 2 * (qmul30(q1, q1) + qmul30(q2, q2));
+    out->roll_cdeg = (int16_t)imu_fusion_atan2_cdeg(sinr, cosr);
+
+    // Pitch = asin(sinp) = atan2(sinp, sqrt(1 - sinp^2)), in Q15
+    int32_t sinp = 2 * (qmul30(q0, q2) - qmul30(q3, q1));
+    if (sinp > Q30_ONE) sinp = Q30_ONE;
+    if (sinp < -Q30_ONE) sinp = -Q30_ONE;
+    int32_t sinp15 = sinp >> 15;
+    int32_t cosp15 = (int32_t)isqrt32((uint32_t)(Q30_ONE - sinp15 * sinp15));
+    out->pitch_cdeg = (int16_t)imu_fusion_atan2_cdeg(sinp15, cosp15);
+
+    // Yaw
+    int32_t siny = 2 * (qmul30(q0, q3) + qmul30(q1, q2));
+    int32_t cosy = Q30_ONE - 2 * (qmul30(q2, q2) + qmul30(q3, q3));
+    out->yaw_cdeg = (int16_t)imu_fusion_atan2_cdeg(siny, cosy);
+}
+
+int imu_fusion_subscribe(imu_fusion_t *f, imu_fusion_subscriber_t cb, void *ctx) {
+    for (int i = 0; i < IMU_FUSION_MAX_SUBSCRIBERS; i++) {
+        if (!f->subscribers[i]) {
+            f->subscriber_ctx[i] = ctx;
+            f->subscribers[i] = cb;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void imu_fusion_unsubscribe(imu_fusion_t *f, imu_fusion_subscriber_t cb) {
+    for (int i = 0; i < IMU_FUSION_MAX_SUBSCRIBERS; i++) {
+        if (f->subscribers[i] == cb) {
+            f->subscribers[i] = NULL;
+            f->subscriber_ctx[i] = NULL;
+        }
+    }
+}
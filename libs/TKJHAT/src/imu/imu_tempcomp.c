@@ -0,0 +1,326 @@
+/*
+Version 0.83
+
+MIT License
+
+Copyright (c) 2025 Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <stddef.h>
+#include <string.h>
+
+#include <tkjhat/imu_tempcomp.h>
+
+#define RECORD_MAGIC        0x43544B54u     // "TKTC" little endian
+#define TEMP_1C             128             // register scale: 128 LSB per °C
+#define TEMP_KEY_SHIFT      4               // correction is recomputed every 1/8 °C
+#define FIT_SHIFT           4               // fit in 1/8 °C units
+#define MIN_SPAN            (2 * TEMP_1C)   // slope needs data over at least 2 °C
+#define EXTRAPOLATE         (5 * TEMP_1C)   // the lines are held flat 5 °C outside the data
+#define ACCEL_MIN_DT        (TEMP_1C / 2)   // accelerometer pairs at least 0.5 °C apart
+#define ACCEL_SXX_MAX       ((int64_t)(40 * TEMP_1C) * (40 * TEMP_1C) * 16)  // then old pairs fade out
+#define STILL_TEMP          TEMP_1C         // temperature spread of a still window
+
+// Plausibility limits of the model (finest range, Q8): a bad fit must not
+// remove more than the sensor can really drift.
+#define GYRO_OFF_MAX_Q8     (10 * 131 * 256)    // 10 dps
+#define GYRO_SLOPE_MAX_Q8   (131 * 256 / 10)    // 0.1 dps / °C
+#define ACCEL_SLOPE_MAX_Q8  (16384 * 256 / 1000) // 1 mg / °C
+
+static inline int32_t iabs(int32_t x) { return x < 0 ? -x : x; }
+
+static inline int32_t clamp32(int32_t x, int32_t lim) {
+    return x > lim ? lim : (x < -lim ? -lim : x);
+}
+
+static inline int16_t clamp16(int32_t x) {
+    if (x > 32767) return 32767;
+    if (x < -32768) return -32768;
+    return (int16_t)x;
+}
+
+// log2(fsr / finest), or -1 if fsr is not a valid range
+static int fsr_shift(uint16_t fsr, uint16_t finest) {
+    for (int s = 0; s < 4; s++) {
+        if (fsr == (finest << s)) return s;
+    }
+    return -1;
+}
+
+static uint32_t crc32(const uint8_t *p, size_t len) {
+    uint32_t crc = 0xFFFFFFFFu;
+    while (len--) {
+        crc ^= *p++;
+        for (int k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+    }
+    return ~crc;
+}
+
+void imu_tempcomp_default_config(struct imu_tempcomp_config *cfg, uint16_t odr_hz,
+                                 uint16_t accel_fsr_g, uint16_t gyro_fsr_dps) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->odr_hz = odr_hz;
+    cfg->accel_fsr_g = accel_fsr_g;
+    cfg->gyro_fsr_dps = gyro_fsr_dps;
+    cfg->window_ms = 500;
+    cfg->still_mg = 20;
+    cfg->still_mdps = 1000;
+    cfg->orientation_mg = 8;
+}
+
+// Gyroscope: weighted least squares line through the bins. Accelerometer:
+// slope from the accumulated same-orientation pairs.
+static void refit(imu_tempcomp_t *tc) {
+    int64_t sw = 0, st = 0, stt = 0, sb[3] = { 0 }, stb[3] = { 0 };
+    tc->temp_lo = INT16_MAX;
+    tc->temp_hi = INT16_MIN;
+    for (int i = 0; i < IMU_TEMPCOMP_BINS; i++) {
+        const imu_tempcomp_bin_t *b = &tc->bins[i];
+        if (b->weight == 0) continue;
+        const int64_t w = b->weight, t = b->temp >> FIT_SHIFT;
+        sw += w;
+        st += w * t;
+        stt += w * t * t;
+        for (int k = 0; k < 3; k++) {
+            sb[k] += w * b->gyro_q8[k];
+            stb[k] += w * t * b->gyro_q8[k];
+        }
+        if (b->temp < tc->temp_lo) tc->temp_lo = b->temp;
+        if (b->temp > tc->temp_hi) tc->temp_hi = b->temp;
+    }
+
+    const int64_t den = sw * stt - st * st;
+    for (int k = 0; k < 3; k++) {
+        int32_t off = 0, slope = 0;
+        if (sw > 0 && tc->temp_hi - tc->temp_lo >= MIN_SPAN && den > 0) {
+            off = (int32_t)((stt * sb[k] - st * stb[k]) / den);
+            slope = (int32_t)((sw * stb[k] - st * sb[k]) * (TEMP_1C >> FIT_SHIFT) / den);
+        } else if (sw > 0) {
+            off = (int32_t)(sb[k] / sw);
+        }
+        tc->gyro_off_q8[k] = clamp32(off, GYRO_OFF_MAX_Q8);
+        tc->gyro_slope_q8[k] = clamp32(slope, GYRO_SLOPE_MAX_Q8);
+
+        int32_t aslope = 0;
+        if (tc->accel_sxx > 0) {
+            aslope = (int32_t)(tc->accel_sxy[k] * TEMP_1C / tc->accel_sxx);
+        }
+        tc->accel_slope_q8[k] = clamp32(aslope, ACCEL_SLOPE_MAX_Q8);
+    }
+    tc->corr_valid = false;
+}
+
+int imu_tempcomp_init(imu_tempcomp_t *tc, const struct imu_tempcomp_config *cfg) {
+    const int as = fsr_shift(cfg->accel_fsr_g, IMU_TEMPCOMP_ACCEL_FSR_G);
+    const int gs = fsr_shift(cfg->gyro_fsr_dps, IMU_TEMPCOMP_GYRO_FSR_DPS);
+    if (as < 0 || gs < 0 || cfg->odr_hz == 0) return -1;
+
+    uint32_t win = ((uint32_t)cfg->window_ms * cfg->odr_hz + 999u) / 1000u;
+    if (win < 8 || cfg->still_mg == 0 || cfg->still_mdps == 0) return -2;
+    if (win > IMU_TEMPCOMP_MAX_WINDOW) win = IMU_TEMPCOMP_MAX_WINDOW;
+
+    memset(tc, 0, sizeof(*tc));
+    tc->accel_shift = (uint8_t)as;
+    tc->gyro_shift = (uint8_t)gs;
+    tc->win_samples = (uint16_t)win;
+    // Thresholds in LSB of the configured ranges (at least 1 LSB)
+    const uint32_t a_lsb_g = 32768u / cfg->accel_fsr_g;
+    const uint32_t g_lsb_dps = 32768u / cfg->gyro_fsr_dps;
+    tc->still_accel = (uint16_t)((cfg->still_mg * a_lsb_g + 999u) / 1000u);
+    tc->still_gyro = (uint16_t)((cfg->still_mdps * g_lsb_dps + 999u) / 1000u);
+    tc->orientation = (uint16_t)((cfg->orientation_mg * a_lsb_g + 999u) / 1000u);
+    refit(tc);
+    return 0;
+}
+
+void imu_tempcomp_reset_window(imu_tempcomp_t *tc) {
+    tc->win_n = 0;
+}
+
+// Accelerometer: the bias change between two still windows in the same
+// orientation is the temperature effect. Any movement in between breaks the
+// pair (ref_valid is cleared by a moving window).
+static void observe_accel(imu_tempcomp_t *tc, int16_t temp, const int32_t a_q8[3]) {
+    const int32_t tol_q8 = (int32_t)tc->orientation << (8 + tc->accel_shift);
+    if (tc->ref_valid) {
+        const int32_t dt = temp - tc->ref_temp;
+        bool same = true;
+        for (int k = 0; k < 3; k++) {
+            int32_t expected = tc->ref_accel_q8[k] + tc->accel_slope_q8[k] * dt / TEMP_1C;
+            if (iabs(a_q8[k] - expected) > tol_q8) same = false;
+        }
+        if (same && iabs(dt) < ACCEL_MIN_DT) return;    // keep the reference, wait for more change
+        if (same) {
+            for (int k = 0; k < 3; k++) {
+                tc->accel_sxy[k] += (int64_t)dt * (a_q8[k] - tc->ref_accel_q8[k]);
+            }
+            tc->accel_sxx += (int64_t)dt * dt;
+            if (tc->accel_sxx > ACCEL_SXX_MAX) {
+                for (int k = 0; k < 3; k++) tc->accel_sxy[k] /= 2;
+                tc->accel_sxx /= 2;
+            }
+        }
+    }
+    for (int k = 0; k < 3; k++) tc->ref_accel_q8[k] = a_q8[k];
+    tc->ref_temp = temp;
+    tc->ref_valid = true;
+}
+
+// One still window: mean bias at the mean temperature
+static void observe(imu_tempcomp_t *tc, int16_t temp, const int32_t a_q8[3], const int32_t g_q8[3]) {
+    tc->observations++;
+    observe_accel(tc, temp, a_q8);
+
+    const int32_t rel = temp + (25 - IMU_TEMPCOMP_MIN_C) * TEMP_1C;
+    const int32_t idx = rel >= 0 ? rel / (IMU_TEMPCOMP_BIN_C * TEMP_1C) : -1;
+    if (idx >= 0 && idx < IMU_TEMPCOMP_BINS) {
+        imu_tempcomp_bin_t *b = &tc->bins[idx];
+        if (b->weight < IMU_TEMPCOMP_BIN_MAX_WEIGHT) b->weight++;
+        const int32_t w = b->weight;
+        for (int k = 0; k < 3; k++) b->gyro_q8[k] += (g_q8[k] - b->gyro_q8[k]) / w;
+        b->temp = (int16_t)(b->temp + (temp - b->temp) / w);
+    }
+    refit(tc);
+    tc->dirty = true;
+}
+
+static void close_window(imu_tempcomp_t *tc, bool *still_out) {
+    bool still = true;
+    for (int k = 0; k < 6; k++) {
+        const int32_t spread = tc->win_max[k] - tc->win_min[k];
+        if (spread > (k < 3 ? tc->still_accel : tc->still_gyro)) still = false;
+    }
+    const int32_t n = tc->win_n;
+    const int16_t temp = (int16_t)(tc->win_sum[6] / n);
+    if (tc->win_temp_max - tc->win_temp_min > STILL_TEMP) still = false;
+    *still_out = still;
+    tc->win_n = 0;
+    if (!still) {
+        tc->ref_valid = false;
+        return;
+    }
+    int32_t a_q8[3], g_q8[3];
+    for (int k = 0; k < 3; k++) {
+        a_q8[k] = (int32_t)(((int64_t)tc->win_sum[k] << (8 + tc->accel_shift)) / n);
+        g_q8[k] = (int32_t)(((int64_t)tc->win_sum[3 + k] << (8 + tc->gyro_shift)) / n);
+    }
+    observe(tc, temp, a_q8, g_q8);
+}
+
+int imu_tempcomp_learn(imu_tempcomp_t *tc, const icm42670_raw_sample_t *samples, size_t n) {
+    int still_windows = 0;
+    for (size_t i = 0; i < n; i++) {
+        const icm42670_raw_sample_t *s = &samples[i];
+        const int16_t v[6] = { s->ax, s->ay, s->az, s->gx, s->gy, s->gz };
+        if (tc->win_n == 0) {
+            memset(tc->win_sum, 0, sizeof(tc->win_sum));
+            for (int k = 0; k < 6; k++) tc->win_min[k] = tc->win_max[k] = v[k];
+            tc->win_temp_min = tc->win_temp_max = s->temp;
+        }
+        for (int k = 0; k < 6; k++) {
+            tc->win_sum[k] += v[k];
+            if (v[k] < tc->win_min[k]) tc->win_min[k] = v[k];
+            if (v[k] > tc->win_max[k]) tc->win_max[k] = v[k];
+        }
+        tc->win_sum[6] += s->temp;
+        if (s->temp < tc->win_temp_min) tc->win_temp_min = s->temp;
+        if (s->temp > tc->win_temp_max) tc->win_temp_max = s->temp;
+        if (++tc->win_n == tc->win_samples) {
+            bool still;
+            close_window(tc, &still);
+            still_windows += still;
+        }
+    }
+    return still_windows;
+}
+
+// Model at a temperature, finest range Q8
+static void model_q8(const imu_tempcomp_t *tc, int16_t temp, int32_t out_q8[6]) {
+    int32_t t = temp;
+    if (tc->temp_lo <= tc->temp_hi) {
+        if (t < tc->temp_lo - EXTRAPOLATE) t = tc->temp_lo - EXTRAPOLATE;
+        if (t > tc->temp_hi + EXTRAPOLATE) t = tc->temp_hi + EXTRAPOLATE;
+    }
+    for (int k = 0; k < 3; k++) {
+        out_q8[k] = tc->accel_slope_q8[k] * t / TEMP_1C;
+        out_q8[3 + k] = tc->gyro_off_q8[k] + tc->gyro_slope_q8[k] * t / TEMP_1C;
+    }
+}
+
+void imu_tempcomp_bias(const imu_tempcomp_t *tc, int16_t temp, int16_t bias[6]) {
+    int32_t q8[6];
+    model_q8(tc, temp, q8);
+    for (int k = 0; k < 6; k++) {
+        const int sh = 8 + (k < 3 ? tc->accel_shift : tc->gyro_shift);
+        bias[k] = clamp16((q8[k] + (1 << (sh - 1))) >> sh);
+    }
+}
+
+void imu_tempcomp_apply(imu_tempcomp_t *tc, icm42670_raw_sample_t *samples, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        icm42670_raw_sample_t *s = &samples[i];
+        const int16_t key = (int16_t)(s->temp >> TEMP_KEY_SHIFT);
+        if (!tc->corr_valid || key != tc->corr_temp) {
+            imu_tempcomp_bias(tc, (int16_t)(key << TEMP_KEY_SHIFT), tc->corr);
+            tc->corr_temp = key;
+            tc->corr_valid = true;
+        }
+        s->ax = clamp16(s->ax - tc->corr[0]);
+        s->ay = clamp16(s->ay - tc->corr[1]);
+        s->az = clamp16(s->az - tc->corr[2]);
+        s->gx = clamp16(s->gx - tc->corr[3]);
+        s->gy = clamp16(s->gy - tc->corr[4]);
+        s->gz = clamp16(s->gz - tc->corr[5]);
+    }
+}
+
+bool imu_tempcomp_dirty(const imu_tempcomp_t *tc) {
+    return tc->dirty;
+}
+
+void imu_tempcomp_export(imu_tempcomp_t *tc, imu_tempcomp_record_t *rec) {
+    memset(rec, 0, sizeof(*rec));
+    rec->magic = RECORD_MAGIC;
+    rec->version = IMU_TEMPCOMP_RECORD_VERSION;
+    rec->size = sizeof(*rec);
+    memcpy(rec->bins, tc->bins, sizeof(rec->bins));
+    memcpy(rec->accel_sxy, tc->accel_sxy, sizeof(rec->accel_sxy));
+    rec->accel_sxx = tc->accel_sxx;
+    rec->crc = crc32((const uint8_t *)rec, offsetof(imu_tempcomp_record_t, crc));
+    tc->dirty = false;
+}
+
+int imu_tempcomp_import(imu_tempcomp_t *tc, const imu_tempcomp_record_t *rec) {
+    if (rec->magic != RECORD_MAGIC || rec->version != IMU_TEMPCOMP_RECORD_VERSION ||
+        rec->size != sizeof(*rec) || rec->accel_sxx < 0 ||
+        rec->crc != crc32((const uint8_t *)rec, offsetof(imu_tempcomp_record_t, crc))) {
+        return -1;
+    }
+    for (int i = 0; i < IMU_TEMPCOMP_BINS; i++) {
+        if (rec->bins[i].weight > IMU_TEMPCOMP_BIN_MAX_WEIGHT) return -1;
+    }
+    memcpy(tc->bins, rec->bins, sizeof(tc->bins));
+    memcpy(tc->accel_sxy, rec->accel_sxy, sizeof(tc->accel_sxy));
+    tc->accel_sxx = rec->accel_sxx;
+    tc->dirty = false;
+    refit(tc);
+    return 0;
+}
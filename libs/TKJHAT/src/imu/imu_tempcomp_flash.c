@@ -0,0 +1,68 @@
+/*
+Version 0.83
+
+MIT License
+
+Copyright (c) 2025 Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Flash storage of the temperature compensation model. Kept apart from
+// imu_tempcomp.c so that the model itself builds on the host.
+
+#include <string.h>
+
+#include <pico/flash.h>
+#include <hardware/flash.h>
+#include <hardware/regs/addressmap.h>
+
+#include <tkjhat/imu_tempcomp.h>
+
+// Last sector of the flash: far from the program, which is written from the start
+#define TEMPCOMP_FLASH_OFFSET   (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE)
+// Programming is done in whole pages
+#define TEMPCOMP_FLASH_BYTES    ((sizeof(imu_tempcomp_record_t) + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE * FLASH_PAGE_SIZE)
+#define TEMPCOMP_FLASH_TIMEOUT_MS 100
+
+static uint8_t flash_page_buf[TEMPCOMP_FLASH_BYTES];
+
+// Runs with interrupts off and the other core parked (flash_safe_execute)
+static void tempcomp_flash_write(void *param) {
+    flash_range_erase(TEMPCOMP_FLASH_OFFSET, FLASH_SECTOR_SIZE);
+    flash_range_program(TEMPCOMP_FLASH_OFFSET, (const uint8_t *)param, TEMPCOMP_FLASH_BYTES);
+}
+
+int imu_tempcomp_load_flash(imu_tempcomp_t *tc) {
+    imu_tempcomp_record_t rec;
+    memcpy(&rec, (const void *)(XIP_BASE + TEMPCOMP_FLASH_OFFSET), sizeof(rec));
+    return imu_tempcomp_import(tc, &rec);
+}
+
+int imu_tempcomp_save_flash(imu_tempcomp_t *tc) {
+    imu_tempcomp_record_t rec;
+    imu_tempcomp_export(tc, &rec);
+    memset(flash_page_buf, 0xFF, sizeof(flash_page_buf));
+    memcpy(flash_page_buf, &rec, sizeof(rec));
+    if (flash_safe_execute(tempcomp_flash_write, flash_page_buf, TEMPCOMP_FLASH_TIMEOUT_MS) != PICO_OK) {
+        tc->dirty = true;   // try again next time
+        return -1;
+    }
+    return 0;
+}
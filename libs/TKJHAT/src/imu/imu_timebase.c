@@ -0,0 +1,178 @@
+/*
+Version 0.83
+
+MIT License
+
+Copyright (c) 2025 Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <stdint.h>
+#include <string.h>
+
+#include <tkjhat/imu_timebase.h>
+
+#define DRIFT_SHIFT         2           // drift EMA: 1/4 of each new measurement
+
+int imu_timebase_init(imu_timebase_t *tb, uint16_t odr_hz) {
+    // Below IMU_TIMEBASE_ODR_MIN the 16-bit timestamps wrap between samples
+    if (!tb || odr_hz < IMU_TIMEBASE_ODR_MIN || odr_hz > IMU_TIMEBASE_ODR_MAX) return -1;
+    memset(tb, 0, sizeof(*tb));
+    tb->period_us = 1000000u / odr_hz;
+    return 0;
+}
+
+void imu_timebase_reset(imu_timebase_t *tb) {
+    uint32_t period = tb->period_us;
+    memset(tb, 0, sizeof(*tb));
+    tb->period_us = period;
+}
+
+// Host - sensor offset at sensor time s
+static int64_t offset_at(const imu_timebase_t *tb, int64_t s) {
+    return tb->anchor_offset + ((tb->drift_q32 * (s - tb->anchor_s)) >> 32);
+}
+
+uint64_t imu_timebase_to_host(const imu_timebase_t *tb, int64_t sensor_us) {
+    return (uint64_t)(sensor_us + offset_at(tb, sensor_us));
+}
+
+// Keep the minimum of the window and measure the drift across the history
+static void close_window(imu_timebase_t *tb, int64_t s, int64_t c) {
+    uint8_t oldest = tb->hist_len < IMU_TIMEBASE_HISTORY ? 0 : tb->hist_pos;
+    if (tb->hist_len > 0) {
+        int64_t ds = tb->win_min_s - tb->hist_s[oldest];
+        if (ds > IMU_TIMEBASE_WINDOW_US / 2) {
+            int64_t meas = ((tb->win_min_offset - tb->hist_offset[oldest]) * 4294967296LL) / ds;
+            const int64_t max = (int64_t)IMU_TIMEBASE_MAX_DRIFT_PPM * 4294967296LL / 1000000;
+            if (meas <= max && meas >= -max) {
+                // While the history fills up each baseline is longer than the previous one
+                tb->drift_q32 = tb->hist_len < IMU_TIMEBASE_HISTORY ? meas
+                              : tb->drift_q32 + ((meas - tb->drift_q32) >> DRIFT_SHIFT);
+            }
+        }
+    }
+    tb->hist_offset[tb->hist_pos] = tb->win_min_offset;
+    tb->hist_s[tb->hist_pos] = tb->win_min_s;
+    tb->hist_pos = (uint8_t)((tb->hist_pos + 1) % IMU_TIMEBASE_HISTORY);
+    if (tb->hist_len < IMU_TIMEBASE_HISTORY) tb->hist_len++;
+
+    // Lower envelope of the window minima with the new drift
+    int64_t env = INT64_MAX;
+    for (uint8_t i = 0; i < tb->hist_len; i++) {
+        int64_t o = tb->hist_offset[i] + ((tb->drift_q32 * (s - tb->hist_s[i])) >> 32);
+        if (o < env) env = o;
+    }
+    tb->anchor_offset = env;
+    tb->anchor_s = s;
+
+    tb->win_start_s = s;
+    tb->win_min_offset = c;
+    tb->win_min_s = s;
+    tb->win_batches = 0;
+}
+
+int imu_timebase_update(imu_timebase_t *tb, const uint16_t *tmst, size_t n,
+                        const icm42670_fifo_batch_info_t *info, uint64_t *time_us) {
+    if (n == 0) return 0;
+    const int64_t h = (int64_t)info->read_time_us;
+    int64_t s_last;
+
+    if (!tb->valid) {
+        // First batch: the sensor time starts at the timestamp of its last sample
+        s_last = tmst[n - 1];
+    } else if (!info->overflow) {
+        // Nothing lost: the batch continues where the previous one ended
+        int64_t s_first = tb->last_s + (uint16_t)(tmst[0] - tb->last_tmst);
+        s_last = s_first;
+        for (size_t i = 1; i < n; i++) s_last += (uint16_t)(tmst[i] - tmst[i - 1]);
+    } else {
+        // Samples lost: use the read time. The FIFO is full, so its last sample
+        // is at most one period old. Take the time with the same low 16 bits
+        // closest to half a period before the read.
+        int64_t pred = h - offset_at(tb, tb->last_s);
+        pred = h - offset_at(tb, pred) - tb->period_us / 2;
+        s_last = pred + (int16_t)(uint16_t)(tmst[n - 1] - (uint16_t)pred);
+    }
+
+    // The other samples go backwards through the timestamp differences
+    int64_t s = s_last;
+    if (time_us) time_us[n - 1] = (uint64_t)s;
+    for (size_t i = n - 1; i > 0; i--) {
+        s -= (uint16_t)(tmst[i] - tmst[i - 1]);
+        if (time_us) time_us[i - 1] = (uint64_t)s;
+    }
+    const int64_t s_first = s;
+
+    int lost = 0;
+    if (tb->valid) {
+        int64_t gap = s_first - tb->last_s;
+        if (gap > (int64_t)tb->period_us * 3 / 2) {
+            lost = (int)((gap + tb->period_us / 2) / tb->period_us) - 1;
+        }
+    }
+
+    // Upper bound of the offset: the last sample was taken before the read
+    const int64_t c = h - s_last;
+    if (!tb->valid) {
+        tb->anchor_offset = c;
+        tb->anchor_s = s_last;
+        tb->win_start_s = s_last;
+        tb->win_min_offset = c;
+        tb->win_min_s = s_last;
+        tb->valid = true;
+    } else {
+        if (c < tb->win_min_offset) {
+            tb->win_min_offset = c;
+            tb->win_min_s = s_last;
+        }
+        tb->win_batches++;
+        if (s_last - tb->win_start_s >= IMU_TIMEBASE_WINDOW_US &&
+            tb->win_batches >= IMU_TIMEBASE_WINDOW_BATCHES) {
+            close_window(tb, s_last, c);
+        }
+
+        // Follow the lowest bound: never place a sample after the moment it
+        // was read, and only creep up to cover drift estimate errors.
+        int64_t o = offset_at(tb, s_last);
+        int64_t creep = ((s_last - tb->anchor_s) * IMU_TIMEBASE_CREEP_PPM) / 1000000;
+        tb->anchor_offset = c < o + creep ? c : o + creep;
+        tb->anchor_s = s_last;
+    }
+    tb->last_s = s_last;
+    tb->last_tmst = tmst[n - 1];
+    tb->lost += (uint32_t)lost;
+
+    if (time_us) {
+        for (size_t i = 0; i < n; i++) {
+            time_us[i] = imu_timebase_to_host(tb, (int64_t)time_us[i]);
+        }
+    }
+    return lost;
+}
+
+int32_t imu_timebase_drift_ppm(const imu_timebase_t *tb) {
+    return (int32_t)((tb->drift_q32 * 1000000) >> 32);
+}
+
+uint32_t imu_timebase_period_ns(const imu_timebase_t *tb) {
+    int64_t ns = (int64_t)tb->period_us * 1000;
+    return (uint32_t)(ns + ((ns * tb->drift_q32) >> 32));
+}
@@ -30,25 +30,81 @@
 /* Includes ------------------------------------------------------------------*/
  
 #include "OpenPDMFilter.h"
+
+/* On the Pico the per-block filters run from RAM: no XIP cache misses while
+ * the microphone interrupt or the worker core decodes a block. */
+#if defined(PICO_ON_DEVICE) && PICO_ON_DEVICE
+#include "pico.h"
+#define FILTER_RAM_FUNC(f) __not_in_flash_func(f)
+#else
+#define FILTER_RAM_FUNC(f) f
+#endif
  
  
-/* Variables -----------------------------------------------------------------*/
- 
-uint32_t div_const = 0;
-int64_t sub_const = 0;
-uint32_t sinc[DECIMATION_MAX * SINCN];
-uint32_t sinc1[DECIMATION_MAX];
-uint32_t sinc2[DECIMATION_MAX * 2];
-uint32_t coef[SINCN][DECIMATION_MAX];
+/* Tables --------------------------------------------------------------------*/
+
+/* Coefficient k of the SINCN = 3 kernel of length 3 * D: a zero, the triple
+ * convolution of boxcars of length D, a zero. Closed form, a constant
+ * expression, so the tables below are computed by the compiler. */
+#define SINC3_T(n)       ((n) >= 2 ? (n) * ((n) - 1) / 2 : 0)
+#define SINC3_COEF(k, D) (((k) < 1 || (k) > 3 * (D) - 2) ? 0 :                 \
+                          SINC3_T((k) + 1) - 3 * SINC3_T((k) + 1 - (D)) +        \
+                          3 * SINC3_T((k) + 1 - 2 * (D)) - SINC3_T((k) + 1 - 3 * (D)))
+
+#ifdef USE_NIBBLE_LUT
+/* lut4_D[d][n][s]: contribution of value n of the d-th nibble of a block to
+ * sinc phase s (MSB first). Entries are at most 4 * 3/4 * D^2 < 65536.
+ * Shared read-only by all filter instances; const, so they stay in flash. */
+#define NIB_BIT(D, d, n, s, j) (((n) & (0x08 >> (j))) ? SINC3_COEF((s) * (D) + (d) * 4 + (j), D) : 0)
+#define NIB(D, d, n, s)  (NIB_BIT(D, d, n, s, 0) + NIB_BIT(D, d, n, s, 1) + \
+                          NIB_BIT(D, d, n, s, 2) + NIB_BIT(D, d, n, s, 3))
+#define NIB_S(D, d, n)   { NIB(D, d, n, 0), NIB(D, d, n, 1), NIB(D, d, n, 2) }
+#define NIB_N(D, d)      { NIB_S(D, d, 0),  NIB_S(D, d, 1),  NIB_S(D, d, 2),  NIB_S(D, d, 3),  \
+                           NIB_S(D, d, 4),  NIB_S(D, d, 5),  NIB_S(D, d, 6),  NIB_S(D, d, 7),  \
+                           NIB_S(D, d, 8),  NIB_S(D, d, 9),  NIB_S(D, d, 10), NIB_S(D, d, 11), \
+                           NIB_S(D, d, 12), NIB_S(D, d, 13), NIB_S(D, d, 14), NIB_S(D, d, 15) }
+#define NIB_D8(D, d)     NIB_N(D, d),     NIB_N(D, d + 1), NIB_N(D, d + 2), NIB_N(D, d + 3), \
+                         NIB_N(D, d + 4), NIB_N(D, d + 5), NIB_N(D, d + 6), NIB_N(D, d + 7)
+
+static const uint16_t lut4_64[64 / 4][16][SINCN] = {
+  NIB_D8(64, 0), NIB_D8(64, 8)
+};
+static const uint16_t lut4_128[128 / 4][16][SINCN] = {
+  NIB_D8(128, 0), NIB_D8(128, 8), NIB_D8(128, 16), NIB_D8(128, 24)
+};
+#endif
 #ifdef USE_LUT
-int32_t lut[256][DECIMATION_MAX / 8][SINCN];
+/* Built by Open_PDM_Filter_Init() for one decimation and shared by all
+ * instances: they must use the same decimation. */
+static int32_t lut[256][DECIMATION_MAX / 8][SINCN];
+static uint8_t lut_decimation = 0;
 #endif
  
  
 /* Functions -----------------------------------------------------------------*/
  
-#ifdef USE_LUT
-int32_t filter_table_mono_64(uint8_t *data, uint8_t sincn)
+#if defined(USE_NIBBLE_LUT)
+/* All three phases in one pass: two nibbles per input byte. */
+static inline void filter_nibble(uint8_t *data, const uint16_t *lut4, uint8_t channels, uint8_t decimation, TPDMFilter_Acc *Z0, TPDMFilter_Acc *Z1, TPDMFilter_Acc *Z2)
+{
+  int32_t z0 = 0, z1 = 0, z2 = 0;
+  uint8_t d;
+ 
+  for (d = 0; d < decimation / 4; d += 2) {
+    uint8_t c = *data;
+    const uint16_t *hi = &lut4[(d * 16 + (c >> 4)) * SINCN];
+    const uint16_t *lo = &lut4[((d + 1) * 16 + (c & 0x0F)) * SINCN];
+    z0 += hi[0] + lo[0];
+    z1 += hi[1] + lo[1];
+    z2 += hi[2] + lo[2];
+    data += channels;
+  }
+  *Z0 = z0;
+  *Z1 = z1;
+  *Z2 = z2;
+}
+#elif defined(USE_LUT)
+static int32_t filter_table_mono_64(uint8_t *data, uint8_t sincn)
 {
   return (int32_t)
     lut[data[0]][0][sincn] +
@@ -60,7 +116,7 @@ int32_t filter_table_mono_64(uint8_t *data, uint8_t sincn)
     lut[data[6]][6][sincn] +
     lut[data[7]][7][sincn];
 }
-int32_t filter_table_stereo_64(uint8_t *data, uint8_t sincn)
+static int32_t filter_table_stereo_64(uint8_t *data, uint8_t sincn)
 {
   return (int32_t)
     lut[data[0]][0][sincn] +
@@ -72,7 +128,7 @@ int32_t filter_table_stereo_64(uint8_t *data, uint8_t sincn)
     lut[data[12]][6][sincn] +
     lut[data[14]][7][sincn];
 }
-int32_t filter_table_mono_128(uint8_t *data, uint8_t sincn)
+static int32_t filter_table_mono_128(uint8_t *data, uint8_t sincn)
 {
   return (int32_t)
     lut[data[0]][0][sincn] +
@@ -92,7 +148,7 @@ int32_t filter_table_mono_128(uint8_t *data, uint8_t sincn)
     lut[data[14]][14][sincn] +
     lut[data[15]][15][sincn];
 }
-int32_t filter_table_stereo_128(uint8_t *data, uint8_t sincn)
+static int32_t filter_table_stereo_128(uint8_t *data, uint8_t sincn)
 {
   return (int32_t)
     lut[data[0]][0][sincn] +
@@ -112,59 +168,14 @@ int32_t filter_table_stereo_128(uint8_t *data, uint8_t sincn)
     lut[data[28]][14][sincn] +
     lut[data[30]][15][sincn];
 }
-int32_t (* filter_tables_64[2]) (uint8_t *data, uint8_t sincn) = {filter_table_mono_64, filter_table_stereo_64};
-int32_t (* filter_tables_128[2]) (uint8_t *data, uint8_t sincn) = {filter_table_mono_128, filter_table_stereo_128};
-#else
-int32_t filter_table(uint8_t *data, uint8_t sincn, TPDMFilter_InitStruct *param)
-{
-  uint8_t c, i;
-  uint16_t data_index = 0;
-  uint32_t *coef_p = &coef[sincn][0];
-  int32_t F = 0;
-  uint8_t decimation = param->Decimation;
-  uint8_t channels = param->In_MicChannels;
- 
-  for (i = 0; i < decimation; i += 8) {
-    c = data[data_index];
-    F += ((c >> 7)       ) * coef_p[i    ] +
-         ((c >> 6) & 0x01) * coef_p[i + 1] +
-         ((c >> 5) & 0x01) * coef_p[i + 2] +
-         ((c >> 4) & 0x01) * coef_p[i + 3] +
-         ((c >> 3) & 0x01) * coef_p[i + 4] +
-         ((c >> 2) & 0x01) * coef_p[i + 5] +
-         ((c >> 1) & 0x01) * coef_p[i + 6] +
-         ((c     ) & 0x01) * coef_p[i + 7];
-    data_index += channels;
-  }
-  return F;
-}
+static int32_t (* filter_tables_64[2]) (uint8_t *data, uint8_t sincn) = {filter_table_mono_64, filter_table_stereo_64};
+static int32_t (* filter_tables_128[2]) (uint8_t *data, uint8_t sincn) = {filter_table_mono_128, filter_table_stereo_128};
 #endif
  
-void convolve(uint32_t Signal[/* SignalLen */], unsigned short SignalLen,
-              uint32_t Kernel[/* KernelLen */], unsigned short KernelLen,
-              uint32_t Result[/* SignalLen + KernelLen - 1 */])
-{
-  uint16_t n;
- 
-  for (n = 0; n < SignalLen + KernelLen - 1; n++)
-  {
-    unsigned short kmin, kmax, k;
-    
-    Result[n] = 0;
-    
-    kmin = (n >= KernelLen - 1) ? n - (KernelLen - 1) : 0;
-    kmax = (n < SignalLen - 1) ? n : SignalLen - 1;
-    
-    for (k = kmin; k <= kmax; k++) {
-      Result[n] += Signal[k] * Kernel[n - k];
-    }
-  }
-}
- 
 void Open_PDM_Filter_Init(TPDMFilter_InitStruct *Param)
 {
-  uint16_t i, j;
-  int64_t sum = 0;
+  uint16_t i;
+  int64_t sum;
  
   uint8_t decimation = Param->Decimation;
  
@@ -172,57 +183,53 @@ void Open_PDM_Filter_Init(TPDMFilter_InitStruct *Param)
     Param->Coef[i] = 0;
     Param->bit[i] = 0;
   }
-  for (i = 0; i < decimation; i++) {
-    sinc1[i] = 1;
-  }
  
   Param->OldOut = Param->OldIn = Param->OldZ = 0;
   Param->LP_ALFA = (Param->LP_HZ != 0 ? (uint16_t) (Param->LP_HZ * 256 / (Param->LP_HZ + Param->Fs / (2 * 3.14159))) : 0);
   Param->HP_ALFA = (Param->HP_HZ != 0 ? (uint16_t) (Param->Fs * 256 / (2 * 3.14159 * Param->HP_HZ + Param->Fs)) : 0);
  
   Param->FilterLen = decimation * SINCN;       
-  sinc[0] = 0;
-  sinc[decimation * SINCN - 1] = 0;      
-  convolve(sinc1, decimation, sinc1, decimation, sinc2);
-  convolve(sinc2, decimation * 2 - 1, sinc1, decimation, &sinc[1]);     
-  for(j = 0; j < SINCN; j++) {
-    for (i = 0; i < decimation; i++) {
-      coef[j][i] = sinc[j * decimation + i];
-      sum += sinc[j * decimation + i];
-    }
-  }
- 
-  sub_const = sum >> 1;
-  div_const = sub_const * Param->MaxVolume / 32768 / FILTER_GAIN;
-  div_const = (div_const == 0 ? 1 : div_const);
- 
+
+  /* The kernel is three boxcars of length decimation convolved: it sums to
+   * decimation^3. */
+  sum = (int64_t)decimation * decimation * decimation;
+  Param->SubConst = sum >> 1;
+  Param->DivConst = Param->SubConst * Param->MaxVolume / 32768 / FILTER_GAIN;
+  Param->DivConst = (Param->DivConst == 0 ? 1 : Param->DivConst);
+ 
+#ifdef USE_NIBBLE_LUT
+  Param->Lut = (decimation == 128 ? &lut4_128[0][0][0] : &lut4_64[0][0][0]);
+#endif
 #ifdef USE_LUT
   /* Look-Up Table. */
-  uint16_t c, d, s;
-  for (s = 0; s < SINCN; s++)
-  {
-    uint32_t *coef_p = &coef[s][0];
-    for (c = 0; c < 256; c++)
-      for (d = 0; d < decimation / 8; d++)
-        lut[c][d][s] = ((c >> 7)       ) * coef_p[d * 8    ] +
-                       ((c >> 6) & 0x01) * coef_p[d * 8 + 1] +
-                       ((c >> 5) & 0x01) * coef_p[d * 8 + 2] +
-                       ((c >> 4) & 0x01) * coef_p[d * 8 + 3] +
-                       ((c >> 3) & 0x01) * coef_p[d * 8 + 4] +
-                       ((c >> 2) & 0x01) * coef_p[d * 8 + 5] +
-                       ((c >> 1) & 0x01) * coef_p[d * 8 + 6] +
-                       ((c     ) & 0x01) * coef_p[d * 8 + 7];
+  if (lut_decimation != decimation) {
+    uint16_t c, d, s, j;
+    for (s = 0; s < SINCN; s++)
+      for (c = 0; c < 256; c++)
+        for (d = 0; d < decimation / 8; d++) {
+          int32_t v = 0;
+          for (j = 0; j < 8; j++)
+            if (c & (0x80 >> j)) v += SINC3_COEF(s * decimation + d * 8 + j, decimation);
+          lut[c][d][s] = v;
+        }
+    lut_decimation = decimation;
   }
 #endif
 }
  
-void Open_PDM_Filter_64(uint8_t* data, uint16_t* dataOut, uint16_t volume, TPDMFilter_InitStruct *Param)
+void FILTER_RAM_FUNC(Open_PDM_Filter_64)(uint8_t* data, uint16_t* dataOut, uint16_t volume, TPDMFilter_InitStruct *Param)
 {
   uint8_t i, data_out_index;
   uint8_t channels = Param->In_MicChannels;
   uint8_t data_inc = ((DECIMATION_MAX >> 4) * channels);
-  int64_t Z, Z0, Z1, Z2;
-  int64_t OldOut, OldIn, OldZ;
+  TPDMFilter_Acc Z, Z0, Z1, Z2;
+  TPDMFilter_Acc OldOut, OldIn, OldZ;
+#ifdef OPENPDM_INT64
+  const TPDMFilter_Acc z_max = INT64_MAX;
+#else
+  /* Keeps OldZ * volume + DivConst / 2 in range (see OpenPDMFilter.h). */
+  const TPDMFilter_Acc z_max = volume ? (INT32_MAX - (TPDMFilter_Acc)Param->DivConst) / volume : INT32_MAX;
+#endif
  
   OldOut = Param->OldOut;
   OldIn = Param->OldIn;
@@ -233,17 +240,15 @@ void Open_PDM_Filter_64(uint8_t* data, uint16_t* dataOut, uint16_t volume, TPDMF
 #endif
  
   for (i = 0, data_out_index = 0; i < Param->Fs / 1000; i++, data_out_index += channels) {
-#ifdef USE_LUT
+#if defined(USE_NIBBLE_LUT)
+    filter_nibble(data, Param->Lut, channels, Param->Decimation, &Z0, &Z1, &Z2);
+#elif defined(USE_LUT)
     Z0 = filter_tables_64[j](data, 0);
     Z1 = filter_tables_64[j](data, 1);
     Z2 = filter_tables_64[j](data, 2);
-#else
-    Z0 = filter_table(data, 0, Param);
-    Z1 = filter_table(data, 1, Param);
-    Z2 = filter_table(data, 2, Param);
 #endif
  
-    Z = Param->Coef[1] + Z2 - sub_const;
+    Z = (TPDMFilter_Acc)Param->Coef[1] + Z2 - Param->SubConst;
     Param->Coef[1] = Param->Coef[0] + Z1;
     Param->Coef[0] = Z0;
  
@@ -251,8 +256,8 @@ void Open_PDM_Filter_64(uint8_t* data, uint16_t* dataOut, uint16_t volume, TPDMF
     OldIn = Z;
     OldZ = ((256 - Param->LP_ALFA) * OldZ + Param->LP_ALFA * OldOut) >> 8;
  
-    Z = OldZ * volume;
-    Z = RoundDiv(Z, div_const);
+    Z = SaturaLH(OldZ, -z_max, z_max) * volume;
+    Z = RoundDiv(Z, (TPDMFilter_Acc)Param->DivConst);
     Z = SaturaLH(Z, -32700, 32700);
  
     dataOut[data_out_index] = Z;
@@ -264,13 +269,19 @@ void Open_PDM_Filter_64(uint8_t* data, uint16_t* dataOut, uint16_t volume, TPDMF
   Param->OldZ = OldZ;
 }
  
-void Open_PDM_Filter_128(uint8_t* data, uint16_t* dataOut, uint16_t volume, TPDMFilter_InitStruct *Param)
+void FILTER_RAM_FUNC(Open_PDM_Filter_128)(uint8_t* data, uint16_t* dataOut, uint16_t volume, TPDMFilter_InitStruct *Param)
 {
   uint8_t i, data_out_index;
   uint8_t channels = Param->In_MicChannels;
   uint8_t data_inc = ((DECIMATION_MAX >> 3) * channels);
-  int64_t Z, Z0, Z1, Z2;
-  int64_t OldOut, OldIn, OldZ;
+  TPDMFilter_Acc Z, Z0, Z1, Z2;
+  TPDMFilter_Acc OldOut, OldIn, OldZ;
+#ifdef OPENPDM_INT64
+  const TPDMFilter_Acc z_max = INT64_MAX;
+#else
+  /* Keeps OldZ * volume + DivConst / 2 in range (see OpenPDMFilter.h). */
+  const TPDMFilter_Acc z_max = volume ? (INT32_MAX - (TPDMFilter_Acc)Param->DivConst) / volume : INT32_MAX;
+#endif
  
   OldOut = Param->OldOut;
   OldIn = Param->OldIn;
@@ -281,17 +292,15 @@ void Open_PDM_Filter_128(uint8_t* data, uint16_t* dataOut, uint16_t volume, TPDM
 #endif
  
   for (i = 0, data_out_index = 0; i < Param->Fs / 1000; i++, data_out_index += channels) {
-#ifdef USE_LUT
+#if defined(USE_NIBBLE_LUT)
+    filter_nibble(data, Param->Lut, channels, Param->Decimation, &Z0, &Z1, &Z2);
+#elif defined(USE_LUT)
     Z0 = filter_tables_128[j](data, 0);
     Z1 = filter_tables_128[j](data, 1);
     Z2 = filter_tables_128[j](data, 2);
-#else
-    Z0 = filter_table(data, 0, Param);
-    Z1 = filter_table(data, 1, Param);
-    Z2 = filter_table(data, 2, Param);
 #endif
  
-    Z = Param->Coef[1] + Z2 - sub_const;
+    Z = (TPDMFilter_Acc)Param->Coef[1] + Z2 - Param->SubConst;
     Param->Coef[1] = Param->Coef[0] + Z1;
     Param->Coef[0] = Z0;
  
@@ -299,8 +308,8 @@ void Open_PDM_Filter_128(uint8_t* data, uint16_t* dataOut, uint16_t volume, TPDM
     OldIn = Z;
     OldZ = ((256 - Param->LP_ALFA) * OldZ + Param->LP_ALFA * OldOut) >> 8;
  
-    Z = OldZ * volume;
-    Z = RoundDiv(Z, div_const);
+    Z = SaturaLH(OldZ, -z_max, z_max) * volume;
+    Z = RoundDiv(Z, (TPDMFilter_Acc)Param->DivConst);
     Z = SaturaLH(Z, -32700, 32700);
  
     dataOut[data_out_index] = Z;
@@ -48,9 +48,51 @@
  * Enable to use a Look-Up Table to improve performances while using more FLASH
  * and RAM memory.
  * Note: Without Look-Up Table up to stereo@16KHz configuration is supported.
+ *
+ * Two tables are available (selected at build time). Both are computed from
+ * the closed form of the sinc^3 coefficients and shared by all instances:
+ * - OPENPDM_BYTE_LUT defined: USE_LUT, one entry per input byte,
+ *   256 x DECIMATION_MAX/8 x SINCN x int32 = 48 KB of RAM, built by
+ *   Open_PDM_Filter_Init() for one decimation: all instances must use the
+ *   same decimation.
+ * - Otherwise: USE_NIBBLE_LUT, one entry per input nibble (4 bits),
+ *   const tables for decimation 64 and 128 (1.5 KB + 3 KB of flash, no RAM)
+ *   computed by the compiler. The output is the same bit for bit; the table
+ *   takes twice the lookups per sample, but the three sinc phases are summed
+ *   in one pass over the data.
+ *
+ * All other state is in TPDMFilter_InitStruct, so several instances can run
+ * at the same time (two rates, or stereo). Stereo: the input bytes of the two
+ * microphones are interleaved (L R L R ...); use one instance per channel with
+ * In_MicChannels = Out_MicChannels = 2, and pass data + 1 and data_out + 1 to
+ * the right channel instance. The output is interleaved the same way.
  */
+#ifdef OPENPDM_BYTE_LUT
 #define USE_LUT
+#else
+#define USE_NIBBLE_LUT
+#endif
  
+/*
+ * Integer width of the comb, high-pass and low-pass stages.
+ * By default they run on int32_t: Cortex-M0+ has no 64-bit multiply and
+ * int64_t division is a library call, while int32_t division uses the RP2040
+ * hardware divider. With SINCN = 3 the headroom is (D = Decimation <= 128):
+ * - comb output Z: the kernel sums to D^3, so |Z| <= D^3 / 2 = 2^20
+ * - high-pass OldOut = a * (Z - average of old Z): |OldOut| <= 2^21 (+256 for
+ *   the truncating shift), so HP_ALFA * (OldOut + Z - OldIn) < 2^8 * 2^22
+ * - low-pass OldZ is an average of OldOut: |OldZ| <= 2^21, product < 2^29
+ * - OldZ * volume is clamped per block to stay in range; any clamped value is
+ *   far beyond the +-32700 output saturation, so the result does not change.
+ * The output is the same bit for bit as with int64_t. Define OPENPDM_INT64 to
+ * get the original 64-bit stages back (for comparison).
+ */
+#ifdef OPENPDM_INT64
+typedef int64_t TPDMFilter_Acc;
+#else
+typedef int32_t TPDMFilter_Acc;
+#endif
+
 #define SINCN            3
 #define DECIMATION_MAX 128
 #ifdef PICO_BUILD
@@ -82,7 +124,10 @@ typedef struct {
   /* Private */
   uint32_t Coef[SINCN];
   uint16_t FilterLen;
-  int64_t OldOut, OldIn, OldZ;
+  TPDMFilter_Acc OldOut, OldIn, OldZ;
+  TPDMFilter_Acc SubConst;
+  uint32_t DivConst;
+  const uint16_t *Lut;
   uint16_t LP_ALFA;
   uint16_t HP_ALFA;
   uint16_t bit[5];
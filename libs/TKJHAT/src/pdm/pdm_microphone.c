@@ -13,6 +13,9 @@
 #include "hardware/clocks.h"
 #include "hardware/dma.h"
 #include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "pico/multicore.h"
+#include "pico/time.h"
 
 #include "OpenPDM2PCM/OpenPDMFilter.h"
 
@@ -20,74 +23,198 @@
 
 #include <tkjhat/pdm_microphone.h>
 
-#define PDM_DECIMATION       64
-#define PDM_RAW_BUFFER_COUNT 2
+// Raw PDM data is written by two chained DMA channels into a ring of
+// raw_buffer_count buffers:
+//   data channel:    PIO RX FIFO -> raw buffer, chains to the control channel
+//   control channel: next buffer address from raw_buffer_addr[] -> data channel
+//                    WRITE_ADDR_TRIG, which restarts the data channel at once
+// The control channel wraps around the address table (DMA read ring), so the
+// ring runs without the CPU. The interrupt only counts finished buffers and
+// calls the user handler; a late interrupt does not lose data.
+//
+// Sequence numbers count buffers since start. Buffer seq is in slot
+// seq % raw_buffer_count. write_seq is the buffer the DMA is writing now and
+// is only changed by the interrupt; read_seq is the next buffer to convert and
+// is only changed by the reader.
+//
+// Optionally (pdm_microphone_pcm_queue_init()) a worker, normally on core 1,
+// is the only reader of the raw ring: it runs the PDM filter and pushes PCM
+// frames into a single-producer / single-consumer queue. pcm_head is only
+// changed by the worker and pcm_tail only by the consumer, so the queue needs
+// no lock, only memory barriers between the data and the index updates.
+//
+// Stopping: running is cleared first, then stop() and deinit() wait until
+// the converting context (worker_busy, or reader_busy for
+// pdm_microphone_read() without a queue) has left pdm_convert_raw(), so a
+// conversion can not store read_seq after the indices are reset. Only one
+// worker may exist (pdm_microphone_claim_worker()), as one flag can not
+// track two of them.
+
+// Address table for the control channel. Aligned to its largest size, as the
+// DMA read ring needs a naturally aligned table.
+static uint8_t* raw_buffer_addr[PDM_RAW_BUFFER_COUNT_MAX]
+    __attribute__((aligned(PDM_RAW_BUFFER_COUNT_MAX * sizeof(uint8_t*))));
+
+typedef void (*pdm_filter_fn)(uint8_t* data, uint16_t* data_out, uint16_t volume,
+                              TPDMFilter_InitStruct* param);
 
 static struct {
     struct pdm_microphone_config config;
+    bool initialized;
+    int pio_program_offset;
     int dma_channel;
-    uint8_t* raw_buffer[PDM_RAW_BUFFER_COUNT];
-    volatile int raw_buffer_write_index;
-    volatile int raw_buffer_read_index;
+    int dma_ctrl_channel;
+    dma_channel_config dma_channel_cfg;
+    uint8_t* raw_buffer[PDM_RAW_BUFFER_COUNT_MAX];
+    uint raw_buffer_count;
     uint raw_buffer_size;
+    volatile uint32_t write_seq;
+    volatile uint32_t read_seq;
+    uint32_t buffers_base;      // write_seq at the last reset of the stats
+    uint32_t overruns;
+    uint32_t underruns;
+    uint16_t max_fill;
     uint dma_irq;
     TPDMFilter_InitStruct filter;
+    pdm_filter_fn filter_fn;
     uint16_t filter_volume;
+    agc_t agc;
+    bool agc_on;
     pdm_samples_ready_handler_t samples_ready_handler;
     volatile bool stopping; 
+    volatile bool running;
+    int16_t* pcm_frames;
+    uint pcm_frame_count;
+    volatile uint32_t pcm_head;
+    volatile uint32_t pcm_tail;
+    uint32_t pcm_dropped;
+    volatile bool worker_busy;
+    volatile bool reader_busy;
 } pdm_mic;
 
+static bool core1_worker_launched;
+static bool worker_claimed;
+
 
 
 static void pdm_dma_handler();
 
+// Wait until no conversion runs; running must already be false. sleep_ms()
+// blocks the calling task under FreeRTOS, so a worker task on the same core,
+// preempted by a higher priority caller, can run and finish.
+static void pdm_wait_converters() {
+    __dmb();
+    while (pdm_mic.worker_busy || pdm_mic.reader_busy) {
+        sleep_ms(1);
+    }
+}
+
+static bool is_power_of_two(uint x) {
+    return x != 0 && (x & (x - 1)) == 0;
+}
+
+static uint log2_uint(uint x) {
+    uint n = 0;
+    while (x > 1) {
+        x >>= 1;
+        n++;
+    }
+    return n;
+}
+
 int pdm_microphone_init(const struct pdm_microphone_config* config) {
+    pdm_samples_ready_handler_t handler = pdm_mic.samples_ready_handler;
+    if (pdm_mic.initialized) {
+        pdm_microphone_deinit();
+    }
+
     memset(&pdm_mic, 0x00, sizeof(pdm_mic));
     memcpy(&pdm_mic.config, config, sizeof(pdm_mic.config));
 
+    pdm_mic.initialized = true;
+    pdm_mic.samples_ready_handler = handler;
     pdm_mic.stopping = false;
+    pdm_mic.pio_program_offset = -1;
+    pdm_mic.dma_channel = -1;
+    pdm_mic.dma_ctrl_channel = -1;
+
+    uint decimation = config->decimation ? config->decimation : PDM_DECIMATION_DEFAULT;
+    if (decimation == 64) {
+        pdm_mic.filter_fn = Open_PDM_Filter_64;
+    } else if (decimation == 128) {
+        pdm_mic.filter_fn = Open_PDM_Filter_128;
+    } else {
+        pdm_microphone_deinit();
+        return -1;
+    }
+    pdm_mic.config.decimation = decimation;
 
-    if (config->sample_buffer_size % (config->sample_rate / 1000)) {
+    // The filter makes sample_rate / 1000 samples per call (Fs is 16 bits)
+    if (config->sample_rate < 1000 || config->sample_rate % 1000 || config->sample_rate > 64000 ||
+        config->sample_rate * decimation > PDM_CLOCK_MAX_HZ ||
+        config->sample_buffer_size == 0 ||
+        config->sample_buffer_size % (config->sample_rate / 1000)) {
+        pdm_microphone_deinit();
         return -1;
     }
 
-    pdm_mic.raw_buffer_size = config->sample_buffer_size * (PDM_DECIMATION / 8);
+    pdm_mic.raw_buffer_count = config->raw_buffer_count ? config->raw_buffer_count
+                                                        : PDM_RAW_BUFFER_COUNT_DEFAULT;
+    // Power of two: the control channel wraps around the table with a DMA ring
+    if (!is_power_of_two(pdm_mic.raw_buffer_count) || pdm_mic.raw_buffer_count < 2 ||
+        pdm_mic.raw_buffer_count > PDM_RAW_BUFFER_COUNT_MAX) {
+        pdm_microphone_deinit();
+        return -1;
+    }
+
+    pdm_mic.raw_buffer_size = config->sample_buffer_size * (decimation / 8);
 
-    for (int i = 0; i < PDM_RAW_BUFFER_COUNT; i++) {
+    for (uint i = 0; i < pdm_mic.raw_buffer_count; i++) {
         pdm_mic.raw_buffer[i] = malloc(pdm_mic.raw_buffer_size);
         if (pdm_mic.raw_buffer[i] == NULL) {
             pdm_microphone_deinit();
 
             return -1;   
         }
+        raw_buffer_addr[i] = pdm_mic.raw_buffer[i];
     }
 
-    pdm_mic.dma_channel = dma_claim_unused_channel(true);
-    if (pdm_mic.dma_channel < 0) {
+    pdm_mic.dma_channel = dma_claim_unused_channel(false);
+    pdm_mic.dma_ctrl_channel = dma_claim_unused_channel(false);
+    if (pdm_mic.dma_channel < 0 || pdm_mic.dma_ctrl_channel < 0) {
         pdm_microphone_deinit();
 
         return -1;
     }
 
-    uint pio_sm_offset = pio_add_program(config->pio, &pdm_microphone_data_program);
+    if (!pio_can_add_program(config->pio, &pdm_microphone_data_program)) {
+        pdm_microphone_deinit();
 
-    float clk_div = clock_get_hz(clk_sys) / (config->sample_rate * PDM_DECIMATION * 4.0);
+        return -1;
+    }
+    pdm_mic.pio_program_offset = pio_add_program(config->pio, &pdm_microphone_data_program);
+
+    // The PIO program takes 4 cycles per PDM bit
+    float clk_div = clock_get_hz(clk_sys) / (config->sample_rate * decimation * 4.0);
 
     pdm_microphone_data_init(
         config->pio,
         config->pio_sm,
-        pio_sm_offset,
+        pdm_mic.pio_program_offset,
         clk_div,
         config->gpio_data,
         config->gpio_clk
     );
 
+    // Data channel: PIO -> raw buffer, then the control channel picks the next buffer
     dma_channel_config dma_channel_cfg = dma_channel_get_default_config(pdm_mic.dma_channel);
 
     channel_config_set_transfer_data_size(&dma_channel_cfg, DMA_SIZE_8);
     channel_config_set_read_increment(&dma_channel_cfg, false);
     channel_config_set_write_increment(&dma_channel_cfg, true);
     channel_config_set_dreq(&dma_channel_cfg, pio_get_dreq(config->pio, config->pio_sm, false));
+    channel_config_set_chain_to(&dma_channel_cfg, pdm_mic.dma_ctrl_channel);
+    pdm_mic.dma_channel_cfg = dma_channel_cfg;
 
     pdm_mic.dma_irq = DMA_IRQ_0;
 
@@ -105,7 +232,7 @@ int pdm_microphone_init(const struct pdm_microphone_config* config) {
     pdm_mic.filter.HP_HZ = 10; 
     pdm_mic.filter.In_MicChannels = 1;
     pdm_mic.filter.Out_MicChannels = 1;
-    pdm_mic.filter.Decimation = PDM_DECIMATION;
+    pdm_mic.filter.Decimation = decimation;
     pdm_mic.filter.MaxVolume = 64;
     pdm_mic.filter.Gain = 16;
 
@@ -114,12 +241,32 @@ int pdm_microphone_init(const struct pdm_microphone_config* config) {
 }
 
 void pdm_microphone_deinit() {
-    for (int i = 0; i < PDM_RAW_BUFFER_COUNT; i++) {
+    if (!pdm_mic.initialized) {
+        return;
+    }
+
+    if (pdm_mic.running) {
+        pdm_microphone_stop();
+    }
+
+    // A worker may be converting a buffer: wait until it has seen
+    // running == false before the buffers are freed
+    pdm_wait_converters();
+
+    for (int i = 0; i < PDM_RAW_BUFFER_COUNT_MAX; i++) {
         if (pdm_mic.raw_buffer[i]) {
             free(pdm_mic.raw_buffer[i]);
 
             pdm_mic.raw_buffer[i] = NULL;
         }
+        raw_buffer_addr[i] = NULL;
+    }
+
+    if (pdm_mic.pcm_frames) {
+        free(pdm_mic.pcm_frames);
+
+        pdm_mic.pcm_frames = NULL;
+        pdm_mic.pcm_frame_count = 0;
     }
 
     if (pdm_mic.dma_channel > -1) {
@@ -127,9 +274,28 @@ void pdm_microphone_deinit() {
 
         pdm_mic.dma_channel = -1;
     }
+
+    if (pdm_mic.dma_ctrl_channel > -1) {
+        dma_channel_unclaim(pdm_mic.dma_ctrl_channel);
+
+        pdm_mic.dma_ctrl_channel = -1;
+    }
+
+    if (pdm_mic.pio_program_offset > -1) {
+        pio_sm_set_enabled(pdm_mic.config.pio, pdm_mic.config.pio_sm, false);
+        pio_remove_program(pdm_mic.config.pio, &pdm_microphone_data_program, pdm_mic.pio_program_offset);
+
+        pdm_mic.pio_program_offset = -1;
+    }
+
+    pdm_mic.initialized = false;
 }
 
 int pdm_microphone_start() {
+    if (!pdm_mic.initialized) {
+        return -1;
+    }
+
     pdm_mic.stopping = false;
 
     // Reset SM cleanly before enabling
@@ -152,23 +318,49 @@ int pdm_microphone_start() {
 
     Open_PDM_Filter_Init(&pdm_mic.filter);
 
-    // Enable SM and start the first DMA transfer
-    pio_sm_set_enabled(pdm_mic.config.pio, pdm_mic.config.pio_sm, true);
-
-    pdm_mic.raw_buffer_write_index = 0;
-    pdm_mic.raw_buffer_read_index  = 0;
+    pdm_mic.write_seq = 0;
+    pdm_mic.read_seq  = 0;
+    pdm_mic.buffers_base = 0;
+    pdm_mic.pcm_head  = 0;
+    pdm_mic.pcm_tail  = 0;
+
+    // Control channel: one 32-bit address per trigger, from the table (wrapping)
+    // into the data channel's WRITE_ADDR_TRIG alias
+    dma_channel_config ctrl_cfg = dma_channel_get_default_config(pdm_mic.dma_ctrl_channel);
+    channel_config_set_transfer_data_size(&ctrl_cfg, DMA_SIZE_32);
+    channel_config_set_read_increment(&ctrl_cfg, true);
+    channel_config_set_write_increment(&ctrl_cfg, false);
+    channel_config_set_ring(&ctrl_cfg, false, log2_uint(pdm_mic.raw_buffer_count * sizeof(uint8_t*)));
+    dma_channel_configure(
+        pdm_mic.dma_ctrl_channel,
+        &ctrl_cfg,
+        &dma_channel_hw_addr(pdm_mic.dma_channel)->al2_write_addr_trig,
+        &raw_buffer_addr[1],
+        1,
+        false
+    );
 
-    dma_channel_transfer_to_buffer_now(
+    // Data channel (re-applied: stop() breaks the chain)
+    dma_channel_configure(
         pdm_mic.dma_channel,
+        &pdm_mic.dma_channel_cfg,
         pdm_mic.raw_buffer[0],
-        pdm_mic.raw_buffer_size
+        &pdm_mic.config.pio->rxf[pdm_mic.config.pio_sm],
+        pdm_mic.raw_buffer_size,
+        false
     );
 
+    // Enable SM and start the first DMA transfer
+    pio_sm_set_enabled(pdm_mic.config.pio, pdm_mic.config.pio_sm, true);
+    dma_channel_start(pdm_mic.dma_channel);
+    pdm_mic.running = true;
+
     return 0;
 }
 
 void pdm_microphone_stop() {
     pdm_mic.stopping = true;                 // 1) tell ISR to no-op
+    pdm_mic.running = false;
     //pdm_mic.samples_ready_handler = NULL;    //    avoid user callbacks during teardown
 
     irq_set_enabled(pdm_mic.dma_irq, false); // 2) block IRQ line globally
@@ -182,38 +374,66 @@ void pdm_microphone_stop() {
         dma_hw->ints1 = (1u << pdm_mic.dma_channel);
     }
 
-    dma_channel_abort(pdm_mic.dma_channel);  // 4) now it's safe to abort DMA
+    // 4) break the chain (data channel chains to itself = no chaining), so
+    //    aborting one channel can not restart the other, then abort both
+    dma_channel_config cfg = pdm_mic.dma_channel_cfg;
+    channel_config_set_chain_to(&cfg, pdm_mic.dma_channel);
+    dma_channel_set_config(pdm_mic.dma_channel, &cfg, false);
+    dma_channel_abort(pdm_mic.dma_ctrl_channel);
+    dma_channel_abort(pdm_mic.dma_channel);
 
     // 5) stop the PIO state machine
     pio_sm_set_enabled(pdm_mic.config.pio, pdm_mic.config.pio_sm, false);
 
-    // 6) reset indices
-    pdm_mic.raw_buffer_write_index = 0;
-    pdm_mic.raw_buffer_read_index  = 0;
+    // 6) wait for a conversion in progress, then reset indices
+    pdm_wait_converters();
+    pdm_mic.write_seq = 0;
+    pdm_mic.read_seq  = 0;
+    pdm_mic.buffers_base = 0;
 
     // leave stopping=true; start() will clear it
 }
 
+// Slot the data channel is writing now. The control channel has already read
+// the address of that slot, so its read pointer is one entry further.
+static uint pdm_dma_write_slot() {
+    uint32_t next = (uint32_t)dma_channel_hw_addr(pdm_mic.dma_ctrl_channel)->read_addr;
+    uint entry = (next - (uint32_t)(uintptr_t)raw_buffer_addr) / sizeof(uint8_t*);
+    return (entry + pdm_mic.raw_buffer_count - 1) & (pdm_mic.raw_buffer_count - 1);
+}
+
+// Sequence number of the buffer the DMA is writing now, read from the hardware
+// (write_seq can be behind by the interrupt latency)
+static uint32_t pdm_dma_write_seq() {
+    const uint mask = pdm_mic.raw_buffer_count - 1;
+    return pdm_mic.write_seq + ((pdm_dma_write_slot() - pdm_mic.write_seq) & mask);
+}
+
 static void pdm_dma_handler() {
     // clear IRQ first
     if (pdm_mic.dma_irq == DMA_IRQ_0) dma_hw->ints0 = (1u << pdm_mic.dma_channel);
     else                              dma_hw->ints1 = (1u << pdm_mic.dma_channel);
 
-    if (pdm_mic.stopping) return;  // don't re-arm or callback while stopping
+    if (pdm_mic.stopping) return;  // don't callback while stopping
 
-    // normal handler body
-    pdm_mic.raw_buffer_read_index  = pdm_mic.raw_buffer_write_index;
-    pdm_mic.raw_buffer_write_index = (pdm_mic.raw_buffer_write_index + 1) % PDM_RAW_BUFFER_COUNT;
+    // Count every buffer finished since the last interrupt (more than one if
+    // this interrupt was late), from the position of the DMA in the ring
+    const uint mask = pdm_mic.raw_buffer_count - 1;
+    uint32_t now = pdm_dma_write_seq();
 
-    dma_channel_transfer_to_buffer_now(
-        pdm_mic.dma_channel,
-        pdm_mic.raw_buffer[pdm_mic.raw_buffer_write_index],
-        pdm_mic.raw_buffer_size
-    );
+    while (pdm_mic.write_seq != now) {
+        pdm_mic.write_seq++;
 
-    if (pdm_mic.samples_ready_handler) pdm_mic.samples_ready_handler();
-}
+        uint32_t fill = pdm_mic.write_seq - pdm_mic.read_seq;
+        if (fill > mask) fill = mask;
+        if (fill > pdm_mic.max_fill) pdm_mic.max_fill = (uint16_t)fill;
+
+        if (pdm_mic.samples_ready_handler) pdm_mic.samples_ready_handler();
+    }
 
+    // Wake the worker if it waits in WFE on the other core
+    __sev();
+}
 
 void pdm_microphone_set_samples_ready_handler(pdm_samples_ready_handler_t handler) {
     pdm_mic.samples_ready_handler = handler;
@@ -231,7 +451,54 @@ void pdm_microphone_set_filter_volume(uint16_t volume) {
     pdm_mic.filter_volume = volume;
 }
 
-int pdm_microphone_read(int16_t* buffer, size_t samples) {
+int pdm_microphone_set_agc(const struct agc_config* config) {
+    if (pdm_mic.running) {
+        return -1;
+    }
+    if (config == NULL) {
+        pdm_mic.agc_on = false;
+        return 0;
+    }
+    if (agc_init(&pdm_mic.agc, config) != 0) {
+        pdm_mic.agc_on = false;
+        return -1;
+    }
+    pdm_mic.agc_on = true;
+    return 0;
+}
+
+const agc_t* pdm_microphone_get_agc() {
+    return pdm_mic.agc_on ? &pdm_mic.agc : NULL;
+}
+
+uint pdm_microphone_available() {
+    if (!pdm_mic.running) return 0;
+    if (pdm_mic.pcm_frames) return pdm_mic.pcm_head - pdm_mic.pcm_tail;
+    uint32_t fill = pdm_dma_write_seq() - pdm_mic.read_seq;
+    return fill > pdm_mic.raw_buffer_count - 1 ? pdm_mic.raw_buffer_count - 1 : fill;
+}
+
+void pdm_microphone_get_stats(struct pdm_microphone_stats* stats) {
+    stats->buffers = pdm_mic.write_seq - pdm_mic.buffers_base;
+    stats->overruns = pdm_mic.overruns;
+    stats->underruns = pdm_mic.underruns;
+    stats->fill = (uint16_t)pdm_microphone_available();
+    stats->max_fill = pdm_mic.max_fill;
+    stats->capacity = (uint16_t)(pdm_mic.raw_buffer_count - 1);
+    stats->pcm_dropped = pdm_mic.pcm_dropped;
+}
+
+void pdm_microphone_reset_stats() {
+    pdm_mic.buffers_base = pdm_mic.write_seq;
+    pdm_mic.overruns = 0;
+    pdm_mic.underruns = 0;
+    pdm_mic.max_fill = 0;
+    pdm_mic.pcm_dropped = 0;
+}
+
+// Convert the oldest raw buffer. Only one context may call it: the worker if
+// there is a PCM queue, otherwise the user through pdm_microphone_read().
+static int pdm_convert_raw(int16_t* buffer, size_t samples) {
     int filter_stride = (pdm_mic.filter.Fs / 1000);
     samples = (samples / filter_stride) * filter_stride;
 
@@ -239,27 +506,166 @@ int pdm_microphone_read(int16_t* buffer, size_t samples) {
         samples = pdm_mic.config.sample_buffer_size;
     }
 
-    if (pdm_mic.raw_buffer_write_index == pdm_mic.raw_buffer_read_index) {
+    if (!pdm_mic.running) {
         return 0;
     }
 
-    uint8_t* in = pdm_mic.raw_buffer[pdm_mic.raw_buffer_read_index];
-    int16_t* out = buffer;
+    uint32_t seq = pdm_mic.read_seq;
+    uint32_t fill = pdm_dma_write_seq() - seq;
 
-    pdm_mic.raw_buffer_read_index++;
+    if (fill == 0) {
+        return 0;
+    }
+
+    // The DMA has come round to the oldest buffers: they are lost, skip them
+    const uint32_t max_fill = pdm_mic.raw_buffer_count - 1;
+    if (fill > max_fill) {
+        pdm_mic.overruns += fill - max_fill;
+        seq += fill - max_fill;
+    }
+
+    uint8_t* in = pdm_mic.raw_buffer[seq & (pdm_mic.raw_buffer_count - 1)];
+    int16_t* out = buffer;
+    const uint in_stride = filter_stride * (pdm_mic.filter.Decimation / 8);
 
     for (int i = 0; i < samples; i += filter_stride) {
-#if PDM_DECIMATION == 64
-        Open_PDM_Filter_64(in, out, pdm_mic.filter_volume, &pdm_mic.filter);
-#elif PDM_DECIMATION == 128
-        Open_PDM_Filter_128(in, out, pdm_mic.filter_volume, &pdm_mic.filter);
-#else
-        #error "Unsupported PDM_DECIMATION value!"
-#endif
-
-        in += filter_stride * (PDM_DECIMATION / 8);
+        pdm_mic.filter_fn(in, (uint16_t*)out, pdm_mic.filter_volume, &pdm_mic.filter);
+
+        in += in_stride;
         out += filter_stride;
     }
 
+    // Overwritten while it was converted: the samples are not valid either
+    if (pdm_dma_write_seq() - seq > max_fill) {
+        pdm_mic.overruns++;
+    }
+
+    // Only now the buffer is released: it is counted in the fill level while converting
+    __compiler_memory_barrier();
+    pdm_mic.read_seq = seq + 1;
+
+    if (pdm_mic.agc_on) {
+        agc_process(&pdm_mic.agc, buffer, samples);
+    }
+
+    return samples;
+}
+
+int pdm_microphone_pcm_queue_init(uint frame_count) {
+    if (!is_power_of_two(frame_count) || pdm_mic.running || pdm_mic.pcm_frames ||
+        pdm_mic.raw_buffer_size == 0) {
+        return -1;
+    }
+
+    pdm_mic.pcm_frames = malloc(frame_count * pdm_mic.config.sample_buffer_size * sizeof(int16_t));
+    if (pdm_mic.pcm_frames == NULL) {
+        return -1;
+    }
+
+    pdm_mic.pcm_frame_count = frame_count;
+    pdm_mic.pcm_head = 0;
+    pdm_mic.pcm_tail = 0;
+    return 0;
+}
+
+uint pdm_microphone_worker_process() {
+    uint frames = 0;
+
+    // Busy before anything is checked: pdm_microphone_stop() clears running
+    // and then waits for busy to drop
+    pdm_mic.worker_busy = true;
+    __dmb();
+
+    while (pdm_mic.running && pdm_mic.pcm_frames) {
+        const uint32_t head = pdm_mic.pcm_head;
+
+        // Queue full: the raw buffer is still consumed, or the DMA ring would
+        // overrun too, but its samples are dropped
+        if (head - pdm_mic.pcm_tail >= pdm_mic.pcm_frame_count) {
+            if (pdm_dma_write_seq() == pdm_mic.read_seq) break;
+            pdm_mic.read_seq++;
+            pdm_mic.pcm_dropped++;
+            continue;
+        }
+
+        int16_t* frame = &pdm_mic.pcm_frames[(head & (pdm_mic.pcm_frame_count - 1)) *
+                                             pdm_mic.config.sample_buffer_size];
+        if (pdm_convert_raw(frame, pdm_mic.config.sample_buffer_size) == 0) break;
+
+        // Frame data before the index that publishes it
+        __dmb();
+        pdm_mic.pcm_head = head + 1;
+        frames++;
+    }
+
+    __dmb();
+    pdm_mic.worker_busy = false;
+
+    return frames;
+}
+
+static void pdm_core1_worker() {
+    while (true) {
+        // The DMA interrupt sends an event (SEV) after every buffer
+        if (pdm_microphone_worker_process() == 0) __wfe();
+    }
+}
+
+int pdm_microphone_claim_worker() {
+    uint32_t irq = save_and_disable_interrupts();
+    bool claimed = worker_claimed;
+    worker_claimed = true;
+    restore_interrupts(irq);
+    return claimed ? -1 : 0;
+}
+
+void pdm_microphone_release_worker() {
+    worker_claimed = false;
+}
+
+int pdm_microphone_launch_core1_worker() {
+    // Once only: the worker keeps running when the format is changed
+    if (core1_worker_launched) {
+        return 0;
+    }
+    if (pdm_microphone_claim_worker() != 0) {
+        return -1;
+    }
+    core1_worker_launched = true;
+    multicore_launch_core1(pdm_core1_worker);
+    return 0;
+}
+
+int pdm_microphone_read(int16_t* buffer, size_t samples) {
+    if (!pdm_mic.pcm_frames) {
+        // Busy before running is checked, as in the worker
+        pdm_mic.reader_busy = true;
+        __dmb();
+        int n = pdm_convert_raw(buffer, samples);
+        __dmb();
+        pdm_mic.reader_busy = false;
+        if (n == 0 && pdm_mic.running) pdm_mic.underruns++;
+        return n;
+    }
+
+    const uint32_t tail = pdm_mic.pcm_tail;
+    if (!pdm_mic.running || pdm_mic.pcm_head == tail) {
+        pdm_mic.underruns++;
+        return 0;
+    }
+
+    // Index before the frame data it publishes
+    __dmb();
+    if (samples > pdm_mic.config.sample_buffer_size) {
+        samples = pdm_mic.config.sample_buffer_size;
+    }
+    memcpy(buffer,
+           &pdm_mic.pcm_frames[(tail & (pdm_mic.pcm_frame_count - 1)) * pdm_mic.config.sample_buffer_size],
+           samples * sizeof(int16_t));
+
+    // Frame copied before the slot is given back to the worker
+    __dmb();
+    pdm_mic.pcm_tail = tail + 1;
+
     return samples;
 }
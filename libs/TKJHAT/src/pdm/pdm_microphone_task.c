@@ -0,0 +1,113 @@
+/*
+Version 0.83
+
+MIT License
+
+Copyright (c) 2025 Raisul Islam, Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "hardware/timer.h"
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include <tkjhat/pdm_microphone_task.h>
+
+static struct {
+    struct pdm_microphone_task_config config;
+    TaskHandle_t task;
+    int16_t* frame;
+    volatile uint32_t busy_us;
+    volatile uint32_t frames;
+} mic_task;
+
+// DMA interrupt, once per finished buffer: only wake the task
+static void pdm_task_notify() {
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(mic_task.task, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+static void pdm_task_fn(void* arg) {
+    (void)arg;
+    const struct pdm_microphone_task_config* cfg = &mic_task.config;
+    const TickType_t wait = cfg->poll_ms ? pdMS_TO_TICKS(cfg->poll_ms) : portMAX_DELAY;
+
+    while (true) {
+        if (ulTaskNotifyTake(pdTRUE, wait) == 0) {
+            cfg->handler(mic_task.frame, 0, cfg->arg);
+            continue;
+        }
+        uint64_t start = time_us_64();
+
+        // Filter every waiting buffer (into the PCM queue, if there is one)
+        // before the frames are handed out
+        pdm_microphone_worker_process();
+        while (pdm_microphone_available()) {
+            int n = pdm_microphone_read(mic_task.frame, cfg->frame_samples);
+            if (n <= 0) break;
+            cfg->handler(mic_task.frame, (size_t)n, cfg->arg);
+            mic_task.frames++;
+        }
+        mic_task.busy_us += (uint32_t)(time_us_64() - start);
+    }
+}
+
+int pdm_microphone_task_create(const struct pdm_microphone_task_config* config) {
+    if (mic_task.task != NULL || config->handler == NULL || config->frame_samples == 0) {
+        return -1;
+    }
+    // The task is the worker: not together with the core 1 worker
+    if (pdm_microphone_claim_worker() != 0) {
+        return -1;
+    }
+
+    mic_task.config = *config;
+    mic_task.frame = pvPortMalloc(config->frame_samples * sizeof(int16_t));
+    if (mic_task.frame == NULL) {
+        pdm_microphone_release_worker();
+        return -1;
+    }
+    if (xTaskCreate(pdm_task_fn, "pdm_mic", config->stack_words, NULL, config->priority,
+                    &mic_task.task) != pdPASS) {
+        vPortFree(mic_task.frame);
+        mic_task.frame = NULL;
+        mic_task.task = NULL;
+        pdm_microphone_release_worker();
+        return -1;
+    }
+#if (configNUMBER_OF_CORES > 1)
+    if (config->core_mask != 0) {
+        vTaskCoreAffinitySet(mic_task.task, config->core_mask);
+    }
+#endif
+
+    pdm_microphone_set_samples_ready_handler(pdm_task_notify);
+    return 0;
+}
+
+void pdm_microphone_task_stats(uint32_t* busy_us, uint32_t* frames) {
+    // The task may add to the sums in between: a report is off by one frame at most
+    if (busy_us) *busy_us = mic_task.busy_us;
+    if (frames) *frames = mic_task.frames;
+    mic_task.busy_us = 0;
+    mic_task.frames = 0;
+}
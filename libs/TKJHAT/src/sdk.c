@@ -30,6 +30,10 @@ SOFTWARE.
 //#include "tusb.h" //is it needed?
 #include "hardware/irq.h"
 #include "hardware/pwm.h"
+#include "hardware/clocks.h"
+#include "pico/time.h"
+#include "pico/sync.h"
+#include "pico/util/queue.h"
 #include <tkjhat/ssd1306.h>
 #include <tkjhat/pdm_microphone.h>
 #include <stdio.h>
@@ -214,33 +218,154 @@ void stop_rgb_led(){
  *  BUZZER
  * ========================= */
 
+ // The buzzer is driven by a PWM slice: a square wave (50 % duty) at the
+ // tone frequency, the CPU is free while it plays. An alarm stops the tone
+ // of buzzer_play_tone_async().
+ //
+ // The alarm interrupt and the tasks (on either core) change the buzzer
+ // under buzzer_lock. Every change of the tone gets a new generation, passed
+ // to the alarm: an alarm of an older tone, also one already running when
+ // the tone is changed, does not stop the new one.
+static uint buzzer_slice;
+static uint buzzer_channel;
+static critical_section_t buzzer_lock;
+static uint32_t buzzer_generation = 0;
+static alarm_id_t buzzer_alarm = 0;
+static volatile bool buzzer_playing = false;
+
+// buzzer_lock gets a spin lock of its own: a shared striped one could be
+// the one of a lock held by the caller, and nesting it would hang
+static void buzzer_lock_init(void) {
+    if (!critical_section_is_initialized(&buzzer_lock))
+        critical_section_init_with_lock_num(&buzzer_lock, (uint)spin_lock_claim_unused(true));
+}
+
+// Divider (8.4 fixed point) and wrap for the frequency: the smallest
+// divider that keeps the wrap in 16 bits gives the most exact frequency.
+static void buzzer_start_locked(uint32_t frequency) {
+    const uint32_t clk = clock_get_hz(clk_sys);
+    uint32_t div16 = (uint32_t)(((uint64_t)clk * 16 + (uint64_t)frequency * 65536 - 1) /
+                                ((uint64_t)frequency * 65536));
+    if (div16 < 16) div16 = 16;                 // 1.0
+    if (div16 > 255 * 16 + 15) div16 = 255 * 16 + 15;
+    uint32_t top = (uint32_t)((uint64_t)clk * 16 / ((uint64_t)div16 * frequency));
+    if (top < 2) top = 2;
+    if (top > 65536) top = 65536;
+
+    pwm_set_clkdiv_int_frac(buzzer_slice, (uint8_t)(div16 >> 4), (uint8_t)(div16 & 15));
+    pwm_set_wrap(buzzer_slice, (uint16_t)(top - 1));
+    pwm_set_chan_level(buzzer_slice, buzzer_channel, (uint16_t)(top / 2));
+    pwm_set_counter(buzzer_slice, 0);
+    buzzer_playing = true;
+}
+
+static void buzzer_stop_locked(void) {
+    pwm_set_chan_level(buzzer_slice, buzzer_channel, 0);
+    buzzer_playing = false;
+}
+
+static int64_t buzzer_alarm_cb(alarm_id_t id, void *user_data) {
+    (void)id;
+    critical_section_enter_blocking(&buzzer_lock);
+    if ((uint32_t)(uintptr_t)user_data == buzzer_generation) {
+        buzzer_alarm = 0;
+        buzzer_stop_locked();
+    }
+    critical_section_exit(&buzzer_lock);
+    return 0;                                   // do not repeat
+}
+
+// Start a new generation: the pending alarm no longer stops the tone.
+// Returns the alarm to cancel after the lock is released.
+static alarm_id_t buzzer_new_generation_locked(void) {
+    const alarm_id_t id = buzzer_alarm;
+    buzzer_alarm = 0;
+    buzzer_generation++;
+    return id;
+}
+
+// Set a tone (0 = silence) without a time limit
+static void buzzer_set(uint32_t frequency) {
+    buzzer_lock_init();
+    critical_section_enter_blocking(&buzzer_lock);
+    const alarm_id_t old = buzzer_new_generation_locked();
+    if (frequency == 0)
+        buzzer_stop_locked();
+    else
+        buzzer_start_locked(frequency);
+    critical_section_exit(&buzzer_lock);
+    if (old > 0)
+        cancel_alarm(old);
+}
+
  void init_buzzer() {
-    // Initialize the buzzer pin as an output
-    gpio_init(BUZZER_PIN);
-    gpio_set_dir(BUZZER_PIN, GPIO_OUT);
+    // The buzzer pin is a PWM output, silent until a tone is played
+    buzzer_lock_init();
+    gpio_set_function(BUZZER_PIN, GPIO_FUNC_PWM);
+    buzzer_slice = pwm_gpio_to_slice_num(BUZZER_PIN);
+    buzzer_channel = pwm_gpio_to_channel(BUZZER_PIN);
+    pwm_set_chan_level(buzzer_slice, buzzer_channel, 0);
+    pwm_set_enabled(buzzer_slice, true);
+    buzzer_playing = false;
+}
+
+int buzzer_play_tone_async(uint32_t frequency, uint32_t duration_ms) {
+    if (frequency == 0 || duration_ms == 0) {
+        buzzer_set(0);
+        return 0;
+    }
+
+    buzzer_lock_init();
+    critical_section_enter_blocking(&buzzer_lock);
+    const alarm_id_t old = buzzer_new_generation_locked();
+    const uint32_t gen = buzzer_generation;
+    buzzer_start_locked(frequency);
+    critical_section_exit(&buzzer_lock);
+    if (old > 0)
+        cancel_alarm(old);
+
+    alarm_id_t id = add_alarm_in_ms(duration_ms, buzzer_alarm_cb, (void *)(uintptr_t)gen, true);
+
+    critical_section_enter_blocking(&buzzer_lock);
+    int result = 0;
+    if (gen == buzzer_generation) {
+        if (id < 0) {
+            buzzer_stop_locked();               // no free alarm: no tone that never ends
+            result = -1;
+        } else if (buzzer_playing) {
+            buzzer_alarm = id;                  // not when the alarm has already stopped the tone
+        }
+    }
+    critical_section_exit(&buzzer_lock);
+    return result;
 }
 
  void buzzer_play_tone(uint32_t frequency, uint32_t duration_ms) {
-    // Calculate the period (in microseconds) and number of cycles
-    uint32_t period_us = 1000000 / frequency;
-    uint32_t num_cycles = duration_ms * frequency / 1000;
-
-    // Generate the tone by toggling the buzzer pin at the specified frequency
-    for (uint32_t i = 0; i < num_cycles; i++) {
-        gpio_put(BUZZER_PIN, 1);
-        busy_wait_us(period_us / 2);
-        gpio_put(BUZZER_PIN, 0);
-        busy_wait_us(period_us / 2);
-    }
+    // The alarm stops the tone; sleep_ms lets other tasks run meanwhile
+    // (under FreeRTOS the task is blocked, without it the core waits)
+    if (buzzer_play_tone_async(frequency, duration_ms) < 0)
+        return;
+    sleep_ms(duration_ms);
+}
+
+bool buzzer_is_playing(void) {
+    return buzzer_playing;
+}
+
+void buzzer_set_frequency(uint32_t frequency) {
+    // Replaces a timed tone: its alarm no longer stops the buzzer
+    buzzer_set(frequency);
 }
 
  void buzzer_turn_off() {
-    // Turn off the buzzer by setting the pin to low
-    gpio_put(BUZZER_PIN, 0);
+    // Cancel a timed tone and silence the output
+    buzzer_set(0);
 }
 
 void deinit_buzzer() {
-    // Deinitialize the buzzer pin
+    // Stop the PWM and release the buzzer pin
+    buzzer_turn_off();
+    pwm_set_enabled(buzzer_slice, false);
     gpio_deinit(BUZZER_PIN);
 }
 
@@ -278,9 +403,13 @@ bool i2c_read(uint8_t addr, uint8_t *dst, size_t len, bool nostop) {
 // Uses https://github.com/ArmDeveloperEcosystem/microphone-library-for-pico/tree/main
 // Uses pio to read pdm data and OpenPDM2PCM library to transform PDM to PCM
 // Microphone related functions
-// Sample rate: 16Khz
+// Sample rate: 8Khz (default)
 // Buffer size: 256 samples.
  int init_pdm_microphone() {
+    return init_pdm_microphone_rate(MEMS_SAMPLING_FREQUENCY, MEMS_DECIMATION);
+}
+
+ int init_pdm_microphone_rate(uint32_t sample_rate, uint8_t decimation) {
     const struct pdm_microphone_config config = {
     // GPIO pin for the PDM DAT signal
     .gpio_data = PDM_DATA,
@@ -295,10 +424,16 @@ bool i2c_read(uint8_t addr, uint8_t *dst, size_t len, bool nostop) {
     .pio_sm = 0,
 
     // sample rate in Hz
-    .sample_rate = MEMS_SAMPLING_FREQUENCY,
+    .sample_rate = sample_rate,
 
     // number of samples to buffer
     .sample_buffer_size = MEMS_BUFFER_SIZE,
+
+    // number of buffers in the DMA ring
+    .raw_buffer_count = MEMS_RAW_BUFFER_COUNT,
+
+    // PDM bits per PCM sample
+    .decimation = decimation,
     };
 
     return pdm_microphone_init(&config);
@@ -491,6 +626,22 @@ void draw_circle(int16_t x0, int16_t y0, int16_t r, bool fill) {
     ssd1306_show(&disp);
 }
 
+void draw_bars(const uint8_t *heights, size_t n) {
+    if (!heights || n == 0 || n > disp.width) return;
+
+    const uint32_t w = disp.width / n;
+    const uint32_t bar = w >= 3 ? w - 1 : w;   // gap between wide bars
+    ssd1306_clear(&disp);
+    for (size_t i = 0; i < n; i++) {
+        uint32_t h = heights[i] > disp.height ? disp.height : heights[i];
+        if (h)
+            ssd1306_draw_square(&disp, (uint32_t)i * w, disp.height - h, bar, h);
+    }
+
+    // Update the display once for all the bars
+    ssd1306_show(&disp);
+}
+
 void clear_display() {
     // Clear the display
     ssd1306_clear(&disp);
@@ -734,6 +885,7 @@ void stop_hdc2021() {
 // https://invensense.tdk.com/wp-content/uploads/2021/07/DS-000451-ICM-42670-P-v1.0.pdf
 
 float aRes, gRes;      // scale resolutions per LSB for the sensors
+static uint16_t accel_odr_hz = 0, gyro_odr_hz = 0;  // 0 = not started, used to check filter settings
 
 static int icm_i2c_write_byte(uint8_t reg, uint8_t value) {
     uint8_t buf[2] = { reg, value };
@@ -809,6 +961,7 @@ int init_ICM42670() {
     
     //Soft reset
     icm_soft_reset();
+    accel_odr_hz = gyro_odr_hz = 0;
     
     //DETECT ADDRESS FOR AD0 floating pin: 
     int address = ICM42670_autodetect_address();
@@ -881,6 +1034,7 @@ int ICM42670_startAccel(uint16_t odr_hz, uint16_t fsr_g) {
     int rc = icm_i2c_write_byte(ICM42670_ACCEL_CONFIG0_REG, accel_config0_val);
     busy_wait_us(400); 
     if (rc != 0) return -3;
+    accel_odr_hz = odr_hz;
     return 0; // success
 }
 
@@ -925,6 +1079,65 @@ int ICM42670_startGyro(uint16_t odr_hz, uint16_t fsr_dps) {
     uint8_t gyro_config0_val = (fsr_bits << 5) | (odr_bits & 0x0F);
     if (icm_i2c_write_byte(ICM42670_GYRO_CONFIG0_REG, gyro_config0_val) != 0) return -3;
     busy_wait_us(400); 
+    gyro_odr_hz = odr_hz;
+    return 0;
+}
+
+// Map a UI filter bandwidth in Hz to GYRO_CONFIG1 / ACCEL_CONFIG1 bits.
+// Returns -1 for unsupported values.
+static int icm_ui_filt_bw_bits(uint16_t bw_hz) {
+    switch (bw_hz) {
+        case 0:   return ICM42670_UI_FILT_BW_BYPASS;
+        case 180: return ICM42670_UI_FILT_BW_180HZ;
+        case 121: return ICM42670_UI_FILT_BW_121HZ;
+        case 73:  return ICM42670_UI_FILT_BW_73HZ;
+        case 53:  return ICM42670_UI_FILT_BW_53HZ;
+        case 34:  return ICM42670_UI_FILT_BW_34HZ;
+        case 25:  return ICM42670_UI_FILT_BW_25HZ;
+        case 16:  return ICM42670_UI_FILT_BW_16HZ;
+        default:  return -1;
+    }
+}
+
+int ICM42670_set_accel_filter(uint16_t bw_hz, uint8_t lp_avg) {
+    int bw_bits = icm_ui_filt_bw_bits(bw_hz);
+    uint8_t avg_bits;
+    switch (lp_avg) {
+        case 2:  avg_bits = 0; break;
+        case 4:  avg_bits = 1; break;
+        case 8:  avg_bits = 2; break;
+        case 16: avg_bits = 3; break;
+        case 32: avg_bits = 4; break;
+        case 64: avg_bits = 5; break;
+        default: return -1;
+    }
+    if (bw_bits < 0) return -1;
+
+    // The bandwidth must be below Nyquist and the averaging must fit in one ODR period
+    if (accel_odr_hz == 0) return -2;
+    if (bw_hz != 0 && 2u * bw_hz >= accel_odr_hz) return -2;
+    if ((uint32_t)lp_avg * accel_odr_hz > ICM42670_ACCEL_UI_AVG_MAX_RATE) return -2;
+
+    // Only the two fields: bits 7 and 3 are reserved
+    uint8_t cfg;
+    if (icm_i2c_read_byte(ICM42670_ACCEL_CONFIG1_REG, &cfg) != 0) return -3;
+    cfg &= (uint8_t)~(ICM42670_ACCEL_UI_AVG_MASK | ICM42670_UI_FILT_BW_MASK);
+    cfg |= (uint8_t)((avg_bits << 4) | bw_bits);
+    if (icm_i2c_write_byte(ICM42670_ACCEL_CONFIG1_REG, cfg) != 0) return -3;
+    return 0;
+}
+
+int ICM42670_set_gyro_filter(uint16_t bw_hz) {
+    int bw_bits = icm_ui_filt_bw_bits(bw_hz);
+    if (bw_bits < 0) return -1;
+    if (gyro_odr_hz == 0) return -2;
+    if (bw_hz != 0 && 2u * bw_hz >= gyro_odr_hz) return -2;
+
+    // Only the bandwidth field: the other bits are reserved (reset value 0x31)
+    uint8_t cfg;
+    if (icm_i2c_read_byte(ICM42670_GYRO_CONFIG1_REG, &cfg) != 0) return -3;
+    cfg = (uint8_t)((cfg & ~ICM42670_UI_FILT_BW_MASK) | bw_bits);
+    if (icm_i2c_write_byte(ICM42670_GYRO_CONFIG1_REG, cfg) != 0) return -3;
     return 0;
 }
 
@@ -975,30 +1188,290 @@ int ICM42670_start_with_default_values(void) {
 }
 
 
-int ICM42670_read_sensor_data(float *ax, float *ay, float *az,
-    float *gx, float *gy, float *gz,float *t) {
-        
+int ICM42670_read_sensor_data_raw(icm42670_raw_sample_t *s) {
+
         uint8_t raw[14]; // 14 bytes total from TEMP to GYRO Z
 
         int rc = icm_i2c_read_bytes(ICM42670_SENSOR_DATA_START_REG, raw, sizeof(raw));
         if (rc != 0) return rc;
 
         // Convert to signed 16-bit integers (big-endian)
-        int16_t t_raw = (int16_t)((raw[0] << 8) | raw[1]);
-        int16_t ax_raw = ((int16_t)raw[2] << 8) | raw[3];
-        int16_t ay_raw = ((int16_t)raw[4] << 8) | raw[5];
-        int16_t az_raw = ((int16_t)raw[6] << 8) | raw[7];
-        int16_t gx_raw = (int16_t)((raw[8] << 8) | raw[9]);
-        int16_t gy_raw = (int16_t)((raw[10] << 8) | raw[11]);
-        int16_t gz_raw = (int16_t)((raw[12] << 8) | raw[13]);
-
-        *t = ((float)t_raw / 128.0f)+ 25.0;
-        *ax =  (float)ax_raw / aRes; 
-        *ay =  (float)ay_raw / aRes; 
-        *az =  (float)az_raw / aRes;
-        *gx =  (float)gx_raw / gRes; 
-        *gy =  (float)gy_raw / gRes; 
-        *gz =  (float)gz_raw / gRes;
+        s->temp = (int16_t)((raw[0] << 8) | raw[1]);
+        s->ax = (int16_t)((raw[2] << 8) | raw[3]);
+        s->ay = (int16_t)((raw[4] << 8) | raw[5]);
+        s->az = (int16_t)((raw[6] << 8) | raw[7]);
+        s->gx = (int16_t)((raw[8] << 8) | raw[9]);
+        s->gy = (int16_t)((raw[10] << 8) | raw[11]);
+        s->gz = (int16_t)((raw[12] << 8) | raw[13]);
+        return 0; // success
+}
+
+int ICM42670_read_sensor_data(float *ax, float *ay, float *az,
+    float *gx, float *gy, float *gz,float *t) {
+        
+        icm42670_raw_sample_t s;
+
+        int rc = ICM42670_read_sensor_data_raw(&s);
+        if (rc != 0) return rc;
+
+        *t = ((float)s.temp / 128.0f)+ 25.0;
+        *ax =  (float)s.ax / aRes; 
+        *ay =  (float)s.ay / aRes; 
+        *az =  (float)s.az / aRes;
+        *gx =  (float)s.gx / gRes; 
+        *gy =  (float)s.gy / gRes; 
+        *gz =  (float)s.gz / gRes;
         return 0; // success
 }
 
+/* =========================
+ *  ICM-42670 FIFO
+ * ========================= */
+
+// MREG1 registers are accessed indirectly through BLK_SEL / MADDR / M_W / M_R.
+// The datasheet requires the sensor clock to be running and a 10 µs gap
+// after each access (datasheet: "Accessing MREG1, MREG2 and MREG3 registers").
+static int icm_mreg1_write(uint8_t reg, uint8_t value) {
+    if (icm_i2c_write_byte(ICM42670_BLK_SEL_W_REG, 0x00) != 0) return -1;
+    if (icm_i2c_write_byte(ICM42670_MADDR_W_REG, reg) != 0) return -1;
+    if (icm_i2c_write_byte(ICM42670_M_W_REG, value) != 0) return -1;
+    busy_wait_us(10);
+    return 0;
+}
+
+static int icm_mreg1_read(uint8_t reg, uint8_t *value) {
+    if (icm_i2c_write_byte(ICM42670_BLK_SEL_R_REG, 0x00) != 0) return -1;
+    if (icm_i2c_write_byte(ICM42670_MADDR_R_REG, reg) != 0) return -1;
+    busy_wait_us(10);
+    if (icm_i2c_read_byte(ICM42670_M_R_REG, value) != 0) return -1;
+    busy_wait_us(10);
+    return 0;
+}
+
+int ICM42670_fifo_flush(void) {
+    int rc = icm_i2c_write_byte(ICM42670_REG_SIGNAL_PATH_RESET, ICM42670_FIFO_FLUSH_BIT);
+    busy_wait_us(2);  // flush takes 1.5 µs
+    return rc;
+}
+
+int ICM42670_fifo_start(void) {
+    // FIFO_CONFIG5 must be changed while the FIFO is in bypass
+    if (icm_i2c_write_byte(ICM42670_FIFO_CONFIG1_REG, ICM42670_FIFO_BYPASS_BIT) != 0) return -1;
+
+    // ICM42670_fifo_read_timed() takes the count as bytes, high byte first, and
+    // the packets (as ICM42670_read_sensor_data_raw() the registers) big endian
+    uint8_t intf = 0;
+    if (icm_i2c_read_byte(ICM42670_INTF_CONFIG0_REG, &intf) != 0) return -1;
+    intf &= (uint8_t)~ICM42670_FIFO_COUNT_FORMAT_BIT;
+    intf |= ICM42670_FIFO_COUNT_ENDIAN_BIT | ICM42670_SENSOR_DATA_ENDIAN_BIT;
+    if (icm_i2c_write_byte(ICM42670_INTF_CONFIG0_REG, intf) != 0) return -1;
+
+    uint8_t cfg5 = 0;
+    if (icm_mreg1_read(ICM42670_MREG1_FIFO_CONFIG5, &cfg5) != 0) return -2;
+    cfg5 &= ~(uint8_t)0x08;  // 16-bit samples (FIFO packet 3), no high resolution
+    cfg5 |= ICM42670_FIFO_CONFIG5_ACCEL_EN | ICM42670_FIFO_CONFIG5_GYRO_EN |
+            ICM42670_FIFO_CONFIG5_TMST_FSYNC_EN;
+    if (icm_mreg1_write(ICM42670_MREG1_FIFO_CONFIG5, cfg5) != 0) return -2;
+    // Absolute timestamps with 1 us resolution (not deltas)
+    if (icm_mreg1_write(ICM42670_MREG1_TMST_CONFIG1, ICM42670_TMST_CONFIG1_TMST_EN) != 0) return -2;
+
+    // Stream mode: when full, the oldest packets are overwritten
+    if (icm_i2c_write_byte(ICM42670_FIFO_CONFIG1_REG, 0x00) != 0) return -3;
+    return ICM42670_fifo_flush() == 0 ? 0 : -4;
+}
+
+int ICM42670_fifo_stop(void) {
+    return icm_i2c_write_byte(ICM42670_FIFO_CONFIG1_REG, ICM42670_FIFO_BYPASS_BIT);
+}
+
+// Parse one FIFO packet 3. Returns false if the packet is empty or incomplete.
+static bool icm_fifo_parse_packet(const uint8_t *p, icm42670_raw_sample_t *s, uint16_t *tmst) {
+    uint8_t header = p[0];
+    if (header & ICM42670_FIFO_HEADER_EMPTY) return false;
+    if ((header & (ICM42670_FIFO_HEADER_ACCEL | ICM42670_FIFO_HEADER_GYRO)) !=
+        (ICM42670_FIFO_HEADER_ACCEL | ICM42670_FIFO_HEADER_GYRO)) return false;
+
+    s->ax = (int16_t)((p[1] << 8) | p[2]);
+    s->ay = (int16_t)((p[3] << 8) | p[4]);
+    s->az = (int16_t)((p[5] << 8) | p[6]);
+    s->gx = (int16_t)((p[7] << 8) | p[8]);
+    s->gy = (int16_t)((p[9] << 8) | p[10]);
+    s->gz = (int16_t)((p[11] << 8) | p[12]);
+    // FIFO temperature is 8 bits: °C = t / 2 + 25. Bring it to register scale (/128).
+    s->temp = (int16_t)((int8_t)p[13] * 64);
+    if (tmst) *tmst = (uint16_t)((p[14] << 8) | p[15]);
+
+    if (s->ax == ICM42670_FIFO_INVALID_SAMPLE || s->gx == ICM42670_FIFO_INVALID_SAMPLE) return false;
+    return true;
+}
+
+int ICM42670_fifo_read_timed(icm42670_raw_sample_t *samples, uint16_t *tmst, size_t max,
+                             icm42670_fifo_batch_info_t *info) {
+    uint8_t cnt[2];
+    if (icm_i2c_read_bytes(ICM42670_FIFO_COUNTH_REG, cnt, 2) != 0) return -1;
+    // Every packet counted here was sampled before this moment
+    const uint64_t read_time = time_us_64();
+    size_t packets = (size_t)((cnt[0] << 8) | cnt[1]) / ICM42670_FIFO_PACKET_SIZE;
+    if (info) {
+        info->read_time_us = read_time;
+        info->overflow = packets >= ICM42670_FIFO_SIZE / ICM42670_FIFO_PACKET_SIZE;
+    }
+    if (packets > max) packets = max;
+
+    // 8 packets per transfer keeps the buffer small and the length below 256
+    uint8_t buf[8 * ICM42670_FIFO_PACKET_SIZE];
+    size_t n = 0;
+    while (packets > 0) {
+        size_t chunk = packets > 8 ? 8 : packets;
+        if (icm_i2c_read_bytes(ICM42670_FIFO_DATA_REG, buf,
+                               (uint8_t)(chunk * ICM42670_FIFO_PACKET_SIZE)) != 0) {
+            return n > 0 ? (int)n : -2;
+        }
+        for (size_t i = 0; i < chunk; i++) {
+            if (icm_fifo_parse_packet(&buf[i * ICM42670_FIFO_PACKET_SIZE], &samples[n],
+                                      tmst ? &tmst[n] : NULL)) n++;
+        }
+        packets -= chunk;
+    }
+    return (int)n;
+}
+
+int ICM42670_fifo_read(icm42670_raw_sample_t *samples, size_t max) {
+    return ICM42670_fifo_read_timed(samples, NULL, max, NULL);
+}
+
+
+
+/* =========================
+ *  ICM-42670 APEX
+ * ========================= */
+
+// The ISR only timestamps the interrupt. Status registers are read later from
+// task context because the I2C bus is shared with the other drivers.
+static queue_t apex_irq_queue;
+static bool apex_queue_ready = false;
+static volatile icm42670_apex_irq_callback_t apex_callback = NULL;
+
+static void icm_apex_irq_handler(void) {
+    if (gpio_get_irq_event_mask(ICM42670_INT) & GPIO_IRQ_EDGE_RISE) {
+        gpio_acknowledge_irq(ICM42670_INT, GPIO_IRQ_EDGE_RISE);
+        uint64_t now = time_us_64();
+        queue_try_add(&apex_irq_queue, &now);   // if full, the oldest ones are kept
+        icm42670_apex_irq_callback_t cb = apex_callback;
+        if (cb) cb();
+    }
+}
+
+int ICM42670_apex_start(const struct icm42670_apex_config *cfg, icm42670_apex_irq_callback_t callback) {
+    const uint8_t wom_axes = cfg->events & ICM42670_APEX_WOM_ANY;
+    const bool need_dmp = cfg->events & (ICM42670_APEX_SMD | ICM42670_APEX_TILT);
+
+    if (cfg->events == 0) return -1;
+    // SMD is built on top of WOM
+    if ((cfg->events & ICM42670_APEX_SMD) && !wom_axes) return -1;
+    uint32_t thr = (cfg->wom_threshold_mg * 256u + 500u) / 1000u;   // 1 LSB = 1/256 g
+    if (wom_axes && (thr == 0 || thr > 255)) return -1;
+
+    if (!apex_queue_ready) {
+        queue_init(&apex_irq_queue, sizeof(uint64_t), ICM42670_APEX_EVENT_QUEUE_LENGTH);
+        apex_queue_ready = true;
+    }
+    ICM42670_apex_stop();
+
+    // INT1: pulsed, push-pull, active high. Written here instead of init_ICM42670()
+    // because writing it right after a cold power-on blocks the sensor (see init).
+    if (icm_i2c_write_byte(ICM42670_INT_CONFIG, ICM42670_INT1_APEX_CONFIG_VALUE) != 0) return -2;
+
+    if (wom_axes) {
+        // Thresholds, then 1 ms before routing the interrupt
+        if (icm_mreg1_write(ICM42670_MREG1_ACCEL_WOM_X_THR, (uint8_t)thr) != 0) return -2;
+        if (icm_mreg1_write(ICM42670_MREG1_ACCEL_WOM_Y_THR, (uint8_t)thr) != 0) return -2;
+        if (icm_mreg1_write(ICM42670_MREG1_ACCEL_WOM_Z_THR, (uint8_t)thr) != 0) return -2;
+        sleep_ms(1);
+    }
+
+    if (need_dmp) {
+        // DMP at 50 Hz, memory reset and init (datasheet APEX initialization sequence)
+        uint8_t cfg0 = 0;
+        if (icm_i2c_read_byte(ICM42670_APEX_CONFIG0_REG, &cfg0) != 0) return -3;
+        if (icm_i2c_write_byte(ICM42670_APEX_CONFIG1_REG, 0x02) != 0) return -3;
+        if (icm_i2c_write_byte(ICM42670_APEX_CONFIG0_REG, cfg0 | 0x01) != 0) return -3;
+        sleep_ms(1);
+        if (icm_i2c_write_byte(ICM42670_APEX_CONFIG0_REG, (cfg0 & ~0x01) | 0x04) != 0) return -3;
+        sleep_ms(50);
+    }
+
+    // Route the events to INT1
+    uint8_t src1 = wom_axes;
+    if (cfg->events & ICM42670_APEX_SMD) src1 |= 0x08;
+    if (icm_i2c_write_byte(ICM42670_INT_SOURCE1_REG, src1) != 0) return -4;
+    if (icm_mreg1_write(ICM42670_MREG1_INT_SOURCE6,
+                        (cfg->events & ICM42670_APEX_TILT) ? 0x08 : 0x00) != 0) return -4;
+
+    if (wom_axes) {
+        sleep_ms(50);
+        // OR of the axes, first over-threshold sample raises the interrupt
+        uint8_t wom = 0x01;
+        if (cfg->wom_compare_previous) wom |= 0x02;
+        if (icm_i2c_write_byte(ICM42670_WOM_CONFIG_REG, wom) != 0) return -4;
+    }
+    if (need_dmp) {
+        uint8_t cfg1 = 0x02;   // keep DMP ODR 50 Hz
+        if (cfg->events & ICM42670_APEX_SMD) cfg1 |= 0x40;
+        if (cfg->events & ICM42670_APEX_TILT) cfg1 |= 0x10;
+        if (icm_i2c_write_byte(ICM42670_APEX_CONFIG1_REG, cfg1) != 0) return -4;
+    }
+
+    // Clear anything latched during configuration, then enable the GPIO interrupt
+    uint8_t st;
+    icm_i2c_read_byte(ICM42670_INT_STATUS2_REG, &st);
+    icm_i2c_read_byte(ICM42670_INT_STATUS3_REG, &st);
+    while (queue_try_remove(&apex_irq_queue, NULL)) {}
+
+    apex_callback = callback;
+    gpio_init(ICM42670_INT);
+    gpio_set_dir(ICM42670_INT, GPIO_IN);
+    gpio_disable_pulls(ICM42670_INT);
+    gpio_add_raw_irq_handler(ICM42670_INT, icm_apex_irq_handler);
+    gpio_set_irq_enabled(ICM42670_INT, GPIO_IRQ_EDGE_RISE, true);
+    irq_set_enabled(IO_IRQ_BANK0, true);
+    return 0;
+}
+
+int ICM42670_apex_stop(void) {
+    gpio_set_irq_enabled(ICM42670_INT, GPIO_IRQ_EDGE_RISE, false);
+    gpio_remove_raw_irq_handler(ICM42670_INT, icm_apex_irq_handler);
+    apex_callback = NULL;
+
+    int rc = 0;
+    if (icm_i2c_write_byte(ICM42670_WOM_CONFIG_REG, 0x00) != 0) rc = -1;
+    if (icm_i2c_write_byte(ICM42670_INT_SOURCE1_REG, 0x00) != 0) rc = -1;
+    if (icm_i2c_write_byte(ICM42670_APEX_CONFIG1_REG, 0x02) != 0) rc = -1;
+    if (icm_mreg1_write(ICM42670_MREG1_INT_SOURCE6, 0x00) != 0) rc = -1;
+    return rc;
+}
+
+int ICM42670_apex_read_event(icm42670_apex_event_t *ev) {
+    uint64_t t;
+    if (!apex_queue_ready || !queue_try_remove(&apex_irq_queue, &t)) return 0;
+
+    uint8_t st2 = 0, st3 = 0;
+    if (icm_i2c_read_byte(ICM42670_INT_STATUS2_REG, &st2) != 0) return -1;
+    if (icm_i2c_read_byte(ICM42670_INT_STATUS3_REG, &st3) != 0) return -1;
+
+    // INT_STATUS2 bits match ICM42670_APEX_WOM_* and ICM42670_APEX_SMD
+    ev->events = st2 & (ICM42670_APEX_WOM_ANY | ICM42670_APEX_SMD);
+    if (st3 & 0x08) ev->events |= ICM42670_APEX_TILT;
+    ev->time_us = t;
+    return 1;
+}
+
+int ICM42670_apex_flush_events(void) {
+    if (apex_queue_ready) {
+        while (queue_try_remove(&apex_irq_queue, NULL)) {}
+    }
+    uint8_t st;
+    if (icm_i2c_read_byte(ICM42670_INT_STATUS2_REG, &st) != 0) return -1;
+    if (icm_i2c_read_byte(ICM42670_INT_STATUS3_REG, &st) != 0) return -1;
+    return 0;
+}
@@ -0,0 +1,189 @@
+/*
+ * agc_sim: tkjhat/agc on synthetic speech from a whisper to a shout.
+ *
+ * Speech: words of one to three vowels (harmonics of a 100-220 Hz pitch
+ * shaped by two formants, the level of each word varies by 6 dB) with
+ * pauses, over a steady room noise. The AGC input is the PCM of the filter
+ * at volume 16; the fixed column is the same speech at the default volume 64
+ * (4x, clipped at +-32700 by the filter), for comparison.
+ * Printed per speaker level:
+ *   in dB      speech level at the AGC input (rms, dBFS)
+ *   fixed dB   level with the fixed volume, and the share of clipped samples
+ *   agc dB     level after the AGC (from 2 s on, once settled)
+ *   peak       largest output sample (the limiter keeps it under the ceiling)
+ *   noise dB   room noise in the pauses after the AGC
+ *   limited    1 ms steps cut by the limiter
+ * The "step" case starts quiet and gets 35 dB louder in the middle (someone
+ * moves to the microphone); its agc column is the level after the step.
+ *
+ * Usage:
+ *   agc_sim [--seed S]
+ *
+ * Exit code is 1 if the AGC levels spread more than SPREAD_LIMIT_DB, a
+ * sample goes over the ceiling or the noise in the pauses is above
+ * NOISE_LIMIT_DB.
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <tkjhat/agc.h>
+
+#include "sim_signal.h"
+
+#define RATE            8000
+#define SECONDS         20
+#define FRAME           256         // MEMS_BUFFER_SIZE
+#define NOISE_RMS       8.0         // room and microphone noise at volume 16, LSB
+#define SETTLE_S        2.0
+#define SPREAD_LIMIT_DB 8.0         // most spread of the AGC speech levels
+#define NOISE_LIMIT_DB  -40.0       // most noise in the pauses after the AGC
+
+typedef struct {
+    const char *name;
+    double amp;                     // vowel amplitude at the AGC input
+    double amp_after;               // after the middle (0 = no step)
+} case_t;
+
+static const case_t cases[] = {
+    { "whisper",  150,    0 },
+    { "quiet",    500,    0 },
+    { "normal",  1500,    0 },
+    { "loud",    5000,    0 },
+    { "shout",  12000,    0 },
+    { "step",     150, 12000 },
+};
+
+// Speech into x (added), truth into speech[]
+static void add_speech(double *x, bool *speech, size_t n, const case_t *c) {
+    static const struct sim_word word = { 0.02, 0.0, 0.0 };
+    size_t t = (size_t)(0.5 * RATE);
+    while (t < n - RATE) {
+        const double amp = c->amp_after > 0 && t >= n / 2 ? c->amp_after : c->amp;
+        t = sim_add_word(x, speech, n, t, amp * (0.5 + 0.5 * sim_urand()), &word, RATE);
+        t += (size_t)((0.15 + 0.6 * sim_urand()) * RATE);
+    }
+}
+
+static double db(double sum_sq, size_t n) {
+    return n ? 10.0 * log10(sum_sq / n / (32768.0 * 32768.0) + 1e-20) : -200.0;
+}
+
+typedef struct {
+    double in_db, fixed_db, fixed_clip, agc_db, noise_db, ns;
+    int peak;
+    uint32_t limited, clipped;
+} result_t;
+
+static void run(const case_t *c, const struct agc_config *cfg, result_t *r) {
+    const size_t n = SECONDS * RATE;
+    double *x = calloc(n, sizeof(*x));
+    bool *speech = calloc(n, sizeof(*speech));
+    int16_t *pcm = malloc(n * sizeof(*pcm));
+    add_speech(x, speech, n, c);
+    for (size_t i = 0; i < n; i++) {
+        x[i] += NOISE_RMS * sim_gauss();
+        pcm[i] = sim_sat(x[i], AGC_INPUT_CLIP);
+    }
+
+    // Pause samples: no speech within 0.3 s
+    bool *pause = calloc(n, sizeof(*pause));
+    for (size_t i = 0, last = 0, next = 0; i < n; i++) {
+        if (speech[i]) last = i;
+        if (next <= i) {
+            next = i;
+            while (next < n && !speech[next]) next++;
+        }
+        pause[i] = !speech[i] && i - last > 0.3 * RATE && next - i > 0.3 * RATE && last > 0;
+    }
+
+    const size_t from = c->amp_after > 0 ? n / 2 : (size_t)(SETTLE_S * RATE);
+    double in_sq = 0.0, fixed_sq = 0.0;
+    size_t speech_n = 0, clip_n = 0;
+    for (size_t i = from; i < n; i++) {
+        if (!speech[i]) continue;
+        const double f = x[i] * 4.0;
+        const double fc = f > AGC_INPUT_CLIP ? AGC_INPUT_CLIP : f < -AGC_INPUT_CLIP ? -AGC_INPUT_CLIP : f;
+        in_sq += (double)pcm[i] * pcm[i];
+        fixed_sq += fc * fc;
+        clip_n += fc != f;
+        speech_n++;
+    }
+
+    static agc_t agc;
+    agc_init(&agc, cfg);
+    clock_t t0 = clock();
+    for (size_t f = 0; f < n; f += FRAME)
+        agc_process(&agc, pcm + f, n - f < FRAME ? n - f : FRAME);
+    const double secs = (double)(clock() - t0) / CLOCKS_PER_SEC;
+
+    double agc_sq = 0.0, noise_sq = 0.0;
+    size_t noise_n = 0;
+    int peak = 0;
+    for (size_t i = 0; i < n; i++) {
+        const int a = abs(pcm[i]);
+        if (a > peak) peak = a;
+        if (i < (size_t)(SETTLE_S * RATE)) continue;
+        if (speech[i] && i >= from) agc_sq += (double)pcm[i] * pcm[i];
+        if (pause[i]) {
+            noise_sq += (double)pcm[i] * pcm[i];
+            noise_n++;
+        }
+    }
+
+    r->in_db = db(in_sq, speech_n);
+    r->fixed_db = db(fixed_sq, speech_n);
+    r->fixed_clip = speech_n ? (double)clip_n / speech_n : 0.0;
+    r->agc_db = db(agc_sq, speech_n);
+    r->noise_db = db(noise_sq, noise_n);
+    r->peak = peak;
+    agc_counters(&agc, &r->limited, &r->clipped);
+    r->ns = secs * 1e9 / n;
+    free(x);
+    free(speech);
+    free(pause);
+    free(pcm);
+}
+
+int main(int argc, char **argv) {
+    unsigned seed = 1;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--seed") && i + 1 < argc) seed = (unsigned)atoi(argv[++i]);
+        else {
+            fprintf(stderr, "usage: %s [--seed S]\n", argv[0]);
+            return 2;
+        }
+    }
+    srand(seed);
+
+    struct agc_config cfg;
+    agc_default_config(&cfg, RATE);
+
+    printf("%-9s %7s %15s %8s %7s %9s %8s %7s\n", "speaker", "in dB", "fixed dB (clip)", "agc dB", "peak",
+           "noise dB", "limited", "ns/smp");
+    bool ok = true;
+    double lo = 0.0, hi = -200.0;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        result_t r;
+        run(&cases[i], &cfg, &r);
+        bool pass = r.peak <= cfg.ceiling && r.noise_db <= NOISE_LIMIT_DB;
+        ok = ok && pass;
+        if (r.agc_db < lo) lo = r.agc_db;
+        if (r.agc_db > hi) hi = r.agc_db;
+        printf("%-9s %7.1f %7.1f (%4.1f%%) %8.1f %7d %9.1f %8lu %7.2f%s\n", cases[i].name, r.in_db, r.fixed_db,
+               100.0 * r.fixed_clip, r.agc_db, r.peak, r.noise_db, (unsigned long)r.limited, r.ns,
+               pass ? "" : "  <-- FAIL");
+    }
+    const bool spread_ok = hi - lo <= SPREAD_LIMIT_DB;
+    ok = ok && spread_ok;
+    printf("\nAGC levels spread %.1f dB%s\n", hi - lo, spread_ok ? "" : "  <-- FAIL");
+    printf("limits: spread <= %.0f dB, peak <= %u, noise in pauses <= %.0f dBFS\n", SPREAD_LIMIT_DB,
+           (unsigned)cfg.ceiling, NOISE_LIMIT_DB);
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
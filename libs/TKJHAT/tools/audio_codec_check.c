@@ -0,0 +1,297 @@
+/*
+ * audio_codec_check: quality and framing of tkjhat/audio_codec on the computer.
+ *
+ * Every codec encodes the test signals in frames of MEMS_BUFFER_SIZE samples,
+ * the way the hello_microphone example sends them, and the decoded signal is
+ * compared with the input:
+ *   mulaw     all 256 codes survive decode + encode
+ *   sizes     frames of every codec with 1..8 samples fit in AUDIO_FRAME_MAX_SIZE
+ *   tones     SNR of a 1 kHz sine at -6 and -30 dBFS, of a speech-like signal
+ *             (noise bursts with a falling spectrum) and of a sine sweep
+ *   stream    frames mixed with printf text, a lost frame and a corrupted one:
+ *             the decoder must skip the text, report the gap through the
+ *             sequence number, reject the corrupted frame and decode every
+ *             other frame exactly as if nothing was lost
+ *   speed     encoded samples per second of this computer
+ *
+ * Usage:
+ *   audio_codec_check [--rate HZ] [--write FILE]
+ *
+ * --write stores a 3 s stream (1 kHz tone, ADPCM, with some text between the
+ * frames) to test the host decoder: record_audio.py --input FILE -o out.wav
+ *
+ * Exit code is 1 if a check fails or an SNR is below the limits below.
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <tkjhat/audio_codec.h>
+
+#define FRAME_SAMPLES       256     // MEMS_BUFFER_SIZE
+#define SIGNAL_S            2.0
+#define STREAM_FRAMES       40
+#define MIN_SNR_MULAW_DB    30.0    // G.711 gives about 38 dB over a wide range of levels
+#define MIN_SNR_ADPCM_DB    18.0    // lower on loud high frequency content
+
+static const audio_codec_t codecs[] = { AUDIO_CODEC_PCM16, AUDIO_CODEC_MULAW, AUDIO_CODEC_IMA_ADPCM };
+static const char *codec_names[] = { "pcm16", "mulaw", "adpcm" };
+
+static double urand(void) {
+    return rand() / (RAND_MAX + 1.0);
+}
+
+static int16_t sat(double x) {
+    x = x < 0 ? x - 0.5 : x + 0.5;
+    if (x > 32767) return 32767;
+    if (x < -32768) return -32768;
+    return (int16_t)x;
+}
+
+static void make_tone(int16_t *x, size_t n, double fs, double hz, double dbfs) {
+    const double a = 32767.0 * pow(10.0, dbfs / 20.0);
+    for (size_t i = 0; i < n; i++)
+        x[i] = sat(a * sin(2.0 * M_PI * hz * i / fs));
+}
+
+// Bursts of 150 ms of noise through a one pole low-pass, with pauses
+static void make_speech(int16_t *x, size_t n, double fs) {
+    double y = 0.0;
+    const double k = exp(-2.0 * M_PI * 500.0 / fs);
+    for (size_t i = 0; i < n; i++) {
+        y = k * y + (1.0 - k) * (urand() * 2.0 - 1.0);
+        const double t = fmod(i / fs, 0.25);
+        const double env = t < 0.15 ? sin(M_PI * t / 0.15) : 0.0;
+        x[i] = sat(40000.0 * env * y);
+    }
+}
+
+static void make_sweep(int16_t *x, size_t n, double fs) {
+    const double f0 = 100.0, f1 = 0.45 * fs, T = n / fs;
+    for (size_t i = 0; i < n; i++) {
+        const double t = i / fs;
+        const double phase = 2.0 * M_PI * f0 * T / log(f1 / f0) * (exp(t / T * log(f1 / f0)) - 1.0);
+        x[i] = sat(8000.0 * sin(phase));
+    }
+}
+
+// Encode x frame by frame into one stream, then decode the stream back
+static size_t round_trip(audio_codec_t codec, uint32_t rate, const int16_t *x, size_t n,
+                         int16_t *y, uint8_t *stream) {
+    audio_encoder_t enc;
+    audio_encoder_init(&enc, codec, rate);
+    size_t len = 0;
+    for (size_t i = 0; i < n; i += FRAME_SAMPLES) {
+        const size_t m = n - i < FRAME_SAMPLES ? n - i : FRAME_SAMPLES;
+        len += audio_encode_frame(&enc, x + i, m, stream + len, AUDIO_FRAME_MAX_SIZE(m));
+    }
+    size_t pos = 0, out = 0;
+    while (pos < len) {
+        audio_frame_info_t info;
+        int r = audio_decode_frame(stream + pos, len - pos, y + out, n - out, &info);
+        if (r <= 0) break;
+        pos += (size_t)r;
+        out += info.samples;
+    }
+    return out == n ? len : 0;
+}
+
+static double snr_db(const int16_t *x, const int16_t *y, size_t n) {
+    double s = 0.0, e = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        const double d = (double)y[i] - x[i];
+        s += (double)x[i] * x[i];
+        e += d * d;
+    }
+    return e > 0.0 ? 10.0 * log10(s / e) : 200.0;
+}
+
+static bool check_mulaw(void) {
+    int bad = 0;
+    for (int c = 0; c < 256; c++) {
+        if (c == 0x7F) continue;            // -0, decodes to 0 like 0xFF
+        if (audio_mulaw_encode(audio_mulaw_decode((uint8_t)c)) != c) bad++;
+    }
+    printf("mulaw: %d of 255 codes do not survive decode + encode\n", bad);
+    return bad == 0;
+}
+
+static bool check_sizes(uint32_t rate) {
+    static const int16_t x[8] = {0, 1000, -1000, 2000, -2000, 3000, -3000, 4000};
+    uint8_t frame[AUDIO_FRAME_MAX_SIZE(8)];
+    int bad = 0;
+    for (size_t c = 0; c < sizeof(codecs) / sizeof(codecs[0]); c++) {
+        for (size_t m = 1; m <= 8; m++) {
+            audio_encoder_t enc;
+            audio_encoder_init(&enc, codecs[c], rate);
+            if (audio_encode_frame(&enc, x, m, frame, AUDIO_FRAME_MAX_SIZE(m)) == 0) {
+                printf("sizes: %s frame of %u samples does not fit\n", codec_names[c], (unsigned)m);
+                bad++;
+            }
+        }
+    }
+    return bad == 0;
+}
+
+// Stream of the test frames with text, one lost frame and one corrupted frame
+static bool check_stream(uint32_t rate) {
+    static int16_t x[STREAM_FRAMES * FRAME_SAMPLES], ref[STREAM_FRAMES * FRAME_SAMPLES];
+    static int16_t y[FRAME_SAMPLES];
+    static uint8_t stream[STREAM_FRAMES * (AUDIO_FRAME_MAX_SIZE(FRAME_SAMPLES) + 64)];
+    static size_t start[STREAM_FRAMES];
+    const int lost = 10, corrupted = 25;
+    make_speech(x, STREAM_FRAMES * FRAME_SAMPLES, rate);
+
+    // Reference: decode of the complete stream without any text
+    audio_encoder_t enc;
+    uint8_t frame[AUDIO_FRAME_MAX_SIZE(FRAME_SAMPLES)];
+    audio_encoder_init(&enc, AUDIO_CODEC_IMA_ADPCM, rate);
+    for (int f = 0; f < STREAM_FRAMES; f++) {
+        size_t len = audio_encode_frame(&enc, x + f * FRAME_SAMPLES, FRAME_SAMPLES, frame, sizeof(frame));
+        audio_decode_frame(frame, len, ref + f * FRAME_SAMPLES, FRAME_SAMPLES, NULL);
+    }
+
+    audio_encoder_init(&enc, AUDIO_CODEC_IMA_ADPCM, rate);
+    size_t len = 0;
+    for (int f = 0; f < STREAM_FRAMES; f++) {
+        if (f % 7 == 3)
+            len += (size_t)sprintf((char *)stream + len, "TA: debug line %d\n", f);
+        size_t n = audio_encode_frame(&enc, x + f * FRAME_SAMPLES, FRAME_SAMPLES, stream + len,
+                                      AUDIO_FRAME_MAX_SIZE(FRAME_SAMPLES));
+        if (f == lost) continue;            // the encoder state moved on all the same
+        start[f] = len;
+        len += n;
+    }
+    stream[start[corrupted] + AUDIO_FRAME_HEADER_SIZE + 40] ^= 0x10;
+
+    int decoded = 0, gaps = 0, mismatched = 0, skipped = 0;
+    int last_seq = -1;
+    size_t pos = 0;
+    while (pos < len) {
+        audio_frame_info_t info;
+        int r = audio_decode_frame(stream + pos, len - pos, y, FRAME_SAMPLES, &info);
+        if (r == 0) break;
+        if (r < 0) {
+            pos++;
+            skipped++;
+            continue;
+        }
+        if (last_seq >= 0 && info.seq != (uint8_t)(last_seq + 1)) gaps++;
+        last_seq = info.seq;
+        if (memcmp(y, ref + info.seq * FRAME_SAMPLES, sizeof(y)) != 0) mismatched++;
+        decoded++;
+        pos += (size_t)r;
+    }
+    printf("stream: %d of %d frames decoded, %d gaps, %d differ from the full decode, "
+           "%d bytes skipped\n", decoded, STREAM_FRAMES, gaps, mismatched, skipped);
+    return decoded == STREAM_FRAMES - 2 && gaps == 2 && mismatched == 0;
+}
+
+static bool write_stream(const char *path, uint32_t rate) {
+    const size_t n = 3 * rate;
+    int16_t *x = malloc(n * sizeof(*x));
+    FILE *f = fopen(path, "wb");
+    if (!x || !f) {
+        free(x);
+        if (f) fclose(f);
+        return false;
+    }
+    make_tone(x, n, rate, 1000.0, -12.0);
+    audio_encoder_t enc;
+    uint8_t frame[AUDIO_FRAME_MAX_SIZE(FRAME_SAMPLES)];
+    audio_encoder_init(&enc, AUDIO_CODEC_IMA_ADPCM, rate);
+    fprintf(f, "Start tests\n");
+    for (size_t i = 0; i + FRAME_SAMPLES <= n; i += FRAME_SAMPLES) {
+        if (i == 20 * FRAME_SAMPLES) fprintf(f, "debug: halfway\n");
+        fwrite(frame, 1, audio_encode_frame(&enc, x + i, FRAME_SAMPLES, frame, sizeof(frame)), f);
+    }
+    free(x);
+    fclose(f);
+    printf("written %s\n", path);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    uint32_t rate = 8000;
+    const char *write_path = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--rate") && i + 1 < argc) rate = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--write") && i + 1 < argc) write_path = argv[++i];
+        else {
+            fprintf(stderr, "usage: %s [--rate HZ] [--write FILE]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (rate < 1000 || rate > 65535) {
+        fprintf(stderr, "rate must be 1000..65535 Hz\n");
+        return 2;
+    }
+    srand(1);
+
+    bool ok = check_mulaw();
+    ok = check_sizes(rate) && ok;
+
+    const size_t n = (size_t)(SIGNAL_S * rate);
+    int16_t *x = malloc(n * sizeof(*x)), *y = malloc(n * sizeof(*y));
+    uint8_t *stream = malloc(n / FRAME_SAMPLES * AUDIO_FRAME_MAX_SIZE(FRAME_SAMPLES) +
+                             AUDIO_FRAME_MAX_SIZE(FRAME_SAMPLES));
+    if (!x || !y || !stream) return 2;
+
+    printf("\n%-8s %10s %10s %10s %10s %10s %10s\n", "codec", "KB/s", "tone -6", "tone -30",
+           "speech", "sweep", "Msample/s");
+    for (size_t c = 0; c < sizeof(codecs) / sizeof(codecs[0]); c++) {
+        double snr[4];
+        size_t bytes = 0;
+        for (int s = 0; s < 4; s++) {
+            switch (s) {
+            case 0: make_tone(x, n, rate, 1000.0, -6.0); break;
+            case 1: make_tone(x, n, rate, 1000.0, -30.0); break;
+            case 2: make_speech(x, n, rate); break;
+            case 3: make_sweep(x, n, rate); break;
+            }
+            bytes = round_trip(codecs[c], rate, x, n, y, stream);
+            if (bytes == 0) {
+                printf("%s: decode of the stream failed\n", codec_names[c]);
+                ok = false;
+            }
+            snr[s] = snr_db(x, y, n);
+        }
+
+        audio_encoder_t enc;
+        audio_encoder_init(&enc, codecs[c], rate);
+        const int reps = 50;
+        clock_t t0 = clock();
+        for (int r = 0; r < reps; r++)
+            for (size_t i = 0; i + FRAME_SAMPLES <= n; i += FRAME_SAMPLES)
+                audio_encode_frame(&enc, x + i, FRAME_SAMPLES, stream, AUDIO_FRAME_MAX_SIZE(FRAME_SAMPLES));
+        const double secs = (double)(clock() - t0) / CLOCKS_PER_SEC;
+
+        printf("%-8s %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", codec_names[c],
+               bytes / SIGNAL_S / 1024.0, snr[0], snr[1], snr[2], snr[3],
+               secs > 0 ? reps * (double)n / secs / 1e6 : 0.0);
+
+        const double min_snr = codecs[c] == AUDIO_CODEC_MULAW ? MIN_SNR_MULAW_DB :
+                               codecs[c] == AUDIO_CODEC_IMA_ADPCM ? MIN_SNR_ADPCM_DB : 200.0;
+        for (int s = 0; s < 4; s++) {
+            if (snr[s] < min_snr) {
+                printf("  FAIL: SNR below %.1f dB\n", min_snr);
+                ok = false;
+                break;
+            }
+        }
+    }
+    printf("\n");
+
+    ok = check_stream(rate) && ok;
+    if (write_path && !write_stream(write_path, rate)) ok = false;
+    free(x);
+    free(y);
+    free(stream);
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
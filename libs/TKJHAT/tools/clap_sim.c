@@ -0,0 +1,357 @@
+/*
+ * clap_sim: tkjhat/clap on synthetic sounds or on recorded .wav files.
+ *
+ * Synthetic (no files given): 60 s per case at 8 kHz, the audio pushed in
+ * microphone frames of MEMS_BUFFER_SIZE samples. A clap is a burst of noise
+ * (0.5 ms attack, 3-8 ms decay) followed by the echo of the room (noise
+ * 12-20 dB quieter, RT60 0.3-0.6 s). Claps come as singles, doubles (150-300
+ * ms apart) and triples, 2-4 s between the groups. Speech is words of one
+ * to three vowels (harmonics of a 100-220 Hz pitch shaped by two formants),
+ * some of them starting with a plosive (a short noise burst 15-50 ms before
+ * the vowel). Typing is key clicks (0.3-1 ms decay) 4-10 times a second.
+ * Every case is run with the seeds S..S+N-1 (--seeds N, 8 by default) and
+ * the limits are checked on the totals: one minute has only about 20 groups,
+ * so one seed alone passes or fails on a single group. Printed per case:
+ *   groups     groups of claps in the case
+ *   right      groups given with the right count
+ *   wrong      groups given with another count
+ *   missed     groups not given at all
+ *   false/min  groups given where there were no claps
+ *   ns/smp     time of clap_push() per sample on this computer
+ *
+ * With .wav files (16-bit PCM, mono or stereo, any rate; e.g. recorded with
+ * examples/hello_microphone/tools/record_audio.py) every group found is
+ * printed with its time, and --expect N checks that each file has N claps.
+ * --save writes the synthetic cases of seed S as clap_<case>.wav for that path.
+ *
+ * Usage:
+ *   clap_sim [--seed S] [--seeds N] [--save]
+ *   clap_sim [--expect N] file.wav...
+ *
+ * Exit code is 1 if a result is outside its limit (or a file does not have
+ * the expected claps), 2 on a bad argument or file.
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <tkjhat/clap.h>
+
+#include "sim_signal.h"
+
+#define RATE            8000
+#define FRAME           256         // MEMS_BUFFER_SIZE
+#define SECONDS         60
+#define NOISE_RMS       32.0        // room and microphone noise at volume 64, LSB
+#define MAX_GROUPS      64
+#define HIT_LIMIT       0.90        // least share of groups with the right count
+#define FALSE_LIMIT     1.0         // most false groups per minute
+
+typedef struct {
+    const char *name;
+    double clap;                    // rms of a clap (0 = none)
+    double echo_db;                 // echo under the clap
+    double speech;                  // vowel amplitude (0 = no speech)
+    bool typing;
+    double hit_limit;               // 0 = not checked (no claps)
+} case_t;
+
+static const case_t cases[] = {
+    { "quiet",   6000, -18,    0, false, HIT_LIMIT },
+    { "far",     2500, -12,    0, false, HIT_LIMIT },
+    { "speech",  6000, -18, 1500, false, HIT_LIMIT },
+    { "talk",       0,   0, 3000, false, 0 },
+    { "shout",      0,   0, 8000, false, 0 },
+    { "typing",     0,   0,    0, true,  0 },
+    { "all",     6000, -15, 1500, true,  HIT_LIMIT },
+};
+
+typedef struct {
+    size_t first, last;             // sample of the first and last clap
+    int count;
+} group_t;
+
+static void add_clap(double *x, size_t n, size_t t, const case_t *c) {
+    const double rms = c->clap * (0.6 + 0.4 * sim_urand());
+    sim_add_burst(x, n, t, rms, 0.0005, 0.003 + 0.005 * sim_urand(), RATE);
+    const double rt60 = 0.3 + 0.3 * sim_urand();
+    const double echo = rms * pow(10.0, (c->echo_db - 4.0 * sim_urand()) / 20.0);
+    sim_add_burst(x, n, t + (size_t)(0.002 * RATE), echo, 0.003, rt60 / 6.9, RATE);
+}
+
+static size_t add_claps(double *x, size_t n, const case_t *c, group_t *groups) {
+    size_t count = 0, t = (size_t)(1.0 * RATE);
+    while (t < n - 2 * RATE && count < MAX_GROUPS) {
+        group_t *g = &groups[count++];
+        const double r = sim_urand();
+        g->count = r < 0.5 ? 1 : r < 0.85 ? 2 : 3;
+        g->first = t;
+        for (int k = 0; k < g->count; k++) {
+            add_clap(x, n, t, c);
+            g->last = t;
+            t += (size_t)((0.15 + 0.15 * sim_urand()) * RATE);
+        }
+        t = g->last + (size_t)((2.0 + 2.0 * sim_urand()) * RATE);
+    }
+    return count;
+}
+
+// Words, some starting with a plosive
+static void add_speech(double *x, size_t n, double amp) {
+    static const struct sim_word word = { 0.02, 0.02, 0.0 };
+    size_t t = (size_t)(0.3 * RATE);
+    while (t < n - RATE) {
+        const double level = amp * (0.5 + 0.5 * sim_urand());
+        if (sim_urand() < 0.5) {
+            const double rms = level * (0.2 + 0.3 * sim_urand());
+            sim_add_burst(x, n, t, rms, 0.001, 0.003 + 0.005 * sim_urand(), RATE);
+            t += (size_t)((0.015 + 0.035 * sim_urand()) * RATE);
+        }
+        t = sim_add_word(x, NULL, n, t, level, &word, RATE);
+        t += (size_t)((0.1 + 0.5 * sim_urand()) * RATE);
+    }
+}
+
+static void add_typing(double *x, size_t n) {
+    for (size_t t = (size_t)(0.2 * RATE); t < n; t += (size_t)((0.1 + 0.15 * sim_urand()) * RATE)) {
+        const double rms = 400.0 + 1200.0 * sim_urand();
+        sim_add_burst(x, n, t, rms, 0.0002, 0.0003 + 0.0007 * sim_urand(), RATE);
+    }
+}
+
+typedef struct {
+    size_t truth;                   // groups of claps
+    int right, wrong, false_groups;
+    double ns;                      // sum of the ns/smp of the seeds
+} tally_t;
+
+typedef struct {
+    double t;                       // end of the group, s
+    uint8_t count;
+} event_t;
+
+// Runs the detector over pcm in microphone frames; returns the number of groups
+static size_t detect(const int16_t *pcm, size_t n, uint32_t rate, event_t *events, size_t max_events,
+                     double *ns) {
+    static clap_t clap;
+    struct clap_config cfg;
+    clap_default_config(&cfg, rate);
+    if (clap_init(&clap, &cfg) != 0) return 0;
+    size_t count = 0;
+    clock_t t0 = clock();
+    for (size_t f = 0; f < n; f += FRAME) {
+        const size_t m = n - f < FRAME ? n - f : FRAME;
+        const uint8_t group = clap_push(&clap, pcm + f, m);
+        if (group && count < max_events) {
+            events[count].t = (double)(f + m) / rate;
+            events[count].count = group;
+            count++;
+        }
+    }
+    if (ns) *ns = (double)(clock() - t0) / CLOCKS_PER_SEC * 1e9 / n;
+    return count;
+}
+
+static bool write_wav(const char *path, const int16_t *pcm, size_t n, uint32_t rate) {
+    FILE *f = fopen(path, "wb");
+    if (!f) return false;
+    const uint32_t data = (uint32_t)(n * 2);
+    uint8_t h[44];
+    memcpy(h, "RIFF", 4);
+    const uint32_t riff = 36 + data, fmt_size = 16, byte_rate = rate * 2;
+    const uint16_t pcm_format = 1, channels = 1, align = 2, bits = 16;
+    // The header fields are little endian, like the host
+    memcpy(h + 4, &riff, 4);
+    memcpy(h + 8, "WAVEfmt ", 8);
+    memcpy(h + 16, &fmt_size, 4);
+    memcpy(h + 20, &pcm_format, 2);
+    memcpy(h + 22, &channels, 2);
+    memcpy(h + 24, &rate, 4);
+    memcpy(h + 28, &byte_rate, 4);
+    memcpy(h + 32, &align, 2);
+    memcpy(h + 34, &bits, 2);
+    memcpy(h + 36, "data", 4);
+    memcpy(h + 40, &data, 4);
+    const bool ok = fwrite(h, 1, sizeof(h), f) == sizeof(h) && fwrite(pcm, 2, n, f) == n;
+    fclose(f);
+    return ok;
+}
+
+// 16-bit PCM .wav, the first channel; returns the samples (malloc) or NULL
+static int16_t *read_wav(const char *path, size_t *n, uint32_t *rate) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "%s: cannot open\n", path);
+        return NULL;
+    }
+    uint8_t h[12], chunk[8];
+    uint16_t format = 0, channels = 0, bits = 0;
+    int16_t *pcm = NULL;
+    if (fread(h, 1, 12, f) != 12 || memcmp(h, "RIFF", 4) || memcmp(h + 8, "WAVE", 4)) {
+        fprintf(stderr, "%s: not a .wav file\n", path);
+        goto out;
+    }
+    while (fread(chunk, 1, 8, f) == 8) {
+        uint32_t size;
+        memcpy(&size, chunk + 4, 4);
+        if (!memcmp(chunk, "fmt ", 4) && size >= 16) {
+            uint8_t fmt[16];
+            if (fread(fmt, 1, 16, f) != 16) break;
+            memcpy(&format, fmt, 2);
+            memcpy(&channels, fmt + 2, 2);
+            memcpy(rate, fmt + 4, 4);
+            memcpy(&bits, fmt + 14, 2);
+            fseek(f, (long)(size - 16 + (size & 1)), SEEK_CUR);
+        } else if (!memcmp(chunk, "data", 4)) {
+            if (format != 1 || bits != 16 || channels == 0 || *rate == 0) {
+                fprintf(stderr, "%s: only 16-bit PCM is supported\n", path);
+                goto out;
+            }
+            const size_t frames = size / (2u * channels);
+            int16_t *raw = malloc(frames * channels * sizeof(*raw));
+            pcm = malloc(frames * sizeof(*pcm) + sizeof(*pcm));
+            if (!raw || !pcm) {
+                free(raw);
+                free(pcm);
+                pcm = NULL;
+                goto out;
+            }
+            *n = fread(raw, 2u * channels, frames, f);
+            for (size_t i = 0; i < *n; i++) pcm[i] = raw[i * channels];
+            free(raw);
+            goto out;
+        } else {
+            fseek(f, (long)(size + (size & 1)), SEEK_CUR);
+        }
+    }
+    fprintf(stderr, "%s: no data chunk\n", path);
+out:
+    fclose(f);
+    return pcm;
+}
+
+static int run_files(int count, char **paths, int expect) {
+    bool ok = true;
+    for (int i = 0; i < count; i++) {
+        size_t n = 0;
+        uint32_t rate = 0;
+        int16_t *pcm = read_wav(paths[i], &n, &rate);
+        if (!pcm) return 2;
+        event_t events[256];
+        double ns;
+        const size_t groups = detect(pcm, n, rate, events, 256, &ns);
+        int claps = 0;
+        printf("%s: %.1f s at %lu Hz\n", paths[i], (double)n / rate, (unsigned long)rate);
+        for (size_t k = 0; k < groups; k++) {
+            printf("  %8.2f s  %u clap%s\n", events[k].t, events[k].count, events[k].count > 1 ? "s" : "");
+            claps += events[k].count;
+        }
+        const bool pass = expect < 0 || claps == expect;
+        ok = ok && pass;
+        printf("  %d claps in %zu groups%s\n", claps, groups, pass ? "" : "  <-- FAIL");
+        free(pcm);
+    }
+    if (expect >= 0) printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+    unsigned seed = 1, seeds = 8;
+    int expect = -1, first_file = argc;
+    bool save = false;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--seed") && i + 1 < argc) seed = (unsigned)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--seeds") && i + 1 < argc) seeds = (unsigned)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--expect") && i + 1 < argc) expect = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--save")) save = true;
+        else if (argv[i][0] != '-') {
+            first_file = i;
+            break;
+        } else {
+            fprintf(stderr, "usage: %s [--seed S] [--seeds N] [--save]\n       %s [--expect N] file.wav...\n", argv[0],
+                    argv[0]);
+            return 2;
+        }
+    }
+    if (first_file < argc) return run_files(argc - first_file, argv + first_file, expect);
+    if (seeds == 0) {
+        fprintf(stderr, "--seeds must be at least 1\n");
+        return 2;
+    }
+    const size_t n = SECONDS * RATE;
+    double *x = malloc(n * sizeof(*x));
+    int16_t *pcm = malloc(n * sizeof(*pcm));
+    if (!x || !pcm) return 2;
+
+    enum { CASES = sizeof(cases) / sizeof(cases[0]) };
+    tally_t tally[CASES] = {0};
+    for (unsigned s = 0; s < seeds; s++) {
+        srand(seed + s);
+        for (size_t c = 0; c < CASES; c++) {
+            const case_t *cs = &cases[c];
+            group_t groups[MAX_GROUPS];
+            size_t truth = 0;
+            for (size_t i = 0; i < n; i++) x[i] = NOISE_RMS * sim_gauss();
+            if (cs->speech > 0) add_speech(x, n, cs->speech);
+            if (cs->typing) add_typing(x, n);
+            if (cs->clap > 0) truth = add_claps(x, n, cs, groups);
+            for (size_t i = 0; i < n; i++) pcm[i] = sim_sat(x[i], 32700.0);
+
+            event_t events[256];
+            double ns;
+            const size_t found = detect(pcm, n, RATE, events, 256, &ns);
+
+            // A group given from its first clap to 1 s after the last one belongs to it
+            tally_t *t = &tally[c];
+            bool *used = calloc(truth + 1, sizeof(*used));
+            for (size_t k = 0; k < found; k++) {
+                const double te = events[k].t;
+                size_t g = 0;
+                while (g < truth &&
+                       !(te >= (double)groups[g].first / RATE && te <= (double)groups[g].last / RATE + 1.0))
+                    g++;
+                if (g == truth || used[g]) {
+                    t->false_groups++;
+                } else {
+                    used[g] = true;
+                    if (events[k].count == groups[g].count) t->right++;
+                    else t->wrong++;
+                }
+            }
+            free(used);
+            t->truth += truth;
+            t->ns += ns;
+
+            if (save && s == 0) {
+                char path[64];
+                snprintf(path, sizeof(path), "clap_%s.wav", cs->name);
+                if (write_wav(path, pcm, n, RATE)) printf("written %s\n", path);
+            }
+        }
+    }
+
+    printf("seeds %u..%u, %u min per case\n", seed, seed + seeds - 1, seeds * SECONDS / 60);
+    printf("%-8s %7s %7s %7s %7s %10s %7s\n", "case", "groups", "right", "wrong", "missed", "false/min",
+           "ns/smp");
+    bool ok = true;
+    for (size_t c = 0; c < CASES; c++) {
+        const case_t *cs = &cases[c];
+        const tally_t *t = &tally[c];
+        const int missed = (int)t->truth - t->right - t->wrong;
+        const double false_min = t->false_groups * 60.0 / ((double)seeds * SECONDS);
+        const bool pass = (cs->hit_limit == 0 || t->right >= cs->hit_limit * t->truth) && false_min <= FALSE_LIMIT;
+        ok = ok && pass;
+        printf("%-8s %7zu %7d %7d %7d %10.2f %7.2f%s\n", cs->name, t->truth, t->right, t->wrong, missed,
+               false_min, t->ns / seeds, pass ? "" : "  <-- FAIL");
+    }
+    free(x);
+    free(pcm);
+    printf("\nlimits: right >= %.0f %% of the groups, false <= %.1f groups/min\n", HIT_LIMIT * 100.0, FALSE_LIMIT);
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,198 @@
+/*
+ * fft_check: accuracy and speed of tkjhat/fft against a double precision DFT.
+ *
+ * For every size (64..512) and window the same blocks go through
+ * fft_spectrum_db() and through a direct DFT in double precision:
+ *
+ *   - tones at 0, -20, -40 and -60 dBFS between two bins, plus 20 LSB of
+ *     noise: error of the peak bin, and the largest error in the bins the
+ *     reference puts within 50 dB of the peak
+ *   - the same tone with no noise: dynamic range, i.e. the peak over the
+ *     loudest fixed-point bin where the reference is below -100 dB relative
+ *     (what the arithmetic adds; not for 64 points, where the window
+ *     sidelobes never fall that low)
+ *   - white noise at 10 and 1000 LSB rms: average level error (block floating
+ *     point keeps quiet blocks as accurate as loud ones)
+ *
+ * Speed: microseconds per transform on this computer. The hat_spectrum
+ * example prints the cycles per transform on the board.
+ *
+ * Usage:
+ *   fft_check [--verbose]
+ *
+ * Exit code is 1 if an error is above its limit.
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <tkjhat/fft.h>
+
+#define PEAK_LIMIT_DB       0.1     // peak bin
+#define NEAR_DB             50.0    // bins this near the peak are compared
+#define NEAR_LIMIT_DB       0.5     // and may be this much off
+#define RANGE_LIMIT_DB      70.0    // least dynamic range
+#define NOISE_LIMIT_DB      0.5     // average level of white noise
+
+static double gauss(void) {
+    double u = (rand() + 1.0) / (RAND_MAX + 2.0), v = rand() / (RAND_MAX + 1.0);
+    return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * v);
+}
+
+static int16_t sat(double x) {
+    x = x < 0 ? x - 0.5 : x + 0.5;
+    if (x > 32767) return 32767;
+    if (x < -32768) return -32768;
+    return (int16_t)x;
+}
+
+static double window(fft_window_t w, size_t i, size_t n) {
+    return w == FFT_WINDOW_HANN ? 0.5 - 0.5 * cos(2.0 * M_PI * i / n) : 1.0;
+}
+
+// Reference: dBFS of bins 0..n/2-1, same scale as fft_spectrum_db()
+static void reference_db(const int16_t *x, size_t n, fft_window_t w, double *db) {
+    double sum = 0.0;
+    for (size_t i = 0; i < n; i++) sum += window(w, i, n);
+    const double ref = 32767.0 * sum / 2.0;
+    for (size_t k = 0; k < n / 2; k++) {
+        double re = 0.0, im = 0.0;
+        for (size_t i = 0; i < n; i++) {
+            const double v = x[i] * window(w, i, n), a = 2.0 * M_PI * (double)(k * i % n) / n;
+            re += v * cos(a);
+            im -= v * sin(a);
+        }
+        const double mag = sqrt(re * re + im * im) / ref;
+        db[k] = mag > 1e-6 ? 20.0 * log10(mag) : -120.0;
+    }
+}
+
+static void tone(int16_t *x, size_t n, double dbfs, double bin, double noise) {
+    const double amp = 32767.0 * pow(10.0, dbfs / 20.0);
+    for (size_t i = 0; i < n; i++)
+        x[i] = sat(amp * sin(2.0 * M_PI * bin * i / n + 0.3) + noise * gauss());
+}
+
+typedef struct {
+    double peak_err, near_err, range, noise_err;
+} result_t;
+
+static void check(size_t n, fft_window_t w, result_t *r, bool verbose) {
+    static fft_t f;
+    struct fft_config cfg;
+    fft_default_config(&cfg, (uint16_t)n);
+    cfg.window = w;
+    if (fft_init(&f, &cfg) != 0) {
+        fprintf(stderr, "fft_init(%zu) failed\n", n);
+        exit(2);
+    }
+    int16_t x[FFT_MAX_SIZE], db_q8[FFT_MAX_SIZE / 2];
+    double ref[FFT_MAX_SIZE / 2];
+    memset(r, 0, sizeof(*r));
+    r->range = -1.0;
+
+    static const double levels[] = { 0.0, -20.0, -40.0, -60.0 };
+    for (size_t l = 0; l < sizeof(levels) / sizeof(levels[0]); l++) {
+        // Tone with noise
+        const double bin = n / 8.0 + 0.37;
+        tone(x, n, levels[l] - 0.5, bin, 20.0);
+        fft_spectrum_db(&f, x, db_q8);
+        reference_db(x, n, w, ref);
+        size_t peak = 0;
+        for (size_t k = 1; k < n / 2; k++)
+            if (ref[k] > ref[peak]) peak = k;
+        double e = fabs(db_q8[peak] / 256.0 - ref[peak]);
+        if (e > r->peak_err) r->peak_err = e;
+        for (size_t k = 0; k < n / 2; k++) {
+            if (ref[k] < ref[peak] - NEAR_DB) continue;
+            e = fabs(db_q8[k] / 256.0 - ref[k]);
+            if (e > r->near_err) r->near_err = e;
+        }
+        if (verbose)
+            printf("  %3zu %s %4.0f dBFS: peak %7.2f ref %7.2f\n", n, w == FFT_WINDOW_HANN ? "hann" : "rect",
+                   levels[l], db_q8[peak] / 256.0, ref[peak]);
+
+        // Clean tone: dynamic range of the arithmetic (Hann only, the rectangular
+        // window leaks everywhere)
+        if (w == FFT_WINDOW_HANN) {
+            tone(x, n, levels[l] - 0.5, bin, 0.0);
+            fft_spectrum_db(&f, x, db_q8);
+            reference_db(x, n, w, ref);
+            double worst = -200.0;
+            for (size_t k = 0; k < n / 2; k++)
+                if (ref[k] < ref[peak] - 100.0 && db_q8[k] / 256.0 > worst) worst = db_q8[k] / 256.0;
+            if (worst > -200.0 && (r->range < 0.0 || ref[peak] - worst < r->range)) r->range = ref[peak] - worst;
+        }
+    }
+
+    // White noise: mean level over many blocks
+    static const double rms[] = { 10.0, 1000.0 };
+    for (size_t l = 0; l < 2; l++) {
+        double sum_fixed = 0.0, sum_ref = 0.0;
+        for (int b = 0; b < 20; b++) {
+            for (size_t i = 0; i < n; i++) x[i] = sat(rms[l] * gauss());
+            fft_spectrum_db(&f, x, db_q8);
+            reference_db(x, n, w, ref);
+            for (size_t k = 1; k < n / 2; k++) {
+                sum_fixed += pow(10.0, db_q8[k] / 2560.0);
+                sum_ref += pow(10.0, ref[k] / 10.0);
+            }
+        }
+        const double e = fabs(10.0 * log10(sum_fixed / sum_ref));
+        if (e > r->noise_err) r->noise_err = e;
+    }
+}
+
+static double speed_us(size_t n) {
+    static fft_t f;
+    struct fft_config cfg;
+    fft_default_config(&cfg, (uint16_t)n);
+    fft_init(&f, &cfg);
+    int16_t x[FFT_MAX_SIZE], db_q8[FFT_MAX_SIZE / 2];
+    tone(x, n, -20.0, n / 8.0 + 0.37, 100.0);
+    const int reps = 20000;
+    volatile int16_t sink = 0;
+    clock_t t0 = clock();
+    for (int r = 0; r < reps; r++) {
+        x[r & 7] ^= 1;
+        fft_spectrum_db(&f, x, db_q8);
+        sink ^= db_q8[n / 8];
+    }
+    (void)sink;
+    return (double)(clock() - t0) / CLOCKS_PER_SEC * 1e6 / reps;
+}
+
+int main(int argc, char **argv) {
+    bool verbose = argc > 1 && !strcmp(argv[1], "--verbose");
+    srand(1);
+
+    printf("size window  peak err  near err  range dB  noise err   us/FFT\n");
+    bool ok = true;
+    for (size_t n = FFT_MIN_SIZE; n <= FFT_MAX_SIZE; n *= 2) {
+        for (int w = FFT_WINDOW_RECT; w <= FFT_WINDOW_HANN; w++) {
+            result_t r;
+            check(n, (fft_window_t)w, &r, verbose);
+            bool pass = r.peak_err <= PEAK_LIMIT_DB && r.near_err <= NEAR_LIMIT_DB && r.noise_err <= NOISE_LIMIT_DB &&
+                        (r.range < 0.0 || r.range >= RANGE_LIMIT_DB);
+            ok = ok && pass;
+            if (w == FFT_WINDOW_HANN && r.range >= 0.0)
+                printf("%4zu %-6s %9.3f %9.3f %9.1f %10.3f %8.2f%s\n", n, "hann", r.peak_err, r.near_err, r.range,
+                       r.noise_err, speed_us(n), pass ? "" : "  <-- FAIL");
+            else if (w == FFT_WINDOW_HANN)
+                printf("%4zu %-6s %9.3f %9.3f %9s %10.3f %8.2f%s\n", n, "hann", r.peak_err, r.near_err, "-",
+                       r.noise_err, speed_us(n), pass ? "" : "  <-- FAIL");
+            else
+                printf("%4zu %-6s %9.3f %9.3f %9s %10.3f %8s%s\n", n, "rect", r.peak_err, r.near_err, "-",
+                       r.noise_err, "", pass ? "" : "  <-- FAIL");
+        }
+    }
+    printf("\nlimits: peak %.1f dB, near %.1f dB, range %.0f dB, noise %.1f dB\n", PEAK_LIMIT_DB, NEAR_LIMIT_DB,
+           RANGE_LIMIT_DB, NOISE_LIMIT_DB);
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,259 @@
+/*
+ * fusion_replay: host accuracy check for tkjhat/imu_fusion.
+ *
+ * Runs the fixed-point filter and a float Mahony filter (same equations, same
+ * gains) side by side and prints the angle difference between them.
+ *
+ * Usage:
+ *   fusion_replay [options] data.csv
+ *   fusion_replay [options] --synthetic
+ *
+ * The CSV file contains one raw sample per line: ax,ay,az,gx,gy,gz (LSB, as
+ * returned by ICM42670_read_sensor_data_raw() / ICM42670_fifo_read()). Lines
+ * that do not start with a number (e.g. a header) are skipped.
+ *
+ * --synthetic generates a known motion (tilt around X and Y, rotation around Z)
+ * and additionally compares roll / pitch against the true angles.
+ *
+ * Options:
+ *   --odr HZ      Sample rate (default 400)
+ *   --afsr G      Accelerometer full-scale range in g (default 4)
+ *   --gfsr DPS    Gyroscope full-scale range in dps (default 500)
+ *   --kp K        Proportional gain (default IMU_FUSION_KP_DEFAULT)
+ *   --ki K        Integral gain (default IMU_FUSION_KI_DEFAULT)
+ *   --print N     Print the angles every N samples
+ *
+ * Exit code is 1 if the maximum roll / pitch difference to the float filter is
+ * above 0.5 degrees.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <tkjhat/imu_fusion.h>
+
+#define DEG(x)          ((x) * 57.29577951308232)
+#define MAX_ERROR_DEG   0.5
+
+typedef struct {
+    double q0, q1, q2, q3;
+    double ix, iy, iz;
+    double kp, ki, dt, rad_per_lsb;
+} ref_filter_t;
+
+static void ref_init(ref_filter_t *r, const struct imu_fusion_config *cfg) {
+    memset(r, 0, sizeof(*r));
+    r->q0 = 1.0;
+    r->kp = cfg->kp;
+    r->ki = cfg->ki;
+    r->dt = 1.0 / cfg->odr_hz;
+    r->rad_per_lsb = (cfg->gyro_fsr_dps / 32768.0) * (M_PI / 180.0);
+}
+
+static void ref_update(ref_filter_t *r, const icm42670_raw_sample_t *s, double lsb_per_g) {
+    double gx = s->gx * r->rad_per_lsb, gy = s->gy * r->rad_per_lsb, gz = s->gz * r->rad_per_lsb;
+    double ax = s->ax, ay = s->ay, az = s->az;
+    double norm = sqrt(ax * ax + ay * ay + az * az);
+
+    if (norm >= 0.5 * lsb_per_g && norm <= 1.5 * lsb_per_g) {
+        ax /= norm; ay /= norm; az /= norm;
+        double vx = 2 * (r->q1 * r->q3 - r->q0 * r->q2);
+        double vy = 2 * (r->q0 * r->q1 + r->q2 * r->q3);
+        double vz = r->q0 * r->q0 - r->q1 * r->q1 - r->q2 * r->q2 + r->q3 * r->q3;
+        double ex = ay * vz - az * vy;
+        double ey = az * vx - ax * vz;
+        double ez = ax * vy - ay * vx;
+        if (r->ki > 0) {
+            r->ix += r->ki * ex * r->dt;
+            r->iy += r->ki * ey * r->dt;
+            r->iz += r->ki * ez * r->dt;
+        }
+        gx += r->kp * ex + r->ix;
+        gy += r->kp * ey + r->iy;
+        gz += r->kp * ez + r->iz;
+    } else {
+        gx += r->ix; gy += r->iy; gz += r->iz;
+    }
+
+    double hx = 0.5 * gx * r->dt, hy = 0.5 * gy * r->dt, hz = 0.5 * gz * r->dt;
+    double q0 = r->q0, q1 = r->q1, q2 = r->q2, q3 = r->q3;
+    r->q0 = q0 - q1 * hx - q2 * hy - q3 * hz;
+    r->q1 = q1 + q0 * hx + q2 * hz - q3 * hy;
+    r->q2 = q2 + q0 * hy - q1 * hz + q3 * hx;
+    r->q3 = q3 + q0 * hz + q1 * hy - q2 * hx;
+    double n = sqrt(r->q0 * r->q0 + r->q1 * r->q1 + r->q2 * r->q2 + r->q3 * r->q3);
+    r->q0 /= n; r->q1 /= n; r->q2 /= n; r->q3 /= n;
+}
+
+static void ref_euler(const ref_filter_t *r, double *roll, double *pitch, double *yaw) {
+    *roll = DEG(atan2(2 * (r->q0 * r->q1 + r->q2 * r->q3), 1 - 2 * (r->q1 * r->q1 + r->q2 * r->q2)));
+    double sinp = 2 * (r->q0 * r->q2 - r->q3 * r->q1);
+    if (sinp > 1) sinp = 1;
+    if (sinp < -1) sinp = -1;
+    *pitch = DEG(asin(sinp));
+    *yaw = DEG(atan2(2 * (r->q0 * r->q3 + r->q1 * r->q2), 1 - 2 * (r->q2 * r->q2 + r->q3 * r->q3)));
+}
+
+static double wrap180(double a) {
+    while (a > 180) a -= 360;
+    while (a < -180) a += 360;
+    return a;
+}
+
+typedef struct {
+    double max, sum_sq;
+    unsigned long n;
+} err_stat_t;
+
+static void err_add(err_stat_t *e, double d) {
+    d = fabs(wrap180(d));
+    if (d > e->max) e->max = d;
+    e->sum_sq += d * d;
+    e->n++;
+}
+
+static void err_print(const char *name, const err_stat_t *e) {
+    printf("  %-6s max %.3f deg, rms %.3f deg\n", name, e->max, e->n ? sqrt(e->sum_sq / e->n) : 0.0);
+}
+
+// Synthetic motion: roll and pitch oscillate +-60 / +-40 degrees, yaw turns at
+// 30 dps. Gyro rates are the body rates of that motion; gravity is rotated into
+// the body frame. Small deterministic noise is added to both sensors.
+static void synth_sample(double t, const struct imu_fusion_config *cfg,
+                         icm42670_raw_sample_t *s, double *roll, double *pitch) {
+    const double wr = 2 * M_PI * 0.2, wp = 2 * M_PI * 0.13;
+    double phi = 60 * M_PI / 180 * sin(wr * t);
+    double theta = 40 * M_PI / 180 * sin(wp * t);
+    double dphi = 60 * M_PI / 180 * wr * cos(wr * t);
+    double dtheta = 40 * M_PI / 180 * wp * cos(wp * t);
+    double dpsi = 30 * M_PI / 180;
+
+    // ZYX Euler rates to body rates
+    double p = dphi - dpsi * sin(theta);
+    double q = dtheta * cos(phi) + dpsi * cos(theta) * sin(phi);
+    double r = -dtheta * sin(phi) + dpsi * cos(theta) * cos(phi);
+
+    double lsb_per_g = 32768.0 / cfg->accel_fsr_g;
+    double lsb_per_rad = 32768.0 / (cfg->gyro_fsr_dps * M_PI / 180);
+    double noise_a = ((rand() % 201) - 100) * 0.0005;
+    double noise_g = ((rand() % 201) - 100) * 0.0001;
+
+    s->ax = (int16_t)lrint((-sin(theta) + noise_a) * lsb_per_g);
+    s->ay = (int16_t)lrint((cos(theta) * sin(phi) - noise_a) * lsb_per_g);
+    s->az = (int16_t)lrint((cos(theta) * cos(phi) + noise_a) * lsb_per_g);
+    s->gx = (int16_t)lrint((p + noise_g) * lsb_per_rad);
+    s->gy = (int16_t)lrint((q - noise_g) * lsb_per_rad);
+    s->gz = (int16_t)lrint((r + noise_g) * lsb_per_rad);
+    s->temp = 0;
+    *roll = DEG(phi);
+    *pitch = DEG(theta);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [--odr HZ] [--afsr G] [--gfsr DPS] [--kp K] [--ki K] [--print N] "
+                    "(data.csv | --synthetic)\n", prog);
+}
+
+int main(int argc, char **argv) {
+    struct imu_fusion_config cfg = {
+        .odr_hz = 400, .accel_fsr_g = 4, .gyro_fsr_dps = 500,
+        .kp = IMU_FUSION_KP_DEFAULT, .ki = IMU_FUSION_KI_DEFAULT,
+        .publish_divider = 1,
+    };
+    const char *path = NULL;
+    int synthetic = 0;
+    long print_every = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--synthetic")) synthetic = 1;
+        else if (!strcmp(argv[i], "--odr") && i + 1 < argc) cfg.odr_hz = (uint16_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--afsr") && i + 1 < argc) cfg.accel_fsr_g = (uint16_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--gfsr") && i + 1 < argc) cfg.gyro_fsr_dps = (uint16_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--kp") && i + 1 < argc) cfg.kp = (float)atof(argv[++i]);
+        else if (!strcmp(argv[i], "--ki") && i + 1 < argc) cfg.ki = (float)atof(argv[++i]);
+        else if (!strcmp(argv[i], "--print") && i + 1 < argc) print_every = atol(argv[++i]);
+        else if (argv[i][0] != '-' && !path) path = argv[i];
+        else { usage(argv[0]); return 2; }
+    }
+    if (!synthetic && !path) { usage(argv[0]); return 2; }
+
+    imu_fusion_t f;
+    int rc = imu_fusion_init(&f, &cfg);
+    if (rc != 0) {
+        fprintf(stderr, "imu_fusion_init failed (%d)\n", rc);
+        return 2;
+    }
+    ref_filter_t ref;
+    ref_init(&ref, &cfg);
+    const double lsb_per_g = 32768.0 / cfg.accel_fsr_g;
+
+    FILE *in = NULL;
+    if (!synthetic) {
+        in = fopen(path, "r");
+        if (!in) { perror(path); return 2; }
+    }
+
+    err_stat_t e_roll = {0}, e_pitch = {0}, e_yaw = {0}, t_roll = {0}, t_pitch = {0};
+    unsigned long n = 0;
+    const unsigned long synth_samples = 60UL * cfg.odr_hz;
+    char line[256];
+
+    while (1) {
+        icm42670_raw_sample_t s;
+        double true_roll = 0, true_pitch = 0;
+
+        if (synthetic) {
+            if (n >= synth_samples) break;
+            synth_sample((double)n / cfg.odr_hz, &cfg, &s, &true_roll, &true_pitch);
+        } else {
+            if (!fgets(line, sizeof(line), in)) break;
+            int v[6];
+            if (sscanf(line, "%d,%d,%d,%d,%d,%d", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5]) != 6) continue;
+            s.ax = (int16_t)v[0]; s.ay = (int16_t)v[1]; s.az = (int16_t)v[2];
+            s.gx = (int16_t)v[3]; s.gy = (int16_t)v[4]; s.gz = (int16_t)v[5];
+            s.temp = 0;
+        }
+
+        imu_fusion_update(&f, &s);
+        ref_update(&ref, &s, lsb_per_g);
+        n++;
+
+        imu_orientation_t o;
+        imu_fusion_get_orientation(&f, &o);
+        double rr, rp, ry;
+        ref_euler(&ref, &rr, &rp, &ry);
+
+        // Skip the first second: both filters converge from identity
+        if (n > cfg.odr_hz) {
+            err_add(&e_roll, o.roll_cdeg / 100.0 - rr);
+            err_add(&e_pitch, o.pitch_cdeg / 100.0 - rp);
+            err_add(&e_yaw, o.yaw_cdeg / 100.0 - ry);
+            if (synthetic) {
+                err_add(&t_roll, o.roll_cdeg / 100.0 - true_roll);
+                err_add(&t_pitch, o.pitch_cdeg / 100.0 - true_pitch);
+            }
+        }
+        if (print_every > 0 && n % (unsigned long)print_every == 0) {
+            printf("%lu fixed %.2f %.2f %.2f float %.2f %.2f %.2f\n", n,
+                   o.roll_cdeg / 100.0, o.pitch_cdeg / 100.0, o.yaw_cdeg / 100.0, rr, rp, ry);
+        }
+    }
+    if (in) fclose(in);
+
+    printf("%lu samples @ %u Hz\n", n, cfg.odr_hz);
+    printf("Fixed point vs float filter:\n");
+    err_print("roll", &e_roll);
+    err_print("pitch", &e_pitch);
+    err_print("yaw", &e_yaw);
+    if (synthetic) {
+        printf("Fixed point vs true motion:\n");
+        err_print("roll", &t_roll);
+        err_print("pitch", &t_pitch);
+    }
+
+    int ok = e_roll.max <= MAX_ERROR_DEG && e_pitch.max <= MAX_ERROR_DEG;
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,357 @@
+/*
+ * gesture_replay: offline evaluation and tuning of tkjhat/gesture.
+ *
+ * Replays a labelled IMU session through the recognizer and reports accuracy
+ * (per class precision / recall and confusion matrix) and the cost per sample.
+ *
+ * Usage:
+ *   gesture_replay [options] session.csv
+ *   gesture_replay [options] --synthetic N
+ *
+ * Session CSV: one raw sample per line, ax,ay,az,gx,gy,gz[,label]
+ * The optional label marks the sample where a gesture starts: '.' for a dot,
+ * '-' for a dash. Lines that do not start with a number are skipped.
+ *
+ * --synthetic N generates a session with N random dots and dashes, plus
+ * distractors (slow tilts and sideways wobbles) that must not be detected.
+ * Use --save to write it as a session CSV.
+ *
+ * Options (recognizer configuration, defaults from gesture_default_config()):
+ *   --odr HZ --afsr G --start-mg MG --stop-mg MG --stop-ms MS
+ *   --min-ms MS --max-ms MS --refractory-ms MS
+ * Evaluation:
+ *   --tolerance-ms MS   A detection matches a label if the gesture started at
+ *                       most this far from the label (default 300)
+ *   --features FILE     Write the features of every segmented gesture (CSV),
+ *                       with the matched label, for training a new tree
+ *   --seed S            Random seed for --synthetic
+ *   --save FILE         Save the synthetic session
+ *
+ * Exit code is 1 if the accuracy is below 90 %.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <tkjhat/gesture.h>
+
+#define MIN_ACCURACY    0.90
+
+typedef struct {
+    icm42670_raw_sample_t s;
+    char label;                 // '.', '-' or 0
+} rec_t;
+
+typedef struct {
+    rec_t *r;
+    size_t n, cap;
+} session_t;
+
+static void push_rec(session_t *ss, const icm42670_raw_sample_t *s, char label) {
+    if (ss->n == ss->cap) {
+        ss->cap = ss->cap ? ss->cap * 2 : 4096;
+        ss->r = realloc(ss->r, ss->cap * sizeof(rec_t));
+        if (!ss->r) { perror("realloc"); exit(2); }
+    }
+    ss->r[ss->n].s = *s;
+    ss->r[ss->n].label = label;
+    ss->n++;
+}
+
+static int load_csv(const char *path, session_t *ss) {
+    FILE *in = fopen(path, "r");
+    if (!in) { perror(path); return -1; }
+    char line[256];
+    while (fgets(line, sizeof(line), in)) {
+        int v[6];
+        char label = 0;
+        int pos = 0;
+        if (sscanf(line, "%d,%d,%d,%d,%d,%d%n", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &pos) != 6) continue;
+        if (line[pos] == ',' && (line[pos + 1] == '.' || line[pos + 1] == '-')) label = line[pos + 1];
+        icm42670_raw_sample_t s = {
+            (int16_t)v[0], (int16_t)v[1], (int16_t)v[2], (int16_t)v[3], (int16_t)v[4], (int16_t)v[5], 0
+        };
+        push_rec(ss, &s, label);
+    }
+    fclose(in);
+    return 0;
+}
+
+/* ---------------- synthetic session ---------------- */
+
+static double urand(double lo, double hi) {
+    return lo + (hi - lo) * (rand() / (double)RAND_MAX);
+}
+
+static double gauss(void) {
+    double u = urand(1e-9, 1), v = urand(0, 1);
+    return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+// Biphasic pulse (push and stop) of length 1, shape in [-1, 1]
+static double pulse(double x) {
+    return (x < 0 || x > 1) ? 0 : sin(2 * M_PI * x);
+}
+
+static void synth_session(session_t *ss, int gestures, uint16_t odr, uint16_t afsr) {
+    const double lsb_g = 32768.0 / afsr;
+    const double lsb_dps = 32768.0 / 500.0;
+    double gx = 0, gy = 0, gz = 1;      // gravity direction, slowly changing
+
+    for (int k = 0; k < gestures; k++) {
+        // Gap (fast input down to 150 ms) and sometimes a distractor in it
+        int r = rand() % 10;
+        int kind = r < 5 ? '.' : '-';
+        int distractor = rand() % 6 == 0 ? 1 + rand() % 2 : 0;
+        double gap = urand(0.15, 0.8);
+        double len = kind == '.' ? urand(0.10, 0.20) : urand(0.20, 0.40);
+        double amp = kind == '.' ? urand(0.35, 0.8) : urand(0.3, 0.6);
+        double cross = urand(0.0, 0.3);
+
+        double dist_len = distractor ? urand(0.8, 1.5) : 0;
+        double tilt_target = urand(-0.3, 0.3);
+        double gy_start = gy;
+        // Layout: quiet gap, [distractor, pause], gesture
+        int n_gap = (int)(gap * odr), n_dist = (int)(dist_len * odr), n_g = (int)(len * odr);
+        int n_pause = distractor ? (int)(urand(0.3, 0.8) * odr) : 0;
+        int g0 = n_gap + n_dist + n_pause;
+
+        for (int i = 0; i < g0 + n_g; i++) {
+            double ax = 0, ay = 0, az = 0, wx = 0, wy = 0, wz = 0;
+            char label = 0;
+            if (i >= n_gap && i < n_gap + n_dist) {
+                double x = (double)(i - n_gap) / n_dist;
+                if (distractor == 1) {
+                    // Slow tilt towards Y
+                    gy = gy_start + (tilt_target - gy_start) * (0.5 - 0.5 * cos(M_PI * x));
+                    gz = sqrt(1 - gy * gy);
+                    wx = (tilt_target - gy_start) * 0.5 * M_PI * sin(M_PI * x) / dist_len * 57.3;
+                } else {
+                    // Sideways wobble along Y
+                    ay = 0.25 * sin(2 * M_PI * 3 * x);
+                    wz = 20 * sin(2 * M_PI * 3 * x);
+                }
+            } else if (i >= g0) {
+                double x = (double)(i - g0) / n_g;
+                if (i == g0) label = (char)kind;
+                double p = amp * pulse(x);
+                if (kind == '.') {
+                    az = p; ax = cross * p * 0.5; ay = cross * p * 0.5;
+                    wx = 40 * amp * pulse(x);
+                } else {
+                    ax = p; az = cross * p * 0.5; ay = cross * p * 0.3;
+                    wy = 40 * amp * pulse(x);
+                }
+            }
+            icm42670_raw_sample_t s;
+            s.ax = (int16_t)lrint((gx + ax + 0.003 * gauss()) * lsb_g);
+            s.ay = (int16_t)lrint((gy + ay + 0.003 * gauss()) * lsb_g);
+            s.az = (int16_t)lrint((gz + az + 0.003 * gauss()) * lsb_g);
+            s.gx = (int16_t)lrint((wx + 0.5 * gauss()) * lsb_dps);
+            s.gy = (int16_t)lrint((wy + 0.5 * gauss()) * lsb_dps);
+            s.gz = (int16_t)lrint((wz + 0.5 * gauss()) * lsb_dps);
+            s.temp = 0;
+            push_rec(ss, &s, label);
+        }
+    }
+    // Quiet tail so the last gesture can end
+    for (int i = 0; i < odr; i++) {
+        icm42670_raw_sample_t s = {
+            (int16_t)lrint(gx * lsb_g), (int16_t)lrint(gy * lsb_g), (int16_t)lrint(gz * lsb_g), 0, 0, 0, 0
+        };
+        push_rec(ss, &s, 0);
+    }
+}
+
+/* ---------------- evaluation ---------------- */
+
+static int class_of(char label) {
+    return label == '.' ? GESTURE_DOT : label == '-' ? GESTURE_DASH : GESTURE_NONE;
+}
+
+static const char *class_name(int c) {
+    return c == GESTURE_DOT ? "dot" : c == GESTURE_DASH ? "dash" : "none";
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [options] (session.csv | --synthetic N)\n"
+                    "see the top of gesture_replay.c for the options\n", prog);
+}
+
+int main(int argc, char **argv) {
+    uint16_t odr = 100, afsr = 4;
+    struct gesture_config cfg;
+    int over[8];
+    const char *ov_names[8] = { "--start-mg", "--stop-mg", "--stop-ms", "--min-ms",
+                                "--max-ms", "--refractory-ms", NULL, NULL };
+    for (int i = 0; i < 8; i++) over[i] = -1;
+    const char *path = NULL, *features_path = NULL, *save_path = NULL;
+    int synthetic = 0, tolerance_ms = 300;
+    unsigned seed = 1;
+
+    for (int i = 1; i < argc; i++) {
+        int matched = 0;
+        for (int k = 0; ov_names[k]; k++) {
+            if (!strcmp(argv[i], ov_names[k]) && i + 1 < argc) { over[k] = atoi(argv[++i]); matched = 1; }
+        }
+        if (matched) continue;
+        if (!strcmp(argv[i], "--synthetic") && i + 1 < argc) synthetic = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--odr") && i + 1 < argc) odr = (uint16_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--afsr") && i + 1 < argc) afsr = (uint16_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--tolerance-ms") && i + 1 < argc) tolerance_ms = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--features") && i + 1 < argc) features_path = argv[++i];
+        else if (!strcmp(argv[i], "--save") && i + 1 < argc) save_path = argv[++i];
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc) seed = (unsigned)atoi(argv[++i]);
+        else if (argv[i][0] != '-' && !path) path = argv[i];
+        else { usage(argv[0]); return 2; }
+    }
+    if (!synthetic && !path) { usage(argv[0]); return 2; }
+
+    gesture_default_config(&cfg, odr, afsr);
+    if (over[0] >= 0) cfg.start_mg = (uint16_t)over[0];
+    if (over[1] >= 0) cfg.stop_mg = (uint16_t)over[1];
+    if (over[2] >= 0) cfg.stop_ms = (uint16_t)over[2];
+    if (over[3] >= 0) cfg.min_ms = (uint16_t)over[3];
+    if (over[4] >= 0) cfg.max_ms = (uint16_t)over[4];
+    if (over[5] >= 0) cfg.refractory_ms = (uint16_t)over[5];
+
+    session_t ss = {0};
+    if (synthetic) {
+        srand(seed);
+        synth_session(&ss, synthetic, odr, afsr);
+    } else if (load_csv(path, &ss) != 0) {
+        return 2;
+    }
+    if (save_path) {
+        FILE *out = fopen(save_path, "w");
+        if (!out) { perror(save_path); return 2; }
+        fprintf(out, "ax,ay,az,gx,gy,gz,label\n");
+        for (size_t i = 0; i < ss.n; i++) {
+            const icm42670_raw_sample_t *s = &ss.r[i].s;
+            fprintf(out, "%d,%d,%d,%d,%d,%d,%c\n", s->ax, s->ay, s->az, s->gx, s->gy, s->gz,
+                    ss.r[i].label ? ss.r[i].label : ' ');
+        }
+        fclose(out);
+    }
+
+    gesture_t g;
+    int rc = gesture_init(&g, &cfg);
+    if (rc != 0) {
+        fprintf(stderr, "gesture_init failed (%d)\n", rc);
+        return 2;
+    }
+
+    FILE *feat = NULL;
+    if (features_path) {
+        feat = fopen(features_path, "w");
+        if (!feat) { perror(features_path); return 2; }
+        fprintf(feat, "end_sample,duration,peak_x,peak_y,peak_z,share_x,share_y,share_z,"
+                      "gyro_x,gyro_y,gyro_z,predicted,label\n");
+    }
+
+    // Labels with the sample index where they start
+    size_t n_labels = 0;
+    for (size_t i = 0; i < ss.n; i++) if (ss.r[i].label) n_labels++;
+    size_t *label_at = calloc(n_labels + 1, sizeof(size_t));
+    char *label_cls = calloc(n_labels + 1, 1);
+    char *label_used = calloc(n_labels + 1, 1);
+    for (size_t i = 0, k = 0; i < ss.n; i++) {
+        if (ss.r[i].label) { label_at[k] = i; label_cls[k] = ss.r[i].label; k++; }
+    }
+
+    const size_t window = (size_t)((cfg.max_ms + tolerance_ms) * (uint32_t)odr / 1000);
+    const long tol_samples = (long)tolerance_ms * odr / 1000;
+    int confusion[GESTURE_CLASS_COUNT][GESTURE_CLASS_COUNT] = {{0}};   // [true][predicted]
+    size_t first_label = 0;
+    unsigned long segments = 0;
+
+    for (size_t i = 0; i < ss.n; i++) {
+        gesture_class_t c = gesture_push(&g, &ss.r[i].s);
+        const gesture_features_t *f = gesture_last_features(&g);
+        if (f->end_sample != (uint32_t)(i + 1)) continue;   // no gesture ended here
+        segments++;
+
+        // Labels that can no longer match any gesture are misses
+        while (first_label < n_labels && label_at[first_label] + window < i) {
+            if (!label_used[first_label]) {
+                confusion[class_of(label_cls[first_label])][GESTURE_NONE]++;
+                label_used[first_label] = 1;
+            }
+            first_label++;
+        }
+        // Match with the unused label closest to the start of the gesture
+        long start = (long)i + 1 - f->f[GESTURE_F_DURATION];
+        long best = -1, best_dist = tol_samples + 1;
+        for (size_t k = first_label; k < n_labels && (long)label_at[k] <= (long)i; k++) {
+            long d = labs((long)label_at[k] - start);
+            if (!label_used[k] && d < best_dist) { best = (long)k; best_dist = d; }
+        }
+        int truth = GESTURE_NONE;
+        if (best >= 0) {
+            label_used[best] = 1;
+            truth = class_of(label_cls[best]);
+        }
+        if (truth != GESTURE_NONE || c != GESTURE_NONE) confusion[truth][c]++;
+        if (feat) {
+            fprintf(feat, "%u", f->end_sample);
+            for (int k = 0; k < GESTURE_F_COUNT; k++) fprintf(feat, ",%d", f->f[k]);
+            fprintf(feat, ",%s,%s\n", class_name(c), class_name(truth));
+        }
+    }
+    for (size_t k = 0; k < n_labels; k++) {
+        if (!label_used[k]) confusion[class_of(label_cls[k])][GESTURE_NONE]++;
+    }
+    if (feat) fclose(feat);
+
+    // Cost: replay again several times, only the recognizer is timed
+    const int reps = ss.n < 100000 ? 20 : 2;
+    struct timespec t0, t1;
+    volatile int sink = 0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int r = 0; r < reps; r++) {
+        gesture_init(&g, &cfg);
+        for (size_t i = 0; i < ss.n; i++) sink += gesture_push(&g, &ss.r[i].s);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double ns = ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / ((double)reps * ss.n);
+
+    printf("%zu samples @ %u Hz, %zu labelled gestures, %lu segments\n", ss.n, odr, n_labels, segments);
+    printf("config: start %u mg, stop %u mg / %u ms, min %u ms, max %u ms, refractory %u ms\n",
+           cfg.start_mg, cfg.stop_mg, cfg.stop_ms, cfg.min_ms, cfg.max_ms, cfg.refractory_ms);
+    printf("\nconfusion (rows: label, columns: detected)\n%8s", "");
+    for (int p = 0; p < GESTURE_CLASS_COUNT; p++) printf("%8s", class_name(p));
+    printf("\n");
+    for (int t = 0; t < GESTURE_CLASS_COUNT; t++) {
+        printf("%8s", class_name(t));
+        for (int p = 0; p < GESTURE_CLASS_COUNT; p++) printf("%8d", confusion[t][p]);
+        printf("\n");
+    }
+
+    int correct = 0, total = 0;
+    printf("\n");
+    for (int c = GESTURE_DOT; c < GESTURE_CLASS_COUNT; c++) {
+        int tp = confusion[c][c], det = 0, lab = 0;
+        for (int k = 0; k < GESTURE_CLASS_COUNT; k++) { det += confusion[k][c]; lab += confusion[c][k]; }
+        printf("%-5s precision %5.1f %%  recall %5.1f %%\n", class_name(c),
+               det ? 100.0 * tp / det : 0.0, lab ? 100.0 * tp / lab : 0.0);
+    }
+    for (int t = 0; t < GESTURE_CLASS_COUNT; t++) {
+        for (int p = 0; p < GESTURE_CLASS_COUNT; p++) {
+            total += confusion[t][p];
+            if (t == p) correct += confusion[t][p];
+        }
+    }
+    double acc = total ? (double)correct / total : 1.0;
+    printf("accuracy %.1f %% (false detections count as errors)\n", 100.0 * acc);
+    printf("cost %.1f ns/sample on this host (%d replays)\n", ns, reps);
+
+    free(label_at);
+    free(label_cls);
+    free(label_used);
+    free(ss.r);
+    (void)sink;
+    return acc >= MIN_ACCURACY ? 0 : 1;
+}
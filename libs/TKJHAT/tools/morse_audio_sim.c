@@ -0,0 +1,256 @@
+/*
+ * morse_audio_sim: decode synthetic morse audio with tkjhat/tone_detect and
+ * tkjhat/morse_decode, the way the morse application hears the buzzer.
+ *
+ * A text is keyed as a buzzer tone (fundamental plus the third harmonic of the
+ * square wave, 2 ms ramps) with timing jitter and mixed with white noise and,
+ * in some cases, speech-like bursts. The audio is pushed in microphone
+ * buffers of MEMS_BUFFER_SIZE samples; every detector block steps the timing
+ * decoder. The symbols are turned back into text and compared with the
+ * original.
+ *
+ * Cases: clean, noisy (wideband SNR 0 dB), faster and slower sender than the
+ * decoder expects, jitter, buzzer off frequency, speech-like bursts a little
+ * louder than the tone (over the marks and the gaps alike), 16 kHz sample rate.
+ *
+ * Usage:
+ *   morse_audio_sim [--text TEXT] [--seed S] [--verbose]
+ *
+ * Exit code is 1 if any case decodes a character wrong.
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <tkjhat/tone_detect.h>
+#include <tkjhat/morse_decode.h>
+
+#include "sim_signal.h"
+
+#define BUFFER_SAMPLES  256         // MEMS_BUFFER_SIZE
+#define DETECT_HZ       600         // MORSE_FREQ_HZ of the application
+#define UNIT_MS         100         // unit_ms of the application
+#define MAX_SYMBOLS     4096
+#define MAX_TEXT        256
+
+static const char *codes[128] = {
+    ['A'] = ".-",    ['B'] = "-...",  ['C'] = "-.-.",  ['D'] = "-..",   ['E'] = ".",
+    ['F'] = "..-.",  ['G'] = "--.",   ['H'] = "....",  ['I'] = "..",    ['J'] = ".---",
+    ['K'] = "-.-",   ['L'] = ".-..",  ['M'] = "--",    ['N'] = "-.",    ['O'] = "---",
+    ['P'] = ".--.",  ['Q'] = "--.-",  ['R'] = ".-.",   ['S'] = "...",   ['T'] = "-",
+    ['U'] = "..-",   ['V'] = "...-",  ['W'] = ".--",   ['X'] = "-..-",  ['Y'] = "-.--",
+    ['Z'] = "--..",
+    ['0'] = "-----", ['1'] = ".----", ['2'] = "..---", ['3'] = "...--", ['4'] = "....-",
+    ['5'] = ".....", ['6'] = "-....", ['7'] = "--...", ['8'] = "---..", ['9'] = "----.",
+};
+
+typedef struct {
+    const char *name;
+    uint32_t rate;
+    double unit_ms;                 // sender
+    double jitter;                  // relative, uniform +-
+    double tone_hz;
+    double amp;                     // tone amplitude (LSB)
+    double noise;                   // white noise rms (LSB)
+    double bursts;                  // scale of the speech-like bursts, rms about 1.5 x this (0 = none)
+} sim_case_t;
+
+static const sim_case_t cases[] = {
+    { "clean",       8000, 100, 0.00, 600, 3000,   30,    0 },
+    { "noisy 0 dB",  8000, 100, 0.05, 600, 1000,  707,    0 },
+    { "fast 65 ms",  8000,  65, 0.05, 600, 3000,   60,    0 },
+    { "slow 160 ms", 8000, 160, 0.05, 600, 3000,   60,    0 },
+    { "jitter 20%",  8000, 100, 0.20, 600, 3000,   60,    0 },
+    { "off 640 Hz",  8000, 100, 0.05, 640, 3000,   60,    0 },
+    { "speech",      8000, 100, 0.05, 600, 1500,   60, 1000 },
+    { "16 kHz",     16000, 100, 0.05, 600, 3000,   60,    0 },
+};
+
+// Key-down intervals of the text, in seconds
+typedef struct {
+    double start, end;
+} mark_t;
+
+static size_t key_text(const char *text, double unit_s, double jitter, mark_t *marks, size_t max,
+                       double *total_s) {
+    double t = 0.3;                 // silence before the first letter
+    size_t n = 0;
+    for (const char *p = text; *p; p++) {
+        if (*p == ' ') {
+            t += 4 * unit_s;        // 3 units of letter gap already added: 7 in total
+            continue;
+        }
+        const char *code = codes[(unsigned char)*p & 0x7F];
+        if (!code) continue;
+        for (const char *c = code; *c; c++) {
+            double len = (*c == '.' ? 1 : 3) * unit_s * (1.0 + jitter * (2 * sim_urand() - 1));
+            if (n < max) marks[n++] = (mark_t){ t, t + len };
+            t += len + unit_s * (1.0 + jitter * (2 * sim_urand() - 1));
+        }
+        t += 2 * unit_s;            // letter gap: 3 units with the one after the last mark
+    }
+    *total_s = t + 1.0;             // room for the last word gap
+    return n;
+}
+
+static int16_t *synth(const sim_case_t *c, const char *text, size_t *count) {
+    static mark_t marks[MAX_SYMBOLS];
+    double total_s;
+    size_t nm = key_text(text, c->unit_ms / 1000.0, c->jitter, marks, MAX_SYMBOLS, &total_s);
+    const size_t n = (size_t)(total_s * c->rate);
+    int16_t *x = malloc(n * sizeof(*x));
+    if (!x) return NULL;
+
+    const double ramp_s = 0.002, w = 2.0 * SIM_PI * c->tone_hz / c->rate;
+    double burst_lp = 0.0;
+    const double k = exp(-2.0 * SIM_PI * 700.0 / c->rate);
+    size_t m = 0;
+    for (size_t i = 0; i < n; i++) {
+        const double t = (double)i / c->rate;
+        while (m < nm && t > marks[m].end + ramp_s) m++;
+        double env = 0.0;
+        if (m < nm && t >= marks[m].start) {
+            env = 1.0;
+            if (t < marks[m].start + ramp_s) env = (t - marks[m].start) / ramp_s;
+            if (t > marks[m].end) env = 1.0 - (t - marks[m].end) / ramp_s;
+        }
+        double s = c->amp * env * (sin(w * i) + sin(3 * w * i) / 3.0);
+        s += c->noise * sim_gauss();
+        if (c->bursts > 0) {
+            // Bursts of 120 ms every 700 ms, below 700 Hz: a voice in the room
+            burst_lp = k * burst_lp + (1.0 - k) * sim_gauss();
+            const double bt = fmod(t, 0.7);
+            if (bt < 0.12) s += c->bursts * 3.0 * burst_lp * sin(SIM_PI * bt / 0.12);
+        }
+        x[i] = sim_sat(s, 32767.0);
+    }
+    *count = n;
+    return x;
+}
+
+// Symbols back to text: letters of the codes, word gaps as spaces
+static void symbols_to_text(const char *sym, char *text, size_t max) {
+    size_t n = 0;
+    const char *p = sym;
+    while (*p && n + 2 < max) {
+        if (*p == ' ') {
+            if (p[1] == ' ' && n > 0 && text[n - 1] != ' ') text[n++] = ' ';
+            p++;
+            continue;
+        }
+        char letter = morse_decode_letter(p);
+        text[n++] = letter ? letter : '?';
+        while (*p == '.' || *p == '-') p++;
+    }
+    while (n > 0 && text[n - 1] == ' ') n--;
+    text[n] = '\0';
+}
+
+// Edit distance between the texts (character errors)
+static int distance(const char *a, const char *b) {
+    static int d[MAX_TEXT + 1][MAX_TEXT + 1];
+    const size_t la = strlen(a), lb = strlen(b);
+    if (la > MAX_TEXT || lb > MAX_TEXT) return (int)(la > lb ? la : lb);
+    for (size_t i = 0; i <= la; i++) d[i][0] = (int)i;
+    for (size_t j = 0; j <= lb; j++) d[0][j] = (int)j;
+    for (size_t i = 1; i <= la; i++) {
+        for (size_t j = 1; j <= lb; j++) {
+            int best = d[i - 1][j - 1] + (a[i - 1] != b[j - 1]);
+            if (d[i - 1][j] + 1 < best) best = d[i - 1][j] + 1;
+            if (d[i][j - 1] + 1 < best) best = d[i][j - 1] + 1;
+            d[i][j] = best;
+        }
+    }
+    return d[la][lb];
+}
+
+static int run_case(const sim_case_t *c, const char *text, bool verbose, double *ns_per_sample) {
+    size_t n;
+    int16_t *x = synth(c, text, &n);
+    if (!x) return -1;
+
+    tone_detect_t td;
+    struct tone_detect_config tcfg;
+    tone_detect_default_config(&tcfg, c->rate, DETECT_HZ);
+    morse_decode_t md;
+    struct morse_decode_config mcfg;
+    morse_decode_default_config(&mcfg, UNIT_MS);
+    if (tone_detect_init(&td, &tcfg) != 0 || morse_decode_init(&md, &mcfg) != 0) {
+        free(x);
+        return -1;
+    }
+    const uint32_t block_ms = tone_detect_block_us(&td) / 1000;
+
+    static char sym[MAX_SYMBOLS];
+    size_t ns = 0;
+    bool key[BUFFER_SAMPLES / 8];
+    for (size_t i = 0; i < n; i += BUFFER_SAMPLES) {
+        const size_t m = n - i < BUFFER_SAMPLES ? n - i : BUFFER_SAMPLES;
+        size_t blocks = tone_detect_push(&td, x + i, m, key, sizeof(key) / sizeof(key[0]));
+        for (size_t b = 0; b < blocks; b++) {
+            char out[MORSE_DECODE_MAX_OUT];
+            size_t k = morse_decode_step(&md, key[b], block_ms, out);
+            for (size_t j = 0; j < k && ns + 1 < MAX_SYMBOLS; j++) sym[ns++] = out[j];
+        }
+    }
+    sym[ns] = '\0';
+
+    // Speed of the detector alone
+    const int reps = 20;
+    clock_t t0 = clock();
+    for (int r = 0; r < reps; r++) {
+        tone_detect_reset(&td);
+        tone_detect_push(&td, x, n, NULL, 0);
+    }
+    *ns_per_sample = (double)(clock() - t0) / CLOCKS_PER_SEC * 1e9 / ((double)reps * n);
+
+    char decoded[MAX_TEXT];
+    symbols_to_text(sym, decoded, sizeof(decoded));
+    const int errors = distance(text, decoded);
+    uint32_t amp, noise, level;
+    tone_detect_levels(&td, &amp, &noise, &level);
+    printf("%-12s %6u %8u %6d   %s\n", c->name, (unsigned)c->rate, (unsigned)morse_decode_unit_ms(&md),
+           errors, decoded);
+    if (verbose) printf("             symbols: %s\n", sym);
+    free(x);
+    return errors;
+}
+
+int main(int argc, char **argv) {
+    const char *text = "SOS TKJHAT 2025 MORSE PICO";
+    bool verbose = false;
+    unsigned seed = 1;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--text") && i + 1 < argc) text = argv[++i];
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc) seed = (unsigned)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--verbose")) verbose = true;
+        else {
+            fprintf(stderr, "usage: %s [--text TEXT] [--seed S] [--verbose]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (strlen(text) >= MAX_TEXT) {
+        fprintf(stderr, "text too long\n");
+        return 2;
+    }
+    srand(seed);
+
+    printf("text: %s\n\n%-12s %6s %8s %6s   %s\n", text, "case", "rate", "unit ms", "errors", "decoded");
+    bool ok = true;
+    double ns_sum = 0.0;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        double ns;
+        int errors = run_case(&cases[i], text, verbose, &ns);
+        ns_sum += ns;
+        if (errors != 0) ok = false;
+    }
+    printf("\ntone detector: %.1f ns per sample on this computer\n",
+           ns_sum / (sizeof(cases) / sizeof(cases[0])));
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,197 @@
+/*
+ * morse_timing_check: timelines of tkjhat/morse_player against the PARIS
+ * standard.
+ *
+ * "PARIS " (".--. .- .-. .. ...  " in the symbols of the morse application)
+ * is 50 units, so it must take 60 / WPM seconds at standard timing and
+ * 60 / overall WPM seconds with Farnsworth timing. Printed per speed:
+ *   unit ms    dot length
+ *   gap ms     Farnsworth unit of the letter and word gaps
+ *   PARIS ms   length of the timeline and the error to 60 / WPM
+ *   old ms     the same word with the timing of the old print_task (a unit
+ *              after every mark, then 3 or 7 more), for comparison
+ *   decoded    standard speeds only: the timeline keyed in 1 ms steps into
+ *              tkjhat/morse_decode gives back the message
+ * The elements of a short message are also checked one by one, and broken
+ * settings must be rejected.
+ *
+ * Usage:
+ *   morse_timing_check [--text SYMBOLS]
+ *
+ * Exit code is 1 if a timeline is off by more than LIMIT_US or a check fails,
+ * 2 on a bad argument.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <tkjhat/morse_player.h>
+#include <tkjhat/morse_decode.h>
+
+#define MAX_STEPS   1024
+#define MAX_TEXT    512
+#define LIMIT_US    100             // most error of a whole word (rounding of the units)
+#define PARIS       ".--. .- .-. .. ...  "
+
+typedef struct {
+    uint32_t char_wpm, overall_wpm;
+} speed_t;
+
+static const speed_t speeds[] = {
+    {  5,  0 }, { 12,  0 }, { 20,  0 }, { 25,  0 }, { 40,  0 }, { 100, 0 },
+    { 18, 10 }, { 20,  5 }, { 15, 12 }, { 13,  7 },
+};
+
+static struct morse_step steps[MAX_STEPS];
+
+static uint64_t total_us(int count) {
+    uint64_t us = 0;
+    for (int i = 0; i < count; i++)
+        us += steps[i].us;
+    return us;
+}
+
+// print_task before the player: mark + 1 unit, ' ' 3 units, "  " 7 units
+static uint64_t old_us(const char *text, uint32_t unit_us) {
+    uint64_t us = 0;
+    for (size_t i = 0; text[i]; i++) {
+        if (text[i] == '.')
+            us += 2 * unit_us;
+        else if (text[i] == '-')
+            us += 4 * unit_us;
+        else if (text[i] == ' ' && text[i + 1] == ' ') {
+            us += 7 * unit_us;
+            i++;
+        } else if (text[i] == ' ')
+            us += 3 * unit_us;
+    }
+    return us;
+}
+
+// Key the timeline into the decoder in 1 ms steps, symbols into out
+static void decode(int count, uint32_t unit_us, char *out, size_t size) {
+    morse_decode_t md;
+    struct morse_decode_config cfg;
+    morse_decode_default_config(&cfg, (uint16_t)(unit_us / 1000));
+    cfg.min_unit_ms = 5;                    // the default 20 ms is slower than 60 WPM
+    morse_decode_init(&md, &cfg);
+    size_t n = 0;
+    char sym[MORSE_DECODE_MAX_OUT];
+    for (int i = 0; i <= count; i++) {
+        // A long silence after the end gives the last gaps
+        const bool key = i < count && steps[i].on;
+        const uint32_t ms = i < count ? (steps[i].us + 500) / 1000 : 20 * unit_us / 1000;
+        for (uint32_t t = 0; t < ms; t++) {
+            const size_t k = morse_decode_step(&md, key, 1, sym);
+            for (size_t j = 0; j < k && n + 1 < size; j++)
+                out[n++] = sym[j];
+        }
+    }
+    out[n] = '\0';
+}
+
+// Message as the decoder gives it: no leading spaces, at most two in a row,
+// ending with a word gap
+static void normalize(const char *text, char *out, size_t size) {
+    size_t n = 0, spaces = 0;
+    for (size_t i = 0; text[i] && n + 3 < size; i++) {
+        if (text[i] == ' ') {
+            if (n > 0 && spaces < 2)
+                out[n++] = ' ';
+            spaces++;
+        } else if (text[i] == '.' || text[i] == '-') {
+            out[n++] = text[i];
+            spaces = 0;
+        }
+    }
+    while (spaces < 2 && n > 0) {
+        out[n++] = ' ';
+        spaces++;
+    }
+    out[n] = '\0';
+}
+
+static bool check_elements(void) {
+    // 12 WPM: 100 ms unit. Dot, mark gap, dot, word gap, dash, letter gap
+    // (from the extra space at the end)
+    static const struct morse_step expect[] = {
+        { 100000, 0, true }, { 100000, 0, false }, { 100000, 1, true },
+        { 700000, 3, false }, { 300000, 4, true }, { 300000, 6, false },
+    };
+    struct morse_timing t;
+    morse_timing_wpm(&t, 12, 0);
+    int count = morse_compile("..  -x \n.-", &t, steps, MAX_STEPS);
+    bool ok = count == (int)(sizeof(expect) / sizeof(expect[0]));
+    for (int i = 0; ok && i < count; i++)
+        ok = steps[i].us == expect[i].us && steps[i].symbol == expect[i].symbol && steps[i].on == expect[i].on;
+    printf("%-40s %s\n", "elements of \"..  -x \\n.-\" at 12 WPM", ok ? "ok" : "FAIL");
+    if (!ok) {
+        for (int i = 0; i < count; i++)
+            printf("    %s %lu us (symbol %u)\n", steps[i].on ? "on " : "off", (unsigned long)steps[i].us,
+                   steps[i].symbol);
+    }
+
+    bool reject = morse_timing_wpm(&t, 0, 0) < 0 && morse_timing_wpm(&t, MORSE_WPM_MAX + 1, 0) < 0 &&
+                  morse_timing_wpm(&t, 10, 12) < 0;
+    morse_timing_wpm(&t, 20, 0);
+    reject = reject && morse_compile(PARIS, &t, steps, 3) < 0;
+    printf("%-40s %s\n", "bad speeds and a full timeline", reject ? "ok" : "FAIL");
+
+    count = morse_compile("", &t, steps, MAX_STEPS);
+    printf("%-40s %s\n", "empty message", count == 0 ? "ok" : "FAIL");
+    return ok && reject && count == 0;
+}
+
+int main(int argc, char **argv) {
+    const char *text = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--text") && i + 1 < argc && strlen(argv[i + 1]) < MAX_TEXT) text = argv[++i];
+        else {
+            fprintf(stderr, "usage: %s [--text SYMBOLS]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    bool ok = check_elements();
+    printf("\n%-12s %8s %8s %10s %9s %10s %8s\n", "WPM", "unit ms", "gap ms", "PARIS ms", "error us", "old ms",
+           "decoded");
+    for (size_t i = 0; i < sizeof(speeds) / sizeof(speeds[0]); i++) {
+        const speed_t *s = &speeds[i];
+        struct morse_timing t;
+        if (morse_timing_wpm(&t, s->char_wpm, s->overall_wpm) != 0) {
+            printf("%u/%u rejected  <-- FAIL\n", (unsigned)s->char_wpm, (unsigned)s->overall_wpm);
+            ok = false;
+            continue;
+        }
+        const int count = morse_compile(PARIS, &t, steps, MAX_STEPS);
+        const uint32_t wpm = s->overall_wpm ? s->overall_wpm : s->char_wpm;
+        const uint64_t paris_us = total_us(count);
+        const int64_t err = (int64_t)paris_us - 60000000 / wpm;
+        const bool time_ok = count > 0 && llabs(err) <= LIMIT_US;
+
+        const char *decoded = "-";
+        bool decode_ok = true;
+        if (!s->overall_wpm) {
+            char got[MAX_TEXT], want[MAX_TEXT];
+            const char *msg = text ? text : PARIS;
+            const int n = morse_compile(msg, &t, steps, MAX_STEPS);
+            decode(n, t.dot_us, got, sizeof(got));
+            normalize(msg, want, sizeof(want));
+            decode_ok = n >= 0 && !strcmp(got, want);
+            decoded = decode_ok ? "ok" : "wrong";
+        }
+        ok = ok && time_ok && decode_ok;
+
+        char name[16];
+        snprintf(name, sizeof(name), s->overall_wpm ? "%u/%u" : "%u", (unsigned)s->char_wpm,
+                 (unsigned)s->overall_wpm);
+        printf("%-12s %8.1f %8.1f %10.1f %9lld %10.1f %8s%s\n", name, t.dot_us / 1000.0, t.letter_gap_us / 3000.0,
+               paris_us / 1000.0, (long long)err, old_us(PARIS, t.dot_us) / 1000.0, decoded,
+               time_ok && decode_ok ? "" : "  <-- FAIL");
+    }
+    printf("\nlimit: PARIS within %d us of 60 / WPM s\n%s\n", LIMIT_US, ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,297 @@
+/*
+ * pdm_bench: signal quality and speed of the PDM to PCM path on the computer.
+ *
+ * Test signals are turned into PDM bit streams by a second order sigma-delta
+ * modulator with a little dither (the microphone has one on the chip) and
+ * decoded by OpenPDMFilter in the same way as pdm_microphone_read(): one raw
+ * buffer of MEMS_BUFFER_SIZE samples at a time, one millisecond per filter
+ * call. For every sample rate and decimation it reports:
+ *   silence   DC offset and noise floor of a zero input (the offset comes from
+ *             the truncating shift in the high-pass stage)
+ *   tone      SNR, THD and SINAD of a 1 kHz sine
+ *   sweep     gain of a stepped sine sweep relative to 1 kHz: flatness from
+ *             200 Hz to 1 kHz and the -3 dB bandwidth
+ *   speed     output samples per second of this computer
+ *
+ * The numbers are deterministic (fixed seed), so the tool is the regression
+ * gate for filter changes: it fails if a result is worse than the limits
+ * below, which hold for the current filter with some margin.
+ *
+ * Usage:
+ *   pdm_bench [--variant ref|byte|nibble] [--amp A] [--seconds S] [--verbose]
+ *
+ * --amp is the sine amplitude relative to PDM full scale; with the default
+ * volume and gain of the SDK the PCM output clips above about 0.06.
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BUFFER_SAMPLES  256     // MEMS_BUFFER_SIZE
+#define VOLUME          64      // default filter volume of pdm_microphone
+#define SETTLE_S        0.1     // skipped at the start: high-pass and low-pass settle
+#define HARMONICS       5
+#define TONE_HZ         1000.0
+
+#define DITHER          (1.0 / 16384)   // peak, of PDM full scale
+
+// Limits of the regression gate
+#define MIN_SNR_64      40.0    // dB at amp 0.01
+#define MIN_SNR_128     56.0
+#define MAX_THD_PCT     0.5
+#define MAX_DC_LSB      200.0
+#define MAX_NOISE_LSB   60.0
+#define MAX_FLATNESS_DB 2.0     // 200 Hz .. 1 kHz
+#define MIN_BANDWIDTH   0.16    // -3 dB point, fraction of Fs
+
+#define VARIANT_API(v) \
+    void *pdm_variant_new_##v(uint16_t fs, uint8_t decimation, uint8_t channels); \
+    void pdm_variant_run_##v(void *state, uint8_t *pdm, int16_t *out, int ms, uint16_t volume);
+VARIANT_API(ref)
+VARIANT_API(byte)
+VARIANT_API(nibble)
+
+static const struct {
+    const char *name;
+    void *(*create)(uint16_t, uint8_t, uint8_t);
+    void (*run)(void *, uint8_t *, int16_t *, int, uint16_t);
+} variants[] = {
+    { "ref", pdm_variant_new_ref, pdm_variant_run_ref },
+    { "byte", pdm_variant_new_byte, pdm_variant_run_byte },
+    { "nibble", pdm_variant_new_nibble, pdm_variant_run_nibble },
+};
+
+static const double sweep_hz[] = { 50, 100, 200, 500, 1000, 2000, 3000, 4000, 6000, 8000, 12000 };
+#define SWEEP_POINTS (sizeof(sweep_hz) / sizeof(sweep_hz[0]))
+
+static int variant = 2;
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Second order sigma-delta modulator, MSB of each byte first (as the PIO
+// shifts). Input amp * sin(), or silence with amp = 0. The dither breaks the
+// idle patterns a noiseless modulator falls into.
+static void modulate(uint8_t *pdm, size_t bits, double pdm_rate, double freq, double amp) {
+    double i1 = 0, i2 = 0, y = 0;
+    uint32_t lcg = 12345;
+    memset(pdm, 0, bits / 8);
+    for (size_t n = 0; n < bits; n++) {
+        lcg = lcg * 1664525u + 1013904223u;
+        double x = amp * sin(2.0 * M_PI * freq * n / pdm_rate) +
+                   DITHER * ((double)(lcg >> 8) / (1 << 23) - 1.0);
+        i1 += x - y;
+        i2 += i1 - y;
+        y = i2 >= 0 ? 1.0 : -1.0;
+        if (y > 0) pdm[n / 8] |= (uint8_t)(0x80 >> (n % 8));
+    }
+}
+
+// As pdm_microphone_read(): one raw buffer per call, one ms per filter call
+static void decode(uint8_t *pdm, int16_t *pcm, size_t samples, uint16_t fs, uint8_t dec) {
+    void *state = variants[variant].create(fs, dec, 1);
+    if (!state) exit(2);
+    const size_t raw_bytes = BUFFER_SAMPLES * dec / 8;
+    for (size_t i = 0; i + BUFFER_SAMPLES <= samples; i += BUFFER_SAMPLES) {
+        variants[variant].run(state, pdm + i / BUFFER_SAMPLES * raw_bytes, pcm + i,
+                              BUFFER_SAMPLES / (fs / 1000), VOLUME);
+    }
+    free(state);
+}
+
+// Amplitude of the component at freq (least squares fit of sin and cos)
+static double amplitude(const double *x, size_t n, double fs, double freq, double *fit) {
+    double ss = 0, sc = 0, cc = 0, xs = 0, xc = 0;
+    for (size_t i = 0; i < n; i++) {
+        double s = sin(2.0 * M_PI * freq * i / fs), c = cos(2.0 * M_PI * freq * i / fs);
+        ss += s * s; cc += c * c; sc += s * c;
+        xs += x[i] * s; xc += x[i] * c;
+    }
+    double det = ss * cc - sc * sc;
+    double a = (xs * cc - xc * sc) / det, b = (xc * ss - xs * sc) / det;
+    if (fit) {
+        for (size_t i = 0; i < n; i++) {
+            fit[i] = a * sin(2.0 * M_PI * freq * i / fs) + b * cos(2.0 * M_PI * freq * i / fs);
+        }
+    }
+    return sqrt(a * a + b * b);
+}
+
+typedef struct {
+    double a1;          // fundamental amplitude in LSB
+    double snr_db;      // fundamental against noise (harmonics removed)
+    double thd_pct;
+    double sinad_db;    // fundamental against noise and harmonics
+    bool clipped;
+} tone_result_t;
+
+static tone_result_t analyse_tone(const int16_t *pcm, size_t n, double fs, double freq) {
+    tone_result_t r = { 0 };
+    double *x = malloc(n * sizeof(double)), *fit = malloc(n * sizeof(double));
+    if (!x || !fit) exit(2);
+    double mean = 0;
+    for (size_t i = 0; i < n; i++) {
+        mean += pcm[i];
+        if (pcm[i] <= -32700 || pcm[i] >= 32700) r.clipped = true;
+    }
+    mean /= n;
+    for (size_t i = 0; i < n; i++) x[i] = pcm[i] - mean;
+
+    double total = 0;
+    for (size_t i = 0; i < n; i++) total += x[i] * x[i];
+
+    // Remove the fundamental and the harmonics below Fs / 2 one by one
+    double harm2 = 0;
+    for (int h = 1; h <= HARMONICS; h++) {
+        if (h * freq >= fs / 2) break;
+        double a = amplitude(x, n, fs, h * freq, fit);
+        for (size_t i = 0; i < n; i++) x[i] -= fit[i];
+        if (h == 1) r.a1 = a;
+        else harm2 += a * a;
+    }
+    double noise = 0;
+    for (size_t i = 0; i < n; i++) noise += x[i] * x[i];
+    noise /= n;
+    double sig = r.a1 * r.a1 / 2;
+    r.snr_db = 10 * log10(sig / (noise > 0 ? noise : 1e-12));
+    r.thd_pct = 100 * sqrt(harm2) / (r.a1 > 0 ? r.a1 : 1e-12);
+    r.sinad_db = 10 * log10(sig / (total / n - sig > 0 ? total / n - sig : 1e-12));
+    free(x);
+    free(fit);
+    return r;
+}
+
+int main(int argc, char **argv) {
+    double amp = 0.01;
+    double seconds = 0.6;
+    bool verbose = false;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--amp") && i + 1 < argc) amp = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--seconds") && i + 1 < argc) seconds = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--verbose")) verbose = true;
+        else if (!strcmp(argv[i], "--variant") && i + 1 < argc) {
+            const char *name = argv[++i];
+            variant = -1;
+            for (int v = 0; v < (int)(sizeof(variants) / sizeof(variants[0])); v++) {
+                if (!strcmp(name, variants[v].name)) variant = v;
+            }
+            if (variant < 0) {
+                fprintf(stderr, "unknown variant %s\n", name);
+                return 2;
+            }
+        } else {
+            fprintf(stderr, "usage: %s [--variant ref|byte|nibble] [--amp A] [--seconds S] "
+                            "[--verbose]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (seconds < 2 * SETTLE_S) seconds = 2 * SETTLE_S;
+
+    static const struct { uint16_t fs; uint8_t dec; } cfgs[] = {
+        { 8000, 64 }, { 8000, 128 }, { 16000, 64 }, { 16000, 128 }, { 32000, 64 },
+    };
+    bool ok = true;
+
+    printf("variant %s, amplitude %.4f of PDM full scale, %.1f s per signal\n\n",
+           variants[variant].name, amp, seconds);
+    printf("%6s %4s %7s %9s %7s %6s %8s %8s %9s %9s\n", "Fs", "dec", "DC LSB", "noise LSB",
+           "SNR dB", "THD %", "SINAD dB", "flat dB", "-3 dB Hz", "Msample/s");
+
+    for (size_t c = 0; c < sizeof(cfgs) / sizeof(cfgs[0]); c++) {
+        const uint16_t fs = cfgs[c].fs;
+        const uint8_t dec = cfgs[c].dec;
+        size_t samples = (size_t)(seconds * fs) / BUFFER_SAMPLES * BUFFER_SAMPLES;
+        const size_t skip = (size_t)(SETTLE_S * fs);
+        const size_t n = samples - skip;
+        uint8_t *pdm = malloc(samples * dec / 8);
+        int16_t *pcm = malloc(samples * sizeof(int16_t));
+        if (!pdm || !pcm) return 2;
+
+        // Silence: DC offset and noise floor
+        modulate(pdm, samples * dec, (double)fs * dec, 0, 0);
+        decode(pdm, pcm, samples, fs, dec);
+        double mean = 0, var = 0;
+        for (size_t i = skip; i < samples; i++) mean += pcm[i];
+        mean /= n;
+        for (size_t i = skip; i < samples; i++) var += (pcm[i] - mean) * (pcm[i] - mean);
+        double noise_rms = sqrt(var / n);
+
+        // 1 kHz tone (timed)
+        modulate(pdm, samples * dec, (double)fs * dec, TONE_HZ, amp);
+        double t0 = now_s();
+        decode(pdm, pcm, samples, fs, dec);
+        double rate = samples / (now_s() - t0) / 1e6;
+        tone_result_t tone = analyse_tone(pcm + skip, n, fs, TONE_HZ);
+
+        // Stepped sine sweep, relative to 1 kHz
+        double gain_db[SWEEP_POINTS];
+        double flatness = 0, bandwidth = fs / 2.0;
+        bool band_edge = false;
+        for (size_t k = 0; k < SWEEP_POINTS; k++) {
+            gain_db[k] = NAN;
+            if (sweep_hz[k] >= fs / 2.0) continue;
+            modulate(pdm, samples * dec, (double)fs * dec, sweep_hz[k], amp);
+            decode(pdm, pcm, samples, fs, dec);
+            tone_result_t t = analyse_tone(pcm + skip, n, fs, sweep_hz[k]);
+            gain_db[k] = 20 * log10(t.a1 / tone.a1);
+            if (sweep_hz[k] >= 200 && sweep_hz[k] <= 1000 && fabs(gain_db[k]) > flatness) {
+                flatness = fabs(gain_db[k]);
+            }
+            // -3 dB point: interpolated in dB over log frequency
+            if (!band_edge && k > 0 && sweep_hz[k] > TONE_HZ && gain_db[k] < -3.0) {
+                double f = (-3.0 - gain_db[k - 1]) / (gain_db[k] - gain_db[k - 1]);
+                bandwidth = sweep_hz[k - 1] * pow(sweep_hz[k] / sweep_hz[k - 1], f);
+                band_edge = true;
+            }
+        }
+
+        printf("%6u %4u %7.1f %9.1f %7.1f %6.2f %8.1f %8.2f %9.0f %9.2f%s\n", fs, dec, mean,
+               noise_rms, tone.snr_db, tone.thd_pct, tone.sinad_db, flatness, bandwidth, rate,
+               tone.clipped ? "  (clipped)" : "");
+        if (verbose) {
+            printf("         response:");
+            for (size_t k = 0; k < SWEEP_POINTS; k++) {
+                if (!isnan(gain_db[k])) printf(" %g Hz %+.1f dB,", sweep_hz[k], gain_db[k]);
+            }
+            printf("\n");
+        }
+
+        const double min_snr = dec == 64 ? MIN_SNR_64 : MIN_SNR_128;
+        if (tone.snr_db < min_snr) {
+            printf("  FAIL: SNR below %.1f dB\n", min_snr);
+            ok = false;
+        }
+        if (tone.thd_pct > MAX_THD_PCT || tone.clipped) {
+            printf("  FAIL: THD above %.1f %% or clipped\n", MAX_THD_PCT);
+            ok = false;
+        }
+        if (fabs(mean) > MAX_DC_LSB || noise_rms > MAX_NOISE_LSB) {
+            printf("  FAIL: DC offset above %.0f LSB or noise above %.0f LSB\n", MAX_DC_LSB,
+                   MAX_NOISE_LSB);
+            ok = false;
+        }
+        if (flatness > MAX_FLATNESS_DB) {
+            printf("  FAIL: response from 200 Hz to 1 kHz off by more than %.1f dB\n",
+                   MAX_FLATNESS_DB);
+            ok = false;
+        }
+        if (bandwidth < MIN_BANDWIDTH * fs) {
+            printf("  FAIL: -3 dB bandwidth below %.2f Fs\n", MIN_BANDWIDTH);
+            ok = false;
+        }
+
+        free(pdm);
+        free(pcm);
+    }
+
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,51 @@
+/*
+ * pdm_filter_variant: one build of OpenPDMFilter.c behind a plain interface.
+ *
+ * CMakeLists.txt compiles this file together with OpenPDMFilter.c once per
+ * variant (table type, 32- or 64-bit stages) and renames the symbols with a
+ * suffix. The filter state is allocated here, because its size depends on the
+ * variant. Used by pdm_filter_check.
+ *
+ * With channels = 2 the input holds the bytes of two microphones interleaved
+ * (L R L R ...) and one filter instance decodes each channel into
+ * interleaved output.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "OpenPDMFilter.h"
+
+void *pdm_variant_new(uint16_t fs, uint8_t decimation, uint8_t channels) {
+    TPDMFilter_InitStruct *p = calloc(1, sizeof(*p));
+    if (!p) return NULL;
+    // Same settings as pdm_microphone_init()
+    p->Fs = fs;
+    p->LP_HZ = fs / 2;
+    p->HP_HZ = 10;
+    p->In_MicChannels = channels;
+    p->Out_MicChannels = channels;
+    p->Decimation = decimation;
+    p->MaxVolume = 64;
+    p->Gain = 16;
+    Open_PDM_Filter_Init(p);
+    return p;
+}
+
+// Decode ms milliseconds, one millisecond per call (as pdm_microphone_read()).
+// For a channel of a stereo stream, pdm and out point to its first byte and
+// sample.
+void pdm_variant_run(void *state, uint8_t *pdm, int16_t *out, int ms, uint16_t volume) {
+    TPDMFilter_InitStruct *p = state;
+    const int bytes_per_ms = p->Fs / 1000 * p->Decimation / 8 * p->In_MicChannels;
+    const int samples_per_ms = p->Fs / 1000 * p->Out_MicChannels;
+    for (int m = 0; m < ms; m++) {
+        uint16_t *o = (uint16_t *)(out + (size_t)m * samples_per_ms);
+        if (p->Decimation == 64) Open_PDM_Filter_64(pdm + (size_t)m * bytes_per_ms, o, volume, p);
+        else Open_PDM_Filter_128(pdm + (size_t)m * bytes_per_ms, o, volume, p);
+    }
+}
+
+size_t pdm_variant_state_size(void) {
+    return sizeof(TPDMFilter_InitStruct);
+}
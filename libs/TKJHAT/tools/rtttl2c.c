@@ -0,0 +1,178 @@
+/*
+ * rtttl2c: RTTTL ring tones to tkjhat/melody tables.
+ *
+ * Each argument is an RTTTL string ("name:d=4,o=5,b=100:8e6,8d#6,p,2a"); a
+ * file given with -f has one per line (empty lines and lines starting with #
+ * are skipped). For each tune a const struct melody_note table named after
+ * the tune is printed, with the RTTTL in a comment above it, ready to paste
+ * into a program that plays it with melody_play().
+ *
+ * --check parses a few tunes with known notes (e.g. A4 = 440 Hz, a dotted
+ * half note at 100 bpm = 1800 ms) and some broken strings that must be
+ * rejected.
+ *
+ * Usage:
+ *   rtttl2c [-n MAX_NOTES] "rtttl"... | -f file
+ *   rtttl2c --check
+ *
+ * Exit code is 1 if a tune does not parse (or a check fails), 2 on a bad
+ * argument or file.
+ */
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <tkjhat/melody.h>
+
+#define MAX_NOTES   512
+#define LINE_LEN    4096
+#define PER_LINE    4               // notes per output line
+
+static struct melody_note notes[MAX_NOTES];
+
+// C identifier from the tune name
+static void table_name(const char *name, char *out, size_t size) {
+    size_t n = 0;
+    if (!isalpha((unsigned char)name[0]) && n + 1 < size)
+        out[n++] = 'm';
+    for (const char *p = name; *p && n + 1 < size; p++)
+        out[n++] = isalnum((unsigned char)*p) ? (char)tolower((unsigned char)*p) : '_';
+    out[n] = '\0';
+}
+
+static bool convert(const char *text, size_t max_notes) {
+    char name[64], id[80];
+    int count = melody_parse_rtttl(text, notes, max_notes, name, sizeof(name));
+    if (count < 0) {
+        fprintf(stderr, "cannot parse (or over %zu notes): %s\n", max_notes, text);
+        return false;
+    }
+    table_name(name, id, sizeof(id));
+    unsigned long ms = 0;
+    for (int i = 0; i < count; i++)
+        ms += notes[i].ms;
+
+    printf("// %s\n// %d notes, %.1f s\n", text, count, ms / 1000.0);
+    printf("static const struct melody_note %s[] = {\n", id);
+    for (int i = 0; i < count; i++) {
+        printf("%s{%u, %u},", i % PER_LINE == 0 ? "    " : " ", notes[i].freq, notes[i].ms);
+        if (i % PER_LINE == PER_LINE - 1 || i == count - 1)
+            printf("\n");
+    }
+    printf("};\n\n");
+    return true;
+}
+
+typedef struct {
+    const char *text;
+    int count;                      // -1: must be rejected
+    struct melody_note expect[8];
+} check_t;
+
+static const check_t checks[] = {
+    { "Intro:d=16,o=4,b=100:a,d5,a,d5,2a,4f,4g,2d.", 8,
+      { {440, 150}, {587, 150}, {440, 150}, {587, 150}, {440, 1200}, {349, 600}, {392, 600}, {294, 1800} } },
+    { "Defaults::c,p,a#,8b.", 4,
+      { {1047, 952}, {0, 952}, {1865, 952}, {1976, 714} } },
+    { " Spaces : d=8 , o=5 , b=120 : c , 4e. , 16g7 , 2p ", 4,
+      { {523, 250}, {659, 750}, {3136, 125}, {0, 1000} } },
+    { "Range:d=1,o=3,b=240:c,b8", 2,
+      { {131, 1000}, {7902, 1000} } },
+    { "Upper:D=4,O=5,B=60:A,C#6", 2,
+      { {880, 1000}, {1109, 1000} } },
+    { "no colon", -1, { {0, 0} } },
+    { "Bad:d=3,o=5,b=100:a", -1, { {0, 0} } },
+    { "Bad:d=4,o=9,b=100:a", -1, { {0, 0} } },
+    { "Bad:d=4,o=5,b=100:h", -1, { {0, 0} } },
+    { "Bad:d=4,o=5,b=100:a2", -1, { {0, 0} } },
+    { "Bad:d=4,o=5,b=100:p#", -1, { {0, 0} } },
+    { "Bad:d=4,o=5,b=100:a;b", -1, { {0, 0} } },
+    { "Long:d=1,o=5,b=1:a.", -1, { {0, 0} } },
+};
+
+static bool run_checks(void) {
+    bool ok = true;
+    for (size_t i = 0; i < sizeof(checks) / sizeof(checks[0]); i++) {
+        const check_t *c = &checks[i];
+        int count = melody_parse_rtttl(c->text, notes, MAX_NOTES, NULL, 0);
+        bool pass = count == c->count;
+        for (int k = 0; pass && k < count; k++)
+            pass = notes[k].freq == c->expect[k].freq && notes[k].ms == c->expect[k].ms;
+        printf("%-50s %3d notes%s\n", c->text, count, pass ? "" : "  <-- FAIL");
+        if (!pass && count > 0) {
+            for (int k = 0; k < count; k++)
+                printf("    {%u, %u}\n", notes[k].freq, notes[k].ms);
+        }
+        ok = ok && pass;
+    }
+
+    // Overflow of the output
+    int count = melody_parse_rtttl("Full:d=4,o=5,b=100:a,b,c", notes, 2, NULL, 0);
+    printf("%-50s %3d notes%s\n", "3 notes into room for 2", count, count == -1 ? "" : "  <-- FAIL");
+    ok = ok && count == -1;
+
+    // Name cut to the buffer
+    char name[4];
+    melody_parse_rtttl("Longname:d=4,o=5,b=100:a", notes, MAX_NOTES, name, sizeof(name));
+    printf("%-50s \"%s\"%s\n", "name into 4 bytes", name, !strcmp(name, "Lon") ? "" : "  <-- FAIL");
+    ok = ok && !strcmp(name, "Lon");
+
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok;
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [-n MAX_NOTES] \"rtttl\"... | -f file\n       %s --check\n", argv0, argv0);
+}
+
+int main(int argc, char **argv) {
+    size_t max_notes = MAX_NOTES;
+    const char *file = NULL;
+    int first = argc;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--check")) {
+            return run_checks() ? 0 : 1;
+        } else if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            max_notes = (size_t)atoi(argv[++i]);
+            if (max_notes == 0 || max_notes > MAX_NOTES) {
+                usage(argv[0]);
+                return 2;
+            }
+        } else if (!strcmp(argv[i], "-f") && i + 1 < argc) {
+            file = argv[++i];
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return 2;
+        } else {
+            first = i;
+            break;
+        }
+    }
+    if (!file && first == argc) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    bool ok = true;
+    if (file) {
+        FILE *f = fopen(file, "r");
+        if (!f) {
+            fprintf(stderr, "cannot open %s\n", file);
+            return 2;
+        }
+        char line[LINE_LEN];
+        while (fgets(line, sizeof(line), f)) {
+            line[strcspn(line, "\r\n")] = '\0';
+            if (line[0] == '\0' || line[0] == '#')
+                continue;
+            ok = convert(line, max_notes) && ok;
+        }
+        fclose(f);
+    }
+    for (int i = first; i < argc; i++)
+        ok = convert(argv[i], max_notes) && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,72 @@
+/*
+ * sim_signal: synthetic audio shared by the host simulations. See
+ * sim_signal.h.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "sim_signal.h"
+
+double sim_urand(void) {
+    return rand() / (RAND_MAX + 1.0);
+}
+
+double sim_gauss(void) {
+    double u = sim_urand() + 1e-12, v = sim_urand();
+    return sqrt(-2.0 * log(u)) * cos(2.0 * SIM_PI * v);
+}
+
+int16_t sim_sat(double x, double limit) {
+    x = x < 0 ? x - 0.5 : x + 0.5;
+    if (x > limit) x = limit;
+    if (x < -limit) x = -limit;
+    return (int16_t)x;
+}
+
+size_t sim_add_word(double *x, bool *truth, size_t n, size_t t, double level, const struct sim_word *w,
+                    uint32_t rate) {
+    const int syllables = 1 + rand() % 3;
+    const double f0 = 100.0 + 120.0 * sim_urand();
+    const double release = 0.04 * rate;
+    double phase = 0.0;
+    for (int s = 0; s < syllables; s++) {
+        const size_t len = (size_t)((0.12 + 0.13 * sim_urand()) * rate);
+        const double attack = (w->attack_s + w->attack_var_s * sim_urand()) * rate;
+        const double f1 = 400.0 + 400.0 * sim_urand(), f2 = 1100.0 + 900.0 * sim_urand();
+        for (size_t i = 0; i < len && t < n; i++, t++) {
+            double env = i < attack ? i / attack : 1.0;
+            if (i > len - release) env *= (len - i) / release;
+            phase += 2.0 * SIM_PI * f0 * (1.0 + w->wobble * (i % 200)) / rate;
+            double v = 0.0;
+            for (int k = 1; k * f0 < 3500.0; k++) {
+                const double f = k * f0;
+                v += (1.0 / (1.0 + pow((f - f1) / 150.0, 2)) +
+                      0.5 / (1.0 + pow((f - f2) / 250.0, 2))) * sin(k * phase);
+            }
+            x[t] += level * env * v / 2.0;
+            if (truth) truth[t] = true;
+        }
+    }
+    return t;
+}
+
+size_t sim_add_fricative(double *x, bool *truth, size_t n, size_t t, size_t len, double a) {
+    double prev = 0.0;
+    for (size_t i = 0; i < len && t < n; i++, t++) {
+        const double g = sim_gauss();
+        x[t] += a * (g - prev) * sin(SIM_PI * i / len);
+        prev = g;
+        if (truth) truth[t] = true;
+    }
+    return t;
+}
+
+void sim_add_burst(double *x, size_t n, size_t t, double rms, double attack_s, double tau_s, uint32_t rate) {
+    const size_t len = (size_t)(tau_s * 7.0 * rate);
+    for (size_t i = 0; i < len && t + i < n; i++) {
+        const double s = (double)i / rate;
+        const double env = (s < attack_s ? s / attack_s : 1.0) * exp(-s / tau_s);
+        x[t + i] += rms * env * sim_gauss();
+    }
+}
@@ -0,0 +1,55 @@
+/*
+ * sim_signal: synthetic audio shared by the host simulations (vad_sim,
+ * agc_sim, clap_sim, morse_audio_sim).
+ *
+ * Random numbers come from rand(), so a --seed given to srand() repeats a
+ * run. The generators add into a double buffer; sim_sat() turns it into
+ * PCM.
+ *
+ * Speech is built from words: one to three vowels on a pitch of 100-220 Hz
+ * (all harmonics under 3.5 kHz, shaped by two formants, 400-800 Hz and
+ * 1100-2000 Hz, picked per vowel), with a linear attack and a 40 ms release.
+ * Fricatives ("s", "f") are differentiated noise under a half sine, and
+ * bursts (plosives, claps, key clicks) are noise with an attack and an
+ * exponential decay.
+ */
+
+#ifndef SIM_SIGNAL_H
+#define SIM_SIGNAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SIM_PI          3.14159265358979323846
+
+// Vowels of a word
+struct sim_word {
+    double attack_s;                // shortest attack of a vowel
+    double attack_var_s;            // attack is up to this much longer
+    double wobble;                  // pitch rises by this much per sample, restarting every 200 samples (0 = steady)
+};
+
+// Uniform in [0, 1)
+double sim_urand(void);
+
+// Normal, mean 0, standard deviation 1
+double sim_gauss(void);
+
+// Rounded and clipped to +-limit
+int16_t sim_sat(double x, double limit);
+
+// Adds a word at level (vowel amplitude) from sample t; the samples are also
+// marked in truth (can be NULL). Returns the sample after the word.
+size_t sim_add_word(double *x, bool *truth, size_t n, size_t t, double level, const struct sim_word *w,
+                    uint32_t rate);
+
+// Adds a fricative of len samples and amplitude a from sample t (marked in
+// truth, can be NULL). Returns the sample after it.
+size_t sim_add_fricative(double *x, bool *truth, size_t n, size_t t, size_t len, double a);
+
+// Adds a noise burst of the given rms from sample t: linear attack, then an
+// exponential decay with time constant tau_s (7 time constants long)
+void sim_add_burst(double *x, size_t n, size_t t, double rms, double attack_s, double tau_s, uint32_t rate);
+
+#endif /* SIM_SIGNAL_H */
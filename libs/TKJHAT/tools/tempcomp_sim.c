@@ -0,0 +1,269 @@
+/*
+ * tempcomp_sim: check tkjhat/imu_tempcomp against a simulated warming board.
+ *
+ * The simulated ICM-42670 has a gyroscope bias that follows the die
+ * temperature (offset, slope and a small curvature) and an accelerometer bias
+ * with a temperature slope. The board warms up from room temperature while it
+ * is used: short gestures, then rests in a random orientation. Like the morse
+ * application, the FIFO is read during gestures and once every few seconds
+ * while the board rests.
+ *
+ * Two sessions are run. The model learned in the first one is exported and
+ * imported into a fresh state before the second (a power cycle), so the second
+ * session shows the compensation from a cold start without any calibration.
+ *
+ * Usage:
+ *   tempcomp_sim [--odr HZ] [--afsr G] [--gfsr DPS] [--minutes M] [--seed S]
+ *
+ * Exit code is 1 if, in the second session, the gyroscope bias left after the
+ * compensation is above 0.1 dps or a quarter of the uncompensated one, the
+ * accelerometer drift is not reduced by half, or the record round trip fails.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <tkjhat/imu_tempcomp.h>
+
+#define BATCH           32
+#define IDLE_READ_S     10.0        // FIFO read while resting
+#define FIFO_PACKETS    128
+#define GYRO_NOISE_DPS  0.05
+#define ACCEL_NOISE_G   0.0015
+
+static double urand(void) {
+    return rand() / (RAND_MAX + 1.0);
+}
+
+static double gauss(void) {
+    double u = urand() + 1e-12, v = urand();
+    return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * v);
+}
+
+static int16_t sat(double x) {
+    x = x < 0 ? x - 0.5 : x + 0.5;
+    if (x > 32767) return 32767;
+    if (x < -32768) return -32768;
+    return (int16_t)x;
+}
+
+// True biases of the simulated unit at temperature t (°C)
+static void gyro_bias_dps(double t, double b[3]) {
+    const double d = t - 25.0;
+    b[0] = 0.60 + 0.020 * d + 0.0003 * d * d;
+    b[1] = -0.35 - 0.015 * d;
+    b[2] = 0.20 + 0.030 * d - 0.0002 * d * d;
+}
+
+static void accel_bias_g(double t, double b[3]) {
+    const double d = t - 25.0;
+    b[0] = 0.012 + 0.00040 * d;
+    b[1] = -0.008 - 0.00025 * d;
+    b[2] = 0.020 + 0.00050 * d;
+}
+
+typedef struct {
+    double gx, gy, gz;          // gravity direction while resting
+} pose_t;
+
+static void random_pose(pose_t *p) {
+    static const pose_t poses[] = {
+        { 0, 0, 1 }, { 0, 0, -1 }, { 0.26, 0, 0.97 }, { 0, -0.5, 0.87 }, { 1, 0, 0 },
+    };
+    *p = poses[rand() % (int)(sizeof(poses) / sizeof(poses[0]))];
+}
+
+typedef struct {
+    double odr, a_lsb, g_lsb;
+    double t0, t1, tau_s;       // warm-up: t0 -> t1 with time constant tau
+} board_t;
+
+static double board_temp(const board_t *b, double time_s) {
+    return b->t1 - (b->t1 - b->t0) * exp(-time_s / b->tau_s);
+}
+
+static void make_sample(const board_t *b, double time_s, const pose_t *p, double move,
+                        icm42670_raw_sample_t *s) {
+    const double t = board_temp(b, time_s);
+    double gb[3], ab[3];
+    gyro_bias_dps(t, gb);
+    accel_bias_g(t, ab);
+    const double w = sin(2.0 * M_PI * 3.0 * time_s) * move;
+    s->ax = sat((p->gx + ab[0] + 0.6 * w + ACCEL_NOISE_G * gauss()) * b->a_lsb);
+    s->ay = sat((p->gy + ab[1] + ACCEL_NOISE_G * gauss()) * b->a_lsb);
+    s->az = sat((p->gz + ab[2] + 0.3 * w + ACCEL_NOISE_G * gauss()) * b->a_lsb);
+    s->gx = sat((gb[0] + 120.0 * w + GYRO_NOISE_DPS * gauss()) * b->g_lsb);
+    s->gy = sat((gb[1] + 40.0 * w + GYRO_NOISE_DPS * gauss()) * b->g_lsb);
+    s->gz = sat((gb[2] + GYRO_NOISE_DPS * gauss()) * b->g_lsb);
+    // FIFO temperature: 0.5 °C steps, register scale
+    s->temp = (int16_t)(lround((t - 25.0) * 2.0) * 64);
+}
+
+typedef struct {
+    double gyro_raw_max, gyro_comp_max;     // worst 1 s mean bias (dps) while resting
+    double accel_raw_drift, accel_comp_drift; // largest change of the resting accel (g)
+    unsigned long still_windows;
+} session_result_t;
+
+// One session of `minutes`. `learn` feeds the module like the application does.
+static void run_session(imu_tempcomp_t *tc, const board_t *b, double minutes, bool measure,
+                        session_result_t *res) {
+    memset(res, 0, sizeof(*res));
+    icm42670_raw_sample_t batch[BATCH], copy[BATCH];
+    const double dt = 1.0 / b->odr;
+    double time_s = 0;
+    pose_t pose;
+    random_pose(&pose);
+    double ref_raw[3] = { 0 }, ref_comp[3] = { 0 };
+    pose_t ref_pose = pose;
+    bool have_ref = false;
+
+    while (time_s < minutes * 60.0) {
+        // A few gestures (read continuously), then a rest in a new orientation
+        int gestures = 1 + rand() % 4;
+        double busy = gestures * (0.4 + 0.4 * urand()) + 1.0;
+        imu_tempcomp_reset_window(tc);
+        for (double t = 0; t < busy; t += BATCH * dt) {
+            for (int i = 0; i < BATCH; i++) {
+                double tt = time_s + t + i * dt;
+                double move = fmod(t + i * dt, 0.8) < 0.4 && t < busy - 1.0 ? 1.0 : 0.0;
+                make_sample(b, tt, &pose, move, &batch[i]);
+            }
+            imu_tempcomp_learn(tc, batch, BATCH);
+            imu_tempcomp_apply(tc, batch, BATCH);
+        }
+        time_s += busy;
+        random_pose(&pose);
+
+        // Rest: the FIFO holds the last 128 samples when it is read
+        double rest = 20.0 + 100.0 * urand();
+        for (double t = IDLE_READ_S; t <= rest; t += IDLE_READ_S) {
+            double t_read = time_s + t;
+            imu_tempcomp_reset_window(tc);   // gap since the previous read
+            double sum_raw[6] = { 0 }, sum_comp[6] = { 0 };
+            int n = 0;
+            for (int k = 0; k < FIFO_PACKETS; k += BATCH) {
+                for (int i = 0; i < BATCH; i++) {
+                    make_sample(b, t_read - (FIFO_PACKETS - k - i) * dt, &pose, 0.0, &batch[i]);
+                }
+                memcpy(copy, batch, sizeof(batch));
+                res->still_windows += (unsigned long)imu_tempcomp_learn(tc, batch, BATCH);
+                imu_tempcomp_apply(tc, copy, BATCH);
+                for (int i = 0; i < BATCH; i++, n++) {
+                    const int16_t r[6] = { batch[i].ax, batch[i].ay, batch[i].az,
+                                           batch[i].gx, batch[i].gy, batch[i].gz };
+                    const int16_t c[6] = { copy[i].ax, copy[i].ay, copy[i].az,
+                                           copy[i].gx, copy[i].gy, copy[i].gz };
+                    for (int a = 0; a < 6; a++) {
+                        sum_raw[a] += r[a];
+                        sum_comp[a] += c[a];
+                    }
+                }
+            }
+            if (!measure) continue;
+            for (int a = 0; a < 3; a++) {
+                double raw = fabs(sum_raw[3 + a] / n / b->g_lsb);
+                double comp = fabs(sum_comp[3 + a] / n / b->g_lsb);
+                if (raw > res->gyro_raw_max) res->gyro_raw_max = raw;
+                if (comp > res->gyro_comp_max) res->gyro_comp_max = comp;
+            }
+            // Accelerometer drift: only comparable in the first orientation
+            if (pose.gx == ref_pose.gx && pose.gy == ref_pose.gy && pose.gz == ref_pose.gz) {
+                for (int a = 0; a < 3; a++) {
+                    double raw = sum_raw[a] / n / b->a_lsb, comp = sum_comp[a] / n / b->a_lsb;
+                    if (!have_ref) {
+                        ref_raw[a] = raw;
+                        ref_comp[a] = comp;
+                        continue;
+                    }
+                    if (fabs(raw - ref_raw[a]) > res->accel_raw_drift) res->accel_raw_drift = fabs(raw - ref_raw[a]);
+                    if (fabs(comp - ref_comp[a]) > res->accel_comp_drift) res->accel_comp_drift = fabs(comp - ref_comp[a]);
+                }
+                have_ref = true;
+            }
+        }
+        time_s += rest;
+        if (!have_ref) ref_pose = pose;
+    }
+}
+
+int main(int argc, char **argv) {
+    int odr = 100, afsr = 4, gfsr = 250;
+    double minutes = 40.0;
+    unsigned seed = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--odr") && i + 1 < argc) odr = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--afsr") && i + 1 < argc) afsr = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--gfsr") && i + 1 < argc) gfsr = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--minutes") && i + 1 < argc) minutes = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc) seed = (unsigned)atoi(argv[++i]);
+        else {
+            fprintf(stderr, "usage: %s [--odr HZ] [--afsr G] [--gfsr DPS] [--minutes M] [--seed S]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+    srand(seed);
+
+    struct imu_tempcomp_config cfg;
+    imu_tempcomp_default_config(&cfg, (uint16_t)odr, (uint16_t)afsr, (uint16_t)gfsr);
+    imu_tempcomp_t tc;
+    if (imu_tempcomp_init(&tc, &cfg) != 0) {
+        fprintf(stderr, "invalid sensor settings\n");
+        return 2;
+    }
+    const board_t board = {
+        .odr = odr, .a_lsb = 32768.0 / afsr, .g_lsb = 32768.0 / gfsr,
+        .t0 = 22.0, .t1 = 41.0, .tau_s = 600.0,
+    };
+
+    session_result_t s1, s2;
+    run_session(&tc, &board, minutes, false, &s1);
+
+    // Power cycle: the model goes through the flash record
+    imu_tempcomp_record_t rec;
+    imu_tempcomp_export(&tc, &rec);
+    imu_tempcomp_t tc2;
+    imu_tempcomp_init(&tc2, &cfg);
+    bool roundtrip = imu_tempcomp_import(&tc2, &rec) == 0 && !imu_tempcomp_dirty(&tc2);
+    int16_t b1[6], b2[6];
+    for (int t = -10; t <= 30 && roundtrip; t++) {
+        imu_tempcomp_bias(&tc, (int16_t)(t * 128), b1);
+        imu_tempcomp_bias(&tc2, (int16_t)(t * 128), b2);
+        roundtrip = memcmp(b1, b2, sizeof(b1)) == 0;
+    }
+    rec.bins[3].gyro_q8[0] ^= 1;
+    imu_tempcomp_t tc3;
+    imu_tempcomp_init(&tc3, &cfg);
+    bool corrupt_rejected = imu_tempcomp_import(&tc3, &rec) != 0;
+
+    run_session(&tc2, &board, minutes, true, &s2);
+
+    printf("ODR %d Hz, +-%d g, +-%d dps, %.0f min per session, %.0f -> %.0f C\n",
+           odr, afsr, gfsr, minutes, board.t0, board.t1);
+    printf("session 1: %lu still windows learned\n", s1.still_windows);
+    int16_t bias[6];
+    for (int t = 22; t <= 42; t += 5) {
+        double gb[3];
+        gyro_bias_dps(t, gb);
+        imu_tempcomp_bias(&tc, (int16_t)((t - 25) * 128), bias);
+        printf("  %2d C  gyro bias true %6.3f %6.3f %6.3f  model %6.3f %6.3f %6.3f dps\n", t,
+               gb[0], gb[1], gb[2], bias[3] / board.g_lsb, bias[4] / board.g_lsb, bias[5] / board.g_lsb);
+    }
+    printf("session 2 (after power cycle):\n");
+    printf("  gyro bias at rest: %.3f dps uncompensated, %.3f dps compensated (worst axis)\n",
+           s2.gyro_raw_max, s2.gyro_comp_max);
+    printf("  accel drift at rest: %.2f mg uncompensated, %.2f mg compensated\n",
+           s2.accel_raw_drift * 1000.0, s2.accel_comp_drift * 1000.0);
+    printf("record round trip %s, corrupted record %s\n", roundtrip ? "ok" : "FAILED",
+           corrupt_rejected ? "rejected" : "ACCEPTED");
+
+    bool ok = roundtrip && corrupt_rejected &&
+              s2.gyro_comp_max <= 0.1 && s2.gyro_comp_max <= s2.gyro_raw_max / 4 &&
+              s2.accel_comp_drift <= s2.accel_raw_drift / 2;
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
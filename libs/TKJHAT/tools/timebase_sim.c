@@ -0,0 +1,139 @@
+/*
+ * timebase_sim: check tkjhat/imu_timebase against a simulated sensor.
+ *
+ * The simulated ICM-42670 samples at its own (drifting) clock and stores
+ * 16-bit timestamps in a 128-packet FIFO. The FIFO is read at irregular
+ * intervals, like a task delayed by display writes and buzzer waits, with
+ * some long pauses that overflow the FIFO. The estimated sample times are
+ * compared with the true ones.
+ *
+ * Usage:
+ *   timebase_sim [--odr HZ] [--drift PPM] [--seconds S] [--period-ms MS]
+ *                [--jitter-ms MS] [--seed S]
+ *
+ * Exit code is 1 if, after the first 3 s, the RMS time error is above half a
+ * sample period or the maximum above two periods, the drift error is above
+ * 200 ppm or lost samples are not counted correctly.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <tkjhat/imu_timebase.h>
+
+#define FIFO_PACKETS    128
+#define SETTLE_US       3000000.0
+#define MAX_DRIFT_ERR   200.0
+
+static double urand(void) {
+    return rand() / (RAND_MAX + 1.0);
+}
+
+int main(int argc, char **argv) {
+    int odr = 400;
+    double drift_ppm = 12000.0;     // the sensor RC oscillator can be ~1 % off
+    double seconds = 60.0;
+    double read_period_ms = 20.0;
+    double jitter_ms = 15.0;
+    unsigned seed = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--odr") && i + 1 < argc) odr = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--drift") && i + 1 < argc) drift_ppm = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--seconds") && i + 1 < argc) seconds = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--period-ms") && i + 1 < argc) read_period_ms = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--jitter-ms") && i + 1 < argc) jitter_ms = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc) seed = (unsigned)atoi(argv[++i]);
+        else {
+            fprintf(stderr, "usage: %s [--odr HZ] [--drift PPM] [--seconds S] [--period-ms MS] "
+                            "[--jitter-ms MS] [--seed S]\n", argv[0]);
+            return 2;
+        }
+    }
+    srand(seed);
+
+    imu_timebase_t tb;
+    if (imu_timebase_init(&tb, (uint16_t)odr) != 0) {
+        fprintf(stderr, "invalid ODR\n");
+        return 2;
+    }
+
+    const uint32_t period = 1000000u / (uint32_t)odr;   // sensor us
+    const double scale = 1.0 + drift_ppm * 1e-6;        // host us per sensor us
+    const double h0 = 1234567.0;                        // host time of sensor time 0
+    const uint32_t epoch = (uint32_t)(rand() & 0xFFFF);  // timestamp counter at sensor time 0
+
+    uint16_t tmst[FIFO_PACKETS];
+    uint64_t t_us[FIFO_PACKETS];
+
+    uint64_t next_sample = 0;       // index of the oldest sample not read yet
+    double host = h0 + 50000.0;
+    double max_err = 0, sum_err2 = 0, max_interval_err = 0;
+    unsigned long n_err = 0, batches = 0, overflows = 0;
+    long lost_true = 0, lost_est = 0;
+    double prev_true = -1, prev_est = -1;
+
+    while (host < h0 + seconds * 1e6) {
+        // Next read: nominal period plus jitter, sometimes a long pause
+        double wait = read_period_ms * 1000.0 + urand() * jitter_ms * 1000.0;
+        if (urand() < 0.01) wait += 300000.0 + urand() * 2000000.0;
+        host += wait;
+
+        // Samples taken until now (sensor time = (host - h0) / scale)
+        uint64_t newest = (uint64_t)(((host - h0) / scale) / period);
+        uint64_t pending = newest + 1 - next_sample;
+        bool overflow = pending >= FIFO_PACKETS;
+        if (pending > FIFO_PACKETS) {
+            lost_true += (long)(pending - FIFO_PACKETS);
+            next_sample = newest + 1 - FIFO_PACKETS;
+            pending = FIFO_PACKETS;
+        }
+        size_t n = (size_t)pending;
+        for (size_t i = 0; i < n; i++) {
+            tmst[i] = (uint16_t)(epoch + (next_sample + i) * period);
+        }
+        icm42670_fifo_batch_info_t info = {
+            .read_time_us = (uint64_t)(host + 80.0 + urand() * 150.0),  // I2C transfer
+            .overflow = overflow,
+        };
+        overflows += overflow;
+
+        int lost = imu_timebase_update(&tb, tmst, n, &info, t_us);
+        lost_est += lost;
+        batches++;
+
+        for (size_t i = 0; i < n; i++) {
+            double t_true = h0 + (double)((next_sample + i) * period) * scale;
+            double err = (double)t_us[i] - t_true;
+            if (t_true - h0 > SETTLE_US) {
+                if (fabs(err) > max_err) max_err = fabs(err);
+                sum_err2 += err * err;
+                n_err++;
+                if (prev_true >= 0 && i > 0) {
+                    double ie = ((double)t_us[i] - prev_est) - (t_true - prev_true);
+                    if (fabs(ie) > max_interval_err) max_interval_err = fabs(ie);
+                }
+            }
+            prev_true = t_true;
+            prev_est = (double)t_us[i];
+        }
+        next_sample += n;
+    }
+
+    double drift_err = fabs(imu_timebase_drift_ppm(&tb) - drift_ppm);
+    double rms = n_err ? sqrt(sum_err2 / n_err) : 0;
+    printf("ODR %d Hz, drift %.0f ppm, %lu batches (%lu with FIFO overflow)\n",
+           odr, drift_ppm, batches, overflows);
+    printf("time error after %.0f s: max %.1f us, rms %.1f us (period %u us)\n",
+           SETTLE_US / 1e6, max_err, rms, period);
+    printf("interval error: max %.2f us\n", max_interval_err);
+    printf("drift estimate %ld ppm (error %.0f ppm), period %u ns\n",
+           (long)imu_timebase_drift_ppm(&tb), drift_err, imu_timebase_period_ns(&tb));
+    printf("lost samples: %ld counted, %ld true\n", lost_est, lost_true);
+
+    bool ok = rms <= period / 2.0 && max_err <= 2.0 * period && drift_err <= MAX_DRIFT_ERR && lost_est == lost_true;
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
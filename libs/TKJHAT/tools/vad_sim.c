@@ -0,0 +1,201 @@
+/*
+ * vad_sim: tkjhat/vad on synthetic speech in different rooms.
+ *
+ * Speech: words of one to three syllables. A syllable is a vowel (harmonics
+ * of a 100-220 Hz pitch shaped by two formants, 30-50 ms soft attack), and
+ * words may start or end with a fricative (high-passed noise 12-20 dB under
+ * the vowel). Words come in utterances with 1-3 s of silence between.
+ * Backgrounds: quiet room, office noise, a fan (low-passed noise), mains hum,
+ * hiss (white noise with a high zero crossing rate) and a noise level that
+ * steps up 15 dB in the middle.
+ *
+ * The audio goes through vad_push() in microphone frames of MEMS_BUFFER_SIZE
+ * samples, with a pre-roll of PREROLL_FRAMES frames, as in the examples.
+ * Printed per background:
+ *   speech     share of the speech samples that were passed
+ *   clip ms    worst start of an utterance that was lost (pre-roll included)
+ *   passed     share of all frames passed (the rest is saved work)
+ *   false s/min  frames passed with no speech within 0.5 s: wasted work
+ *
+ * Usage:
+ *   vad_sim [--seed S]
+ *
+ * Exit code is 1 if a result is outside its limit.
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <tkjhat/vad.h>
+
+#include "sim_signal.h"
+
+#define RATE            8000
+#define FRAME           256         // MEMS_BUFFER_SIZE
+#define PREROLL_FRAMES  5
+#define SECONDS         60
+
+#define SPEECH_LIMIT    0.99        // least share of speech passed
+#define CLIP_LIMIT_MS   10.0        // longest lost start of an utterance
+#define FALSE_LIMIT     3.0         // most false passes, seconds per minute
+
+typedef struct {
+    const char *name;
+    double white;                   // white noise rms
+    double fan;                     // low-passed noise rms
+    double hum;                     // 50 Hz amplitude
+    double step;                    // white noise rms after the middle (0 = no step)
+    double speech;                  // vowel amplitude
+} room_t;
+
+static const room_t rooms[] = {
+    { "quiet",        3,   0,   0,   0, 3000 },
+    { "office",      40,   0,   0,   0, 2500 },
+    { "fan",          5, 300,   0,   0, 3000 },
+    { "hum",         10,   0, 400,   0, 2500 },
+    { "hiss",       150,   0,   0,   0, 3000 },
+    { "noise step",  20,   0,   0, 112, 3000 },
+};
+
+#define MAX_UTTERANCES 64
+
+// Speech into x (added), truth into speech[]; returns the utterance starts
+static size_t add_speech(double *x, bool *speech, size_t n, double amp, size_t *starts) {
+    static const struct sim_word word = { 0.03, 0.02, 0.0005 };
+    size_t t = (size_t)(1.0 * RATE), u = 0;
+    while (t < n - 3 * RATE && u < MAX_UTTERANCES) {
+        starts[u++] = t;
+        const int words = 1 + rand() % 4;
+        for (int w = 0; w < words; w++) {
+            const double level = amp * (0.5 + 0.5 * sim_urand());
+            // Fricative at the start of some words
+            if (sim_urand() < 0.3) {
+                const size_t len = (size_t)((0.06 + 0.09 * sim_urand()) * RATE);
+                t = sim_add_fricative(x, speech, n, t, len, level * (0.1 + 0.15 * sim_urand()));
+            }
+            t = sim_add_word(x, speech, n, t, level, &word, RATE);
+            // Fricative at the end of some words ("s")
+            if (sim_urand() < 0.3) {
+                const size_t len = (size_t)((0.08 + 0.1 * sim_urand()) * RATE);
+                t = sim_add_fricative(x, speech, n, t, len, level * (0.1 + 0.15 * sim_urand()));
+            }
+            t += (size_t)((0.1 + 0.15 * sim_urand()) * RATE);
+        }
+        t += (size_t)((1.0 + 2.0 * sim_urand()) * RATE);
+    }
+    return u;
+}
+
+typedef struct {
+    double speech, clip_ms, passed, false_per_min, ns;
+} result_t;
+
+static void run(const room_t *room, result_t *r) {
+    const size_t n = SECONDS * RATE;
+    double *x = calloc(n, sizeof(*x));
+    bool *speech = calloc(n, sizeof(*speech)), *passed = calloc(n, sizeof(*passed));
+    int16_t *pcm = malloc(n * sizeof(*pcm));
+    size_t starts[MAX_UTTERANCES];
+    const size_t utterances = add_speech(x, speech, n, room->speech, starts);
+
+    const double k = exp(-2.0 * SIM_PI * 300.0 / RATE);
+    double lp = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        const double white = room->step > 0 && i >= n / 2 ? room->step : room->white;
+        lp = k * lp + (1.0 - k) * sim_gauss();
+        x[i] += white * sim_gauss() + room->fan * 4.0 * lp + room->hum * sin(2.0 * SIM_PI * 50.0 * i / RATE);
+        pcm[i] = sim_sat(x[i], 32767.0);
+    }
+
+    static vad_t vad;
+    static vad_preroll_t preroll;
+    static int16_t storage[PREROLL_FRAMES * FRAME];
+    struct vad_config cfg;
+    vad_default_config(&cfg, RATE);
+    vad_init(&vad, &cfg);
+    vad_preroll_init(&preroll, storage, PREROLL_FRAMES, FRAME);
+
+    // Preroll frames are stored with their position to mark them passed
+    size_t held[PREROLL_FRAMES + 1], nheld = 0;
+    clock_t t0 = clock();
+    for (size_t f = 0; f + FRAME <= n; f += FRAME) {
+        if (!vad_push(&vad, pcm + f, FRAME)) {
+            vad_preroll_push(&preroll, pcm + f, FRAME);
+            if (nheld == PREROLL_FRAMES) {
+                memmove(held, held + 1, (PREROLL_FRAMES - 1) * sizeof(held[0]));
+                nheld--;
+            }
+            held[nheld++] = f;
+            continue;
+        }
+        size_t m, h = 0;
+        while (vad_preroll_pop(&preroll, &m) != NULL)
+            for (size_t i = 0; i < m; i++) passed[held[h] + i] = true, h += (i == m - 1);
+        nheld = 0;
+        for (size_t i = 0; i < FRAME; i++) passed[f + i] = true;
+    }
+    const double secs = (double)(clock() - t0) / CLOCKS_PER_SEC;
+
+    size_t speech_n = 0, speech_passed = 0, passed_n = 0, false_n = 0;
+    for (size_t i = 0; i < n; i++) {
+        speech_n += speech[i];
+        speech_passed += speech[i] && passed[i];
+        passed_n += passed[i];
+    }
+    // False: a passed frame with no speech within 0.5 s
+    for (size_t f = 0; f + FRAME <= n; f += FRAME) {
+        if (!passed[f]) continue;
+        size_t lo = f > RATE / 2 ? f - RATE / 2 : 0, hi = f + FRAME + RATE / 2 < n ? f + FRAME + RATE / 2 : n;
+        bool near = false;
+        for (size_t i = lo; i < hi && !near; i++) near = speech[i];
+        if (!near) false_n += FRAME;
+    }
+    double clip = 0.0;
+    for (size_t u = 0; u < utterances; u++) {
+        size_t i = starts[u];
+        while (i < n && speech[i] && !passed[i]) i++;
+        const double ms = (i - starts[u]) * 1000.0 / RATE;
+        if (ms > clip) clip = ms;
+    }
+    r->speech = (double)speech_passed / speech_n;
+    r->clip_ms = clip;
+    r->passed = (double)passed_n / n;
+    r->false_per_min = (double)false_n / RATE * 60.0 / SECONDS;
+    r->ns = secs * 1e9 / n;
+    free(x);
+    free(speech);
+    free(passed);
+    free(pcm);
+}
+
+int main(int argc, char **argv) {
+    unsigned seed = 1;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--seed") && i + 1 < argc) seed = (unsigned)atoi(argv[++i]);
+        else {
+            fprintf(stderr, "usage: %s [--seed S]\n", argv[0]);
+            return 2;
+        }
+    }
+    srand(seed);
+
+    printf("%-11s %8s %8s %8s %12s %8s\n", "room", "speech", "clip ms", "passed", "false s/min", "ns/smp");
+    bool ok = true;
+    for (size_t i = 0; i < sizeof(rooms) / sizeof(rooms[0]); i++) {
+        result_t r;
+        run(&rooms[i], &r);
+        bool pass = r.speech >= SPEECH_LIMIT && r.clip_ms <= CLIP_LIMIT_MS && r.false_per_min <= FALSE_LIMIT;
+        ok = ok && pass;
+        printf("%-11s %7.1f%% %8.0f %7.1f%% %12.2f %8.2f%s\n", rooms[i].name, 100.0 * r.speech, r.clip_ms,
+               100.0 * r.passed, r.false_per_min, r.ns, pass ? "" : "  <-- FAIL");
+    }
+    printf("\nlimits: speech >= %.0f %%, clip <= %.0f ms, false <= %.1f s/min\n", 100.0 * SPEECH_LIMIT,
+           CLIP_LIMIT_MS, FALSE_LIMIT);
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
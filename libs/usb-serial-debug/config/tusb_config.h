@@ -68,14 +68,46 @@ extern "C" {
 #endif
  
 
+// Optional USB Audio Class 2 microphone (mono, 16 bit) next to the two CDC
+// ports. Enabled with the CMake option USB_SERIAL_DEBUG_AUDIO_MIC, which
+// defines USB_AUDIO_MIC=1 and USB_AUDIO_MIC_SAMPLE_RATE.
+#ifndef USB_AUDIO_MIC
+#define USB_AUDIO_MIC 0
+#endif
+#ifndef USB_AUDIO_MIC_SAMPLE_RATE
+#define USB_AUDIO_MIC_SAMPLE_RATE 16000  // Must match the PDM microphone rate
+#endif
+
 // We don't need other USB classes for this case
 #define CFG_TUD_MSC     0  // Mass Storage Class (USB drive functionality)
 #define CFG_TUD_HID     0  // Human Interface Device (keyboard/mouse)
 #define CFG_TUD_MIDI    0  // MIDI
-#define CFG_TUD_AUDIO   0  // Audio
+#define CFG_TUD_AUDIO   USB_AUDIO_MIC  // Audio (optional microphone, see below)
 #define CFG_TUD_VIDEO   0  // Video
 #define CFG_TUD_VENDOR  0  // Vendor specific class
 
+#if USB_AUDIO_MIC
+//------------- AUDIO (microphone) -------------//
+// One audio function: audio control + one streaming interface with an
+// isochronous IN endpoint. The application pushes PCM with usb_audio_mic_write()
+// (usbSerialDebug/usb_audio.h) into a software FIFO, TinyUSB sends one packet
+// every 1 ms frame from it.
+#define CFG_TUD_AUDIO_FUNC_1_DESC_LEN               TUD_AUDIO_MIC_ONE_CH_DESC_LEN
+#define CFG_TUD_AUDIO_FUNC_1_N_AS_INT               1
+#define CFG_TUD_AUDIO_FUNC_1_CTRL_BUF_SZ            64
+
+#define CFG_TUD_AUDIO_ENABLE_EP_IN                  1
+#define CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_TX  2
+#define CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX          1
+// One sample more than the nominal samples per ms, so the FIFO can catch up
+#define CFG_TUD_AUDIO_EP_SZ_IN                      ((USB_AUDIO_MIC_SAMPLE_RATE / 1000 + 1) * \
+                                                     CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_TX * \
+                                                     CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX)
+#define CFG_TUD_AUDIO_FUNC_1_EP_IN_SZ_MAX           CFG_TUD_AUDIO_EP_SZ_IN
+// Software FIFO: 4 microphone buffers of 256 samples (64 ms at 16 kHz)
+#define CFG_TUD_AUDIO_FUNC_1_EP_IN_SW_BUF_SZ        (4 * 256 * CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_TX)
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,110 @@
+/*
+
+Version 0.80
+
+MIT License
+
+Copyright (c) 2025 Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @file usb_audio.h
+ * @brief Optional USB Audio Class 2 microphone next to the two CDC ports.
+ *
+ * When the library is configured with @c -DUSB_SERIAL_DEBUG_AUDIO_MIC=ON the
+ * board also shows up as a microphone ("TKJHAT Microphone"), mono, 16 bit, at
+ * @c USB_AUDIO_MIC_SAMPLE_RATE (CMake @c USB_SERIAL_DEBUG_AUDIO_RATE, default
+ * 16000 Hz). Any recording program of the host can use it: no framing, no
+ * decoding, no serial port.
+ *
+ * The application copies PCM frames from the PDM microphone into a FIFO with
+ * ::usb_audio_mic_write(); TinyUSB sends one isochronous packet from it every
+ * 1 ms frame. The PDM clock and the USB clock both come from the 12 MHz
+ * crystal, so the rates match and no resampling is needed.
+ *
+ * The mute and volume controls of the host (-40..+20 dB) are applied in
+ * ::usb_audio_mic_write().
+ *
+ * @note Without the option the functions exist but do nothing (write returns 0).
+ * @note You must run TinyUSB in a task (e.g., a task that calls tud_task()).
+ */
+
+
+/**
+ * @brief Check whether the host is recording (streaming interface opened).
+ *
+ * @return @c true while the host reads the microphone; @c false otherwise.
+ */
+bool usb_audio_mic_streaming(void);
+
+/**
+ * @brief Sample rate of the USB microphone in Hz.
+ *
+ * Initialize the PDM microphone with the same rate
+ * (init_pdm_microphone_rate()).
+ *
+ * @return @c USB_AUDIO_MIC_SAMPLE_RATE, or 0 without the audio option.
+ */
+uint32_t usb_audio_mic_sample_rate(void);
+
+/**
+ * @brief Queue PCM samples for the host.
+ *
+ * Applies the mute and volume of the host and copies the samples into the
+ * FIFO of the isochronous endpoint. Samples that do not fit are dropped and
+ * counted (see ::usb_audio_mic_dropped()). Does not block.
+ *
+ * @param pcm     Mono 16-bit samples at ::usb_audio_mic_sample_rate().
+ * @param samples Number of samples.
+ *
+ * @return Number of samples queued. 0 if the host is not recording.
+ *
+ * @note Call from a task, not from an ISR.
+ *
+ * @code
+ * // Example: in the task that reads the PDM PCM queue
+ * while (pdm_microphone_available()) {
+ *   int n = get_microphone_samples(frame, MEMS_BUFFER_SIZE);
+ *   usb_audio_mic_write(frame, n);
+ * }
+ * @endcode
+ */
+size_t usb_audio_mic_write(const int16_t *pcm, size_t samples);
+
+/**
+ * @brief Samples dropped because the FIFO was full (since the host started recording).
+ */
+uint32_t usb_audio_mic_dropped(void);
+
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,211 @@
+/*
+
+Version 0.80
+
+MIT License
+
+Copyright (c) 2025 Iván Sánchez Milara
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ * USB Audio Class 2 microphone (optional, CFG_TUD_AUDIO).
+ * The interfaces and the endpoint are in usb_descriptors.c. Here: the class
+ * requests of the host (sample rate, mute, volume) and the sample FIFO.
+ * Entity IDs are the ones of TUD_AUDIO_MIC_ONE_CH_DESCRIPTOR.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include <tusb.h>
+
+#include "usbSerialDebug/usb_audio.h"
+
+#if CFG_TUD_AUDIO
+
+#define ENTITY_INPUT_TERMINAL   0x01
+#define ENTITY_FEATURE_UNIT     0x02
+#define ENTITY_CLOCK            0x04
+
+// Volume in 1/256 dB, as in UAC2
+#define VOLUME_MIN              (-40 * 256)
+#define VOLUME_MAX              (20 * 256)
+#define VOLUME_RES              256
+#define GAIN_SHIFT              12      // gain is Q12: 4096 = 0 dB
+
+#define WRITE_CHUNK             64      // samples scaled on the stack at a time
+
+static volatile bool streaming;
+static volatile uint32_t dropped;
+static bool mute;
+static int16_t volume;                  // 0 dB
+static int32_t gain_q12 = 1 << GAIN_SHIFT;
+
+bool usb_audio_mic_streaming(void) {
+    return streaming;
+}
+
+uint32_t usb_audio_mic_sample_rate(void) {
+    return USB_AUDIO_MIC_SAMPLE_RATE;
+}
+
+uint32_t usb_audio_mic_dropped(void) {
+    return dropped;
+}
+
+size_t usb_audio_mic_write(const int16_t *pcm, size_t samples) {
+    if (!pcm || !streaming)
+        return 0;
+
+    int16_t chunk[WRITE_CHUNK];
+    const int32_t g = mute ? 0 : gain_q12;
+    size_t queued = 0;
+    while (queued < samples) {
+        size_t n = samples - queued;
+        if (n > WRITE_CHUNK) n = WRITE_CHUNK;
+        for (size_t i = 0; i < n; i++) {
+            int32_t s = (pcm[queued + i] * g) >> GAIN_SHIFT;
+            if (s > 32767) s = 32767;
+            else if (s < -32768) s = -32768;
+            chunk[i] = (int16_t)s;
+        }
+        uint16_t written = tud_audio_write(chunk, (uint16_t)(n * sizeof(chunk[0])));
+        queued += written / sizeof(chunk[0]);
+        if (written < n * sizeof(chunk[0]))
+            break;  // FIFO full
+    }
+    dropped += (uint32_t)(samples - queued);
+    return queued;
+}
+
+//--------------------------------------------------------------------
+// TinyUSB audio callbacks
+//--------------------------------------------------------------------
+
+// Host opens (alternate setting 1) or closes (0) the streaming interface
+bool tud_audio_set_itf_cb(uint8_t rhport, tusb_control_request_t const *p_request) {
+    (void) rhport;
+    if (tu_u16_low(p_request->wValue) != 0) {
+        dropped = 0;
+        streaming = true;
+    }
+    return true;
+}
+
+bool tud_audio_set_itf_close_EP_cb(uint8_t rhport, tusb_control_request_t const *p_request) {
+    (void) rhport;
+    (void) p_request;
+    streaming = false;
+    return true;
+}
+
+bool tud_audio_get_req_entity_cb(uint8_t rhport, tusb_control_request_t const *p_request) {
+    uint8_t const ctrl = tu_u16_high(p_request->wValue);
+    uint8_t const entity = tu_u16_high(p_request->wIndex);
+
+    if (entity == ENTITY_CLOCK) {
+        if (ctrl == AUDIO_CS_CTRL_SAM_FREQ) {
+            if (p_request->bRequest == AUDIO_CS_REQ_CUR) {
+                uint32_t rate = USB_AUDIO_MIC_SAMPLE_RATE;
+                return tud_audio_buffer_and_schedule_control_xfer(rhport, p_request, &rate, sizeof(rate));
+            }
+            if (p_request->bRequest == AUDIO_CS_REQ_RANGE) {
+                // One fixed rate
+                audio_control_range_4_n_t(1) range = {
+                    .wNumSubRanges = 1,
+                    .subrange[0] = { USB_AUDIO_MIC_SAMPLE_RATE, USB_AUDIO_MIC_SAMPLE_RATE, 0 },
+                };
+                return tud_audio_buffer_and_schedule_control_xfer(rhport, p_request, &range, sizeof(range));
+            }
+        }
+        else if (ctrl == AUDIO_CS_CTRL_CLK_VALID) {
+            uint8_t valid = 1;
+            return tud_audio_buffer_and_schedule_control_xfer(rhport, p_request, &valid, sizeof(valid));
+        }
+    }
+    else if (entity == ENTITY_INPUT_TERMINAL && ctrl == AUDIO_TE_CTRL_CONNECTOR) {
+        audio_desc_channel_cluster_t cluster = { .bNrChannels = 1, .bmChannelConfig = 0, .iChannelNames = 0 };
+        return tud_audio_buffer_and_schedule_control_xfer(rhport, p_request, &cluster, sizeof(cluster));
+    }
+    else if (entity == ENTITY_FEATURE_UNIT) {
+        if (ctrl == AUDIO_FU_CTRL_MUTE) {
+            uint8_t cur = mute;
+            return tud_audio_buffer_and_schedule_control_xfer(rhport, p_request, &cur, sizeof(cur));
+        }
+        if (ctrl == AUDIO_FU_CTRL_VOLUME) {
+            if (p_request->bRequest == AUDIO_CS_REQ_CUR)
+                return tud_audio_buffer_and_schedule_control_xfer(rhport, p_request, &volume, sizeof(volume));
+            if (p_request->bRequest == AUDIO_CS_REQ_RANGE) {
+                audio_control_range_2_n_t(1) range = {
+                    .wNumSubRanges = 1,
+                    .subrange[0] = { VOLUME_MIN, VOLUME_MAX, VOLUME_RES },
+                };
+                return tud_audio_buffer_and_schedule_control_xfer(rhport, p_request, &range, sizeof(range));
+            }
+        }
+    }
+    return false;   // stall: not supported
+}
+
+bool tud_audio_set_req_entity_cb(uint8_t rhport, tusb_control_request_t const *p_request, uint8_t *buf) {
+    (void) rhport;
+    uint8_t const ctrl = tu_u16_high(p_request->wValue);
+    uint8_t const entity = tu_u16_high(p_request->wIndex);
+
+    if (entity != ENTITY_FEATURE_UNIT || p_request->bRequest != AUDIO_CS_REQ_CUR)
+        return false;
+    if (ctrl == AUDIO_FU_CTRL_MUTE) {
+        mute = buf[0] != 0;
+        return true;
+    }
+    if (ctrl == AUDIO_FU_CTRL_VOLUME) {
+        int16_t v;
+        memcpy(&v, buf, sizeof(v));
+        if (v < VOLUME_MIN) v = VOLUME_MIN;
+        if (v > VOLUME_MAX) v = VOLUME_MAX;
+        volume = v;
+        gain_q12 = (int32_t)lroundf(powf(10.0f, v / (256.0f * 20.0f)) * (1 << GAIN_SHIFT));
+        return true;
+    }
+    return false;
+}
+
+#else
+
+bool usb_audio_mic_streaming(void) {
+    return false;
+}
+
+uint32_t usb_audio_mic_sample_rate(void) {
+    return 0;
+}
+
+uint32_t usb_audio_mic_dropped(void) {
+    return 0;
+}
+
+size_t usb_audio_mic_write(const int16_t *pcm, size_t samples) {
+    (void) pcm;
+    (void) samples;
+    return 0;
+}
+
+#endif
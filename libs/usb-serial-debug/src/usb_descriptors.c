@@ -30,6 +30,8 @@ SOFTWARE.
  * Creates TWO separate CDC interfaces:
  * - CDC0: For printf/debug output
  * - CDC1: For communication messages  
+ * With USB_AUDIO_MIC (CMake option USB_SERIAL_DEBUG_AUDIO_MIC) also:
+ * - Audio: USB Audio Class 2 microphone, mono 16 bit (see usb_audio.c)
  * 
  */
 
@@ -43,7 +45,9 @@ SOFTWARE.
 #define _PID_MAP(itf, n)  ( (CFG_TUD_##itf) << (n) )
 #define CDC_EXAMPLE_VID     0xCafe                  // If problem use 0x2E8A (Raspberry pi)
 // use _PID_MAP to generate unique PID for each interface
-#define CDC_EXAMPLE_PID     (0x4000 | _PID_MAP(CDC, 0))  //If using Raspberry Pi VID 0x000A
+// (the audio bit gives the microphone build its own PID, so the host does not
+// reuse the cached descriptors of the CDC only build)
+#define CDC_EXAMPLE_PID     (0x4000 | _PID_MAP(CDC, 0) | _PID_MAP(AUDIO, 8))  //If using Raspberry Pi VID 0x000A
 // set USB 2.0
 #define CDC_BCD     0x0200  
 
@@ -80,6 +84,10 @@ enum {
     ITF_NUM_CDC_0_DATA,
     ITF_NUM_CDC_1,
     ITF_NUM_CDC_1_DATA,
+#if CFG_TUD_AUDIO
+    ITF_NUM_AUDIO_CONTROL,
+    ITF_NUM_AUDIO_STREAMING,
+#endif
     ITF_NUM_TOTAL
 };
 
@@ -88,8 +96,12 @@ enum {
 // This creates a composite device with TWO CDC interfaces
 //--------------------------------------------------------------------
 
-// Calculate total length: config + 2 CDC interfaces
+// Calculate total length: config + 2 CDC interfaces (+ microphone)
+#if CFG_TUD_AUDIO
+#define CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_CDC_DESC_LEN + TUD_CDC_DESC_LEN + TUD_AUDIO_MIC_ONE_CH_DESC_LEN)
+#else
 #define CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_CDC_DESC_LEN + TUD_CDC_DESC_LEN)
+#endif
 
 // Endpoint numbers for first CDC interface (CDC0 - Debug/Printf)
 #define EPNUM_CDC0_NOTIF 0x81    // CDC0 notification endpoint
@@ -101,6 +113,9 @@ enum {
 #define EPNUM_CDC1_OUT   0x04    // CDC1 data out endpoint
 #define EPNUM_CDC1_IN    0x84    // CDC1 data in endpoint
 
+// Endpoint of the microphone (isochronous IN)
+#define EPNUM_AUDIO_IN   0x85
+
 // configure descriptor (for 2 CDC interfaces)
 uint8_t const desc_configuration[] = {
     // config descriptor | how much power in mA, count of interfaces, ...
@@ -129,6 +144,15 @@ uint8_t const desc_configuration[] = {
                                    EPNUM_CDC1_IN, 
                                    CFG_TUD_CDC_EP_BUFSIZE),
 
+#if CFG_TUD_AUDIO
+    // Microphone: audio control + streaming interface, 1 channel of 16 bits
+    TUD_AUDIO_MIC_ONE_CH_DESCRIPTOR(ITF_NUM_AUDIO_CONTROL,        // First interface number
+                                    6,                            // String index
+                                    CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_TX,
+                                    CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_TX * 8, // bits used per sample
+                                    EPNUM_AUDIO_IN,               // isochronous IN endpoint
+                                    CFG_TUD_AUDIO_EP_SZ_IN),      // max packet size
+#endif
 };
 
 // called when host requests to get configuration descriptor
@@ -165,6 +189,7 @@ enum {
     STRID_SERIAL,       // 3: Serials
     STRID_CDC_0,        // 4: CDC Interface 0
     STRID_CDC_1,        // 5: CDC Interface 1
+    STRID_AUDIO,        // 6: Microphone (only with CFG_TUD_AUDIO)
 };
 
 
@@ -175,7 +200,8 @@ char const* string_desc_arr [] = {
     "123456",                        // 3: Serial number (overwritten with unique ID)
     "Stdout CDC",                    // 4: CDC0 Interface (Debug/Printf)
     "Communication CDC",             // 5: CDC1 Interface (Messages)
-    //"Reset"                          // 6: Reset interface (not added)
+    "TKJHAT Microphone",             // 6: Audio function (microphone)
+    //"Reset"                          // 7: Reset interface (not added)
 };
 
 // buffer to hold the string descriptor during the request | plus 1 for the null terminator
@@ -13,6 +13,15 @@
 #include <tusb.h>
 #include "usbSerialDebug/helper.h"
 #include "tkjhat/sdk.h"
+#include "tkjhat/gesture.h"
+#include "tkjhat/imu_tempcomp.h"
+#include "tkjhat/tone_detect.h"
+#include "tkjhat/morse_decode.h"
+#include "tkjhat/vad.h"
+#include "tkjhat/clap.h"
+#include "tkjhat/melody.h"
+#include "tkjhat/morse_player.h"
+#include "tkjhat/pdm_microphone_task.h"
 
 #if CFG_TUSB_OS != OPT_OS_FREERTOS
 #error "This should be using FREERTOS but the CFG_TUSB_OS is not OPT_OS_FREERTOS"
@@ -24,6 +33,20 @@
 #define MAX_RX_LEN 64      // maksimi pituus vastaanotettavalle viestille
 #define BUFFER_SIZE 100    // imu buffer size
 #define MORSE_BUF_SIZE 128 // MORSE viestin bufferi
+#define WOM_THRESHOLD_MG 60        // IMU:n herätyskynnys (wake-on-motion), mg näytteestä toiseen
+#define IMU_BATCH 32               // FIFOsta kerralla luettavat näytteet
+#define IMU_READ_PERIOD_MS 20      // FIFO-lukuväli liikkeen aikana
+#define IMU_ACTIVE_US 1000000      // FIFOa luetaan vähintään näin kauan herätyksen jälkeen
+#define TEMPCOMP_IDLE_READ_US 10000000   // levossa FIFO luetaan näin usein biasin oppimista varten
+#define TEMPCOMP_SAVE_US 600000000       // opittu biasmalli tallennetaan flashiin korkeintaan näin usein
+#define MORSE_MIC_INPUT 0          // 1 = COLLECTING-tilassa kuunnellaan myös toisen laitteen summeria mikrofonilla
+#define MORSE_UNIT_MS 100          // pisteen pituus, josta mikrofonin dekooderi aloittaa (seuraa lähettäjää)
+#define MORSE_WPM 12               // vastaanotetun viestin soittonopeus (PARIS, 12 WPM = 100 ms piste)
+#define MORSE_FARNSWORTH_WPM 0     // Farnsworth: merkit MORSE_WPM-nopeudella, välit venytetään tähän kokonaisnopeuteen (0 = ei)
+#define MORSE_MIC_VAD 1            // 1 = hiljaiset kehykset ohitetaan (0 = Goertzel aina: kuulee äänen myös kovassa kohinassa)
+#define MIC_CLAP_INPUT 0           // 1 = COLLECTING-tilassa taputus on välilyönti (kuten BUTTON2), kaksi taputusta lähettää (kuten BUTTON1)
+#define MIC_INPUT (MORSE_MIC_INPUT || MIC_CLAP_INPUT)
+#define MIC_PCM_FRAMES 4           // mikrofonin PCM-jono, MEMS_BUFFER_SIZE näytettä (32 ms) kehystä kohden
 
 // Tilakoneen esittely ---- lisää puuttuvat tilat tarvittaessa
 // TILAT:
@@ -44,6 +67,13 @@ enum state
 };
 enum state programState = WAITING;
 
+// Syötteet: painikkeet ja taputukset kulkevat saman käsittelijän kautta
+enum input_event
+{
+    INPUT_NEXT, // BUTTON1 tai kaksi taputusta: seuraava tila
+    INPUT_SPACE // BUTTON2 tai taputus: välilyönti
+};
+
 volatile char rx_message[MAX_RX_LEN] = {0}; // globaali puskuri
 volatile bool rx_new = false;               // uusi viesti tullut vai ei, ASETETAAN TRUE KUN UUSI VIESTI
 static char rx_buffer[RX_BUFFER_SIZE];
@@ -51,13 +81,19 @@ static size_t rx_index = 0;
 const uint32_t MORSE_FREQ_HZ = 600;    // käytä soveltuvaa taajuutta
 volatile bool button2_pressed = false; // asetetaan BUTTON2 ISR:ssä
 bool morseShown = false;               // onko morse viesti näytetty
+static TaskHandle_t hIMUTask = NULL;   // IMU:n keskeytys herättää tämän tehtävän
 
 // Tehtävien määrittelyt prototyyppinä
 static void buzzer_task(void *arg);
 static void print_task(void *arg);
 static void btn_fxn(uint gpio, uint32_t eventMask);
+static void input_event(enum input_event ev);
 static void usbTask(void *arg);
 void imu_task(void *pvParameters);
+#if MIC_INPUT
+static int mic_init(void);
+static void mic_frame(const int16_t *pcm, size_t n, void *arg);
+#endif
 void tud_cdc_rx_cb(uint8_t itf);
 
 // ALLA PÄÄOHJELMA
@@ -90,7 +126,6 @@ int main()
     TaskHandle_t hBuzzerTaskHandle = NULL;
     TaskHandle_t hPrintTask = NULL;
     TaskHandle_t hUsb = NULL;
-    TaskHandle_t hIMUTask = NULL;
 
     // Create the tasks with xTaskCreate
     BaseType_t result = xTaskCreate(print_task,         // Task function
@@ -125,6 +160,18 @@ int main()
     vTaskCoreAffinitySet(hUsb, 1u << 0);
 #endif
 
+#if MIC_INPUT
+    // Mikrofoni 8 kHz:llä. SDK:n mikrofonitehtävä (prioriteetti 2, ydin 1)
+    // suodattaa puskurit ja kutsuu mic_framea; DMA-keskeytys vain herättää sen.
+    struct pdm_microphone_task_config mic_cfg = PDM_MICROPHONE_TASK_DEFAULT(mic_frame, NULL);
+    mic_cfg.poll_ms = 50; // tila tarkistetaan myös, kun mikrofoni ei näytteistä
+    if (init_pdm_microphone() < 0 || pdm_microphone_pcm_queue_init(MIC_PCM_FRAMES) < 0 ||
+        mic_init() < 0 || pdm_microphone_task_create(&mic_cfg) < 0)
+    {
+        usb_serial_print("Microphone init failed, audio input disabled\n");
+    }
+#endif
+
     // VERY IMPORTANT, THIS SHOULD GO JUST BEFORE vTaskStartSheduler
     // WITHOUT ANY DELAYS. OTHERWISE, THE TinyUSB stack wont recognize
     // the device.
@@ -151,6 +198,49 @@ static void usbTask(void *arg)
     }
 }
 
+// "Hyvät, pahat ja rumat" -teemamusiikin lyhyt intro
+// rtttl2c "Intro:d=16,o=4,b=100:a,d5,a,d5,2a,4f,4g,2d."
+static const struct melody_note melody_gbu[] = {
+    {440, 150}, {587, 150}, {440, 150}, {587, 150},
+    {440, 1200}, {349, 600}, {392, 600}, {294, 1800},
+};
+
+// "MISSION IMPOSSIBLE" -teemamusiikin lyhyt intro ALKUSOITTO
+// rtttl2c "MI:d=8,o=3,b=100:g,16p,g.,a#,c4,g,16p,g.,f,f#"
+static const struct melody_note melody_mi[] = {
+    {196, 300}, {0, 150}, {196, 450}, {233, 300},
+    {262, 300}, {196, 300}, {0, 150}, {196, 450},
+    {175, 300}, {185, 300},
+};
+
+// "MISSION IMPOSSIBLE" -teemamusiikin lyhyt intro LOPPUSOITTO
+// (1500 ms nuotteja ei voi kirjoittaa RTTTL:nä, joten taulukko on käsin tehty)
+static const struct melody_note melody_mi_end[] = {
+    {880, 150}, {698, 150}, {587, 1500}, {880, 150},
+    {698, 150}, {554, 1500}, {880, 150}, {698, 150},
+    {523, 1500}, {466, 150}, {523, 150},
+};
+
+#define MELODY_LEN(m) (sizeof(m) / sizeof((m)[0]))
+
+// Kutsutaan ajastimen keskeytyksessä, kun melodiajono on soitettu
+static void melody_done(void *arg)
+{
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR((TaskHandle_t)arg, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+// Odottaa melodian loppuun; tehtävä on blokattuna eikä kuluta CPU:ta,
+// ajastin vaihtaa nuotit
+static void melody_wait(void)
+{
+    while (melody_is_playing())
+    {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+    }
+}
+
 /**
  * @brief Summeritehtävä ilmoituksia ja melodioita varten.
  *
@@ -165,6 +255,8 @@ static void usbTask(void *arg)
  * - Melodiaa ennen LED/ näyttötehtävät keskeytetään
  *   ja sen jälkeen programState päivitetään ja LED-/näyttötehtävät
  *   palautetaan toimintaan.
+ * - Melodiat soittaa ajastin (tkjhat/melody.h): tehtävä odottaa blokattuna
+ *   ilmoitusta melodian loppumisesta.
  *
  * @param arg Käyttämätön parametri, vaaditaan FreeRTOS-tehtävän prototyypin mukaan.
  */
@@ -173,23 +265,7 @@ static void buzzer_task(void *arg)
 {
     (void)arg;
 
-    // "Hyvät, pahat ja rumat" -teemamusiikin lyhyt intro
-    const uint32_t notes[] = {440, 587, 440, 587, 440, 349, 392, 293};
-    const uint32_t durs[] = {150, 150, 150, 150, 1200, 600, 600, 1800};
-    const size_t count = sizeof(notes) / sizeof(notes[0]);
-    // "HYVÄT, PAHAT JA RUMAT" -teemamusiikin lyhyt intro LOPPUU
-
-    // "MISIION IMPOSSIBLE" -teemamusiikin lyhyt intro ALKUSOITTO
-    const uint32_t notes_M_I[] = {196, 0, 196, 233, 261, 196, 0, 196, 175, 185};
-    const uint32_t durs_M_I[] = {300, 150, 450, 300, 300, 300, 150, 450, 300, 300};
-    const size_t count_M_I = sizeof(notes_M_I) / sizeof(notes_M_I[0]);
-    // "MISSION IMPOSSIBLE" -teemamusiikin lyhyt intro ALKUSOITTO
-
-    // "MISIION IMPOSSIBLE" -teemamusiikin lyhyt intro LOPPUSOITTO
-    const uint32_t notes_M_I_2[] = {880, 698, 587, 880, 698, 554, 880, 698, 523, 466, 523};
-    const uint32_t durs_M_I_2[] = {150, 150, 1500, 150, 150, 1500, 150, 150, 1500, 150, 150};
-    const size_t count_M_I_2 = sizeof(notes_M_I_2) / sizeof(notes_M_I_2[0]);
-    // "MISSION IMPOSSIBLE" -teemamusiikin lyhyt intro LOPPUSOITTO
+    melody_set_done_callback(melody_done, xTaskGetCurrentTaskHandle());
 
     while (1)
     {
@@ -204,38 +280,17 @@ static void buzzer_task(void *arg)
             if (programState == MSG_RECEIVED)
             {
                 write_text("VIESTI"); // näytetään merkki MELODIAN AJAKSI
-                // Soita "MISSION IMPOSSIBLE" melodian alku
-                for (int i = 0; i < 2; i++)
-                {
-                    for (size_t j = 0; j < count_M_I; j++)
-                    {
-                        if (notes_M_I[j] == 0)
-                        {
-                            sleep_ms(durs_M_I[j]); // tauko
-                        }
-                        else
-                        {
-                            buzzer_play_tone(notes_M_I[j], durs_M_I[j]);
-                        }
-                    }
-                }
+                // Soita "MISSION IMPOSSIBLE" melodian alku kahdesti
+                melody_play(melody_mi, MELODY_LEN(melody_mi));
+                melody_queue(melody_mi, MELODY_LEN(melody_mi));
             }
             else if (programState == MSG_PRINTED)
             {
                 write_text("OVER"); // näytetään merkki MELODIAN AJAKSI
-                // Soita "MISSION IMPOSSIBLE" melodian alku
-                for (size_t i = 0; i < count_M_I_2; i++)
-                {
-                    if (notes_M_I_2[i] == 0)
-                    {
-                        sleep_ms(durs_M_I_2[i]); // tauko
-                    }
-                    else
-                    {
-                        buzzer_play_tone(notes_M_I_2[i], durs_M_I_2[i]);
-                    }
-                }
+                // Soita "MISSION IMPOSSIBLE" melodian loppu
+                melody_play(melody_mi_end, MELODY_LEN(melody_mi_end));
             }
+            melody_wait();
 
             set_led_status(false);
 
@@ -262,17 +317,8 @@ static void buzzer_task(void *arg)
             write_text(" MSG SENT"); // näytetään merkki MELODIAN AJAKSI
 
             // Soita "HYVÄT PAHAT JA RUMAT" melodian alku
-            for (size_t i = 0; i < count; i++)
-            {
-                if (notes[i] == 0)
-                {
-                    sleep_ms(durs[i]); // tauko
-                }
-                else
-                {
-                    buzzer_play_tone(notes[i], durs[i]);
-                }
-            }
+            melody_play(melody_gbu, MELODY_LEN(melody_gbu));
+            melody_wait();
 
             // palautetaan tila lähtöön
             programState = WAITING;
@@ -283,13 +329,25 @@ static void buzzer_task(void *arg)
     }
 }
 
+// Kutsutaan ajastimen keskeytyksessä, kun soitettava symboli vaihtuu
+static void morse_symbol_cb(int symbol, void *arg)
+{
+    (void)symbol;
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR((TaskHandle_t)arg, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
 /**
  * @brief Viestin tulostustehtävä morsekoodina.
  *
  * Tämä FreeRTOS-tehtävä tarkistaa, onko saapunut uusi viesti (rx_new)
- * ja tulostaa sen merkkikerrallaan morsekoodina:
- * - Summeri ja LED vilkkuvat morsekoodin mukaan.
- * - Näyttö näyttää symbolin keskellä koko merkin ajan.
+ * ja tulostaa sen morsekoodina:
+ * - Viesti käännetään on/off-aikajanaksi (tkjhat/morse_player.h), jonka
+ *   ajastin soittaa: summeri ja LED vilkkuvat yhdessä mikrosekunnin
+ *   tarkkuudella PARIS-ajoituksella (MORSE_WPM, MORSE_FARNSWORTH_WPM).
+ * - Näyttö näyttää soitettavan symbolin; tehtävä herää vain symbolin
+ *   vaihtuessa eikä vaikuta ajoitukseen.
  * - Kun viesti on tulostettu, programState päivitetään MSG_PRINTED-tilaan.
  *
  * @param arg Käyttämätön parametri, vaaditaan FreeRTOS-tehtävän prototyypin mukaan.
@@ -299,9 +357,14 @@ static void print_task(void *arg)
 {
     (void)arg;
 
-    const uint32_t unit_ms = 100;         // perusyksikkö morse-ajalle, haettu netistä nämä(säädä tarpeen mukaan)
-    const uint32_t dot_ms = unit_ms;      // pisteen kesto
-    const uint32_t dash_ms = 3 * unit_ms; // viivan kesto
+    // Aikajana: enintään kaksi askelta (väli ja ääni) merkkiä kohden
+    static struct morse_step steps[2 * MAX_RX_LEN];
+
+    struct morse_timing timing;
+    if (morse_timing_wpm(&timing, MORSE_WPM, MORSE_FARNSWORTH_WPM) != 0)
+    {
+        morse_timing_wpm(&timing, 12, 0); // virheellinen asetus -> 12 WPM
+    }
 
     while (1)
     {
@@ -331,70 +394,27 @@ static void print_task(void *arg)
                 usb_serial_flush();
             }
 
-            // Toista merkkien mukaan morseaakkosena
-            // local sisältää merkit: '.', '-', ' ' ja mahdollisesti '\n'
-            for (size_t i = 0; local[i] != '\0'; ++i)
+            // Käännä viesti aikajanaksi ('.', '-', ' ' ja sanavälinä kaksi
+            // välilyöntiä; muut merkit ohitetaan, '\n' lopettaa) ja soita se
+            int count = morse_compile(local, &timing, steps, sizeof(steps) / sizeof(steps[0]));
+            if (count > 0 &&
+                morse_player_start(steps, (size_t)count, MORSE_FREQ_HZ, morse_symbol_cb,
+                                   xTaskGetCurrentTaskHandle()) == 0)
             {
-                char c = local[i];
-
-                clear_display();
-
-                // Valmistele symboli
-                char sym[3] = " ";
-                if (c == '.')
-                    sym[0] = '.';
-                else if (c == '-')
-                    sym[0] = '-';
-                else if (c == ' ')
-                    sym[0] = ' '; // välilyönti = tyhjä
-                else
+                // Näytä soitettava symboli keskellä; ajastin soittaa, tehtävä
+                // odottaa blokattuna symbolin vaihtumista
+                int shown = -1;
+                while (morse_player_is_playing())
                 {
-                    sym[0] = c;
-                } // jos jotain muuta
-
-                /// Näytä symboli keskellä
-
-                write_text(sym);
-
-                /* Toista symboli (buzzer + LED) ja pidä näyttö siinä tilassa koko merkin ajan */
-                if (c == '.')
-                {
-                    set_led_status(true);
-                    buzzer_play_tone(MORSE_FREQ_HZ, dot_ms); // soittaa dot_ms aikaa
-                    set_led_status(false);
-                    vTaskDelay(pdMS_TO_TICKS(unit_ms));
-                }
-                else if (c == '-')
-                {
-                    set_led_status(true);
-                    buzzer_play_tone(MORSE_FREQ_HZ, dash_ms); // soittaa dash_ms aikaa
-                    set_led_status(false);
-                    vTaskDelay(pdMS_TO_TICKS(unit_ms));
-                }
-                else if (c == ' ')
-                {
-                    /* välilyönti: kirjain-/sanaväli */
-                    if (local[i + 1] == ' ')
-                    {
-                        /* sanaväli = 7 units */
-                        vTaskDelay(pdMS_TO_TICKS(7 * unit_ms));
-                        ++i; /* skippaa seuraavan välilyönnin, osa sanaväliä */
-                    }
-                    else
+                    int symbol = morse_player_symbol();
+                    if (symbol >= 0 && symbol != shown)
                     {
-                        /* kirjainväli = 3 units */
-                        vTaskDelay(pdMS_TO_TICKS(3 * unit_ms));
+                        char sym[2] = {local[symbol], '\0'};
+                        clear_display();
+                        write_text(sym);
+                        shown = symbol;
                     }
-                }
-                else if (c == '\n' || c == '\r')
-                {
-                    vTaskDelay(pdMS_TO_TICKS(3 * unit_ms));
-                    break;
-                }
-                else
-                {
-                    /* tuntematon merkki esim ääkkönen -> pieni tauko */
-                    vTaskDelay(pdMS_TO_TICKS(unit_ms));
+                    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
                 }
             }
 
@@ -414,6 +434,21 @@ static void print_task(void *arg)
 static void btn_fxn(uint gpio, uint32_t events)
 {
     if (gpio == BUTTON1 && (events & GPIO_IRQ_EDGE_FALL))
+    {
+        input_event(INPUT_NEXT);
+    }
+
+    if (gpio == BUTTON2 && (events & GPIO_IRQ_EDGE_FALL))
+    {
+        input_event(INPUT_SPACE);
+    }
+}
+
+// Syötteen käsittely. Kutsutaan painikkeen keskeytyksestä ja
+// mikrofonitehtävästä (taputukset), joten tässä vain asetetaan tila ja liput.
+static void input_event(enum input_event ev)
+{
+    if (ev == INPUT_NEXT)
     {
 
         // Painnikkeen 1 havaittua muutetaan laitteen tilaa SWITCH rakenteen avulla
@@ -435,21 +470,72 @@ static void btn_fxn(uint gpio, uint32_t events)
         }
     }
 
-    if (gpio == BUTTON2 && (events & GPIO_IRQ_EDGE_FALL))
+    if (ev == INPUT_SPACE)
     {
         button2_pressed = true;
     }
 }
 
+// IMU:n keskeytys (APEX wake-on-motion). Ajetaan keskeytyskontekstissa:
+// herätetään vain imu_task, I2C-lukeminen tehdään tehtävässä.
+static void imu_irq_cb(void)
+{
+    BaseType_t woken = pdFALSE;
+    if (hIMUTask != NULL)
+        vTaskNotifyGiveFromISR(hIMUTask, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+// Lähetä yksi morse-symboli CDC1:lle ja kuittaus CDC0:lle
+static void transmit_morse_symbol(char sym, const char *name)
+{
+    char outbuf[32];
+
+    tud_cdc_n_write(CDC_ITF_TX, (uint8_t *)&sym, 1);
+    tud_cdc_n_write_flush(CDC_ITF_TX);
+    snprintf(outbuf, sizeof(outbuf), "Sent symbol: %s\n", name);
+    usb_serial_print(outbuf);
+}
+
+// Näytä, soita ja lähetä yksi morse-symboli
+static void send_morse_symbol(char sym, uint32_t tone_ms, const char *name)
+{
+    char text[2] = {sym, '\0'};
+
+    clear_display();
+    write_text(text);
+    set_led_status(true);
+#if MORSE_MIC_INPUT
+    // Mikrofoni kuuntelee: oma summeri tulkittaisiin uudelleen symboleiksi
+    vTaskDelay(pdMS_TO_TICKS(tone_ms));
+#else
+    buzzer_play_tone(MORSE_FREQ_HZ, tone_ms);
+#endif
+    set_led_status(false);
+    clear_display();
+
+    // Lähetä symboli välittömästi
+    transmit_morse_symbol(sym, name);
+}
+
 // IMU TEHTÄVÄSSÄ OLLAAN KUN COLLECTING ON OHJELMAN TILANA
+// IMU:n wake-on-motion herättää tehtävän. Silloin luetaan IMU:n FIFO, jossa on
+// myös liikettä edeltävät näytteet, ja syötetään näytteet eleentunnistimelle
+// (tkjhat/gesture.h): Z-akselin liike = piste, X-akselin liike = viiva.
+// Kun liike on loppunut, tehtävä nukkuu taas eikä lue IMU:ta.
+// Levossa FIFO luetaan harvoin: paikallaan olevista näytteistä opitaan
+// anturin bias lämpötilan funktiona (tkjhat/imu_tempcomp.h). Malli poistetaan
+// näytteistä ennen eleentunnistusta ja se säilyy flashissa virrankatkon yli.
 
 void imu_task(void *pvParameters)
 {
     (void)pvParameters;
     clear_display();
 
-    float ax = 0, ay = 0, az = 0, gx = 0, gy = 0, gz = 0, temp = 0;
     char outbuf[128];
+    static gesture_t gesture;
+    static icm42670_raw_sample_t batch[IMU_BATCH];
+    static imu_tempcomp_t tempcomp;
 
     // Alusta IMU kunnes onnistuu
     while (1)
@@ -472,121 +558,300 @@ void imu_task(void *pvParameters)
         }
     }
 
-    enum
+    // FIFO toimii koko ajan: herätessä siinä on viimeisimmät 128 näytettä
+    if (ICM42670_fifo_start() != 0)
+    {
+        usb_serial_print("ICM FIFO start failed\n");
+    }
+
+    const struct icm42670_apex_config apex_cfg = {
+        .events = ICM42670_APEX_WOM_ANY,
+        .wom_threshold_mg = WOM_THRESHOLD_MG,
+        .wom_compare_previous = true, // verrataan edelliseen näytteeseen = liike
+    };
+    int ra = ICM42670_apex_start(&apex_cfg, imu_irq_cb);
+    if (ra != 0)
     {
-        IDLE,
-        DOT_STATE,
-        DASH_STATE
-    } motion_state = IDLE;
+        snprintf(outbuf, sizeof(outbuf), "ICM APEX start failed (ret=%d)\n", ra);
+        usb_serial_print(outbuf);
+    }
 
-    // edelliset arvot delta-laskentaa varten
-    float prev_ax = 0, prev_az = 1;
+    struct gesture_config gesture_cfg;
+    gesture_default_config(&gesture_cfg, ICM42670_ACCEL_ODR_DEFAULT, ICM42670_ACCEL_FSR_DEFAULT);
+    gesture_init(&gesture, &gesture_cfg);
+
+    struct imu_tempcomp_config tempcomp_cfg;
+    imu_tempcomp_default_config(&tempcomp_cfg, ICM42670_ACCEL_ODR_DEFAULT, ICM42670_ACCEL_FSR_DEFAULT,
+                                ICM42670_GYRO_FSR_DEFAULT);
+    imu_tempcomp_init(&tempcomp, &tempcomp_cfg);
+    if (imu_tempcomp_load_flash(&tempcomp) == 0)
+        usb_serial_print("IMU bias model loaded from flash\n");
+    else
+        usb_serial_print("No IMU bias model in flash, learning from scratch\n");
+    uint64_t tempcomp_next_read = time_us_64() + TEMPCOMP_IDLE_READ_US;
+    uint64_t tempcomp_next_save = time_us_64() + TEMPCOMP_SAVE_US;
+
+    bool collecting = false;     // oltiinko edellisellä kierroksella COLLECTING-tilassa
+    bool active = false;         // luetaanko FIFOa (liikettä havaittu)
+    uint64_t active_until = 0;   // FIFOa luetaan vähintään tähän asti viimeisestä herätyksestä
 
     while (1)
     {
-        if (programState == COLLECTING)
+        // Odotetaan IMU:n keskeytystä. Liikkeen aikana FIFO luetaan 20 ms välein,
+        // muuten aikakatkaisu vain BUTTON2:n ja tilan tarkistusta varten.
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(active ? IMU_READ_PERIOD_MS : 50));
+
+        if (programState != COLLECTING)
         {
-            if (!morseShown)
-            {
-                clear_display();
-                write_text("MORSENOW");
-                morseShown = true;
-            }
+            // WAITING ja muut tilat: ei IMU-liikennettä ollenkaan
+            collecting = false;
+            active = false;
+            continue;
+        }
 
-            // --- Button2 käsittely: välilyönti ---
-            if (button2_pressed)
-            {
-                char sym = ' ';
-                clear_display();
-                write_text("SPACE");
-                sleep_ms(100);
-                clear_display();
-
-                // Lähetä heti CDC0:lle
-                tud_cdc_n_write(CDC_ITF_TX, (uint8_t *)&sym, 1);
-                tud_cdc_n_write_flush(CDC_ITF_TX);
-                usb_serial_print("Sent symbol: SPACE\n");
-
-                button2_pressed = false;
-                vTaskDelay(pdMS_TO_TICKS(50));
-            }
+        if (!collecting)
+        {
+            // Unohdetaan liikkeet, jotka tapahtuivat ennen COLLECTING-tilaa
+            ICM42670_apex_flush_events();
+            ICM42670_fifo_flush();
+            gesture_reset(&gesture);
+            collecting = true;
+        }
 
-            // --- IMU-luku ---
-            int rr = ICM42670_read_sensor_data(&ax, &ay, &az, &gx, &gy, &gz, &temp);
-            if (rr != 0)
-            {
-                snprintf(outbuf, sizeof(outbuf), "IMU read failed (ret=%d)\n", rr);
-                usb_serial_print(outbuf);
-                vTaskDelay(pdMS_TO_TICKS(50));
-                continue;
-            }
+        if (!morseShown)
+        {
+            clear_display();
+            write_text("MORSENOW");
+            morseShown = true;
+        }
+
+        // --- Button2 käsittely: välilyönti ---
+        if (button2_pressed)
+        {
+            char sym = ' ';
+            clear_display();
+            write_text("SPACE");
+            sleep_ms(100);
+            clear_display();
 
-            // --- Suodatettu liike ja delta ---
-            float delta_ax = fabs(ax - prev_ax);
-            float delta_az = fabs(az - prev_az);
-            prev_ax = ax;
-            prev_az = az;
+            // Lähetä heti CDC0:lle
+            tud_cdc_n_write(CDC_ITF_TX, (uint8_t *)&sym, 1);
+            tud_cdc_n_write_flush(CDC_ITF_TX);
+            usb_serial_print("Sent symbol: SPACE\n");
 
-            // --- DEBUG: tulosta JOKA KERTA ---
-            snprintf(outbuf, sizeof(outbuf), "ax=%.3f  az=%.3f\n", prev_ax, prev_az);
-            usb_serial_print(outbuf);
+            button2_pressed = false;
+            vTaskDelay(pdMS_TO_TICKS(50));
+        }
 
-            // --- DOT tunnistus ---
-            if (motion_state == IDLE && delta_az > 0.15f)
+        // --- Herätys: IMU havaitsi liikettä ---
+        icm42670_apex_event_t ev;
+        bool woken = false;
+        while (ICM42670_apex_read_event(&ev) > 0)
+            woken = true;
+        if (woken)
+        {
+            if (!active)
             {
-                char sym = '.';
-                clear_display();
-                write_text(".");
-                set_led_status(true);
-                buzzer_play_tone(MORSE_FREQ_HZ, 100);
-                set_led_status(false);
-                clear_display();
-
-                // Lähetä symboli välittömästi
-                tud_cdc_n_write(CDC_ITF_TX, (uint8_t *)&sym, 1);
-                tud_cdc_n_write_flush(CDC_ITF_TX);
-                usb_serial_print("Sent symbol: DOT\n");
-
-                motion_state = DOT_STATE;
+                gesture_reset(&gesture); // FIFOssa on jatkuva pätkä, vanha tila ei ole enää voimassa
+                imu_tempcomp_reset_window(&tempcomp);
             }
-            // --- DASH tunnistus ---
-            else if (motion_state == IDLE && delta_ax > 0.15f)
+            active = true;
+            active_until = time_us_64() + IMU_ACTIVE_US;
+        }
+        if (!active)
+        {
+            // --- Levossa: biasin oppiminen ---
+            // FIFO on täynnä paikallaan olon näytteitä (128 kpl). Luku ei mene eleentunnistukselle.
+            if (time_us_64() > tempcomp_next_read)
             {
-                char sym = '-';
-                clear_display();
-                write_text("-");
-                set_led_status(true);
-                buzzer_play_tone(MORSE_FREQ_HZ, 300);  
-                set_led_status(false);
-                clear_display();
-
-                // Lähetä symboli välittömästi
-                tud_cdc_n_write(CDC_ITF_TX, (uint8_t *)&sym, 1);
-                tud_cdc_n_write_flush(CDC_ITF_TX);
-                usb_serial_print("Sent symbol: DASH\n");
-
-                motion_state = DASH_STATE;
+                tempcomp_next_read = time_us_64() + TEMPCOMP_IDLE_READ_US;
+                imu_tempcomp_reset_window(&tempcomp);
+                int n;
+                while ((n = ICM42670_fifo_read(batch, IMU_BATCH)) > 0)
+                    imu_tempcomp_learn(&tempcomp, batch, (size_t)n);
             }
+            // Flashin kirjoitus pysäyttää molemmat ytimet hetkeksi: vain levossa ja harvoin
+            if (imu_tempcomp_dirty(&tempcomp) && time_us_64() > tempcomp_next_save)
+            {
+                tempcomp_next_save = time_us_64() + TEMPCOMP_SAVE_US;
+                if (imu_tempcomp_save_flash(&tempcomp) == 0)
+                    usb_serial_print("IMU bias model saved to flash\n");
+            }
+            continue;
+        }
 
-            // --- Reset state kun liike loppuu ---
-            if (motion_state != IDLE)
+        // --- FIFO-luku ja eleentunnistus ---
+        int n;
+        do
+        {
+            n = ICM42670_fifo_read(batch, IMU_BATCH);
+            if (n < 0)
             {
-                if ((motion_state == DOT_STATE && delta_az < 0.02f) ||
-                    (motion_state == DASH_STATE && delta_ax < 0.01f))
-                {
-                    motion_state = IDLE;
-                    vTaskDelay(pdMS_TO_TICKS(50));
-                }
+                snprintf(outbuf, sizeof(outbuf), "IMU FIFO read failed (ret=%d)\n", n);
+                usb_serial_print(outbuf);
+                break;
+            }
+            // Bias pois ennen eleentunnistusta (oppiminen raa'asta datasta)
+            imu_tempcomp_learn(&tempcomp, batch, (size_t)n);
+            imu_tempcomp_apply(&tempcomp, batch, (size_t)n);
+            for (int k = 0; k < n; k++)
+            {
+                gesture_class_t c = gesture_push(&gesture, &batch[k]);
+                // --- DOT tunnistus ---
+                if (c == GESTURE_DOT)
+                    send_morse_symbol('.', 100, "DOT");
+                // --- DASH tunnistus ---
+                else if (c == GESTURE_DASH)
+                    send_morse_symbol('-', 300, "DASH");
             }
+        } while (n == IMU_BATCH);
 
-            vTaskDelay(pdMS_TO_TICKS(20)); // pieni viive lukujen välillä
-        }
-        else
+        // Liike loppui: takaisin nukkumaan
+        if (!gesture_busy(&gesture) && time_us_64() > active_until)
+            active = false;
+    }
+}
+
+#if MIC_INPUT
+// MIKROFONI: COLLECTING-tilassa kuunnellaan toisen laitteen summeria
+// (MORSE_MIC_INPUT) ja taputuksia (MIC_CLAP_INPUT).
+// tone_detect etsii MORSE_FREQ_HZ-äänen 10 ms lohkoista (Goertzel, yksi
+// kertolasku näytettä kohden) ja morse_decode muuttaa äänen ja hiljaisuuden
+// pituudet pisteiksi, viivoiksi ja väleiksi. Symbolit lähetetään samoin kuin
+// liikkeellä tehdyt. LED näyttää, kuuleeko laite äänen.
+// vad (äänen tunnistin) ohittaa hiljaiset kehykset: niille ei lasketa
+// Goertzelia, dekooderi saa vain hiljaisuuden keston.
+// clap tunnistaa lyhyet terävät äänet (vähennys ja yhteenlasku näytettä
+// kohden) ja antaa ne input_eventille kuten painikkeet.
+// Muissa tiloissa mikrofoni ei näytteistä.
+#if MORSE_MIC_INPUT
+static tone_detect_t tone;
+static morse_decode_t decoder;
+static vad_t vad;
+#endif
+#if MIC_CLAP_INPUT
+static clap_t clap;
+#endif
+
+static int mic_init(void)
+{
+#if MORSE_MIC_INPUT
+    struct tone_detect_config tone_cfg;
+    tone_detect_default_config(&tone_cfg, MEMS_SAMPLING_FREQUENCY, MORSE_FREQ_HZ);
+    struct morse_decode_config decoder_cfg;
+    morse_decode_default_config(&decoder_cfg, MORSE_UNIT_MS);
+    struct vad_config vad_cfg;
+    vad_default_config(&vad_cfg, MEMS_SAMPLING_FREQUENCY);
+    if (tone_detect_init(&tone, &tone_cfg) != 0 || morse_decode_init(&decoder, &decoder_cfg) != 0 ||
+        vad_init(&vad, &vad_cfg) != 0)
+        return -1;
+#endif
+#if MIC_CLAP_INPUT
+    struct clap_config clap_cfg;
+    clap_default_config(&clap_cfg, MEMS_SAMPLING_FREQUENCY);
+    if (clap_init(&clap, &clap_cfg) != 0)
+        return -1;
+#endif
+    return 0;
+}
+
+#if MORSE_MIC_INPUT
+static void mic_send_symbols(const char *sym, size_t k)
+{
+    for (size_t j = 0; j < k; j++)
+        transmit_morse_symbol(sym[j], sym[j] == '.' ? "DOT" : sym[j] == '-' ? "DASH" : "SPACE");
+}
+
+// Summerin ääni morsemerkeiksi
+static void mic_morse(const int16_t *pcm, size_t n)
+{
+    static bool led = false;
+    bool key[MEMS_BUFFER_SIZE / 8]; // lohkossa on vähintään 8 näytettä
+    char sym[MORSE_DECODE_MAX_OUT];
+    const uint32_t block_ms = tone_detect_block_us(&tone) / 1000;
+
+    if (n == 0)
+    {
+        // Näytteistys alkoi tai loppui
+        tone_detect_reset(&tone);
+        morse_decode_reset(&decoder);
+        vad_reset(&vad);
+        led = false;
+        set_led_status(false);
+        return;
+    }
+
+    bool was_active = vad_active(&vad);
+    if (MORSE_MIC_VAD && !vad_push(&vad, pcm, n))
+    {
+        // Hiljaista: koko kehys yhtenä taukona
+        mic_send_symbols(sym, morse_decode_step(&decoder, false, (uint32_t)n * 1000 / MEMS_SAMPLING_FREQUENCY, sym));
+    }
+    else
+    {
+        if (MORSE_MIC_VAD && !was_active)
+            tone_detect_reset(&tone); // vanha vajaa lohko pois
+        size_t blocks = tone_detect_push(&tone, pcm, n, key, sizeof(key) / sizeof(key[0]));
+        for (size_t b = 0; b < blocks; b++)
+            mic_send_symbols(sym, morse_decode_step(&decoder, key[b], block_ms, sym));
+    }
+    if (tone_detect_key(&tone) != led)
+    {
+        led = !led;
+        set_led_status(led);
+    }
+}
+#endif
+
+// Kutsutaan mikrofonitehtävässä jokaiselle PCM-kehykselle, ja n = 0 50 ms
+// välein, kun kehyksiä ei tule
+static void mic_frame(const int16_t *pcm, size_t n, void *arg)
+{
+    (void)arg;
+    static bool sampling = false;
+
+    bool collecting = (programState == COLLECTING);
+    if (collecting != sampling)
+    {
+        if (collecting && init_microphone_sampling() < 0)
         {
-            vTaskDelay(pdMS_TO_TICKS(100));
+            usb_serial_print("Cannot start sampling the microphone\n");
+            vTaskDelay(pdMS_TO_TICKS(500));
+            return;
         }
+        if (!collecting)
+            end_microphone_sampling();
+        sampling = collecting;
+#if MORSE_MIC_INPUT
+        mic_morse(NULL, 0);
+#endif
+#if MIC_CLAP_INPUT
+        clap_reset(&clap);
+#endif
+        return;
+    }
+    if (!sampling || n == 0)
+        return;
+
+#if MIC_CLAP_INPUT
+    // Yksi taputus = välilyönti, kaksi = lähetys (kolme tai useampi ohitetaan)
+    switch (clap_push(&clap, pcm, n))
+    {
+    case 1:
+        input_event(INPUT_SPACE);
+        break;
+    case 2:
+        input_event(INPUT_NEXT);
+        break;
+    default:
+        break;
     }
+#endif
+#if MORSE_MIC_INPUT
+    mic_morse(pcm, n);
+#endif
 }
+#endif
 
 /**
  * @brief USB CDC -vastaanottokäsittelijä.